@@ -0,0 +1,739 @@
+// Benchmarks for the database engine. The engine is compiled into this file
+// without its REPL, so the benchmarks can call the operators directly.
+#define CS301_NO_MAIN
+#include "cs301project.cpp"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+// Benchmark functions
+void bench_kernels(int row_count);
+template <typename T>
+void bench_kernel_column(const Column &column, const vector<T> &values, T literal, const char *type_name);
+template <typename T>
+bool reference_compare(T value, T literal, enum compare_op op);
+void bench_dictionary(int row_count);
+void bench_parallel_scan(int row_count);
+void bench_aggregate(int row_count);
+void bench_top_k(int row_count);
+void bench_formats(int row_count);
+void bench_stages(const string &data_dir);
+void report_stage(const char *stage, const string &table_name, const string &operation, long rows_in, 
+                  long rows_out, double seconds);
+template <typename F>
+double best_seconds(int run_count, const F &run);
+void bench_string_column(Table &table, const char *encoding_name);
+double seconds_since(chrono::steady_clock::time_point start_time);
+
+/**
+ * Runs the benchmarks.
+ *
+ * @param row_count The number of rows to generate for each benchmark,
+ *                  defaults to 16 million.
+ * @param --data    Instead of the generated benchmarks, times the stages of 
+ *                  a query on the database in a directory, followed by the
+ *                  path and optionally the number of threads. See 
+ *                  generate_data.cpp for making one.
+ *
+ * @retval  0 The benchmarks ran successfully.
+ * @retval -1 The arguments are not valid.
+*/
+int main(int argc, char **argv)
+{
+    int thread_count = 1;
+    int row_count = 1 << 24;
+    if ((argc > 2) && (string(argv[1]) == "--data") && ((argc == 3) || parse_argument(argv[3], 1, thread_count)))
+    {
+        query_pool.start(thread_count);
+        bench_stages(argv[2]);
+        query_pool.stop();
+        return 0;
+    }
+
+    if ((argc > 2) || ((argc == 2) && !parse_argument(argv[1], 1, row_count)))
+    {
+        cout << "Usage: " << argv[0] << " [row_count]" << endl;
+        cout << "       " << argv[0] << " --data <data_dir> [thread_count]" << endl;
+        return -1;
+    }
+
+    bench_kernels(row_count);
+    bench_dictionary(row_count / 4);
+    bench_aggregate(row_count);
+    bench_top_k(row_count);
+    bench_formats(row_count / 4);
+    bench_parallel_scan(row_count);
+    return 0;
+}
+
+/**
+ * Times the WHERE comparison kernels against the scalar filter loop for every
+ * inequality and every instruction set the CPU supports. The rows and masks 
+ * of every kernel, and the rows of the loop, are checked against a reference
+ * that compares one value at a time.
+ *
+ * @param row_count The number of rows in the generated columns.
+*/
+void bench_kernels(int row_count)
+{
+    mt19937 generator(301);
+    uniform_int_distribution<int> int_distribution(0, 99999);
+    uniform_real_distribution<float> float_distribution(0.0f, 100000.0f);
+    bernoulli_distribution null_distribution(0.05);
+
+    Column int_column = new_column("INT_COLUMN", INT);
+    Column float_column = new_column("FLOAT_COLUMN", FLOAT);
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        Data data_item;
+        data_item.empty = null_distribution(generator);
+        data_item.int_data = int_distribution(generator);
+        data_item.float_data = float_distribution(generator);
+        append_data(int_column, data_item);
+        append_data(float_column, data_item);
+    }
+
+    cout << "kernel rows=" << row_count << " (million rows per second on one core, "
+         << "<level>=<with row ids>/<mask only>)" << endl;
+    bench_kernel_column(int_column, int_column.int_data, 50000, "INT");
+    bench_kernel_column(float_column, float_column.float_data, 50000.0f, "FLOAT");
+}
+
+/**
+ * Times every inequality on one column.
+ *
+ * @param column    The column to filter.
+ * @param values    The typed values of the column.
+ * @param literal   The value to compare against.
+ * @param type_name The name of the column type to print.
+*/
+template <typename T>
+void bench_kernel_column(const Column &column, const vector<T> &values, T literal, const char *type_name)
+{
+    const char *op_names[] = { "=", "<>", "<", "<=", ">", ">=" };
+    const char *level_names[] = { "scalar", "sse4.2", "avx2" };
+    enum simd_level detected_level = kernel_simd_level;
+
+    vector<int> all_rows;
+    for (int row_idx = 0; row_idx < column.row_count; row_idx++)
+    {
+        all_rows.push_back(row_idx);
+    }
+
+    for (int op = OP_EQ; op <= OP_GE; op++)
+    {
+        vector<int> expected_rows;
+        for (int row_idx = 0; row_idx < column.row_count; row_idx++)
+        {
+            if (!is_row_empty(column, row_idx) && reference_compare(values[row_idx], literal, (enum compare_op)op))
+                expected_rows.push_back(row_idx);
+        }
+
+        // The per row loop that WHERE used before the kernels
+        vector<int> loop_rows;
+        chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+        filter_column_op(values, column.null_bitmap, literal, (enum compare_op)op, all_rows, loop_rows);
+        double loop_seconds = seconds_since(start_time);
+
+        cout << type_name << " " << op_names[op] << " loop=" << column.row_count / loop_seconds / 1e6;
+        if (loop_rows != expected_rows)
+            cout << " (MISMATCH)";
+
+        for (int level = SIMD_SCALAR; level <= detected_level; level++)
+        {
+            vector<int> matching_rows;
+            kernel_simd_level = (enum simd_level)level;
+            start_time = chrono::steady_clock::now();
+            filter_column_range(values, column.null_bitmap, literal, (enum compare_op)op,
+                                0, column.row_count, matching_rows);
+            double kernel_seconds = seconds_since(start_time);
+
+            // The kernel on its own, without turning the mask into row ids
+            vector<uint64_t> mask((column.row_count + 63) / 64);
+            start_time = chrono::steady_clock::now();
+            compare_kernel(values.data(), column.row_count, literal, (enum compare_op)op, mask.data());
+            double mask_seconds = seconds_since(start_time);
+
+            // The mask also has the bits of the empty rows, compared with 
+            // the zero they store
+            bool mask_matches = true;
+            for (int row_idx = 0; row_idx < column.row_count; row_idx++)
+            {
+                bool mask_bit = (mask[row_idx / 64] >> (row_idx % 64)) & 1;
+                bool expected_bit = reference_compare(values[row_idx], literal, (enum compare_op)op);
+                mask_matches = mask_matches && (mask_bit == expected_bit);
+            }
+
+            cout << " " << level_names[level] << "=" << column.row_count / kernel_seconds / 1e6
+                 << "/" << column.row_count / mask_seconds / 1e6;
+            if ((matching_rows != expected_rows) || !mask_matches)
+                cout << " (MISMATCH)";
+        }
+        cout << " selected=" << expected_rows.size() << endl;
+        kernel_simd_level = detected_level;
+    }
+}
+
+/**
+ * Compares two values the plain way, the reference the kernels are checked
+ * against.
+ *
+ * @param value   The value of a row.
+ * @param literal The value to compare against.
+ * @param op      The inequality to test.
+ *
+ * @return True if the value passes the comparison.
+*/
+template <typename T>
+bool reference_compare(T value, T literal, enum compare_op op)
+{
+    if (op == OP_EQ)
+        return value == literal;
+    else if (op == OP_NE)
+        return value != literal;
+    else if (op == OP_LT)
+        return value < literal;
+    else if (op == OP_LE)
+        return value <= literal;
+    else if (op == OP_GT)
+        return value > literal;
+    else // OP_GE
+        return value >= literal;
+}
+
+/**
+ * Times WHERE and ORDERBY on a STRING column with a few distinct values, 
+ * first storing each value and then dictionary encoded.
+ * 
+ * @param row_count The number of rows in the generated column.
+*/
+void bench_dictionary(int row_count)
+{
+    const char *cities[] = { "Houston", "Spring", "Bellaire", "Humble", "Sugarland", "Stafford", 
+                             "Fondren Southwest", "Greater Greenspoint" };
+    mt19937 generator(301);
+    uniform_int_distribution<int> city_distribution(0, 7);
+    bernoulli_distribution null_distribution(0.05);
+
+    Table table = { .table_name = "BENCH", .tc_column_idx = -1 };
+    table.table_data.push_back(new_column("CITY", STRING));
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        Data data_item;
+        data_item.empty = null_distribution(generator);
+        data_item.string_data = cities[city_distribution(generator)];
+        append_data(table.table_data[0], data_item);
+    }
+
+    cout << "dictionary rows=" << row_count << " distinct=8" << endl;
+    bench_string_column(table, "plain");
+
+    Column plain_column = table.table_data[0];
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    encode_strings(table.table_data[0]);
+    double encode_seconds = seconds_since(start_time);
+    cout << "encode=" << encode_seconds << "s" << endl;
+    bench_string_column(table, "encoded");
+
+    // Both encodings have to give the same rows in the same order
+    Table plain_table = table;
+    plain_table.table_data[0] = plain_column;
+    Predicate where_predicate;
+    compile_where("CITY>=Humble", table, where_predicate);
+    Table_View encoded_view = parse_table(where_predicate, table, 0);
+    Table_View plain_view = parse_table(where_predicate, plain_table, 0);
+    sort_table("CITY:-1", encoded_view);
+    sort_table("CITY:-1", plain_view);
+    if (encoded_view.row_idxs != plain_view.row_idxs)
+        cout << "MISMATCH" << endl;
+}
+
+/**
+ * Times SUM over an INT and a FLOAT column adding one row at a time and with
+ * the sum kernels of every instruction set the CPU supports, and checks that
+ * they give the same sums. Then times a GROUPBY on an INT column with 1000 
+ * distinct values.
+ * 
+ * @param row_count The number of rows in the generated table.
+*/
+void bench_aggregate(int row_count)
+{
+    mt19937 generator(301);
+    uniform_int_distribution<int> int_distribution(0, 99999);
+    uniform_real_distribution<float> float_distribution(0.0f, 100000.0f);
+    uniform_int_distribution<int> group_distribution(0, 999);
+    bernoulli_distribution null_distribution(0.05);
+
+    Table table = { .table_name = "BENCH", .tc_column_idx = -1 };
+    table.table_data.push_back(new_column("ID", INT));
+    table.table_data.push_back(new_column("AMOUNT", FLOAT));
+    table.table_data.push_back(new_column("GROUP_ID", INT));
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        Data data_item;
+        data_item.empty = null_distribution(generator);
+        data_item.int_data = int_distribution(generator);
+        data_item.float_data = float_distribution(generator);
+        append_data(table.table_data[0], data_item);
+        append_data(table.table_data[1], data_item);
+
+        data_item.empty = false;
+        data_item.int_data = group_distribution(generator);
+        append_data(table.table_data[2], data_item);
+    }
+
+    Predicate where_predicate;
+    where_predicate.kind = PREDICATE_AND;
+    Table_View all_rows = parse_table(where_predicate, table, 0, false);
+
+    const char *level_names[] = { "scalar", "sse4.2", "avx2" };
+    enum simd_level detected_level = kernel_simd_level;
+    cout << "aggregate rows=" << row_count << " (million rows per second on one core)" << endl;
+    for (int column_idx = 0; column_idx < 2; column_idx++)
+    {
+        Aggregate item = { .function = AGGREGATE_SUM, .column_idx = column_idx };
+        const Column *column = &table.table_data[column_idx];
+
+        // One row at a time, the way a GROUPBY adds its rows
+        Aggregate_State expected = { 0, 0, 0.0, -1 };
+        chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+        for (int row_idx : all_rows.row_idxs)
+        {
+            accumulate_row(item, column, row_idx, expected);
+        }
+        double loop_seconds = seconds_since(start_time);
+        cout << "SUM(" << column->column_name << ") loop=" << row_count / loop_seconds / 1e6;
+
+        for (int level = SIMD_SCALAR; level <= detected_level; level++)
+        {
+            kernel_simd_level = (enum simd_level)level;
+            Aggregate_State state = { 0, 0, 0.0, -1 };
+            start_time = chrono::steady_clock::now();
+            accumulate_rows(item, column, all_rows.row_idxs.data(), row_count, state);
+            double kernel_seconds = seconds_since(start_time);
+
+            cout << " " << level_names[level] << "=" << row_count / kernel_seconds / 1e6;
+            if ((state.count != expected.count) || (state.int_sum != expected.int_sum) || 
+                (fabs(state.float_sum - expected.float_sum) > 1e-9 * fabs(expected.float_sum)))
+                cout << " (MISMATCH)";
+        }
+        cout << endl;
+        kernel_simd_level = detected_level;
+    }
+
+    Aggregate_Query query;
+    parse_aggregates("GROUP_ID, COUNT(*), SUM(ID), AVG(AMOUNT)", "GROUP_ID", table, query);
+    Table aggregate_table;
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    Table_View result = aggregate_rows(query, all_rows, aggregate_table);
+    double group_seconds = seconds_since(start_time);
+    cout << "GROUPBY groups=" << result.row_idxs.size() << " " << row_count / group_seconds / 1e6 << endl;
+}
+
+/**
+ * Times ORDERBY with LIMIT 20 and LIMIT 1000 against a full sort of an INT 
+ * column with many ties, and checks that they give the same first rows.
+ * 
+ * @param row_count The number of rows in the generated table.
+*/
+void bench_top_k(int row_count)
+{
+    mt19937 generator(301);
+    uniform_int_distribution<int> int_distribution(0, 99999);
+
+    Table table = { .table_name = "BENCH", .tc_column_idx = -1 };
+    table.table_data.push_back(new_column("AMOUNT", INT));
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        Data data_item;
+        data_item.empty = false;
+        data_item.int_data = int_distribution(generator);
+        append_data(table.table_data[0], data_item);
+    }
+
+    Predicate where_predicate;
+    where_predicate.kind = PREDICATE_AND;
+    Table_View all_rows = parse_table(where_predicate, table, 0);
+
+    Table_View sorted_rows = all_rows;
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    sort_table("AMOUNT:-1", sorted_rows);
+    double sort_seconds = seconds_since(start_time);
+    cout << "top-k rows=" << row_count << " full sort=" << sort_seconds * 1000 << "ms";
+
+    for (int row_limit : { 20, 1000 })
+    {
+        Table_View top_rows = all_rows;
+        start_time = chrono::steady_clock::now();
+        sort_table("AMOUNT:-1", top_rows, row_limit);
+        double top_seconds = seconds_since(start_time);
+
+        cout << " LIMIT " << row_limit << "=" << top_seconds * 1000 << "ms";
+        if (!equal(top_rows.row_idxs.begin(), top_rows.row_idxs.end(), sorted_rows.row_idxs.begin()))
+            cout << " (MISMATCH)";
+    }
+    cout << endl;
+}
+
+/**
+ * Times formatting a table of INT, FLOAT and STRING columns in every output 
+ * format on one core, the same morsels print_table formats. Some strings hold
+ * commas and quotes, so CSV and JSON Lines have values to escape.
+ * 
+ * @param row_count The number of rows in the generated table.
+*/
+void bench_formats(int row_count)
+{
+    mt19937 generator(301);
+    uniform_int_distribution<int> int_distribution(0, 99999);
+    uniform_real_distribution<float> float_distribution(0.0f, 100000.0f);
+    uniform_int_distribution<int> string_distribution(0, 63);
+    bernoulli_distribution null_distribution(0.05);
+
+    Table table = { .table_name = "BENCH", .tc_column_idx = -1 };
+    table.table_data.push_back(new_column("ID", INT));
+    table.table_data.push_back(new_column("AMOUNT", FLOAT));
+    table.table_data.push_back(new_column("NAME", STRING));
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        int string_idx = string_distribution(generator);
+        Data data_item;
+        data_item.empty = null_distribution(generator);
+        data_item.int_data = int_distribution(generator);
+        data_item.float_data = float_distribution(generator);
+        data_item.string_data = "Name " + to_string(string_idx) + ((string_idx % 8 == 0) ? ", \"Jr\"" : "");
+        for (Column &column : table.table_data)
+        {
+            append_data(column, data_item);
+        }
+    }
+
+    Predicate where_predicate;
+    where_predicate.kind = PREDICATE_AND;
+    Table_View all_rows = parse_table(where_predicate, table, 0);
+
+    const char *format_names[] = { "text", "csv", "jsonl", "binary" };
+    cout << "formats rows=" << row_count << " (million rows per second, MB per second on one core)" << endl;
+    for (int format = FORMAT_TEXT; format <= FORMAT_BINARY; format++)
+    {
+        // Best of 3 runs
+        double best_seconds = 0.0;
+        size_t output_bytes = 0;
+        for (int run = 0; run < 3; run++)
+        {
+            chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+            output_bytes = format_header(all_rows, (enum output_format)format).size();
+            for (int first_row = 0; first_row < row_count; first_row += MORSEL_ROWS)
+            {
+                int last_row = min(row_count, first_row + MORSEL_ROWS);
+                output_bytes += format_rows(all_rows, first_row, last_row, (enum output_format)format).size();
+            }
+            double seconds = seconds_since(start_time);
+            if ((run == 0) || (seconds < best_seconds))
+                best_seconds = seconds;
+        }
+
+        cout << format_names[format] << " " << row_count / best_seconds / 1e6 << " rows " 
+             << output_bytes / best_seconds / 1e6 << " MB (" << output_bytes / 1e6 << " MB)" << endl;
+    }
+}
+
+/**
+ * Times a full scan WHERE on an INT and a FLOAT column with 1, 2, 4, ... 
+ * threads up to the number of cores, and checks that every thread count finds
+ * the same rows.
+ * 
+ * @param row_count The number of rows in the generated table.
+*/
+void bench_parallel_scan(int row_count)
+{
+    mt19937 generator(301);
+    uniform_int_distribution<int> int_distribution(0, 99999);
+    uniform_real_distribution<float> float_distribution(0.0f, 100000.0f);
+
+    Table table = { .table_name = "BENCH", .tc_column_idx = -1 };
+    table.table_data.push_back(new_column("ID", INT));
+    table.table_data.push_back(new_column("AMOUNT", FLOAT));
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        Data data_item;
+        data_item.empty = false;
+        data_item.int_data = int_distribution(generator);
+        data_item.float_data = float_distribution(generator);
+        append_data(table.table_data[0], data_item);
+        append_data(table.table_data[1], data_item);
+    }
+
+    Predicate where_predicate;
+    compile_where("ID<50000 AND AMOUNT>=25000 OR ID=7", table, where_predicate);
+
+    int core_count = max(1u, thread::hardware_concurrency());
+    cout << "parallel scan rows=" << row_count << " cores=" << core_count 
+         << " (million rows per second, speedup over 1 thread)" << endl;
+
+    vector<int> expected_rows;
+    double single_seconds = 0.0;
+    for (int thread_count = 1; thread_count <= core_count; thread_count *= 2)
+    {
+        query_pool.start(thread_count);
+
+        // Best of 3 runs
+        double best_seconds = 0.0;
+        Table_View result;
+        for (int run = 0; run < 3; run++)
+        {
+            chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+            result = parse_table(where_predicate, table, 0);
+            double seconds = seconds_since(start_time);
+            if ((run == 0) || (seconds < best_seconds))
+                best_seconds = seconds;
+        }
+
+        if (thread_count == 1)
+        {
+            expected_rows = result.row_idxs;
+            single_seconds = best_seconds;
+        }
+
+        cout << "threads=" << thread_count << " " << row_count / best_seconds / 1e6
+             << " x" << single_seconds / best_seconds;
+        if (result.row_idxs != expected_rows)
+            cout << " (MISMATCH)";
+        cout << endl;
+    }
+    query_pool.stop();
+}
+
+/**
+ * Times an equality filter, a range filter and a sort on the first column of
+ * a table, and prints the memory used by the column.
+ * 
+ * @param table         The table holding the column.
+ * @param encoding_name The name of the column's encoding to print.
+*/
+void bench_string_column(Table &table, const char *encoding_name)
+{
+    const char *where_strings[] = { "CITY=Spring", "CITY<Humble" };
+    int row_count = table.table_data[0].row_count;
+
+    cout << encoding_name << " bytes=" << column_bytes(table.table_data[0]);
+    for (const char *where_string : where_strings)
+    {
+        Predicate where_predicate;
+        compile_where(where_string, table, where_predicate);
+
+        chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+        Table_View result = parse_table(where_predicate, table, 0);
+        double filter_seconds = seconds_since(start_time);
+        cout << " " << where_string << "=" << row_count / filter_seconds / 1e6;
+    }
+
+    Predicate where_predicate;
+    where_predicate.kind = PREDICATE_AND;
+    Table_View result = parse_table(where_predicate, table, 0);
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    sort_table("CITY:1", result);
+    double sort_seconds = seconds_since(start_time);
+    cout << " ORDERBY=" << row_count / sort_seconds / 1e6 << " (million rows per second)" << endl;
+}
+
+/**
+ * Times the stages of a query separately on a database read from CSV files:
+ * the load, loading every column, WHERE filters, ORDERBY, a SELECT projection
+ * and printing. Each timing is printed as a line of JSON so runs can be 
+ * compared over time. 
+ * Stages that need EMPLOYEE or WORKS_ON are skipped if the table is missing.
+ * 
+ * @param data_dir The directory holding TAB_COLUMNS.csv and the CSV files.
+*/
+void bench_stages(const string &data_dir)
+{
+    if (chdir(data_dir.c_str()) != 0)
+    {
+        cout << "Invalid data directory: " << data_dir << endl;
+        return;
+    }
+
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    vector<Table> database = init_database();
+    double load_seconds = seconds_since(start_time);
+    long loaded_rows = 0;
+    for (const Table &table : database)
+    {
+        if (!table.table_data.empty())
+            loaded_rows += table.table_data[0].row_count;
+    }
+    report_stage("load", "", data_dir, loaded_rows, loaded_rows, load_seconds);
+
+    // The columns are loaded on first use, the stages below call the 
+    // operators directly so every column is loaded up front
+    Column_Pins pins;
+    start_time = chrono::steady_clock::now();
+    for (const Table &table : database)
+    {
+        column_loader.pin_table(table, pins);
+    }
+    report_stage("columns", "", data_dir, loaded_rows, loaded_rows, seconds_since(start_time));
+
+    // The filters read a FLOAT, an encoded STRING, an indexed INT and two 
+    // columns at once
+    const char *where_strings[][2] = 
+    {
+        { "EMPLOYEE", "SALARY>60000" },
+        { "EMPLOYEE", "CITY=Houston" },
+        { "EMPLOYEE", "SSN=100000500" },
+        { "EMPLOYEE", "SALARY>40000 AND SEX=F" },
+        { "WORKS_ON", "HOURS>=20" },
+        { "WORKS_ON", "PNO=3 OR PNO=7" }
+    };
+    const char *order_strings[][2] = 
+    {
+        { "EMPLOYEE", "SALARY:-1" },
+        { "EMPLOYEE", "LNAME:1" },
+        { "WORKS_ON", "PNO:1" }
+    };
+    const char *select_strings[][2] = 
+    {
+        { "EMPLOYEE", "FNAME:1, LNAME:1, SALARY:1" },
+        { "WORKS_ON", "ESSN:1" }
+    };
+
+    auto find_table = [&](const char *table_name)
+    {
+        for (int table_idx = 0; table_idx < database.size(); table_idx++)
+        {
+            if (database[table_idx].table_name == table_name)
+                return table_idx;
+        }
+        return -1;
+    };
+
+    int tc_level = 4;
+    for (auto &where : where_strings)
+    {
+        int table_idx = find_table(where[0]);
+        Predicate where_predicate;
+        if ((table_idx == -1) || !compile_where(where[1], database[table_idx], where_predicate))
+            continue;
+
+        Table_View result;
+        double seconds = best_seconds(3, [&]()
+        {
+            result = parse_table(where_predicate, database[table_idx], tc_level);
+        });
+        report_stage("where", where[0], where[1], visible_row_count(database[table_idx], tc_level), 
+                     result.row_idxs.size(), seconds);
+    }
+
+    for (auto &order : order_strings)
+    {
+        int table_idx = find_table(order[0]);
+        if (table_idx == -1)
+            continue;
+
+        Predicate where_predicate;
+        where_predicate.kind = PREDICATE_AND;
+        Table_View all_rows = parse_table(where_predicate, database[table_idx], tc_level);
+        double seconds = best_seconds(3, [&]()
+        {
+            Table_View sorted_rows = all_rows;
+            sort_table(order[1], sorted_rows);
+        });
+        report_stage("orderby", order[0], order[1], all_rows.row_idxs.size(), all_rows.row_idxs.size(), seconds);
+    }
+
+    // The projection itself only picks columns, so the stage includes 
+    // formatting the rows it keeps. Printing writes every column of every 
+    // row through cout to /dev/null.
+    for (auto &select : select_strings)
+    {
+        int table_idx = find_table(select[0]);
+        if (table_idx == -1)
+            continue;
+
+        Predicate where_predicate;
+        where_predicate.kind = PREDICATE_AND;
+        Table_View all_rows = parse_table(where_predicate, database[table_idx], tc_level);
+        int row_count = all_rows.row_idxs.size();
+        double seconds = best_seconds(3, [&]()
+        {
+            Table_View selected_rows = all_rows;
+            select_columns(select[1], selected_rows);
+            for (int first_row = 0; first_row < row_count; first_row += MORSEL_ROWS)
+            {
+                format_rows(selected_rows, first_row, min(row_count, first_row + MORSEL_ROWS), FORMAT_TEXT);
+            }
+        });
+        report_stage("select", select[0], select[1], row_count, row_count, seconds);
+
+        ofstream null_output("/dev/null");
+        streambuf *console = cout.rdbuf(null_output.rdbuf());
+        seconds = best_seconds(3, [&]() { print_table(all_rows, FORMAT_TEXT); });
+        cout.rdbuf(console);
+        report_stage("print", select[0], "*", row_count, row_count, seconds);
+    }
+}
+
+/**
+ * Prints the timing of a stage as a line of JSON, e.g.
+ * {"stage":"where","table":"EMPLOYEE","operation":"SALARY>60000",
+ *  "rows_in":1000000,"rows_out":400000,"seconds":0.0042,"rows_per_second":2.4e+08}
+ * 
+ * @param stage      The name of the stage.
+ * @param table_name The table the stage ran on, empty for the load.
+ * @param operation  The condition, sort or column list of the stage.
+ * @param rows_in    The number of rows the stage read.
+ * @param rows_out   The number of rows the stage produced.
+ * @param seconds    The best time of the stage.
+*/
+void report_stage(const char *stage, const string &table_name, const string &operation, long rows_in, 
+                  long rows_out, double seconds)
+{
+    string line = "{\"stage\":";
+    append_json_string(line, stage, strlen(stage));
+    line += ",\"table\":";
+    append_json_string(line, table_name.data(), table_name.size());
+    line += ",\"operation\":";
+    append_json_string(line, operation.data(), operation.size());
+    line += ",\"rows_in\":";
+    append_int(line, rows_in);
+    line += ",\"rows_out\":";
+    append_int(line, rows_out);
+    line += ",\"seconds\":";
+    append_float(line, seconds, 6);
+    line += ",\"rows_per_second\":";
+    append_float(line, rows_in / max(seconds, 1e-9), 6);
+    cout << line << "}" << endl;
+}
+
+/**
+ * Runs a function a number of times.
+ * 
+ * @param run_count The number of runs.
+ * @param run       The function to time.
+ * 
+ * @return The time of the fastest run in seconds.
+*/
+template <typename F>
+double best_seconds(int run_count, const F &run)
+{
+    double best = 0.0;
+    for (int run_idx = 0; run_idx < run_count; run_idx++)
+    {
+        chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+        run();
+        double seconds = seconds_since(start_time);
+        if ((run_idx == 0) || (seconds < best))
+            best = seconds;
+    }
+    return best;
+}
+
+/**
+ * @return The number of seconds since the start time.
+*/
+double seconds_since(chrono::steady_clock::time_point start_time)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
@@ -1,9 +1,38 @@
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <list>
+#include <memory>
 #include <fstream>
+#include <immintrin.h>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <sstream>
+#include <fcntl.h>
+#include <pwd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -16,12 +45,15 @@ enum data_type
     CHAR,
     STRING,
     INT,
-    FLOAT
+    FLOAT,
+    BIGINT, // Only used by the results of aggregate functions
+    DOUBLE  // Only used by the results of aggregate functions
 };
 
 /**
- * A structure that can store data based on it's type. If no data is available
- * set the empty field to true.
+ * A structure that can store a single data value based on it's type. If no 
+ * data is available set the empty field to true. Columns do not store Data
+ * objects, it is only used to pass individual values around.
 */
 typedef struct data
 {
@@ -33,854 +65,10226 @@ typedef struct data
 } Data;
 
 /**
- * A structure that represents a column in a databases table.
+ * Where the values of a column that is loaded on first use are read from,
+ * see Column_Loader. That is either the column's blocks in the table's
+ * snapshot, or one field of every line of the table's data file.
+ *
+ * @var column       The column the values are loaded into, NULL once the
+ *                   column is gone or has been changed.
+ * @var file         The mapped snapshot or data file, shared by the columns
+ *                   of the table.
+ * @var file_size    The size of the file.
+ * @var block_begin  Snapshots, where the column's blocks start in the file.
+ * @var block_size   Snapshots, the size of the column's blocks.
+ * @var checksum     Snapshots, the checksum of the column's blocks.
+ * @var field_idx    Data files, the field of each line that holds the
+ *                   column. -1 for snapshots.
+ * @var line_starts  Data files, where each line of the file starts. The line
+ *                   of a row is found through the table's file rows.
+ * @var file_name    Data files, the name of the file.
+ * @var file_mtime   Data files, the modification time of the file in 
+ *                   nanoseconds when it was mapped. With the size it tells
+ *                   if the file changed since.
+ * @var load_mutex   Held while the values are loaded.
+ * @var loaded       True while the values are in memory.
+ * @var pins         The number of queries reading the values, the column is
+ *                   only evicted while there are none.
+ * @var loaded_bytes The memory that the values take.
+ * @var position     The column's place in the loader's list of loaded columns.
+*/
+typedef struct column_source
+{
+    struct column *column;
+    shared_ptr<const char> file;
+    size_t file_size;
+    uint64_t block_begin;
+    uint64_t block_size;
+    uint64_t checksum;
+    int field_idx;
+    shared_ptr<const vector<size_t>> line_starts;
+    string file_name;
+    int64_t file_mtime;
+    mutex load_mutex;
+    bool loaded;
+    int pins;
+    size_t loaded_bytes;
+    list<struct column_source *>::iterator position;
+}
+Column_Source;
+
+/**
+ * Holds the source of a column that is loaded on first use. The source stays
+ * with the column it was attached to: copying a column copies its values, so
+ * a copy is always in memory and has no source.
+*/
+class Source_Handle
+{
+public:
+    Source_Handle() {}
+    Source_Handle(const Source_Handle &) {}
+    Source_Handle &operator=(const Source_Handle &other)
+    {
+        if (this != &other)
+            reset();
+        return *this;
+    }
+    ~Source_Handle() { reset(); }
+
+    const shared_ptr<Column_Source> &get() const { return source; }
+    void reset(shared_ptr<Column_Source> new_source = shared_ptr<Column_Source>());
+
+private:
+    shared_ptr<Column_Source> source;
+};
+
+/**
+ * A structure that represents a column in a databases table. The values are
+ * stored in a single dense array that matches the column's type, the arrays
+ * for the other types are left empty. STRING columns that repeat a few values
+ * are dictionary encoded, each row then stores the code of its value instead.
  * 
- * @var column_name The name of the column. Should always be in all caps.
- * @var type        The type of data that the column is storing.
- * @var column_data A vector of Data objects representing the columns data.
+ * @var column_name        The name of the column. Should always be in all caps.
+ * @var type               The type of data that the column is storing.
+ * @var row_count          The number of rows stored in the column.
+ * @var char_data          The values of a CHAR column.
+ * @var string_data        The values of a STRING column that is not encoded.
+ * @var int_data           The values of an INT column.
+ * @var float_data         The values of a FLOAT column.
+ * @var bigint_data        The values of a BIGINT column.
+ * @var double_data        The values of a DOUBLE column.
+ * @var null_bitmap        One bit per row, a set bit means the row has no value.
+ * @var dictionary_encoded True if the STRING values are dictionary encoded.
+ * @var dictionary         The distinct values of an encoded column, sorted so 
+ *                         that codes compare in the same order as the values.
+ * @var sorted_values      The number of values at the start of the dictionary
+ *                         that are sorted. Values that writes add come after
+ *                         them in the order they were added, until a 
+ *                         checkpoint encodes the column again.
+ * @var added_codes        The code of each value that writes added.
+ * @var string_codes       The code of each row's value in the dictionary.
+ * @var source             Where the values are read from if the column is
+ *                         loaded on first use, empty if they are always in
+ *                         memory. Until a query pins the column only its name,
+ *                         type and row count are set (see Column_Loader).
 */
 typedef struct column
 {
     string column_name;
     enum data_type type;
-    vector<Data> column_data;
-} 
+    int row_count;
+    vector<char> char_data;
+    vector<string> string_data;
+    vector<int32_t> int_data;
+    vector<float> float_data;
+    vector<int64_t> bigint_data;
+    vector<double> double_data;
+    vector<uint64_t> null_bitmap;
+    bool dictionary_encoded;
+    vector<string> dictionary;
+    int sorted_values;
+    unordered_map<string, int32_t> added_codes;
+    vector<int32_t> string_codes;
+    Source_Handle source;
+}
 Column;
 
 /**
- * A structure that represents a table in the database.
+ * A vector whose elements are shared by its copies, so copying it does not
+ * copy the elements. An element is copied the first time it is changed
+ * through a vector that shares it, so a change is never seen by the other
+ * copies. Reading through a const vector never copies.
+*/
+template <typename T>
+class Shared_Vector
+{
+public:
+    /**
+     * Iterates over the elements, as const when Element is.
+    */
+    template <typename Element, typename Base>
+    class shared_iterator
+    {
+    public:
+        typedef random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef Element *pointer;
+        typedef Element &reference;
+
+        shared_iterator(Base position) : position(position) {}
+
+        Element &operator*() const { return **position; }
+        Element *operator->() const { return position->get(); }
+        Element &operator[](ptrdiff_t offset) const { return *position[offset]; }
+        shared_iterator &operator++() { ++position; return *this; }
+        shared_iterator &operator--() { --position; return *this; }
+        shared_iterator operator++(int) { return shared_iterator(position++); }
+        shared_iterator operator--(int) { return shared_iterator(position--); }
+        shared_iterator &operator+=(ptrdiff_t offset) { position += offset; return *this; }
+        shared_iterator &operator-=(ptrdiff_t offset) { position -= offset; return *this; }
+        shared_iterator operator+(ptrdiff_t offset) const { return shared_iterator(position + offset); }
+        shared_iterator operator-(ptrdiff_t offset) const { return shared_iterator(position - offset); }
+        ptrdiff_t operator-(const shared_iterator &other) const { return position - other.position; }
+        bool operator==(const shared_iterator &other) const { return position == other.position; }
+        bool operator!=(const shared_iterator &other) const { return position != other.position; }
+        bool operator<(const shared_iterator &other) const { return position < other.position; }
+        bool operator>(const shared_iterator &other) const { return position > other.position; }
+        bool operator<=(const shared_iterator &other) const { return position <= other.position; }
+        bool operator>=(const shared_iterator &other) const { return position >= other.position; }
+
+    private:
+        Base position;
+    };
+
+    typedef shared_iterator<T, typename vector<shared_ptr<T>>::iterator> iterator;
+    typedef shared_iterator<const T, typename vector<shared_ptr<T>>::const_iterator> const_iterator;
+
+    size_t size() const { return elements.size(); }
+    bool empty() const { return elements.empty(); }
+    void clear() { elements.clear(); }
+    void swap(Shared_Vector &other) { elements.swap(other.elements); }
+    void push_back(T element) { elements.push_back(make_shared<T>(move(element))); }
+
+    const T &operator[](size_t idx) const { return *elements[idx]; }
+    T &operator[](size_t idx) { return writable(idx); }
+    const T &read(size_t idx) const { return *elements[idx]; }
+    const T &back() const { return *elements.back(); }
+    T &back() { return writable(elements.size() - 1); }
+
+    /**
+     * Puts a new element in place of one, without copying the old one first.
+     *
+     * @param idx     The position of the element.
+     * @param element The new element.
+    */
+    void replace(size_t idx, T element) { elements[idx] = make_shared<T>(move(element)); }
+
+    const_iterator begin() const { return const_iterator(elements.begin()); }
+    const_iterator end() const { return const_iterator(elements.end()); }
+
+    // Every element can be changed through the iterators, so none may stay
+    // shared
+    iterator begin()
+    {
+        for (size_t idx = 0; idx < elements.size(); idx++)
+        {
+            writable(idx);
+        }
+        return iterator(elements.begin());
+    }
+    iterator end() { return iterator(elements.end()); }
+
+private:
+    /**
+     * Makes an element the vector's own before it is changed.
+     *
+     * @param idx The position of the element.
+     *
+     * @return The element.
+    */
+    T &writable(size_t idx)
+    {
+        if (elements[idx].use_count() > 1)
+            elements[idx] = make_shared<T>(*elements[idx]);
+        return *elements[idx];
+    }
+
+    vector<shared_ptr<T>> elements;
+};
+
+/**
+ * An enumeration of the kinds of secondary indexes.
+*/
+enum index_type
+{
+    INDEX_HASH,    // Equality lookups
+    INDEX_ORDERED  // Equality and range lookups
+};
+
+// The number of values a Group_Map keeps apart from its shared base before it
+// makes a new base, unless the base is large
+const size_t GROUP_MAP_MIN_ADDED = 1024;
+
+/**
+ * Maps the values of a HASH index to their groups. Groups are only ever 
+ * added, so copies of the map share the values they have in common: the 
+ * values are kept in a shared base, and a copy that adds values while the 
+ * base is shared keeps them apart until there are enough to be worth a new
+ * base. Copying the map only copies the values kept apart.
+*/
+template <typename K>
+class Group_Map
+{
+public:
+    Group_Map() : base(make_shared<unordered_map<K, int>>()) {}
+
+    size_t size() const { return base->size() + added.size(); }
+
+    /**
+     * Finds the group of a value.
+     *
+     * @param key The value.
+     *
+     * @return The group, -1 if the value has none.
+    */
+    int find(const K &key) const
+    {
+        typename unordered_map<K, int>::const_iterator found = added.find(key);
+        if (found != added.end())
+            return found->second;
+        found = base->find(key);
+        return (found == base->end()) ? -1 : found->second;
+    }
+
+    /**
+     * Gives a value a group, unless it has one.
+     *
+     * @param key   The value.
+     * @param group The group for a new value.
+     *
+     * @return The group of the value.
+    */
+    int insert(const K &key, int group)
+    {
+        int found_group = find(key);
+        if (found_group != -1)
+            return found_group;
+
+        if (base.use_count() == 1)
+        {
+            base->insert(make_pair(key, group));
+            return group;
+        }
+        added.insert(make_pair(key, group));
+        if (added.size() > max(GROUP_MAP_MIN_ADDED, base->size() / 64))
+        {
+            shared_ptr<unordered_map<K, int>> merged = make_shared<unordered_map<K, int>>(*base);
+            merged->insert(added.begin(), added.end());
+            base = merged;
+            added.clear();
+        }
+        return group;
+    }
+
+private:
+    shared_ptr<unordered_map<K, int>> base;
+    unordered_map<K, int> added;
+};
+
+/**
+ * A structure that represents a secondary index on one column of a table.
+ * Rows with an empty value are not indexed, since no condition matches them.
+ * 
+ * @var column_idx    The index of the column in the table.
+ * @var type          The kind of index.
+ * @var value_groups  HASH indexes on CHAR, INT and FLOAT columns, maps a value
+ *                    (see index_key) to its group.
+ * @var string_groups HASH indexes on STRING columns, maps a value to its group.
+ * @var group_begins  HASH indexes, where each group starts in grouped_rows. 
+ *                    Has one extra entry at the end.
+ * @var grouped_rows  HASH indexes, the rows of every group one after another,
+ *                    each group in ascending order.
+ * @var sorted_rows   ORDERED indexes, every row that has a value sorted by 
+ *                    value and then by row.
+*/
+typedef struct index
+{
+    int column_idx;
+    enum index_type type;
+    Group_Map<int64_t> value_groups;
+    Group_Map<string> string_groups;
+    vector<int> group_begins;
+    vector<int> grouped_rows;
+    vector<int> sorted_rows;
+}
+Index;
+
+/**
+ * A structure that represents a table in the database. If the table has a TC
+ * column its rows are stored grouped by TC level in ascending order, so the
+ * grouped rows a user can see are always the first rows of the table. Rows 
+ * inserted since then are added at the end, and are grouped again by the 
+ * next checkpoint. Copies of a table share its columns and indexes until one
+ * of them changes.
+ * 
+ * @var table_name    The name of the table. Should always be in all caps.
+ * @var A vector of Column objects representing the table's columns.
+ * @var tc_column_idx The index of the TC column, -1 if there is none.
+ * @var tc_levels     The TC levels that the table holds, in ascending order.
+ * @var tc_level_ends For each TC level, one past the last row of that level.
+ * @var file_rows     For each stored row, the row it came from in the data 
+ *                    file. Used to put results back in file order.
+ * @var tail_begin    The first row inserted since the rows were grouped. The
+ *                    inserted rows are in file order whatever their TC 
+ *                    level, so their levels are checked row by row.
+ * @var next_file_row The file row the next inserted row gets, after every 
+ *                    row of the data file and every row inserted so far.
+ * @var indexes       The secondary indexes on the table's columns.
+ * @var source_size   The size of the data file the rows were loaded from.
+ * @var source_mtime  The modification time of the data file in nanoseconds,
+ *                    used with the size to tell if a snapshot is stale.
+ * @var version       Increased every time the rows change, so that cached 
+ *                    results of the table can be told apart from new ones.
+ * @var log_sequence  The sequence number of the last write-ahead log record
+ *                    applied to the rows, 0 if there is none.
+ * @var saved_sequence The log_sequence that the table's snapshot holds. The
+ *                    rows changed since the snapshot if they differ.
+*/
+typedef struct table
+{
+    string table_name;
+    Shared_Vector<Column> table_data;
+    int tc_column_idx;
+    vector<int> tc_levels;
+    vector<int> tc_level_ends;
+    vector<int> file_rows;
+    int tail_begin;
+    int next_file_row;
+    Shared_Vector<Index> indexes;
+    int64_t source_size;
+    int64_t source_mtime;
+    int64_t version;
+    int64_t log_sequence;
+    int64_t saved_sequence;
+} 
+Table;
+
+/**
+ * A structure that represents the result of a query as a read-only view of a
+ * table in the database, so that no table data has to be copied.
+ * 
+ * @var table       The table that the view reads from.
+ * @var row_idxs    The rows of the table that are in the view, in order.
+ * @var column_idxs The columns of the table that are in the view, in order.
+*/
+typedef struct table_view
+{
+    const Table *table;
+    vector<int> row_idxs;
+    vector<int> column_idxs;
+}
+Table_View;
+
+/**
+ * An enumeration of the inequalities that can be used in a WHERE condition.
+*/
+enum compare_op
+{
+    OP_EQ, // =
+    OP_NE, // <>
+    OP_LT, // <
+    OP_LE, // <=
+    OP_GT, // >
+    OP_GE  // >=
+};
+
+/**
+ * An enumeration of the kinds of nodes in a compiled WHERE clause.
+*/
+enum predicate_kind
+{
+    PREDICATE_COMPARE,
+    PREDICATE_AND,
+    PREDICATE_OR
+};
+
+/**
+ * A structure that represents a compiled WHERE clause as a tree. Leaves 
+ * compare a column against a literal, the other nodes combine their children.
+ * 
+ * @var kind       The kind of node.
+ * @var column_idx The index of the column in the table, leaves only.
+ * @var op         The inequality to test, leaves only.
+ * @var literal    The value to compare against, already converted to the 
+ *                 column's type. Leaves only.
+ * @var parameter_idx For a ? in a prepared query, the index of the value that
+ *                    EXECUTE puts in the literal. -1 for other leaves.
+ * @var children   The child nodes of an AND or OR node.
+*/
+typedef struct predicate
+{
+    enum predicate_kind kind;
+    int column_idx;
+    enum compare_op op;
+    Data literal;
+    int parameter_idx;
+    vector<struct predicate> children;
+}
+Predicate;
+
+/**
+ * An enumeration of the instruction sets that the comparison kernels can use.
+*/
+enum simd_level
+{
+    SIMD_SCALAR,
+    SIMD_SSE42,
+    SIMD_AVX2
+};
+
+/**
+ * The header at the start of a snapshot file. It is followed by the payload,
+ * a list of blocks that are each padded to a multiple of 8 bytes:
+ *   - the schema, a type, name length and name for each column
+ *   - the TC column index and the number of TC levels
+ *   - the TC levels, the TC level ends and the file row of each row
+ *   - the column directory, the offset, size and checksum of the blocks of
+ *     each column
+ *   - for each column the null bitmap and the values. STRING columns store
+ *     the offset of each value and then all of the values one after another.
+ *
+ * Each column has its own checksum so that it can be loaded and checked on
+ * its own, the checksum in the header covers the blocks before the columns.
+ * Version 3 has no column directory and its checksum covers the whole 
+ * payload, versions 1 and 2 have no log_sequence.
+ *
+ * @var magic        Always "CS301SNP".
+ * @var version      The version of the format, SNAPSHOT_VERSION.
+ * @var column_count The number of columns in the table.
+ * @var row_count    The number of rows in the table.
+ * @var source_size  The size of the data file the snapshot was made from.
+ * @var source_mtime The modification time of the data file in nanoseconds.
+ * @var log_sequence The sequence number of the last write-ahead log record 
+ *                   the snapshot holds.
+ * @var payload_size The number of bytes after the header.
+ * @var checksum     A checksum of the payload before the column blocks, see
+ *                   checksum_words.
+*/
+typedef struct snapshot_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t column_count;
+    uint64_t row_count;
+    int64_t source_size;
+    int64_t source_mtime;
+    int64_t log_sequence;
+    uint64_t payload_size;
+    uint64_t checksum;
+}
+Snapshot_Header;
+
+/**
+ * A structure that describes how the rows of a table are found for a query.
+ * 
+ * @var index     The index used to find the candidate rows, NULL when the 
+ *                visible rows are scanned.
+ * @var condition The condition that the index answers.
+ * @var remaining The conditions that still have to be checked on the rows.
+*/
+typedef struct access_plan
+{
+    const Index *index;
+    const Predicate *condition;
+    Predicate remaining;
+}
+Access_Plan;
+
+/**
+ * A structure that describes a query that reads from several tables. Each 
+ * table is joined to the tables listed before it.
+ * 
+ * @var tables         The tables in the order they are listed.
+ * @var column_offsets The position of each table's first column in the schema.
+ * @var join_columns   For each table after the first, the schema columns of 
+ *                     its join condition. The first belongs to an earlier 
+ *                     table and the second to the table being joined.
+ * @var schema         A table without rows holding the columns of every table,
+ *                     named <table>.<column>. The WHERE, ORDERBY and SELECT 
+ *                     statements are resolved against it.
+*/
+typedef struct join_query
+{
+    vector<const Table *> tables;
+    vector<int> column_offsets;
+    vector<pair<int, int>> join_columns;
+    Table schema;
+}
+Join_Query;
+
+/**
+ * An enumeration of the functions that can be used in the SELECT statement of
+ * a query that aggregates its rows.
+*/
+enum aggregate_function
+{
+    AGGREGATE_NONE,  // The value of a GROUPBY column
+    AGGREGATE_COUNT,
+    AGGREGATE_SUM,
+    AGGREGATE_AVG,
+    AGGREGATE_MIN,
+    AGGREGATE_MAX
+};
+
+/**
+ * A structure that represents one item of the SELECT statement of a query 
+ * that aggregates its rows.
+ * 
+ * @var function   The aggregate function.
+ * @var column_idx The column the function reads, -1 for COUNT(*).
+ * @var name       The name of the result column, the item as it was written.
+*/
+typedef struct aggregate
+{
+    enum aggregate_function function;
+    int column_idx;
+    string name;
+}
+Aggregate;
+
+/**
+ * A structure that describes a query that aggregates its rows, which is any
+ * query with a GROUPBY statement or an aggregate function in SELECT.
+ * 
+ * @var group_columns The GROUPBY columns, empty if every row is one group.
+ * @var items         The items of the SELECT statement, in order.
+*/
+typedef struct aggregate_query
+{
+    vector<int> group_columns;
+    vector<Aggregate> items;
+}
+Aggregate_Query;
+
+/**
+ * The running result of one aggregate function over the rows of one group.
+ * 
+ * @var count      The number of rows that have a value.
+ * @var int_sum    The sum of the values of an INT column.
+ * @var float_sum  The sum of the values of a FLOAT column.
+ * @var best_row   MIN and MAX, the row holding the best value so far, -1 if
+ *                 there is none.
+*/
+typedef struct aggregate_state
+{
+    int64_t count;
+    int64_t int_sum;
+    double float_sum;
+    int best_row;
+}
+Aggregate_State;
+
+/**
+ * An enumeration of the formats that results can be printed in.
+*/
+enum output_format
+{
+    FORMAT_TEXT,   // Values joined by commas, as typed in the table files
+    FORMAT_CSV,    // RFC 4180 CSV, values are quoted when needed
+    FORMAT_JSONL,  // One JSON object per row
+    FORMAT_BINARY  // Typed column buffers, see format_header and format_binary_rows
+};
+
+/**
+ * A structure that holds a query that has been parsed, with its tables and
+ * columns resolved and its statements compiled, so that it can be run 
+ * without parsing it again. It is only read while it runs, so every EXECUTE 
+ * of a prepared query shares it. The tables it runs on are found by 
+ * table_idxs, see query_tables.
+ * 
+ * @var query_text      The words of the query, see normalize_query.
+ * @var explain         True if the query starts with EXPLAIN.
+ * @var table           The table the query was prepared on, NULL for a join.
+ * @var join            The join, with the tables it was prepared on. Its 
+ *                      tables are empty if the query is not a join.
+ * @var table_idxs      The index in the database of the table, or of each 
+ *                      table of the join.
+ * @var where_predicate The compiled WHERE statement.
+ * @var parameter_count The number of ?s in the WHERE statement.
+ * @var selecting       True if the query has a SELECT statement.
+ * @var select_string   The SELECT statement.
+ * @var column_idxs     The columns that SELECT keeps, in order.
+ * @var grouping        True if the query has a GROUPBY statement.
+ * @var group_string    The GROUPBY statement.
+ * @var aggregating     True if the rows are grouped or aggregated.
+ * @var aggregate_query The parsed aggregate functions.
+ * @var ordering        True if the query has an ORDERBY statement.
+ * @var order_string    The ORDERBY statement.
+ * @var limit_count     The number of rows to return, -1 if there is no LIMIT.
+ * @var limit_offset    The number of rows to skip.
+ * @var format_given    True if the query has a FORMAT statement.
+ * @var format          The format of the FORMAT statement.
+ * @var read_columns    The columns of the table that the query reads, in
+ *                      ascending order. Empty for a join, which reads every
+ *                      column of its tables.
+*/
+typedef struct prepared_query
+{
+    string query_text;
+    bool explain;
+    const Table *table;
+    Join_Query join;
+    vector<int> table_idxs;
+    Predicate where_predicate;
+    int parameter_count;
+    bool selecting;
+    string select_string;
+    vector<int> column_idxs;
+    bool grouping;
+    string group_string;
+    bool aggregating;
+    Aggregate_Query aggregate_query;
+    bool ordering;
+    string order_string;
+    int limit_count;
+    int limit_offset;
+    bool format_given;
+    enum output_format format;
+    vector<int> read_columns;
+}
+Prepared_Query;
+
+/**
+ * A structure that holds the settings of one user's session.
+ * 
+ * @var tc_level         The users security level, rows with a higher TC level
+ *                       are never shown.
+ * @var format           The format that results are printed in, unless a 
+ *                       query asks for another one.
+ * @var prepared_queries The queries prepared by PREPARE, by name.
+ * @var group_commit     True if whoever runs the session's statements waits 
+ *                       for their log records to be synced, instead of each 
+ *                       INSERT, UPDATE or DELETE waiting itself.
+ * @var commit_sequence  The log record of the last write, 0 if it has been
+ *                       waited for.
+*/
+typedef struct session
+{
+    int tc_level;
+    enum output_format format;
+    unordered_map<string, Prepared_Query> prepared_queries;
+    bool group_commit;
+    int64_t commit_sequence;
+}
+Session;
+
+/**
+ * A pool of worker threads that runs a job split into morsels, small fixed 
+ * size pieces of work such as a range of rows. Each thread has its own queue
+ * of morsels and steals from the end of the other queues once its own queue 
+ * is empty, so no thread sits idle while another still has a backlog. The 
+ * thread that starts a job works on it as well.
+*/
+class Thread_Pool
+{
+public:
+    Thread_Pool() : stopping(false), job_generation(0), job(NULL), job_allocations(NULL), pending_morsels(0) {}
+    ~Thread_Pool() { stop(); }
+
+    void start(int thread_count);
+    void stop(void);
+    int thread_count() const { return queues.size() + (queues.empty() ? 1 : 0); }
+    void run_morsels(int morsel_count, const function<void(int)> &run_morsel);
+
+private:
+    /**
+     * The morsels waiting to be run by one thread.
+    */
+    struct morsel_queue
+    {
+        mutex queue_mutex;
+        deque<int> morsels;
+    };
+
+    void worker_loop(int queue_idx);
+    bool next_morsel(int queue_idx, int &morsel_idx);
+    void run_queue(int queue_idx);
+
+    vector<thread> workers;
+    vector<morsel_queue> queues;
+    mutex job_mutex;
+    mutex state_mutex;
+    condition_variable work_ready;
+    condition_variable job_done;
+    bool stopping;
+    long job_generation;
+    const function<void(int)> *job;
+    atomic<int64_t> *job_allocations;  // The allocation counter of the thread that started the job
+    atomic<int> pending_morsels;
+};
+
+/**
+ * An output buffer for batch mode. Text is collected in one large buffer that
+ * is only written to the file descriptor once it is full, so flushing cout,
+ * for example with endl, does not cost a system call per result.
+*/
+class Batch_Writer : public streambuf
+{
+public:
+    Batch_Writer(int output_fd, size_t buffer_size) : output_fd(output_fd), buffer(buffer_size)
+    {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+    ~Batch_Writer() { write_buffer(); }
+
+    void write_buffer(void);
+
+protected:
+    int overflow(int next_char);
+    streamsize xsputn(const char *text, streamsize length);
+    int sync() { return 0; }
+
+private:
+    int output_fd;
+    vector<char> buffer;
+};
+
+/**
+ * An output buffer that sends what is written to it on to the output of the
+ * current thread. It is installed in cout, so that queries running at the 
+ * same time on several threads each print to their own output. Threads that
+ * have not picked an output print to the buffer cout had before.
+*/
+class Output_Router : public streambuf
+{
+public:
+    Output_Router() : default_output(NULL) {}
+
+    void install(void) { default_output = cout.rdbuf(this); }
+    streambuf *thread_target() const { return (thread_output != NULL) ? thread_output : default_output; }
+    void set_thread_output(streambuf *output) { thread_output = output; }
+
+protected:
+    int overflow(int next_char)
+    {
+        if (next_char == traits_type::eof())
+            return traits_type::not_eof(next_char);
+        return thread_target()->sputc((char)next_char);
+    }
+    streamsize xsputn(const char *text, streamsize length) { return thread_target()->sputn(text, length); }
+    int sync() { return thread_target()->pubsync(); }
+
+private:
+    streambuf *default_output;
+    static thread_local streambuf *thread_output;
+};
+
+/**
+ * A server that holds the database once and runs the queries of many clients
+ * that connect to a Unix domain socket. A client starts with the line 
+ * "SESSION <tc_level>" and then sends one query per line. Each result is 
+ * framed the same way as in batch mode and the results are sent back in the
+ * order the queries were sent.
+ * 
+ * The server, not the client, decides which levels a client can have. The 
+ * user that runs the client is found from the socket (SO_PEERCRED) and a 
+ * session above that user's clearance is refused. The clearances are listed
+ * in TAB_CLEARANCES.csv, users that are not listed can not connect, except 
+ * for the user that runs the server, which can read the data files anyway 
+ * and is cleared for every level. Without that file the socket can only be
+ * opened by the user that runs the server.
+ * 
+ * The queries run on a pool of workers. A client can have a few queries 
+ * running at once, but statements that change its session, such as PREPARE 
+ * or SET, run on their own after the queries before them. Queries run on 
+ * the version of the tables that is current when they start, so they never 
+ * wait for a statement that changes the tables, such as CREATE INDEX or 
+ * INSERT, nor does it wait for them (see Version_Store). Writes wait for their
+ * log record to be synced after their version is published, so the writes of
+ * several clients share a sync.
+*/
+class Query_Server
+{
+public:
+    Query_Server(int worker_count, int session_queries);
+    ~Query_Server();
+
+    int run(const string &socket_path);
+
+private:
+    /**
+     * A connected client, with its session and the queries it has sent that
+     * have not been answered yet.
+    */
+    struct client
+    {
+        int client_fd;
+        Session session;
+        mutex client_mutex;
+        condition_variable query_done;
+        int running_queries;
+        bool running_statement;
+        long next_query;
+        long next_output;
+        map<long, string> finished_outputs;
+    };
+
+    /**
+     * A query waiting for a worker.
+    */
+    struct query_job
+    {
+        shared_ptr<client> owner;
+        long query_idx;
+        string query;
+        bool changes_session;
+        bool changes_tables;
+    };
+
+    void serve_client(shared_ptr<client> owner);
+    void worker_loop(void);
+    void finish_query(client &owner, const query_job &job, const string &output);
+    bool load_clearances(const string &file_name);
+    bool client_clearance(int client_fd, int &clearance);
+
+    int session_queries;
+    unordered_map<uid_t, int> clearances;  // By user ID, from TAB_CLEARANCES.csv
+    vector<thread> workers;
+    mutex job_mutex;
+    condition_variable job_ready;
+    deque<query_job> jobs;
+    bool stopping;
+};
+
+/**
+ * A result kept by the result cache.
+ * 
+ * @var key            The normalized query, with the TC level and format it 
+ *                     ran with.
+ * @var output         Everything the query printed.
+ * @var row_count      The number of rows in the result.
+ * @var table_versions The index in the database and the version of each table
+ *                     the query read. The result is stale once one changes.
+*/
+typedef struct cache_entry
+{
+    string key;
+    string output;
+    int row_count;
+    vector<pair<int, int64_t>> table_versions;
+}
+Cache_Entry;
+
+/**
+ * A cache of the printed results of queries, so that a query that is sent 
+ * again is answered without running it. The least recently used results are
+ * evicted once the results take more than the memory budget.
+*/
+class Result_Cache
+{
+public:
+    Result_Cache() : budget_bytes(0), used_bytes(0), hits(0), misses(0), evictions(0) {}
+
+    void set_budget(size_t budget_bytes);
+    size_t budget() const { return budget_bytes; }
+    bool lookup(const string &key, const vector<Table> &database, string &output, int &row_count);
+    void store(const string &key, const string &output, int row_count, 
+               const vector<pair<int, int64_t>> &table_versions);
+    void print_status(void);
+
+private:
+    void evict(list<Cache_Entry>::iterator entry);
+    static size_t entry_bytes(const Cache_Entry &entry);
+
+    mutex cache_mutex;
+    list<Cache_Entry> entries;  // Most recently used first
+    unordered_map<string, list<Cache_Entry>::iterator> entry_map;
+    size_t budget_bytes;
+    size_t used_bytes;
+    long hits;
+    long misses;
+    long evictions;
+};
+
+/**
+ * An output buffer that passes everything written to it on to another buffer
+ * and keeps a copy, used to cache what a query prints. Once the copy would 
+ * grow past its limit it is dropped and no more is kept.
+*/
+class Capture_Buffer : public streambuf
+{
+public:
+    Capture_Buffer(streambuf *output, size_t limit) : output(output), limit(limit), overflowed(false) {}
+
+    const string &captured() const { return text; }
+    bool complete() const { return !overflowed; }
+
+protected:
+    int overflow(int next_char);
+    streamsize xsputn(const char *data, streamsize length);
+    int sync() { return output->pubsync(); }
+
+private:
+    void keep(const char *data, size_t length);
+
+    streambuf *output;
+    size_t limit;
+    bool overflowed;
+    string text;
+};
+
+/**
+ * One stage of a query run by EXPLAIN ANALYZE.
+ * 
+ * @var stage           The name of the stage, e.g. SCAN or ORDERBY.
+ * @var detail          What the stage did, e.g. its table or columns.
+ * @var rows_in         The number of rows the stage read.
+ * @var rows_out        The number of rows the stage produced.
+ * @var seconds         The wall time of the stage.
+ * @var allocated_bytes The bytes the query allocated during the stage.
+*/
+typedef struct trace_stage
+{
+    string stage;
+    string detail;
+    long rows_in;
+    long rows_out;
+    double seconds;
+    int64_t allocated_bytes;
+}
+Trace_Stage;
+
+/**
+ * Measures the stages of a query into a trace, each stage runs from the end
+ * of the one before it. Without a trace nothing is measured. While a timer
+ * with a trace exists it counts the allocations of its thread, and of the
+ * workers while they run morsels for that thread.
+*/
+class Stage_Timer
+{
+public:
+    Stage_Timer(vector<Trace_Stage> *trace);
+    ~Stage_Timer();
+
+    bool tracing() const { return trace != NULL; }
+    void finish(const string &stage, const string &detail, long rows_in, long rows_out);
+
+private:
+    vector<Trace_Stage> *trace;
+    chrono::steady_clock::time_point start_time;
+    atomic<int64_t> allocated_bytes;
+    atomic<int64_t> *outer_counter;  // Of the timer that counted on this thread before
+    int64_t start_bytes;
+};
+
+/**
+ * An output buffer that throws away everything written to it and counts the
+ * bytes, used by EXPLAIN ANALYZE to print a result without showing it.
+*/
+class Count_Buffer : public streambuf
+{
+public:
+    Count_Buffer() : byte_count(0) {}
+
+    size_t count() const { return byte_count; }
+
+protected:
+    int overflow(int next_char);
+    streamsize xsputn(const char *, streamsize length);
+
+private:
+    size_t byte_count;
+};
+
+/**
+ * The write-ahead log, which makes INSERT, UPDATE and DELETE statements 
+ * durable. Each statement that changes rows is appended as one line, 
+ * "<sequence> <tc_level> <checksum> <statement>", and is replayed on top of 
+ * the snapshots when the program starts. A checkpoint writes the changed 
+ * tables to their snapshots and empties the log.
+ * 
+ * Records are synced in groups. A writer that needs its record on disk 
+ * becomes the leader if no sync is running and syncs every record appended so
+ * far, the writers that append while it syncs are covered by the next leader.
+ * 
+ * Once a sync fails the tables can hold writes that the log does not, so the
+ * log stays failed: no more writes are made and no checkpoint writes them to
+ * the snapshots, until the program starts again from what is on disk.
+*/
+class Write_Ahead_Log
+{
+public:
+    Write_Ahead_Log() : log_fd(-1), log_bytes(0), last_sequence(0), synced_sequence(0), syncing(false), 
+                        failed(false), record_count(0), sync_count(0) {}
+    ~Write_Ahead_Log() { close_log(); }
+
+    bool open_log(const string &file_name, size_t valid_bytes, int64_t last_sequence);
+    void close_log(void);
+    int64_t append(int tc_level, const string &statement);
+    bool wait_synced(int64_t sequence);
+    bool writable(void);
+    bool truncate(void);
+    size_t size(void);
+    int64_t sequence(void);
+    void print_status(void);
+
+private:
+    string file_name;
+    int log_fd;
+    mutex log_mutex;
+    condition_variable sync_done;
+    string pending;           // Records appended but not yet written
+    size_t log_bytes;         // Including the pending records
+    int64_t last_sequence;
+    int64_t synced_sequence;
+    bool syncing;
+    bool failed;
+    long record_count;
+    long sync_count;
+};
+
+/**
+ * The versions of the database, so that queries and writes never wait for 
+ * each other. A query pins the current version and reads it until it is 
+ * done, whatever is written meanwhile, so it sees every table as of one 
+ * moment. A writer copies the current version, changes the copy and publishes
+ * it as the new current version, writers take turns. Copies share the columns
+ * and indexes that a write does not change, see Shared_Vector.
+ * 
+ * A published version is never changed. Versions that are no longer current 
+ * are retired, and a collector thread frees each one once the last query 
+ * that pinned it is done, so queries do not pay for freeing them.
+*/
+class Version_Store
+{
+public:
+    Version_Store() : current_number(0), stopping(false), retired_count(0), collected_count(0) {}
+    ~Version_Store() { stop(); }
+
+    void start(vector<Table> database);
+    void stop(void);
+    shared_ptr<vector<Table>> pin(void);
+    void write(const function<void(vector<Table> &)> &change);
+    void print_status(void);
+
+private:
+    void collect_loop(void);
+
+    mutex version_mutex;
+    condition_variable version_retired;
+    shared_ptr<vector<Table>> current;
+    int64_t current_number;
+    list<shared_ptr<vector<Table>>> retired;  // Waiting for their queries
+    mutex write_mutex;
+    thread collector;
+    bool stopping;
+    long retired_count;
+    long collected_count;
+};
+
+/**
+ * The columns that a query has pinned, they are unpinned when it goes out of
+ * scope.
+*/
+class Column_Pins
+{
+public:
+    ~Column_Pins();
+
+    vector<shared_ptr<Column_Source>> sources;
+};
+
+/**
+ * Loads the columns of the tables on first use. At startup a table only gets
+ * the layout of its snapshot or the start of each line of its data file, a
+ * column's values are read the first time a query pins the column, so the
+ * columns that no query reads never take any memory.
+ *
+ * Pinned columns stay in memory until the query unpins them. Once the loaded
+ * columns take more than the memory budget, the least recently used columns
+ * that are not pinned are evicted, they are read again when they are needed.
+ * A column that is changed is loaded and then kept in memory for good, it no
+ * longer matches its source.
+*/
+class Column_Loader
+{
+public:
+    Column_Loader() : budget_bytes(0), used_bytes(0), attached_count(0), load_count(0), eviction_count(0) {}
+
+    void set_budget(size_t budget_bytes);
+    void attach(Column &column, shared_ptr<Column_Source> source);
+    void detach(Column_Source &source);
+    int pin(const Table &table, const vector<int> &column_idxs, Column_Pins &pins);
+    int pin_table(const Table &table, Column_Pins &pins);
+    void unpin(const vector<shared_ptr<Column_Source>> &sources);
+    void print_status(void);
+
+private:
+    bool load(const Table &table, Column_Source &source);
+    void evict_unpinned(void);
+
+    mutex loader_mutex;
+    list<Column_Source *> loaded_columns;  // Most recently used first
+    size_t budget_bytes;
+    size_t used_bytes;
+    long attached_count;
+    long load_count;
+    long eviction_count;
+};
+
+// Implementation functions
+vector<Table> init_database(void);
+int run_query(string input_line, vector<Table> &database, Session &session);
+bool prepare_query(vector<string> list_of_words, const vector<Table> &database, bool prepared, 
+                   Prepared_Query &query);
+vector<const Table *> query_tables(const Prepared_Query &query, const vector<Table> &database);
+int execute_query(const Prepared_Query &query, const vector<const Table *> &tables, const Predicate &where_predicate, 
+                  const Session &session, vector<Trace_Stage> *trace = NULL);
+void explain_query(const Prepared_Query &query, const vector<const Table *> &tables, const Predicate &where_predicate,
+                   int tc_level);
+int analyze_query(const Prepared_Query &query, const vector<const Table *> &tables, const Predicate &where_predicate,
+                  const string &cache_key, const vector<Table> &database, const Session &session);
+void print_trace(const vector<Trace_Stage> &trace, enum output_format format);
+void *allocate_memory(size_t size);
+bool prepare_statement(const vector<string> &list_of_words, const vector<Table> &database, Session &session);
+bool bind_statement(const string &statement, const Session &session, const vector<Table> &database, 
+                    const Prepared_Query *&query, Predicate &where_predicate, vector<string> &values);
+bool bind_parameters(Predicate &node, const Table &table, const vector<string> &values);
+bool check_column_names(const string &list_string, const Table &table, const string &statement_name);
+int run_batch(const string &query_file, bool framed, vector<Table> &database, Session &session);
+int run_write(string input_line, vector<Table> &database, Session &session);
+int write_table(const vector<Table> &database, const string &statement);
+int modify_table(Table &table, const string &statement, int tc_level);
+int run_insert(Table &table, const string &statement, int tc_level);
+int run_update(Table &table, const string &statement, int tc_level);
+int run_delete(Table &table, const string &statement, int tc_level);
+bool convert_value(const string &value, const Column &column, const string &statement_name, Data &data_item);
+bool check_tc_value(const Table &table, const Data &tc_value, int tc_level, const string &statement_name);
+bool matching_rows(const Table &table, const string &where_string, int tc_level, vector<int> &row_idxs);
+bool write_all(int output_fd, const char *data, size_t length);
+bool read_line(int input_fd, string &buffer, string &line);
+size_t load_csv(Table &table, const string &file_name);
+bool compile_where(const string &where_string, const Table &table, Predicate &where_predicate, 
+                   int *parameter_count = NULL);
+Table_View parse_table(const Predicate &where_predicate, const Table &table_to_parse, int tc_level, 
+                       bool file_order = true, int row_limit = -1);
+void sort_table(const string &orderby_string, Table_View &view_to_order, int row_limit = -1);
+bool parse_limit(vector<string> &list_of_words, int &limit_count, int &limit_offset);
+bool parse_format(vector<string> &list_of_words, enum output_format &format);
+bool format_from_name(const string &format_name, enum output_format &format);
+void select_columns(const string &select_string, Table_View &view_to_select);
+void print_table(const Table_View &view_to_print, enum output_format format = FORMAT_TEXT);
+string format_header(const Table_View &view_to_format, enum output_format format);
+string format_rows(const Table_View &view_to_format, int first_row, int last_row, 
+                   enum output_format format = FORMAT_TEXT);
+string format_binary_rows(const Table_View &view_to_format, int first_row, int last_row);
+void append_int(string &text, int64_t value);
+void append_float(string &text, double value, int precision);
+void append_csv_field(string &text, const char *value, size_t length);
+void append_json_string(string &text, const char *value, size_t length);
+void append_buffer(string &frame, const void *data, size_t size);
+template <typename T>
+void append_column_values(string &frame, const vector<T> &values, const vector<int> &row_idxs, 
+                          int first_row, int last_row);
+Access_Plan plan_access(const Predicate &where_predicate, const Table &table);
+void print_plan(const Predicate &where_predicate, const Table &table, int tc_level, 
+                const string &aggregate_string, const string &order_string, const string &select_string,
+                const string &limit_string);
+bool create_index(vector<Table> &database, const string &statement);
+bool parse_join(const vector<string> &from_words, const vector<Table> &database, Join_Query &join);
+Table_View run_join(const Join_Query &join, const vector<const Table *> &tables, const Predicate &where_predicate, 
+                    int tc_level, Table &joined_table);
+void split_join_predicate(const Predicate &where_predicate, const Join_Query &join, 
+                          vector<Predicate> &table_predicates, Predicate &residual);
+void print_join_plan(const Join_Query &join, const vector<const Table *> &tables, const Predicate &where_predicate, 
+                     int tc_level, const string &aggregate_string, const string &order_string, 
+                     const string &select_string, const string &limit_string);
+void print_access(const Predicate &where_predicate, const Table &table, int tc_level);
+vector<pair<int, int>> hash_join(const Column &left_column, const vector<int> &left_rows, 
+                                 const Column &right_column, const vector<int> &right_rows);
+bool parse_aggregates(const string &select_string, const string &group_string, const Table &table, 
+                      Aggregate_Query &query);
+Table_View aggregate_rows(const Aggregate_Query &query, const Table_View &view_to_aggregate, Table &aggregate_table);
+vector<int> group_rows(const Aggregate_Query &query, const Table &table, const vector<int> &row_idxs, 
+                       vector<int> &first_rows);
+vector<int> column_group_ids(const Column &column, const vector<int> &row_idxs, int &group_count);
+void accumulate_row(const Aggregate &item, const Column *column, int row_idx, Aggregate_State &state);
+void accumulate_rows(const Aggregate &item, const Column *column, const int *row_idxs, int count, 
+                     Aggregate_State &state);
+Column aggregate_column(const Aggregate &item, const Table &table, const Aggregate_State *states, 
+                        const vector<int> &first_rows);
+
+// Index functions
+void build_index(Table &table, int column_idx, enum index_type type);
+int64_t index_key(enum data_type type, char char_data, int int_data, float float_data);
+vector<int> index_lookup(const Index &index, const Table &table, const Predicate &condition, int tc_level);
+int compare_to_literal(const Column &column, int row_idx, const Data &literal);
+void index_add_row(Index &index, const Column &column, int row_idx);
+template <typename F>
+void remap_index(Index &index, F new_row);
+
+// Snapshot functions
+bool write_snapshots(const vector<Table> &database, const string &statement);
+bool write_snapshot(const Table &table, const string &file_name);
+size_t load_snapshot(Table &table, const string &file_name);
+bool read_column_blocks(const char *cursor, const char *blocks_end, Column &column);
+void write_block(ofstream &file, const void *data, size_t size, uint64_t &checksum);
+const char *read_block(const char *&cursor, const char *payload_end, size_t size);
+bool skip_column_blocks(const char *&cursor, const char *payload_end, const Column &column, int row_count);
+uint64_t checksum_words(uint64_t checksum, const char *data, size_t size);
+bool file_stamp(const string &file_name, int64_t &file_size, int64_t &file_mtime);
+bool sync_file(const string &file_name);
+
+// Write-ahead log functions
+int replay_log(vector<Table> &database, const string &file_name);
+bool checkpoint(vector<Table> &database);
+string log_record(int64_t sequence, int tc_level, const string &statement);
+bool parse_log_record(const string &line, int64_t &sequence, int &tc_level, string &statement);
+
+// Column storage functions
+Column new_column(string column_name, enum data_type type);
+void append_data(Column &column, const Data &data_item);
+void insert_data(Column &column, int row_idx, const Data &data_item);
+void set_data(Column &column, int row_idx, const Data &data_item);
+void remove_data(Column &column, const vector<int> &row_idxs);
+template <typename T>
+void remove_values(vector<T> &values, const vector<int> &row_idxs);
+bool is_row_empty(const Column &column, int row_idx);
+const string &string_value(const Column &column, int row_idx);
+bool encode_strings(Column &column);
+int32_t dictionary_code(const Column &column, const string &value);
+int32_t add_dictionary_value(Column &column, const string &value);
+void decode_strings(Column &column);
+bool sort_dictionary(Column &column);
+bool encode_literal(const Column &column, const string &value, enum compare_op &op, int32_t &code);
+void resize_column(Column &column, int row_count);
+bool store_field(Column &column, int row_idx, const char *field_begin, const char *field_end);
+vector<size_t> find_line_starts(const char *file_data, size_t file_size, size_t chunk_begin, size_t chunk_end);
+int parse_column(Column &column, int field_idx, const char *file_data, size_t file_size, 
+                 const vector<size_t> &line_starts, const vector<int> &file_rows);
+void parse_field(Column &column, int field_idx, const char *file_data, size_t file_size, 
+                 const vector<size_t> &line_starts, const vector<int> &file_rows, int first_row, int last_row,
+                 int &rejected_count);
+void report_rejected_fields(const Table &table, const Column &column, int rejected_count);
+size_t column_bytes(const Column &column);
+void unload_column(Column &column);
+void materialize_columns(Table &table);
+Column gather_rows(const Column &column, const vector<int> &row_idxs);
+void cluster_by_tc_level(Table &table);
+bool check_tc_clusters(const Table &table);
+int visible_row_count(const Table &table, int tc_level);
+vector<int> visible_tail_rows(const Table &table, int tc_level);
+bool tail_row_visible(const Table &table, int row_idx, int tc_level);
+void admit_value(Table &table, int column_idx, const Data &data_item);
+int insert_row(Table &table, const vector<Data> &row);
+void remove_rows(Table &table, const vector<int> &row_idxs);
+void reindex_rows(Table &table, int column_idx, const vector<int> &row_idxs);
+
+// Helper Functions
+bool parse_where_or(const vector<string> &tokens, int &token_idx, const Table &table, Predicate &node);
+bool parse_where_and(const vector<string> &tokens, int &token_idx, const Table &table, Predicate &node);
+bool parse_where_condition(const vector<string> &tokens, int &token_idx, const Table &table, Predicate &node);
+bool convert_literal(const string &value, enum data_type type, Data &literal);
+int number_parameters(Predicate &node, int parameter_idx);
+void predicate_columns(const Predicate &node, vector<int> &column_idxs);
+int find_column(const Table &table, const string &column_name);
+int compare_column_rows(const Column &column, int row_idx1, int row_idx2);
+void join_key(const Column &column, int row_idx, string &key);
+void join_key(const Column &column, int row_idx, int64_t &key);
+template <typename K>
+vector<pair<K, int>> join_keys(const Column &column, const vector<int> &rows);
+template <typename K>
+void hash_join_keys(const vector<pair<K, int>> &build_keys, const vector<pair<K, int>> &probe_keys, 
+                    vector<pair<int, int>> &matches);
+bool column_has_name(const Column &column, const string &column_name);
+int join_table_of(const Join_Query &join, int column_idx);
+int predicate_table(const Predicate &node, const Join_Query &join);
+void shift_predicate_columns(Predicate &node, int offset);
+vector<int> evaluate_predicate(const Predicate &node, const Table &table, const vector<int> &candidate_rows);
+void filter_dictionary(const Column &column, const string &value, enum compare_op op, 
+                       const vector<int> &candidate_rows, vector<int> &matching_rows);
+vector<string> split_where_tokens(const string &where_string);
+string normalize_query(const vector<string> &list_of_words);
+string predicate_to_string(const Predicate &node, const Table &table);
+
+// Kernel functions
+enum simd_level detect_simd_level(void);
+void compare_kernel(const int32_t *values, int count, int32_t literal, enum compare_op op, uint64_t *mask);
+void compare_kernel(const float *values, int count, float literal, enum compare_op op, uint64_t *mask);
+void sum_kernel(const int32_t *values, const uint64_t *null_words, int word_count, int64_t &sum);
+void sum_kernel(const float *values, const uint64_t *null_words, int word_count, double &sum);
+
+// The instruction set used by the comparison and sum kernels, picked at 
+// startup based on what the CPU supports
+enum simd_level kernel_simd_level = detect_simd_level();
+
+// The version of the snapshot format and the seed of its checksums
+const uint32_t SNAPSHOT_VERSION = 4;
+const uint32_t LOGGED_SNAPSHOT_VERSION = 3;  // The first with log_sequence, it has no column directory
+const uint64_t CHECKSUM_SEED = 14695981039346656037ULL;
+
+// The threads that run queries, and the number of rows in each morsel. A 
+// morsel is a multiple of 64 rows so that it covers whole null bitmap words.
+Thread_Pool query_pool;
+const int MORSEL_ROWS = 16384;
+
+// The printed results of recent queries, shared by every session
+Result_Cache result_cache;
+const int DEFAULT_CACHE_MB = 64;
+
+// Sends what queries print to the output of the thread that runs them
+Output_Router output_router;
+thread_local streambuf *Output_Router::thread_output = NULL;
+
+// The number of queries a client of the server can have running at once, and
+// the file that lists the TC level each user can connect to the server with
+const int DEFAULT_SESSION_QUERIES = 4;
+const char *CLEARANCE_FILE = "TAB_CLEARANCES.csv";
+
+// Where the allocations of the thread are counted while it runs a query for
+// EXPLAIN ANALYZE, NULL while it does not
+thread_local atomic<int64_t> *allocation_counter = NULL;
+
+// The names of the output formats, in the order of enum output_format
+const char *FORMAT_NAMES[] = { "TEXT", "CSV", "JSONL", "BINARY" };
+
+// The log that INSERT, UPDATE and DELETE are written to, and the size it can
+// grow to before the changed tables are checkpointed
+Write_Ahead_Log write_log;
+const char *WRITE_LOG_FILE = "WAL.log";
+const int DEFAULT_CHECKPOINT_MB = 64;
+size_t checkpoint_bytes = (size_t)DEFAULT_CHECKPOINT_MB << 20;
+
+// Loads the columns of the tables when queries first read them, and the 
+// memory the loaded columns can take before the least recently used are 
+// evicted, 0 for no limit. It comes before the versions of the tables, which
+// are freed first, since a freed column detaches from it.
+Column_Loader column_loader;
+const int DEFAULT_COLUMN_MB = 0;
+
+// The versions of the database that the server's queries and writes run on
+Version_Store table_versions;
+
+// How often the collector looks for retired versions no query uses anymore
+const int COLLECT_INTERVAL_MS = 10;
+string trim(string string_to_trim);
+bool parse_int(const char *field_begin, const char *field_end, int32_t &value);
+bool parse_float(const char *field_begin, const char *field_end, float &value);
+bool parse_argument(const char *text, long min_value, int &value);
+vector<string> split_string_comma(string string_to_parse);
+vector<string> split_string_space(string string_to_parse);
+enum data_type get_type(string type_string);
+
+#ifndef CS301_NO_MAIN
+/**
+ * The main function of the database program. 
+ * 
+ * @note To exit the program the user must enter "EXIT"
+ * 
+ * @param tc_level     An integer representing the users permissions in regards
+ *                     to accessing database records.
+ * @param --server     Instead of the TC level, followed by the path of a Unix
+ *                     socket. Runs a server that clients connect to, each 
+ *                     client asks for its own TC level, up to the clearance
+ *                     of its user (see Query_Server and TAB_CLEARANCES.csv).
+ * @param thread_count The number of threads that run queries, defaults to 1.
+ * @param --batch      Runs the queries of a file, or of stdin if no file is
+ *                     given, without prompts and with buffered output.
+ * @param --framed     In batch mode, marks the start and end of each result.
+ * @param --cache      The memory budget of the result cache in MB, followed 
+ *                     by the number. 0 turns the cache off, defaults to 64.
+ * @param --workers    With --server, the number of queries that run at once,
+ *                     followed by the number. Defaults to the number of cores.
+ * @param --session-queries With --server, the number of queries one client 
+ *                     can have running at once, followed by the number. 
+ *                     Defaults to 4.
+ * @param --checkpoint The size in MB that the write-ahead log can grow to 
+ *                     before the changed tables are checkpointed, followed by
+ *                     the number. Defaults to 64.
+ * @param --column-memory The memory in MB that the columns loaded from the 
+ *                     snapshots and data files can take before the least 
+ *                     recently used are evicted, followed by the number. 0 
+ *                     keeps every loaded column, the default.
+ * 
+ * @retval  0 The program ran successfully.
+ * @retval -1 An error was encountered.
+*/
+int main(int argc, char **argv)
+{    
+    bool server_mode = (argc >= 3) && (string(argv[1]) == "--server");
+    bool batch_mode = false;
+    bool framed = false;
+    string query_file = "";
+    int tc_level = 0;
+    int thread_count = 1;
+    int cache_mb = DEFAULT_CACHE_MB;
+    int worker_count = max(1u, thread::hardware_concurrency());
+    int session_queries = DEFAULT_SESSION_QUERIES;
+    int checkpoint_mb = DEFAULT_CHECKPOINT_MB;
+    int column_mb = DEFAULT_COLUMN_MB;
+    int first_option = server_mode ? 3 : 2;
+    bool valid_arguments = (argc >= 2) && (server_mode || parse_argument(argv[1], INT_MIN, tc_level));
+    for (int arg_idx = first_option; valid_arguments && (arg_idx < argc); arg_idx++)
+    {
+        string argument = argv[arg_idx];
+        bool number_follows = (arg_idx + 1 < argc) && (argv[arg_idx + 1][0] != '\0') &&
+                              (string(argv[arg_idx + 1]).find_first_not_of("0123456789") == string::npos);
+        if ((argument == "--batch") && !server_mode)
+            batch_mode = true;
+        else if ((argument == "--framed") && !server_mode)
+            framed = true;
+        else if ((argument == "--cache") && number_follows)
+            valid_arguments = parse_argument(argv[++arg_idx], 0, cache_mb);
+        else if ((argument == "--workers") && number_follows && server_mode)
+        {
+            valid_arguments = parse_argument(argv[++arg_idx], 0, worker_count);
+            worker_count = max(1, worker_count);
+        }
+        else if ((argument == "--session-queries") && number_follows && server_mode)
+        {
+            valid_arguments = parse_argument(argv[++arg_idx], 0, session_queries);
+            session_queries = max(1, session_queries);
+        }
+        else if ((argument == "--checkpoint") && number_follows)
+        {
+            valid_arguments = parse_argument(argv[++arg_idx], 0, checkpoint_mb);
+            checkpoint_mb = max(1, checkpoint_mb);
+        }
+        else if ((argument == "--column-memory") && number_follows)
+            valid_arguments = parse_argument(argv[++arg_idx], 0, column_mb);
+        else if ((arg_idx == first_option) && (argument.find_first_not_of("0123456789") == string::npos))
+        {
+            valid_arguments = parse_argument(argv[arg_idx], 0, thread_count);
+            thread_count = max(1, thread_count);
+        }
+        else if (batch_mode && (query_file == "") && (argument[0] != '-'))
+            query_file = argument;
+        else
+            valid_arguments = false;
+    }
+    if (!valid_arguments)
+    {
+        cout << "Usage: " << argv[0] << " <tc_level> [thread_count] [--batch [query_file]] [--framed] [--cache <MB>] "
+             << "[--checkpoint <MB>] [--column-memory <MB>]" << endl;
+        cout << "       " << argv[0] << " --server <socket_path> [thread_count] [--workers <count>] "
+             << "[--session-queries <count>] [--cache <MB>] [--checkpoint <MB>] [--column-memory <MB>]" << endl;
+        cout << "A server client can ask for any TC level if it runs as the server's user, otherwise for up to the "
+             << "level " << CLEARANCE_FILE << " gives its user (lines of <user>,<tc_level>)." << endl;
+        return -1;
+    }
+
+    // Batch mode reads a lot of lines, stdin does not need to stay in step 
+    // with C stdio
+    if (batch_mode)
+        ios_base::sync_with_stdio(false);
+
+    // Queries run on a single thread unless more are asked for
+    query_pool.start(thread_count);
+    result_cache.set_budget((size_t)cache_mb << 20);
+    column_loader.set_budget((size_t)column_mb << 20);
+    checkpoint_bytes = (size_t)checkpoint_mb << 20;
+    output_router.install();
+
+    // Initialize the database a return a copy to be used for queries
+    vector<Table> database = init_database();
+
+    // Apply the changes made since the last checkpoint, and checkpoint them
+    // so the next start does not have to replay them again. Snapshots of an
+    // older version are written again as well.
+    int replayed_records = replay_log(database, WRITE_LOG_FILE);
+    if (replayed_records < 0)
+        return -1;
+    bool outdated = (replayed_records > 0);
+    for (const Table &table : database)
+    {
+        outdated = outdated || (table.log_sequence != table.saved_sequence);
+    }
+    if (outdated)
+        checkpoint(database);
+
+    if (server_mode)
+    {
+        table_versions.start(move(database));
+        Query_Server server(worker_count, session_queries);
+        return server.run(argv[2]);
+    }
+
+    // The users security level, rows with a higher TC level are never shown.
+    // Results are printed as text until the user picks another format.
+    Session session = { .tc_level = tc_level, .format = FORMAT_TEXT };
+    if (batch_mode)
+        return run_batch(query_file, framed, database, session);
+
+    // Loop until the user requests to exit the program
+    string input_line;
+    while(1)
+    {
+        cout << "MLS>";
+        if (!getline(cin, input_line)) { break; }
+
+        if (input_line == "EXIT") { break; }
+
+        run_query(input_line, database, session);
+    }
+
+    return 0;
+}
+#endif // CS301_NO_MAIN
+
+/**
+ * Runs one query or statement and prints its result.
+ * 
+ * @param input_line The line that the user entered.
+ * @param database   The database that holds the tables.
+ * @param session    The settings of the user's session, SET and PREPARE 
+ *                   statements change them.
+ * 
+ * @return The number of rows that were printed, -1 if the line is not a valid
+ *         query.
+*/
+int run_query(string input_line, vector<Table> &database, Session &session)
+{
+    // Get the query section that comes before the ';' (inclusive)
+    size_t pos = input_line.find(';');
+    if (pos != string::npos)
+    {
+        input_line = input_line.substr(0, pos + 1);
+    }
+
+    // If ';' is missing the query is invalid
+    if (input_line.empty() || (input_line[input_line.size() - 1] != ';'))
+        return -1;
+
+    // replace the ';' character with a space, so the string can be split
+    // properly
+    input_line[input_line.size() - 1] = ' ';
+
+    // Split the string using a space delimiter in order to parse out
+    // query information.
+    vector<string> list_of_words = split_string_space(input_line);
+    if (list_of_words.empty())
+        return -1;
+
+    if (list_of_words[0] == "CREATE")
+        return create_index(database, input_line) ? 0 : -1;
+
+    if (list_of_words[0] == "SNAPSHOT")
+        return write_snapshots(database, input_line) ? 0 : -1;
+
+    if ((list_of_words[0] == "INSERT") || (list_of_words[0] == "UPDATE") || (list_of_words[0] == "DELETE"))
+        return run_write(input_line, database, session);
+
+    if (list_of_words[0] == "CHECKPOINT")
+    {
+        if (list_of_words.size() != 1)
+        {
+            cout << "Invalid CHECKPOINT statement, expected: CHECKPOINT" << endl;
+            return -1;
+        }
+        return checkpoint(database) ? 0 : -1;
+    }
+
+    // SET FORMAT <format> changes the format of every later result
+    if (list_of_words[0] == "SET")
+    {
+        if ((list_of_words.size() != 3) || (list_of_words[1] != "FORMAT") || 
+            !format_from_name(list_of_words[2], session.format))
+        {
+            cout << "Invalid SET statement, expected: SET FORMAT TEXT|CSV|JSONL|BINARY" << endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    if ((list_of_words[0] == "STATUS") && (list_of_words.size() == 1))
+    {
+        result_cache.print_status();
+        write_log.print_status();
+        table_versions.print_status();
+        column_loader.print_status();
+        return 0;
+    }
+
+    // PREPARE <name> AS <query> parses and plans a query once, so that
+    // EXECUTE <name>(<values>) only has to put the values in place of
+    // its ?s
+    if (list_of_words[0] == "PREPARE")
+        return prepare_statement(list_of_words, database, session) ? 0 : -1;
+
+    if (list_of_words[0] == "DEALLOCATE")
+    {
+        if ((list_of_words.size() != 2) || (session.prepared_queries.erase(list_of_words[1]) == 0))
+        {
+            cout << "Invalid DEALLOCATE statement, expected: DEALLOCATE <prepared query>" << endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    // EXPLAIN ANALYZE runs the query and prints what each of its stages
+    // took instead of its rows
+    bool analyze = (list_of_words.size() > 2) && (list_of_words[0] == "EXPLAIN") && 
+                   (list_of_words[1] == "ANALYZE");
+    if (analyze)
+    {
+        list_of_words.erase(list_of_words.begin(), list_of_words.begin() + 2);
+        input_line = input_line.substr(input_line.find("ANALYZE") + string("ANALYZE").size());
+    }
+
+    // A query is identified by its normalized words, so that queries
+    // that only differ in spacing are the same. An executed query is 
+    // identified by its prepared query and values.
+    const Prepared_Query *query = NULL;
+    Prepared_Query parsed_query;
+    Predicate bound_predicate;
+    string query_text = "";
+    if (list_of_words[0] == "EXECUTE")
+    {
+        vector<string> values;
+        if (!bind_statement(input_line, session, database, query, bound_predicate, values))
+            return -1;
+
+        query_text = query->query_text + " USING";
+        for (const string &value : values)
+        {
+            query_text += " " + value;
+        }
+    }
+    else
+        query_text = normalize_query(list_of_words);
+
+    // A query that already ran with the same TC level and format, on 
+    // tables that have not changed since, prints its cached result
+    string cache_key = "";
+    if ((list_of_words[0] != "EXPLAIN") && (result_cache.budget() > 0))
+    {
+        cache_key = to_string(session.tc_level) + " " + to_string(session.format) + " " + query_text;
+
+        string cached_output;
+        int cached_rows = 0;
+        if (!analyze && result_cache.lookup(cache_key, database, cached_output, cached_rows))
+        {
+            cout.write(cached_output.data(), cached_output.size()) << flush;
+            return cached_rows;
+        }
+    }
+
+    bool executed = (query != NULL);
+    if (query == NULL)
+    {
+        if (!prepare_query(list_of_words, database, false, parsed_query))
+            return -1;
+        query = &parsed_query;
+    }
+    const Predicate &where_predicate = executed ? bound_predicate : query->where_predicate;
+    vector<const Table *> tables = query_tables(*query, database);
+
+    // EXPLAIN only prints the steps the query would run
+    if (query->explain)
+    {
+        explain_query(*query, tables, where_predicate, session.tc_level);
+        return 0;
+    }
+    if (analyze)
+        return analyze_query(*query, tables, where_predicate, cache_key, database, session);
+
+    // What is printed is kept for the result cache, unless it is larger
+    // than the whole cache
+    if (cache_key == "")
+        return execute_query(*query, tables, where_predicate, session);
+
+    streambuf *output_buffer = output_router.thread_target();
+    Capture_Buffer capture(output_buffer, result_cache.budget());
+    output_router.set_thread_output(&capture);
+    int row_count = execute_query(*query, tables, where_predicate, session);
+    output_router.set_thread_output(output_buffer);
+
+    vector<pair<int, int64_t>> table_versions;
+    for (int table_idx : query->table_idxs)
+    {
+        table_versions.push_back(make_pair(table_idx, database[table_idx].version));
+    }
+    if (capture.complete())
+        result_cache.store(cache_key, capture.captured(), row_count, table_versions);
+    return row_count;
+}
+
+/**
+ * Parses a query, resolves its tables and columns and compiles its 
+ * statements, so that it is ready to run. Errors are printed.
+ * 
+ * @param list_of_words The words of the query.
+ * @param database      The database that holds the tables.
+ * @param prepared      True if the query is prepared, its WHERE statement can
+ *                      then have ? in place of values and the columns of its
+ *                      SELECT and ORDERBY statements are checked up front.
+ * @param query         The parsed query.
+ * 
+ * @return True if the query is valid.
+*/
+bool prepare_query(vector<string> list_of_words, const vector<Table> &database, bool prepared, 
+                   Prepared_Query &query)
+{
+    string from_string  = "";
+    string where_string = "";
+    query.query_text = normalize_query(list_of_words);
+    query.explain = (list_of_words[0] == "EXPLAIN");
+    query.table = NULL;
+    query.parameter_count = 0;
+
+    // FORMAT and LIMIT statements end the query, they are taken off
+    // so that the other statements end before them
+    size_t word_count = list_of_words.size();
+    query.format = FORMAT_TEXT;
+    if (!parse_format(list_of_words, query.format))
+        return false;
+    query.format_given = (list_of_words.size() != word_count);
+
+    if (!parse_limit(list_of_words, query.limit_count, query.limit_offset) || list_of_words.empty())
+        return false;
+
+    // Use the FROM section to determine which table to use, more 
+    // tables can be added with JOIN <table> ON <column>=<column>
+    vector<string> from_words;
+    for (int word_idx = 0; word_idx < list_of_words.size() - 1; word_idx++)
+    {
+        if (list_of_words[word_idx] == "FROM")
+        {
+            // First non whitespace string is the table table that we will use
+            from_string = list_of_words[word_idx + 1];
+            for (int from_idx = word_idx + 1; (from_idx < list_of_words.size()) && 
+                 (list_of_words[from_idx] != "WHERE") && (list_of_words[from_idx] != "GROUPBY") &&
+                 (list_of_words[from_idx] != "ORDERBY"); from_idx++)
+            {
+                from_words.push_back(list_of_words[from_idx]);
+            }
+            break;
+        }
+    }
+
+    // Find the table using the FROM statement, the query only reads
+    // from it so no copy is made. A join is resolved against a table
+    // without rows that holds the columns of every joined table.
+    if ((from_words.size() > 1) && (from_words[1] == "JOIN") && 
+        !parse_join(from_words, database, query.join))
+    {
+        return false;
+    }
+    for (int table_idx = 0; query.join.tables.empty() && (table_idx < database.size()); table_idx++)
+    {
+        if (from_string == database[table_idx].table_name)
+        {
+            query.table = &database[table_idx];
+            query.table_idxs.push_back(table_idx);
+            break;
+        }
+    }
+    for (const Table *join_table : query.join.tables)
+    {
+        query.table_idxs.push_back(join_table - database.data());
+    }
+    // If the table does not exist the query is ignored, otherwise get the
+    // other query information
+    if (query.join.tables.empty() && (query.table == NULL))
+        return false;
+    const Table &table = query.join.tables.empty() ? *query.table : query.join.schema;
+
+    // Check for a where statement and use it to parse information if necessary
+    int where_idx = 0;
+    for (int word_idx = 0; word_idx < list_of_words.size(); word_idx++)
+    {
+        if (list_of_words[word_idx] == "WHERE")
+        {
+            where_idx = word_idx;
+            break;
+        }
+    }
+    // If the where statment exists, then we need to get the conditions
+    // that will filter the table
+    for (int word_idx = where_idx + 1; word_idx < list_of_words.size(); word_idx++)
+    {
+        if ((list_of_words[word_idx] != "ORDERBY") && (list_of_words[word_idx] != "GROUPBY"))
+            where_string = where_string + list_of_words[word_idx] + " ";
+        else
+            break;
+    }
+
+    // Compile the where string once, the query is rejected if it
+    // does not match the table. Without conditions every row that
+    // the user can see is kept.
+    query.where_predicate = Predicate();
+    query.where_predicate.kind = PREDICATE_AND;
+    if ((where_idx != 0) && (trim(where_string) != "") && 
+        !compile_where(where_string, table, query.where_predicate, prepared ? &query.parameter_count : NULL))
+    {
+        return false;
+    }
+
+    // Check for a group by statement
+    int groupby_idx = 0;
+    for (int word_idx = 0; word_idx < list_of_words.size(); word_idx++)
+    {
+        if (list_of_words[word_idx] == "GROUPBY")
+        {
+            groupby_idx = word_idx;
+            break;
+        }
+    }
+    // If the group by statement exists, then we need to get the 
+    // columns that the rows are grouped by
+    query.grouping = (groupby_idx != 0);
+    query.group_string = "";
+    if (groupby_idx != 0)
+    {
+        for (int word_idx = groupby_idx + 1; word_idx < list_of_words.size(); word_idx++)
+        {
+            if (list_of_words[word_idx] != "ORDERBY")
+                query.group_string = query.group_string + list_of_words[word_idx] + " ";
+            else
+                break;
+        }
+    }
+
+    // CHeck for an order by statement
+    int orderby_idx = 0;
+    for (int word_idx = 0; word_idx < list_of_words.size(); word_idx++)
+    {
+        if (list_of_words[word_idx] == "ORDERBY")
+        {
+            orderby_idx = word_idx;
+            break;
+        }
+    }
+    // If the order by statement exists, then we need to get the 
+    // conditions that will filter the table
+    query.ordering = (orderby_idx != 0);
+    query.order_string = "";
+    if (orderby_idx != 0)
+    {
+        for (int word_idx = orderby_idx + 1; word_idx < list_of_words.size(); word_idx++)
+        {
+            query.order_string = query.order_string + list_of_words[word_idx] + " ";
+        }
+    }
+
+    // Check for an order by statement
+    int select_idx = -1;
+    for (int word_idx = 0; word_idx < list_of_words.size(); word_idx++)
+    {
+        if (list_of_words[word_idx] == "SELECT")
+        {
+            select_idx = word_idx;
+            break;
+        }
+    }
+
+    // If the select statement exists, then we need to get the select conditions,
+    // so we know what columns are needed
+    query.selecting = (select_idx != -1);
+    query.select_string = "";
+    if (select_idx != -1)
+    {
+        for (int word_idx = select_idx + 1; word_idx < list_of_words.size(); word_idx++)
+        {
+            if (list_of_words[word_idx] != "FROM")
+                query.select_string = query.select_string + list_of_words[word_idx] + " ";
+            else
+                break;
+        }
+    }
+
+    // A GROUPBY statement or an aggregate function in SELECT turns
+    // the rows into one result row per group
+    query.aggregating = query.grouping || (query.select_string.find('(') != string::npos);
+    if (query.aggregating && 
+        !parse_aggregates(query.select_string, query.group_string, table, query.aggregate_query))
+    {
+        return false;
+    }
+
+    // A prepared query should not find out that a column is missing 
+    // when it runs, since SELECT and ORDERBY would skip it
+    if (prepared && !query.aggregating && 
+        (!check_column_names(query.select_string, table, "SELECT") || 
+         !check_column_names(query.order_string, table, "ORDERBY")))
+    {
+        return false;
+    }
+
+    // The SELECT statement only depends on the columns, so the columns
+    // it keeps are found once. A join's result has the columns of its
+    // schema.
+    Table_View all_columns;
+    all_columns.table = &table;
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        all_columns.column_idxs.push_back(column_idx);
+    }
+    if (query.selecting && !query.aggregating)
+        select_columns(query.select_string, all_columns);
+    query.column_idxs.swap(all_columns.column_idxs);
+
+    // Only the columns the query reads have to be loaded before it runs:
+    // the WHERE columns and then either the aggregated columns, or the
+    // ORDERBY columns and the columns that are printed
+    query.read_columns.clear();
+    if (query.join.tables.empty())
+    {
+        predicate_columns(query.where_predicate, query.read_columns);
+        if (query.aggregating)
+        {
+            query.read_columns.insert(query.read_columns.end(), query.aggregate_query.group_columns.begin(),
+                                      query.aggregate_query.group_columns.end());
+            for (const Aggregate &item : query.aggregate_query.items)
+            {
+                if (item.column_idx != -1)
+                    query.read_columns.push_back(item.column_idx);
+            }
+        }
+        else
+        {
+            query.read_columns.insert(query.read_columns.end(), query.column_idxs.begin(), query.column_idxs.end());
+            for (string order_item : split_string_comma(query.order_string))
+            {
+                order_item = order_item.substr(0, order_item.find(':'));
+                order_item.erase(remove(order_item.begin(), order_item.end(), ' '), order_item.end());
+                int column_idx = find_column(table, order_item);
+                if (column_idx >= 0)
+                    query.read_columns.push_back(column_idx);
+            }
+        }
+        sort(query.read_columns.begin(), query.read_columns.end());
+        query.read_columns.erase(unique(query.read_columns.begin(), query.read_columns.end()),
+                                 query.read_columns.end());
+    }
+    return true;
+}
+
+/**
+ * Finds the tables a query reads in the database it runs on. A prepared 
+ * query points at the tables as they were when it was prepared, the server
+ * keeps a version of the tables only while queries read it.
+ * 
+ * @param query    The parsed query.
+ * @param database The database the query runs on.
+ * 
+ * @return The table of the query, or the tables of its join in the order 
+ *         they are listed.
+*/
+vector<const Table *> query_tables(const Prepared_Query &query, const vector<Table> &database)
+{
+    vector<const Table *> tables;
+    for (int table_idx : query.table_idxs)
+    {
+        tables.push_back(&database[table_idx]);
+    }
+    return tables;
+}
+
+/**
+ * Runs a parsed query and prints its result.
+ * 
+ * @param query           The parsed query.
+ * @param tables          The tables the query reads, see query_tables.
+ * @param where_predicate The compiled conditions, with the values of the query
+ *                        bound if it is prepared.
+ * @param session         The settings of the user's session.
+ * @param trace           Where the time and rows of each stage are added, 
+ *                        NULL if they are not measured.
+ * 
+ * @return The number of rows that were printed.
+*/
+int execute_query(const Prepared_Query &query, const vector<const Table *> &tables, const Predicate &where_predicate, 
+                  const Session &session, vector<Trace_Stage> *trace)
+{
+    Stage_Timer timer(trace);
+
+    // The rows that LIMIT and OFFSET need from the sort or the scan
+    int row_limit = -1;
+    if (query.limit_count != -1)
+        row_limit = (int)min((long)query.limit_count + query.limit_offset, (long)INT_MAX);
+
+    // Pin the columns the query reads, loading the ones that are not in
+    // memory yet, so they are not evicted while the query runs
+    Column_Pins pins;
+    int loaded_columns = 0;
+    long loaded_rows = 0;
+    if (query.join.tables.empty())
+    {
+        loaded_columns = column_loader.pin(*tables[0], query.read_columns, pins);
+        loaded_rows = tables[0]->table_data.empty() ? 0 : tables[0]->table_data[0].row_count;
+    }
+    for (int join_idx = 0; join_idx < query.join.tables.size(); join_idx++)
+    {
+        const Table *join_table = tables[join_idx];
+        vector<int> column_idxs;
+        for (int column_idx = 0; column_idx < join_table->table_data.size(); column_idx++)
+        {
+            column_idxs.push_back(column_idx);
+        }
+        loaded_columns += column_loader.pin(*join_table, column_idxs, pins);
+        loaded_rows += join_table->table_data.empty() ? 0 : join_table->table_data[0].row_count;
+    }
+    if (timer.tracing() && (loaded_columns > 0))
+        timer.finish("LOAD", to_string(loaded_columns) + " COLUMNS", loaded_rows, loaded_rows);
+
+    // Parse information out of table using the where string, only
+    // the rows at or below the users tc level are checked. In a
+    // join this is checked on every table.
+    // Aggregates do not need the rows in file order, and without
+    // ORDERBY the scan can stop once it has found enough rows.
+    Table joined_table;
+    Table_View result;
+    if (query.join.tables.empty())
+    {
+        bool stop_early = !query.aggregating && !query.ordering;
+        result = parse_table(where_predicate, *tables[0], session.tc_level, !query.aggregating, 
+                             stop_early ? row_limit : -1);
+
+        if (timer.tracing())
+        {
+            Access_Plan plan = plan_access(where_predicate, *tables[0]);
+            string detail = tables[0]->table_name;
+            if (plan.index != NULL)
+                detail += "." + tables[0]->table_data[plan.index->column_idx].column_name + 
+                          (plan.index->type == INDEX_HASH ? " HASH " : " ORDERED ") + 
+                          predicate_to_string(*plan.condition, *tables[0]);
+            else if (!where_predicate.children.empty() || (where_predicate.kind != PREDICATE_AND))
+                detail += " WHERE " + predicate_to_string(where_predicate, *tables[0]);
+            timer.finish((plan.index != NULL) ? "INDEX" : "SCAN", detail, 
+                         visible_row_count(*tables[0], session.tc_level) + 
+                         visible_tail_rows(*tables[0], session.tc_level).size(), result.row_idxs.size());
+        }
+    }
+    else
+    {
+        result = run_join(query.join, tables, where_predicate, session.tc_level, joined_table);
+
+        if (timer.tracing())
+        {
+            long joined_rows = 0;
+            for (const Table *join_table : tables)
+            {
+                joined_rows += visible_row_count(*join_table, session.tc_level) + 
+                               visible_tail_rows(*join_table, session.tc_level).size();
+            }
+            timer.finish("JOIN", query.join.schema.table_name, joined_rows, result.row_idxs.size());
+        }
+    }
+
+    // The SELECT statement of an aggregate query lists the result
+    // columns, so they are already selected
+    Table aggregate_table;
+    if (query.aggregating)
+    {
+        long grouped_rows = result.row_idxs.size();
+        result = aggregate_rows(query.aggregate_query, result, aggregate_table);
+        if (timer.tracing())
+            timer.finish("AGGREGATE", query.grouping ? "GROUPBY " + trim(query.group_string) : "ALL ROWS", 
+                         grouped_rows, result.row_idxs.size());
+    }
+
+    if (query.ordering && (result.row_idxs.size() != 0))
+    {
+        sort_table(query.order_string, result, row_limit);
+        if (timer.tracing())
+        {
+            string detail = trim(query.order_string) + ((row_limit != -1) ? " TOP " + to_string(row_limit) : "");
+            timer.finish("ORDERBY", detail, result.row_idxs.size(), result.row_idxs.size());
+        }
+    }
+
+    if (!query.aggregating)
+    {
+        result.column_idxs = query.column_idxs;
+        if (timer.tracing())
+            timer.finish("SELECT", query.selecting ? trim(query.select_string) : "*", result.row_idxs.size(), 
+                         result.row_idxs.size());
+    }
+
+    if (query.limit_count != -1)
+    {
+        long limited_rows = result.row_idxs.size();
+        result.row_idxs.erase(result.row_idxs.begin(), 
+                              result.row_idxs.begin() + min((int)result.row_idxs.size(), query.limit_offset));
+        if (result.row_idxs.size() > query.limit_count)
+            result.row_idxs.resize(query.limit_count);
+        if (timer.tracing())
+            timer.finish("LIMIT", to_string(query.limit_count) + " OFFSET " + to_string(query.limit_offset), 
+                         limited_rows, result.row_idxs.size());
+    }
+
+    // Print out the entire table, which should only contain the desired
+    // elements
+    enum output_format format = query.format_given ? query.format : session.format;
+    print_table(result, format);
+    if (timer.tracing())
+        timer.finish("PRINT", FORMAT_NAMES[format], result.row_idxs.size(), result.row_idxs.size());
+    return result.row_idxs.size();
+}
+
+/**
+ * Prints the steps that a parsed query would run.
+ * 
+ * @param query           The parsed query.
+ * @param tables          The tables the query reads, see query_tables.
+ * @param where_predicate The compiled conditions, with the values of the query
+ *                        bound if it is prepared.
+ * @param tc_level        The users security level.
+*/
+void explain_query(const Prepared_Query &query, const vector<const Table *> &tables, const Predicate &where_predicate,
+                   int tc_level)
+{
+    string aggregate_string = "";
+    if (query.aggregating)
+        aggregate_string = query.grouping ? "HASH GROUPBY " + trim(query.group_string) : "ALL ROWS";
+
+    string limit_string = "";
+    if (query.limit_count != -1)
+    {
+        limit_string = to_string(query.limit_count) + " OFFSET " + to_string(query.limit_offset);
+        if (query.ordering)
+            limit_string += " (TOP-K HEAP)";
+        else if (!query.aggregating && query.join.tables.empty())
+            limit_string += " (SCAN STOPS EARLY)";
+    }
+
+    if (query.join.tables.empty())
+        print_plan(where_predicate, *tables[0], tc_level, aggregate_string, query.order_string, 
+                   query.select_string, limit_string);
+    else
+        print_join_plan(query.join, tables, where_predicate, tc_level, aggregate_string, query.order_string, 
+                        query.select_string, limit_string);
+}
+
+/**
+ * Runs a query for EXPLAIN ANALYZE and prints the time, rows and allocations
+ * of each of its stages instead of its rows. Text results show the plan
+ * first, the other formats only have the stages so they can be read by 
+ * other programs. A query found in the result cache is not run.
+ * 
+ * @param query           The parsed query.
+ * @param tables          The tables the query reads, see query_tables.
+ * @param where_predicate The compiled conditions, with the values of the query
+ *                        bound if it is prepared.
+ * @param cache_key       The key of the query's result in the result cache,
+ *                        empty if it is not cached.
+ * @param database        The database that holds the tables.
+ * @param session         The settings of the user's session.
+ * 
+ * @return The number of stages that were printed.
+*/
+int analyze_query(const Prepared_Query &query, const vector<const Table *> &tables, const Predicate &where_predicate,
+                  const string &cache_key, const vector<Table> &database, const Session &session)
+{
+    vector<Trace_Stage> trace;
+    int row_count = 0;
+    bool cache_hit = false;
+    {
+        Stage_Timer timer(&trace);
+        string cached_output;
+        cache_hit = (cache_key != "") && result_cache.lookup(cache_key, database, cached_output, row_count);
+        if (cache_hit)
+            timer.finish("CACHE", "HIT " + to_string(cached_output.size()) + " bytes", row_count, row_count);
+    }
+
+    if (!cache_hit)
+    {
+        Count_Buffer counter;
+        streambuf *output_buffer = output_router.thread_target();
+        output_router.set_thread_output(&counter);
+        row_count = execute_query(query, tables, where_predicate, session, &trace);
+        output_router.set_thread_output(output_buffer);
+        trace.back().detail += " " + to_string(counter.count()) + " bytes";
+    }
+
+    // Loading columns reads whole columns, the rows the query read are those
+    // of the stage after it
+    const Trace_Stage &first_stage = ((trace.size() > 1) && (trace.front().stage == "LOAD")) ? trace[1] : trace.front();
+    Trace_Stage total = { .stage = "TOTAL", .detail = "", .rows_in = first_stage.rows_in, .rows_out = row_count, 
+                          .seconds = 0.0, .allocated_bytes = 0 };
+    total.detail = (cache_key == "") ? "CACHE OFF" : cache_hit ? "CACHE HIT" : "CACHE MISS";
+    for (const Trace_Stage &stage : trace)
+    {
+        total.seconds += stage.seconds;
+        total.allocated_bytes += stage.allocated_bytes;
+    }
+    trace.push_back(total);
+
+    enum output_format format = query.format_given ? query.format : session.format;
+    if (format == FORMAT_TEXT)
+        explain_query(query, tables, where_predicate, session.tc_level);
+    print_trace(trace, format);
+    return trace.size();
+}
+
+/**
+ * Prints the stages of a query as a table with the columns STAGE, DETAIL, 
+ * ROWS_IN, ROWS_OUT, TIME_MS and ALLOCATED_BYTES.
+ * 
+ * @param trace  The stages.
+ * @param format The format to print the table in.
+*/
+void print_trace(const vector<Trace_Stage> &trace, enum output_format format)
+{
+    Table trace_table = { .table_name = "TRACE", .tc_column_idx = -1 };
+    trace_table.table_data.push_back(new_column("STAGE", STRING));
+    trace_table.table_data.push_back(new_column("DETAIL", STRING));
+    trace_table.table_data.push_back(new_column("ROWS_IN", INT));
+    trace_table.table_data.push_back(new_column("ROWS_OUT", INT));
+    trace_table.table_data.push_back(new_column("TIME_MS", DOUBLE));
+    trace_table.table_data.push_back(new_column("ALLOCATED_BYTES", BIGINT));
+
+    Table_View result;
+    result.table = &trace_table;
+    for (const Trace_Stage &stage : trace)
+    {
+        Data data_item;
+        data_item.empty = false;
+        data_item.string_data = stage.stage;
+        append_data(trace_table.table_data[0], data_item);
+        data_item.string_data = stage.detail;
+        append_data(trace_table.table_data[1], data_item);
+        data_item.int_data = stage.rows_in;
+        append_data(trace_table.table_data[2], data_item);
+        data_item.int_data = stage.rows_out;
+        append_data(trace_table.table_data[3], data_item);
+
+        result.row_idxs.push_back(result.row_idxs.size());
+    }
+
+    // append_data only stores the types of the data files
+    Column &time_column = trace_table.table_data[4];
+    Column &bytes_column = trace_table.table_data[5];
+    for (Column *column : { &time_column, &bytes_column })
+    {
+        column->row_count = trace.size();
+        column->null_bitmap.assign((trace.size() + 63) / 64, 0);
+    }
+    for (const Trace_Stage &stage : trace)
+    {
+        time_column.double_data.push_back(stage.seconds * 1000);
+        bytes_column.bigint_data.push_back(stage.allocated_bytes);
+    }
+
+    for (int column_idx = 0; column_idx < trace_table.table_data.size(); column_idx++)
+    {
+        result.column_idxs.push_back(column_idx);
+    }
+    print_table(result, format);
+}
+
+/**
+ * Starts timing the first stage.
+ * 
+ * @param trace Where the stages are added, NULL to not measure them.
+*/
+Stage_Timer::Stage_Timer(vector<Trace_Stage> *trace) 
+    : trace(trace), allocated_bytes(0), outer_counter(allocation_counter), start_bytes(0)
+{
+    if (trace == NULL)
+        return;
+
+    allocation_counter = &allocated_bytes;
+    start_time = chrono::steady_clock::now();
+}
+
+/**
+ * Stops counting the allocations of the thread for this timer.
+*/
+Stage_Timer::~Stage_Timer()
+{
+    if (trace != NULL)
+        allocation_counter = outer_counter;
+}
+
+/**
+ * Adds the stage that just ended to the trace and starts the next one.
+ * 
+ * @param stage    The name of the stage.
+ * @param detail   What the stage did.
+ * @param rows_in  The number of rows the stage read.
+ * @param rows_out The number of rows the stage produced.
+*/
+void Stage_Timer::finish(const string &stage, const string &detail, long rows_in, long rows_out)
+{
+    if (trace == NULL)
+        return;
+
+    chrono::steady_clock::time_point end_time = chrono::steady_clock::now();
+    int64_t end_bytes = allocated_bytes.load();
+    Trace_Stage finished = { .stage = stage, .detail = detail, .rows_in = rows_in, .rows_out = rows_out, 
+                             .seconds = chrono::duration<double>(end_time - start_time).count(), 
+                             .allocated_bytes = end_bytes - start_bytes };
+    trace->push_back(finished);
+
+    // The time and memory spent adding the stage count toward the next one
+    start_time = end_time;
+    start_bytes = end_bytes;
+}
+
+/**
+ * Counts a character.
+ * 
+ * @param next_char The character.
+ * 
+ * @return The character.
+*/
+int Count_Buffer::overflow(int next_char)
+{
+    if (next_char != EOF)
+        byte_count++;
+    return next_char;
+}
+
+/**
+ * Counts a block of characters without looking at them.
+ * 
+ * @param length The number of characters.
+ * 
+ * @return The number of characters.
+*/
+streamsize Count_Buffer::xsputn(const char *, streamsize length)
+{
+    byte_count += length;
+    return length;
+}
+
+/**
+ * Allocates memory for every form of new. The bytes are counted while the 
+ * thread runs a query for EXPLAIN ANALYZE. As long as malloc fails the new
+ * handler is called to free memory, without one bad_alloc is thrown.
+ * 
+ * @param size The number of bytes.
+ * 
+ * @return The memory.
+*/
+void *allocate_memory(size_t size)
+{
+    if (allocation_counter != NULL)
+        allocation_counter->fetch_add(size, memory_order_relaxed);
+
+    while (1)
+    {
+        void *memory = malloc((size == 0) ? 1 : size);
+        if (memory != NULL)
+            return memory;
+
+        new_handler handler = get_new_handler();
+        if (handler == NULL)
+            throw bad_alloc();
+        handler();
+    }
+}
+
+/**
+ * Allocates memory for new and new[], the nothrow forms return NULL instead
+ * of throwing bad_alloc. They are not inlined, so that the compiler sees the
+ * memory they return freed by delete and not by free.
+ * 
+ * @param size The number of bytes.
+ * 
+ * @return The memory.
+*/
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    return allocate_memory(size);
+}
+
+__attribute__((noinline)) void *operator new[](size_t size)
+{
+    return allocate_memory(size);
+}
+
+__attribute__((noinline)) void *operator new(size_t size, const nothrow_t &) noexcept
+{
+    try
+    {
+        return allocate_memory(size);
+    }
+    catch (const bad_alloc &)
+    {
+        return NULL;
+    }
+}
+
+__attribute__((noinline)) void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+    try
+    {
+        return allocate_memory(size);
+    }
+    catch (const bad_alloc &)
+    {
+        return NULL;
+    }
+}
+
+/**
+ * Frees memory allocated by any form of new. They are not inlined for the
+ * same reason as new.
+ * 
+ * @param memory The memory.
+*/
+__attribute__((noinline)) void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void *memory, const nothrow_t &) noexcept
+{
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory, const nothrow_t &) noexcept
+{
+    free(memory);
+}
+
+#ifdef __cpp_sized_deallocation
+__attribute__((noinline)) void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void *memory, size_t) noexcept
+{
+    free(memory);
+}
+#endif
+
+/**
+ * Function that runs a PREPARE statement, which has the form 
+ * PREPARE <name> AS SELECT ... and keeps the parsed query in the session.
+ * Values in the WHERE statement can be left as ? and are given by EXECUTE.
+ * 
+ * @param list_of_words The words of the statement.
+ * @param database      The database that holds the tables.
+ * @param session       The session that keeps the prepared query.
+ * 
+ * @return True if the query was prepared, otherwise an error is printed.
+*/
+bool prepare_statement(const vector<string> &list_of_words, const vector<Table> &database, Session &session)
+{
+    if ((list_of_words.size() < 4) || (list_of_words[2] != "AS") || (list_of_words[3] != "SELECT") ||
+        (list_of_words[1].find_first_of("(),") != string::npos))
+    {
+        cout << "Invalid PREPARE statement, expected: PREPARE <name> AS SELECT ..." << endl;
+        return false;
+    }
+
+    Prepared_Query query;
+    if (!prepare_query(vector<string>(list_of_words.begin() + 3, list_of_words.end()), database, true, query))
+        return false;
+
+    session.prepared_queries[list_of_words[1]] = query;
+    return true;
+}
+
+/**
+ * Function that parses an EXECUTE statement, which has the form 
+ * EXECUTE <name>(<value>, ...) with one value for each ? of the prepared
+ * query, and binds the values to its WHERE statement. The prepared query is
+ * shared by every EXECUTE of it, only its WHERE tree is copied to hold the 
+ * values.
+ * 
+ * @param statement       The statement.
+ * @param session         The session that keeps the prepared queries.
+ * @param database        The database to run the query on. The tables may 
+ *                        have changed since the query was prepared.
+ * @param query           Set to the prepared query.
+ * @param where_predicate Set to the query's WHERE tree with the values in 
+ *                        place of its ?s.
+ * @param values          The values of the statement.
+ * 
+ * @return True if the statement is valid, otherwise an error is printed.
+*/
+bool bind_statement(const string &statement, const Session &session, const vector<Table> &database, 
+                    const Prepared_Query *&query, Predicate &where_predicate, vector<string> &values)
+{
+    string call_string = trim(trim(statement).substr(string("EXECUTE").size()));
+    size_t open_pos = call_string.find('(');
+    if ((open_pos != string::npos) && (call_string[call_string.size() - 1] != ')'))
+    {
+        cout << "Invalid EXECUTE statement, expected: EXECUTE <name>(<value>, ...)" << endl;
+        return false;
+    }
+
+    string name = trim(call_string.substr(0, open_pos));
+    if (open_pos != string::npos)
+    {
+        string value_string = call_string.substr(open_pos + 1, call_string.size() - open_pos - 2);
+        for (const string &value : split_string_comma(value_string))
+        {
+            values.push_back(trim(value));
+        }
+        if ((values.size() == 1) && (values[0] == ""))
+            values.clear();
+    }
+
+    unordered_map<string, Prepared_Query>::const_iterator found = session.prepared_queries.find(name);
+    if (found == session.prepared_queries.end())
+    {
+        cout << "Invalid prepared query in EXECUTE statement: " << name << endl;
+        return false;
+    }
+
+    if (values.size() != found->second.parameter_count)
+    {
+        cout << "Invalid EXECUTE statement, " << name << " expects " << found->second.parameter_count << " values" 
+             << endl;
+        return false;
+    }
+
+    query = &found->second;
+    where_predicate = query->where_predicate;
+    const Table &table = query->join.tables.empty() ? database[query->table_idxs[0]] : query->join.schema;
+    return bind_parameters(where_predicate, table, values);
+}
+
+/**
+ * Converts the values of an EXECUTE statement to the types of their columns
+ * and puts them in place of the ?s of a compiled WHERE tree.
+ * 
+ * @param node   The tree, resolved against the table.
+ * @param table  The table that the tree was compiled for.
+ * @param values The values, one for each ?.
+ * 
+ * @return True if every value is valid for its column, otherwise an error is 
+ *         printed.
+*/
+bool bind_parameters(Predicate &node, const Table &table, const vector<string> &values)
+{
+    if (node.kind != PREDICATE_COMPARE)
+    {
+        for (Predicate &child : node.children)
+        {
+            if (!bind_parameters(child, table, values))
+                return false;
+        }
+        return true;
+    }
+
+    if ((node.parameter_idx >= 0) && 
+        !convert_literal(values[node.parameter_idx], table.table_data[node.column_idx].type, node.literal))
+    {
+        cout << "Invalid value in EXECUTE statement: " << values[node.parameter_idx] << " for column "
+             << table.table_data[node.column_idx].column_name << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Checks that every column of a SELECT or ORDERBY statement is in a table.
+ * 
+ * @param list_string    The comma separated list of <column>[:<number>].
+ * @param table          The table the statement runs on.
+ * @param statement_name The name of the statement, for the error.
+ * 
+ * @return True if every column was found, otherwise an error is printed.
+*/
+bool check_column_names(const string &list_string, const Table &table, const string &statement_name)
+{
+    for (const string &item : split_string_comma(list_string))
+    {
+        string column_name = trim(item.substr(0, item.find(':')));
+        if ((column_name == "") || (column_name == "*"))
+            continue;
+
+        int column_idx = find_column(table, column_name);
+        if (column_idx < 0)
+        {
+            cout << ((column_idx == -2) ? "Ambiguous" : "Invalid") << " column in " << statement_name 
+                 << " statement: " << column_name << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Runs the queries of a file, one per line, until the end of the file or an 
+ * EXIT line. No prompts are printed and the output is collected in a large
+ * buffer, so it is written with few system calls. The number of queries per
+ * second is reported on stderr at the end.
+ * 
+ * With framing each result starts with a "#BEGIN <query>" line and ends with
+ * a "#END <query> ROWS <row count>" line, or "#END <query> ERROR" if the query
+ * was not valid. Queries are numbered from 1 and empty lines are skipped.
+ * 
+ * @param query_file The file holding the queries, stdin if it is empty.
+ * @param framed     True to mark the start and end of each result.
+ * @param database   The database that holds the tables.
+ * @param session    The settings of the user's session.
+ * 
+ * @retval  0 The queries were run.
+ * @retval -1 The query file could not be opened.
+*/
+int run_batch(const string &query_file, bool framed, vector<Table> &database, Session &session)
+{
+    ifstream file;
+    istream *input = &cin;
+    if (query_file != "")
+    {
+        file.open(query_file);
+        if (!file)
+        {
+            cerr << "Could not open query file: " << query_file << endl;
+            return -1;
+        }
+        input = &file;
+    }
+
+    // Reading stdin would otherwise flush stdout before every line
+    Batch_Writer writer(STDOUT_FILENO, 1 << 20);
+    output_router.set_thread_output(&writer);
+    cin.tie(NULL);
+
+    long query_count = 0;
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    string input_line;
+    while (getline(*input, input_line) && (input_line != "EXIT"))
+    {
+        if (trim(input_line) == "")
+            continue;
+
+        query_count++;
+        if (framed)
+            cout << "#BEGIN " << query_count << '\n';
+
+        int row_count = run_query(input_line, database, session);
+        if (framed && (row_count < 0))
+            cout << "#END " << query_count << " ERROR\n";
+        else if (framed)
+            cout << "#END " << query_count << " ROWS " << row_count << '\n';
+    }
+
+    writer.write_buffer();
+    output_router.set_thread_output(NULL);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    cerr << fixed << "Ran " << query_count << " queries in " << setprecision(3) << seconds 
+         << " s, " << setprecision(1) << query_count / max(seconds, 1e-9) << " queries per second" << endl;
+    return 0;
+}
+
+/**
+ * Writes the buffered text to the file descriptor and empties the buffer.
+*/
+void Batch_Writer::write_buffer(void)
+{
+    write_all(output_fd, pbase(), pptr() - pbase());
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+/**
+ * Called when the buffer is full, writes it out and stores the next character.
+ * 
+ * @param next_char The character that did not fit, or EOF.
+ * 
+ * @return The character, or EOF if nothing could be stored.
+*/
+int Batch_Writer::overflow(int next_char)
+{
+    write_buffer();
+    if (next_char == traits_type::eof())
+        return traits_type::not_eof(next_char);
+
+    *pptr() = (char)next_char;
+    pbump(1);
+    return next_char;
+}
+
+/**
+ * Adds text to the buffer. Text larger than the buffer, such as a large 
+ * result, is written straight to the file descriptor instead of being copied.
+ * 
+ * @param text   The text to add.
+ * @param length The number of characters in the text.
+ * 
+ * @return The number of characters added.
+*/
+streamsize Batch_Writer::xsputn(const char *text, streamsize length)
+{
+    if (length > epptr() - pptr())
+    {
+        write_buffer();
+        if (length >= (streamsize)buffer.size())
+        {
+            write_all(output_fd, text, length);
+            return length;
+        }
+    }
+
+    memcpy(pptr(), text, length);
+    pbump(length);
+    return length;
+}
+
+/**
+ * Writes all of a block of data to a file descriptor, retrying short writes.
+ * 
+ * @param output_fd The file descriptor.
+ * @param data      The data to write.
+ * @param length    The number of bytes in the data.
+ * 
+ * @return True if everything was written.
+*/
+bool write_all(int output_fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(output_fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+/**
+ * Reads the next line from a file descriptor. Bytes read after the line are 
+ * kept in a buffer for the next call.
+ * 
+ * @param input_fd The file descriptor.
+ * @param buffer   The bytes that have been read but not returned yet.
+ * @param line     The line, without its line break.
+ * 
+ * @return False at the end of the input.
+*/
+bool read_line(int input_fd, string &buffer, string &line)
+{
+    size_t line_end;
+    while ((line_end = buffer.find('\n')) == string::npos)
+    {
+        char data[4096];
+        ssize_t read_count = read(input_fd, data, sizeof(data));
+        if ((read_count < 0) && (errno == EINTR))
+            continue;
+        if (read_count <= 0)
+            return false;
+        buffer.append(data, read_count);
+    }
+
+    line = buffer.substr(0, line_end);
+    buffer.erase(0, line_end + 1);
+    if ((line != "") && (line[line.size() - 1] == '\r'))
+        line.resize(line.size() - 1);
+    return true;
+}
+
+/**
+ * Starts the workers of the server. The tables are taken from table_versions,
+ * which has to be started.
+ * 
+ * @param worker_count    The number of queries that run at once.
+ * @param session_queries The number of queries a client can have running at
+ *                        once.
+*/
+Query_Server::Query_Server(int worker_count, int session_queries) 
+    : session_queries(session_queries), stopping(false)
+{
+    for (int worker_idx = 0; worker_idx < worker_count; worker_idx++)
+    {
+        workers.push_back(thread(&Query_Server::worker_loop, this));
+    }
+}
+
+/**
+ * Stops the workers once the queries they are running are done.
+*/
+Query_Server::~Query_Server()
+{
+    {
+        lock_guard<mutex> lock(job_mutex);
+        stopping = true;
+    }
+    job_ready.notify_all();
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * Listens on a Unix domain socket and serves each client that connects on a
+ * thread of its own, until accepting a connection fails.
+ * 
+ * @param socket_path The path of the socket, an old socket there is removed.
+ * 
+ * @retval -1 The socket could not be used.
+*/
+int Query_Server::run(const string &socket_path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        cerr << "Socket path is too long: " << socket_path << endl;
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+
+    // Clients that leave without reading their results should not stop the
+    // server
+    signal(SIGPIPE, SIG_IGN);
+
+    // Other users can only open the socket if some of them are cleared
+    bool shared_socket = false;
+    if (!load_clearances(CLEARANCE_FILE))
+        return -1;
+    for (const pair<const uid_t, int> &clearance : clearances)
+    {
+        shared_socket = shared_socket || (clearance.first != getuid());
+    }
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path.c_str());
+    mode_t old_umask = umask(0177);
+    bool bound = (server_fd >= 0) && (bind(server_fd, (sockaddr *)&address, sizeof(address)) == 0);
+    umask(old_umask);
+    if (!bound || (shared_socket && (chmod(socket_path.c_str(), 0666) != 0)) || 
+        (listen(server_fd, SOMAXCONN) < 0))
+    {
+        cerr << "Could not listen on " << socket_path << ": " << strerror(errno) << endl;
+        if (server_fd >= 0)
+            close(server_fd);
+        return -1;
+    }
+    cerr << "Listening on " << socket_path << " with " << workers.size() << " workers" << endl;
+
+    while (1)
+    {
+        int client_fd = accept(server_fd, NULL, NULL);
+        if ((client_fd < 0) && ((errno == EINTR) || (errno == ECONNABORTED)))
+            continue;
+        if (client_fd < 0)
+            break;
+
+        shared_ptr<client> owner = make_shared<client>();
+        owner->client_fd = client_fd;
+        owner->session.format = FORMAT_TEXT;
+        owner->session.group_commit = true;
+        owner->session.commit_sequence = 0;
+        owner->running_queries = 0;
+        owner->running_statement = false;
+        owner->next_query = 1;
+        owner->next_output = 1;
+        thread(&Query_Server::serve_client, this, owner).detach();
+    }
+
+    cerr << "Could not accept a connection: " << strerror(errno) << endl;
+    close(server_fd);
+    unlink(socket_path.c_str());
+    return -1;
+}
+
+/**
+ * Reads the queries of a client and hands them to the workers. SELECT, 
+ * EXPLAIN, EXECUTE and STATUS can run next to each other, up to the client's
+ * limit. Any other statement waits for the queries before it and runs on its
+ * own. The client is closed once it sends EXIT or disconnects and its last 
+ * result is sent.
+ * 
+ * @param owner The client.
+*/
+void Query_Server::serve_client(shared_ptr<client> owner)
+{
+    string buffer;
+    string line;
+
+    // The session starts with the users security level, which can not be
+    // above the clearance of the user that runs the client
+    int clearance = 0;
+    if (!client_clearance(owner->client_fd, clearance))
+    {
+        string error = "#ERROR the user of this client is not in " + string(CLEARANCE_FILE) + "\n";
+        write_all(owner->client_fd, error.data(), error.size());
+        close(owner->client_fd);
+        return;
+    }
+
+    vector<string> words;
+    bool valid_session = false;
+    if (read_line(owner->client_fd, buffer, line))
+        words = split_string_space(line + " ");
+    if ((words.size() == 2) && (words[0] == "SESSION"))
+        valid_session = parse_argument(words[1].c_str(), INT_MIN, owner->session.tc_level);
+    if (!valid_session || (owner->session.tc_level > clearance))
+    {
+        string error = valid_session ? "#ERROR TC level " + words[1] + " is above the clearance of " + 
+                                       to_string(clearance) + "\n" : "#ERROR expected: SESSION <tc_level>\n";
+        write_all(owner->client_fd, error.data(), error.size());
+        close(owner->client_fd);
+        return;
+    }
+    write_all(owner->client_fd, "#READY\n", 7);
+
+    while (read_line(owner->client_fd, buffer, line) && (line != "EXIT"))
+    {
+        vector<string> query_words = split_string_space(line + " ");
+        if (query_words.empty())
+            continue;
+
+        query_job job;
+        job.owner = owner;
+        job.query = line;
+        job.changes_session = (query_words[0] != "SELECT") && (query_words[0] != "EXPLAIN") && 
+                              (query_words[0] != "EXECUTE") && (query_words[0] != "STATUS");
+        job.changes_tables = (query_words[0] == "CREATE") || (query_words[0] == "INSERT") || 
+                             (query_words[0] == "UPDATE") || (query_words[0] == "DELETE") || 
+                             (query_words[0] == "CHECKPOINT");
+
+        {
+            unique_lock<mutex> client_lock(owner->client_mutex);
+            owner->query_done.wait(client_lock, [&]() 
+            {
+                return !owner->running_statement && (owner->running_queries < session_queries) &&
+                       (!job.changes_session || (owner->running_queries == 0));
+            });
+            job.query_idx = owner->next_query++;
+            owner->running_queries++;
+            owner->running_statement = job.changes_session;
+        }
+
+        {
+            lock_guard<mutex> lock(job_mutex);
+            jobs.push_back(job);
+        }
+        job_ready.notify_one();
+    }
+
+    unique_lock<mutex> client_lock(owner->client_mutex);
+    owner->query_done.wait(client_lock, [&]() { return owner->running_queries == 0; });
+    close(owner->client_fd);
+}
+
+/**
+ * The loop of a worker, which runs queries until the server is stopped. What
+ * a query prints is collected and sent to its client in one piece.
+*/
+void Query_Server::worker_loop(void)
+{
+    while (1)
+    {
+        query_job job;
+        {
+            unique_lock<mutex> lock(job_mutex);
+            job_ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        stringbuf output;
+        output_router.set_thread_output(&output);
+
+        Session &session = job.owner->session;
+        int row_count = 0;
+        if (job.changes_tables)
+            table_versions.write([&](vector<Table> &database) { row_count = run_query(job.query, database, session); });
+        else
+        {
+            // Writes published while the query runs do not change its tables
+            shared_ptr<vector<Table>> database = table_versions.pin();
+            row_count = run_query(job.query, *database, session);
+        }
+
+        if ((session.commit_sequence != 0) && job.changes_tables)
+        {
+            if (!write_log.wait_synced(session.commit_sequence))
+            {
+                cout << "Unable to write " << WRITE_LOG_FILE << "!!!" << endl;
+                row_count = -1;
+            }
+            session.commit_sequence = 0;
+        }
+        output_router.set_thread_output(NULL);
+
+        string result = "#BEGIN " + to_string(job.query_idx) + "\n" + output.str() + "#END " + 
+                        to_string(job.query_idx) + ((row_count < 0) ? " ERROR\n" : " ROWS " + to_string(row_count) + "\n");
+        finish_query(*job.owner, job, result);
+    }
+}
+
+/**
+ * Sends the result of a query to its client, after the results of the 
+ * queries the client sent before it. Results that are not next are kept until
+ * the ones before them are sent.
+ * 
+ * @param owner  The client.
+ * @param job    The query.
+ * @param output The framed result.
+*/
+void Query_Server::finish_query(client &owner, const query_job &job, const string &output)
+{
+    lock_guard<mutex> client_lock(owner.client_mutex);
+    owner.finished_outputs[job.query_idx] = output;
+    map<long, string>::iterator next;
+    while ((next = owner.finished_outputs.find(owner.next_output)) != owner.finished_outputs.end())
+    {
+        write_all(owner.client_fd, next->second.data(), next->second.size());
+        owner.finished_outputs.erase(next);
+        owner.next_output++;
+    }
+
+    owner.running_queries--;
+    if (job.changes_session)
+        owner.running_statement = false;
+    owner.query_done.notify_all();
+}
+
+/**
+ * Reads the clearances of the users that can connect, from a file with lines
+ * in the order <user>,<tc_level>. A user is given by name or by user ID. The
+ * file is optional, without it only the user that runs the server can 
+ * connect.
+ * 
+ * @param file_name The name of the file.
+ * 
+ * @return True if the file is missing or valid, otherwise an error is printed.
+*/
+bool Query_Server::load_clearances(const string &file_name)
+{
+    ifstream clearance_file(file_name);
+    string input_line;
+    while (clearance_file.is_open() && getline(clearance_file, input_line))
+    {
+        vector<string> list_of_words = split_string_comma(input_line);
+        if (trim(input_line) == "")
+            continue;
+
+        // A user that has no name is given by its ID
+        int user_id = -1;
+        int tc_level = 0;
+        string user_name = trim(list_of_words[0]);
+        passwd *user = getpwnam(user_name.c_str());
+        if (user != NULL)
+            user_id = user->pw_uid;
+        else if (!parse_argument(user_name.c_str(), 0, user_id))
+            user_id = -1;
+        if ((list_of_words.size() != 2) || (user_id == -1) || 
+            !parse_argument(trim(list_of_words[1]).c_str(), INT_MIN, tc_level))
+        {
+            cerr << "Invalid line in " << file_name << ", expected <user>,<tc_level>: " << input_line << endl;
+            return false;
+        }
+        clearances[user_id] = tc_level;
+    }
+    return true;
+}
+
+/**
+ * Finds the highest TC level a client can have, from the user that runs it.
+ * 
+ * @param client_fd The socket of the client.
+ * @param clearance Set to the highest level.
+ * 
+ * @return True if the user can connect.
+*/
+bool Query_Server::client_clearance(int client_fd, int &clearance)
+{
+    ucred peer;
+    socklen_t peer_size = sizeof(peer);
+    if (getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &peer, &peer_size) != 0)
+        return false;
+
+    unordered_map<uid_t, int>::const_iterator found = clearances.find(peer.uid);
+    if (found != clearances.end())
+        clearance = found->second;
+    else if (peer.uid == getuid())
+        clearance = INT_MAX;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * Opens the log for appending. What comes after the valid records, such as
+ * a record cut off when the program stopped, is removed.
+ * 
+ * @param file_name     The name of the log file, created if it is missing.
+ * @param valid_bytes   The size of the valid records at the start of the file.
+ * @param last_sequence The sequence number of the last record written so far.
+ * 
+ * @return True if the log was opened.
+*/
+bool Write_Ahead_Log::open_log(const string &file_name, size_t valid_bytes, int64_t last_sequence)
+{
+    lock_guard<mutex> lock(log_mutex);
+    log_fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if ((log_fd == -1) || (ftruncate(log_fd, valid_bytes) != 0))
+        return false;
+
+    this->file_name = file_name;
+    pending.clear();
+    log_bytes = valid_bytes;
+    this->last_sequence = last_sequence;
+    synced_sequence = last_sequence;
+    failed = false;
+    return true;
+}
+
+/**
+ * Closes the log. Records that were never waited for are written first.
+*/
+void Write_Ahead_Log::close_log(void)
+{
+    lock_guard<mutex> lock(log_mutex);
+    if (log_fd == -1)
+        return;
+
+    write_all(log_fd, pending.data(), pending.size());
+    close(log_fd);
+    log_fd = -1;
+}
+
+/**
+ * Appends a record to the log. It is only in memory until someone waits for 
+ * it, see wait_synced.
+ * 
+ * @param tc_level  The TC level of the session that ran the statement.
+ * @param statement The statement, on a single line.
+ * 
+ * @return The sequence number of the record, 0 if the log is not open.
+*/
+int64_t Write_Ahead_Log::append(int tc_level, const string &statement)
+{
+    lock_guard<mutex> lock(log_mutex);
+    if (log_fd == -1)
+        return 0;
+
+    string record = log_record(++last_sequence, tc_level, statement);
+    pending += record;
+    log_bytes += record.size();
+    record_count++;
+    return last_sequence;
+}
+
+/**
+ * Waits until a record, and every record before it, is on disk. If no sync 
+ * is running the caller syncs every record appended so far itself, otherwise
+ * it waits for the running sync and checks again.
+ * 
+ * @param sequence The sequence number of the record.
+ * 
+ * @return True if the record is on disk, false if the log can not be written.
+*/
+bool Write_Ahead_Log::wait_synced(int64_t sequence)
+{
+    unique_lock<mutex> lock(log_mutex);
+    while ((synced_sequence < sequence) && !failed)
+    {
+        if (syncing)
+        {
+            sync_done.wait(lock);
+            continue;
+        }
+
+        syncing = true;
+        string records;
+        records.swap(pending);
+        int64_t sync_sequence = last_sequence;
+        lock.unlock();
+
+        bool written = write_all(log_fd, records.data(), records.size()) && (fdatasync(log_fd) == 0);
+
+        lock.lock();
+        syncing = false;
+        failed = !written;
+        if (written)
+        {
+            synced_sequence = sync_sequence;
+            sync_count++;
+        }
+        sync_done.notify_all();
+    }
+    return synced_sequence >= sequence;
+}
+
+/**
+ * Tells if records can still be written, which stops being so for good once 
+ * a sync fails.
+ * 
+ * @return False if a sync failed since the log was opened.
+*/
+bool Write_Ahead_Log::writable(void)
+{
+    lock_guard<mutex> lock(log_mutex);
+    return !failed;
+}
+
+/**
+ * Empties the log after a checkpoint. The sequence numbers carry on from the
+ * last record.
+ * 
+ * @return True if the log was emptied.
+*/
+bool Write_Ahead_Log::truncate(void)
+{
+    unique_lock<mutex> lock(log_mutex);
+    sync_done.wait(lock, [this]() { return !syncing; });
+    if (log_fd == -1)
+        return true;
+
+    pending.clear();
+    log_bytes = 0;
+    synced_sequence = last_sequence;
+    return (ftruncate(log_fd, 0) == 0) && (fsync(log_fd) == 0);
+}
+
+/**
+ * The size of the log, including records that are not written yet.
+ * 
+ * @return The size in bytes.
+*/
+size_t Write_Ahead_Log::size(void)
+{
+    lock_guard<mutex> lock(log_mutex);
+    return log_bytes;
+}
+
+/**
+ * The sequence number of the last record appended.
+ * 
+ * @return The sequence number, 0 if there has never been a record.
+*/
+int64_t Write_Ahead_Log::sequence(void)
+{
+    lock_guard<mutex> lock(log_mutex);
+    return last_sequence;
+}
+
+/**
+ * Prints the size of the log and the number of records and syncs so far. 
+ * More records than syncs means writers shared syncs.
+*/
+void Write_Ahead_Log::print_status(void)
+{
+    lock_guard<mutex> lock(log_mutex);
+    cout << "Write-ahead log: " << ((log_fd == -1) ? "closed, " : "") << log_bytes << " bytes, " << record_count 
+         << " records, " << sync_count << " syncs, last sequence " << last_sequence << endl;
+}
+
+/**
+ * Makes a database the first version and starts the collector.
+ * 
+ * @param database The tables.
+*/
+void Version_Store::start(vector<Table> database)
+{
+    lock_guard<mutex> lock(version_mutex);
+    current = make_shared<vector<Table>>(move(database));
+    current_number = 1;
+    stopping = false;
+    collector = thread(&Version_Store::collect_loop, this);
+}
+
+/**
+ * Stops the collector, if it was started. Retired versions are freed as 
+ * their last query finishes.
+*/
+void Version_Store::stop(void)
+{
+    {
+        lock_guard<mutex> lock(version_mutex);
+        stopping = true;
+    }
+    version_retired.notify_all();
+    if (collector.joinable())
+        collector.join();
+}
+
+/**
+ * Pins the current version. It stays as it is for as long as the returned
+ * pointer is held, and must not be changed.
+ * 
+ * @return The current version.
+*/
+shared_ptr<vector<Table>> Version_Store::pin(void)
+{
+    lock_guard<mutex> lock(version_mutex);
+    return current;
+}
+
+/**
+ * Changes the tables and publishes the result as a new version. Writes run
+ * one at a time, queries keep running on the versions they pinned.
+ * 
+ * @param change Changes a copy of the current version.
+*/
+void Version_Store::write(const function<void(vector<Table> &)> &change)
+{
+    lock_guard<mutex> write_lock(write_mutex);
+    shared_ptr<vector<Table>> next = make_shared<vector<Table>>(*pin());
+    change(*next);
+
+    {
+        lock_guard<mutex> lock(version_mutex);
+        retired.push_back(current);
+        current = next;
+        current_number++;
+        retired_count++;
+    }
+    version_retired.notify_one();
+}
+
+/**
+ * The loop of the collector. While versions are retired it checks every few 
+ * milliseconds for the ones that no query uses anymore and frees them.
+*/
+void Version_Store::collect_loop(void)
+{
+    unique_lock<mutex> lock(version_mutex);
+    while (!stopping)
+    {
+        if (retired.empty())
+            version_retired.wait(lock);
+        else
+            version_retired.wait_for(lock, chrono::milliseconds(COLLECT_INTERVAL_MS));
+
+        // A retired version can not be pinned again, so once the store holds
+        // the only reference it is free for good
+        list<shared_ptr<vector<Table>>> unused;
+        for (list<shared_ptr<vector<Table>>>::iterator version = retired.begin(); version != retired.end();)
+        {
+            if (version->use_count() == 1)
+                unused.splice(unused.end(), retired, version++);
+            else
+                version++;
+        }
+        collected_count += unused.size();
+
+        // Freeing a version can take a while, queries should not wait for it
+        lock.unlock();
+        unused.clear();
+        lock.lock();
+    }
+}
+
+/**
+ * Prints the current version and the number of versions retired and freed
+ * so far. Versions retired but not freed are still pinned by queries.
+*/
+void Version_Store::print_status(void)
+{
+    lock_guard<mutex> lock(version_mutex);
+    if (current == NULL)
+        return;
+    cout << "Versions: current " << current_number << ", " << retired_count << " retired, " << collected_count 
+         << " freed, " << retired.size() << " still pinned" << endl;
+}
+
+/**
+ * Attaches a column to the loader or detaches it. A column that is detached,
+ * because it is about to change or is freed, keeps the values it has.
+ * 
+ * @param new_source The column's new source, empty to only detach it.
+*/
+void Source_Handle::reset(shared_ptr<Column_Source> new_source)
+{
+    if (source != NULL)
+        column_loader.detach(*source);
+    source = new_source;
+}
+
+/**
+ * Unpins the columns.
+*/
+Column_Pins::~Column_Pins()
+{
+    if (!sources.empty())
+        column_loader.unpin(sources);
+}
+
+/**
+ * Sets the memory budget of the loaded columns, evicting columns until they
+ * fit.
+ * 
+ * @param budget_bytes The number of bytes the loaded columns can take, 0 for
+ *                     no limit.
+*/
+void Column_Loader::set_budget(size_t budget_bytes)
+{
+    lock_guard<mutex> lock(loader_mutex);
+    this->budget_bytes = budget_bytes;
+    evict_unpinned();
+}
+
+/**
+ * Makes a column load its values from a source the first time it is pinned.
+ * 
+ * @param column The column, with its row count set. It must not move while
+ *               it has the source.
+ * @param source Where the values are read from.
+*/
+void Column_Loader::attach(Column &column, shared_ptr<Column_Source> source)
+{
+    {
+        lock_guard<mutex> lock(loader_mutex);
+        source->column = &column;
+        source->loaded = false;
+        source->pins = 0;
+        source->loaded_bytes = 0;
+        attached_count++;
+    }
+    column.source.reset(source);
+}
+
+/**
+ * Stops loading a column from its source, called by the column's handle. The
+ * column keeps its values, and no longer counts toward the memory budget.
+ * 
+ * @param source The column's source.
+*/
+void Column_Loader::detach(Column_Source &source)
+{
+    lock_guard<mutex> lock(loader_mutex);
+    if (source.column == NULL)
+        return;
+
+    if (source.loaded)
+    {
+        loaded_columns.erase(source.position);
+        used_bytes -= source.loaded_bytes;
+    }
+    source.column = NULL;
+    attached_count--;
+}
+
+/**
+ * Pins columns of a table, loading the ones that are not in memory. Columns 
+ * that are always in memory are skipped.
+ * 
+ * @param table       The table.
+ * @param column_idxs The columns to pin.
+ * @param pins        Where the pinned columns are added.
+ * 
+ * @return The number of columns that were loaded.
+*/
+int Column_Loader::pin(const Table &table, const vector<int> &column_idxs, Column_Pins &pins)
+{
+    int loaded_count = 0;
+    for (int column_idx : column_idxs)
+    {
+        const shared_ptr<Column_Source> &source = table.table_data.read(column_idx).source.get();
+        if (source == NULL)
+            continue;
+
+        bool loaded = false;
+        {
+            lock_guard<mutex> lock(loader_mutex);
+            source->pins++;
+            loaded = source->loaded;
+            if (loaded)
+                loaded_columns.splice(loaded_columns.begin(), loaded_columns, source->position);
+        }
+        pins.sources.push_back(source);
+
+        if (!loaded && load(table, *source))
+            loaded_count++;
+    }
+    return loaded_count;
+}
+
+/**
+ * Pins every column of a table, loading the ones that are not in memory.
+ * 
+ * @param table The table.
+ * @param pins  Where the pinned columns are added.
+ * 
+ * @return The number of columns that were loaded.
+*/
+int Column_Loader::pin_table(const Table &table, Column_Pins &pins)
+{
+    vector<int> column_idxs;
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        column_idxs.push_back(column_idx);
+    }
+    return pin(table, column_idxs, pins);
+}
+
+/**
+ * Unpins columns, they become the most recently used. Columns are evicted 
+ * if the loaded columns no longer fit in the memory budget.
+ * 
+ * @param sources The sources of the columns.
+*/
+void Column_Loader::unpin(const vector<shared_ptr<Column_Source>> &sources)
+{
+    lock_guard<mutex> lock(loader_mutex);
+    for (const shared_ptr<Column_Source> &source : sources)
+    {
+        source->pins--;
+        if ((source->column != NULL) && source->loaded)
+            loaded_columns.splice(loaded_columns.begin(), loaded_columns, source->position);
+    }
+    evict_unpinned();
+}
+
+/**
+ * Prints how many columns are loaded and the memory they take.
+*/
+void Column_Loader::print_status(void)
+{
+    lock_guard<mutex> lock(loader_mutex);
+    cout << "Columns: " << loaded_columns.size() << " of " << attached_count << " loaded, " << used_bytes << " bytes";
+    if (budget_bytes > 0)
+        cout << " of " << budget_bytes;
+    cout << ", " << load_count << " loads, " << eviction_count << " evictions" << endl;
+}
+
+/**
+ * Loads the values of a pinned column, unless another query loaded them 
+ * first. A column that can not be read ends the program, since its snapshot 
+ * or data file was changed or damaged after it was checked.
+ * 
+ * @param table  The table that holds the column, its file rows give the 
+ *               order of the lines of a data file.
+ * @param source The column's source.
+ * 
+ * @return True if the values were loaded.
+*/
+bool Column_Loader::load(const Table &table, Column_Source &source)
+{
+    lock_guard<mutex> load_lock(source.load_mutex);
+    {
+        lock_guard<mutex> lock(loader_mutex);
+        if (source.loaded)
+            return false;
+    }
+
+    // The pages that were read are let go once the values are copied, they 
+    // are read again if the column is evicted and loaded again
+    Column &column = *source.column;
+    const char *file_data = source.file.get();
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    if (source.field_idx == -1)
+    {
+        const char *blocks = file_data + source.block_begin;
+        if ((checksum_words(CHECKSUM_SEED, blocks, source.block_size) != source.checksum) || 
+            !read_column_blocks(blocks, blocks + source.block_size, column))
+        {
+            cerr << table.table_name << ".snap is corrupt, unable to load " << table.table_name << "." 
+                 << column.column_name << "!!!" << endl;
+            exit(-1);
+        }
+
+        size_t first_page = source.block_begin / page_size * page_size;
+        madvise((void *)(file_data + first_page), source.block_begin + source.block_size - first_page, 
+                MADV_DONTNEED);
+    }
+    else
+    {
+        // The mapping shows what is in the file now, a file that changed 
+        // would give rows that do not line up with the loaded ones
+        struct stat file_stat;
+        if ((stat(source.file_name.c_str(), &file_stat) == -1) || (file_stat.st_size != source.file_size) || 
+            ((int64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec != source.file_mtime))
+        {
+            cerr << source.file_name << " changed since it was loaded, unable to load " << table.table_name << "." 
+                 << column.column_name << "!!!" << endl;
+            exit(-1);
+        }
+
+        report_rejected_fields(table, column, parse_column(column, source.field_idx, file_data, source.file_size, 
+                                                           *source.line_starts, table.file_rows));
+        encode_strings(column);
+        madvise((void *)file_data, source.file_size, MADV_DONTNEED);
+    }
+
+    lock_guard<mutex> lock(loader_mutex);
+    source.loaded = true;
+    source.loaded_bytes = column_bytes(column);
+    source.position = loaded_columns.insert(loaded_columns.begin(), &source);
+    used_bytes += source.loaded_bytes;
+    load_count++;
+    evict_unpinned();
+    return true;
+}
+
+/**
+ * Evicts the least recently used columns that are not pinned until the 
+ * loaded columns fit in the memory budget. The caller holds the loader mutex.
+*/
+void Column_Loader::evict_unpinned(void)
+{
+    list<Column_Source *>::iterator candidate = loaded_columns.end();
+    while ((budget_bytes > 0) && (used_bytes > budget_bytes) && (candidate != loaded_columns.begin()))
+    {
+        --candidate;
+        Column_Source *source = *candidate;
+        if (source->pins > 0)
+            continue;
+
+        candidate = loaded_columns.erase(candidate);
+        unload_column(*source->column);
+        source->loaded = false;
+        used_bytes -= source->loaded_bytes;
+        eviction_count++;
+    }
+}
+
+/**
+ * Sets the memory budget of the cache, evicting results until they fit.
+ * 
+ * @param budget_bytes The number of bytes the results can take, 0 turns the
+ *                     cache off.
+*/
+void Result_Cache::set_budget(size_t budget_bytes)
+{
+    lock_guard<mutex> lock(cache_mutex);
+    this->budget_bytes = budget_bytes;
+    while (used_bytes > budget_bytes)
+    {
+        evict(prev(entries.end()));
+    }
+}
+
+/**
+ * Looks up the result of a query. A result of tables that have changed since
+ * it was stored is evicted and counts as a miss.
+ * 
+ * @param key       The normalized query.
+ * @param database  The database that holds the tables.
+ * @param output    Set to what the query printed.
+ * @param row_count Set to the number of rows in the result.
+ * 
+ * @return True if the result was found.
+*/
+bool Result_Cache::lookup(const string &key, const vector<Table> &database, string &output, int &row_count)
+{
+    lock_guard<mutex> lock(cache_mutex);
+    unordered_map<string, list<Cache_Entry>::iterator>::iterator found = entry_map.find(key);
+    if (found == entry_map.end())
+    {
+        misses++;
+        return false;
+    }
+
+    // A result of newer tables than the ones the query reads is kept, the 
+    // query runs on an older version of the database
+    list<Cache_Entry>::iterator entry = found->second;
+    for (const pair<int, int64_t> &table_version : entry->table_versions)
+    {
+        if (database[table_version.first].version != table_version.second)
+        {
+            if (database[table_version.first].version > table_version.second)
+                evict(entry);
+            misses++;
+            return false;
+        }
+    }
+
+    // The result becomes the most recently used one
+    entries.splice(entries.begin(), entries, entry);
+    output = entry->output;
+    row_count = entry->row_count;
+    hits++;
+    return true;
+}
+
+/**
+ * Stores the result of a query, evicting the least recently used results 
+ * until it fits. Results larger than the whole budget are not stored.
+ * 
+ * @param key            The normalized query.
+ * @param output         What the query printed.
+ * @param row_count      The number of rows in the result.
+ * @param table_versions The index and version of each table the query read.
+*/
+void Result_Cache::store(const string &key, const string &output, int row_count, 
+                         const vector<pair<int, int64_t>> &table_versions)
+{
+    lock_guard<mutex> lock(cache_mutex);
+    Cache_Entry new_entry = { .key = key, .output = output, .row_count = row_count, 
+                              .table_versions = table_versions };
+    size_t new_bytes = entry_bytes(new_entry);
+    if (new_bytes > budget_bytes)
+        return;
+
+    // Another session may have stored the same query in the meantime
+    unordered_map<string, list<Cache_Entry>::iterator>::iterator found = entry_map.find(key);
+    if (found != entry_map.end())
+        evict(found->second);
+
+    while (used_bytes + new_bytes > budget_bytes)
+    {
+        evict(prev(entries.end()));
+        evictions++;
+    }
+
+    entries.push_front(move(new_entry));
+    entry_map[key] = entries.begin();
+    used_bytes += new_bytes;
+}
+
+/**
+ * Prints the number of results in the cache, the memory they take and the
+ * number of hits, misses and evictions so far.
+*/
+void Result_Cache::print_status(void)
+{
+    lock_guard<mutex> lock(cache_mutex);
+    cout << "Result cache: " << entries.size() << " results, " << used_bytes << " of " << budget_bytes 
+         << " bytes, " << hits << " hits, " << misses << " misses, " << evictions << " evictions" << endl;
+}
+
+/**
+ * Removes a result from the cache. The caller holds the cache mutex.
+ * 
+ * @param entry The result to remove.
+*/
+void Result_Cache::evict(list<Cache_Entry>::iterator entry)
+{
+    used_bytes -= entry_bytes(*entry);
+    entry_map.erase(entry->key);
+    entries.erase(entry);
+}
+
+/**
+ * Estimates the memory that a result takes in the cache, counting the key 
+ * twice since the map holds a copy of it.
+ * 
+ * @param entry The result.
+ * 
+ * @return The number of bytes.
+*/
+size_t Result_Cache::entry_bytes(const Cache_Entry &entry)
+{
+    return sizeof(Cache_Entry) + 2 * entry.key.size() + entry.output.size() + 
+           entry.table_versions.size() * sizeof(pair<int, int64_t>);
+}
+
+/**
+ * Passes a character on to the output buffer and keeps a copy of it.
+ * 
+ * @param next_char The character, or EOF.
+ * 
+ * @return The character, or EOF if the output buffer failed.
+*/
+int Capture_Buffer::overflow(int next_char)
+{
+    if (next_char == traits_type::eof())
+        return traits_type::not_eof(next_char);
+
+    char character = (char)next_char;
+    keep(&character, 1);
+    return output->sputc(character);
+}
+
+/**
+ * Passes text on to the output buffer and keeps a copy of it.
+ * 
+ * @param data   The text.
+ * @param length The number of characters in the text.
+ * 
+ * @return The number of characters the output buffer took.
+*/
+streamsize Capture_Buffer::xsputn(const char *data, streamsize length)
+{
+    keep(data, length);
+    return output->sputn(data, length);
+}
+
+/**
+ * Adds text to the copy, or drops the copy once it would grow past the limit.
+ * 
+ * @param data   The text.
+ * @param length The number of characters in the text.
+*/
+void Capture_Buffer::keep(const char *data, size_t length)
+{
+    if (overflowed)
+        return;
+
+    if (text.size() + length > limit)
+    {
+        overflowed = true;
+        string().swap(text);
+        return;
+    }
+    text.append(data, length);
+}
+
+/**
+ * A function will initialize the database based on the provided TAB_COLUMNS.csv
+ * file.
+ * 
+ * @return A vector of tables representing the database.
+*/
+vector<Table> init_database()
+{
+    vector<Table> database;
+    string input_line;
+
+    // First need to get the format of the table.
+    // The columns should be in descending order.
+    ifstream schema_file("TAB_COLUMNS.csv");
+    while (getline(schema_file, input_line))
+    {
+        // Split each line of the schema file. The line should be in the 
+        // following order <table>,<column>,<type>,<column_num>
+        vector<string> list_of_words = split_string_comma(input_line);
+
+        // Iterate through the database to see if the table already exists
+        bool table_exists = false;
+        for (int idx = 0; idx < database.size(); idx++)
+        {
+            // If the table does exist, then just add the column to it
+            if (database[idx].table_name == list_of_words[0])
+            {
+                database[idx].table_data.push_back(new_column(list_of_words[1], get_type(list_of_words[2])));
+                table_exists = true;
+                break;
+            }
+        }
+        if (!table_exists) // The table does not yet exist
+        {
+            Table new_table = { .table_name = list_of_words[0], .tc_column_idx = -1 };
+            new_table.table_data.push_back(new_column(list_of_words[1], get_type(list_of_words[2])));
+            database.push_back(new_table);
+        }
+    }
+    schema_file.close();
+
+    // Totals for the load report
+    size_t loaded_bytes = 0;
+    long loaded_rows = 0;
+    double load_seconds = 0.0;
+
+    // The schema read from the input file is in decending order, therefore
+    // invert the vector so that the columns are indexable.
+    for (int table_idx = 0; table_idx < database.size(); table_idx++)
+    {
+        reverse(database[table_idx].table_data.begin(), database[table_idx].table_data.end());
+
+        // Use the table's snapshot if it is up to date, otherwise read 
+        // through the table's data file. Either way the columns are only
+        // loaded once a query reads them.
+        chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+        size_t snapshot_size = load_snapshot(database[table_idx], database[table_idx].table_name + ".snap");
+        if (snapshot_size > 0)
+            loaded_bytes += snapshot_size;
+        else
+        {
+            loaded_bytes += load_csv(database[table_idx], database[table_idx].table_name + ".csv");
+
+            // Group the rows by TC level so queries only have to look at the 
+            // rows the user is allowed to see
+            cluster_by_tc_level(database[table_idx]);
+        }
+        load_seconds += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+        if (!database[table_idx].table_data.empty())
+            loaded_rows += database[table_idx].table_data[0].row_count;
+
+        if (!check_tc_clusters(database[table_idx]))
+        {
+            cout << "TC levels of " << database[table_idx].table_name << " are not grouped!!!" << endl;
+            exit(-1);
+        }
+    }
+
+    // The load report goes to stderr so that query output stays clean
+    double loaded_megabytes = loaded_bytes / 1e6;
+    cerr << fixed << setprecision(1) << "Loaded " << loaded_rows << " rows (" << loaded_megabytes << " MB) in " 
+         << load_seconds << " s, " << loaded_megabytes / max(load_seconds, 1e-6) << " MB/s" << endl;
+
+    // Build the secondary indexes listed in the optional TAB_INDEXES.csv file.
+    // Each line should be in the following order <table>,<column>,<HASH|ORDERED>
+    ifstream index_file("TAB_INDEXES.csv");
+    while (index_file.is_open() && getline(index_file, input_line))
+    {
+        vector<string> list_of_words = split_string_comma(input_line);
+        if (list_of_words.size() < 3)
+            continue;
+
+        create_index(database, "CREATE INDEX ON " + trim(list_of_words[0]) + " (" + trim(list_of_words[1]) + 
+                               ") USING " + trim(list_of_words[2]));
+    }
+    index_file.close();
+
+    return database;
+}
+
+/**
+ * Loads a CSV data file into the columns of a table. The file is mapped into 
+ * memory and split into chunks on line boundaries, the start of every line is
+ * then found in parallel. Blank lines are skipped. Only the TC column is 
+ * parsed right away, since the rows are grouped by it, the other columns are
+ * parsed from the lines when they are first used (see Column_Loader). The 
+ * file stays mapped until then, so it must not change while the program 
+ * runs. Its size and modification time are checked before each column is
+ * parsed, a file that changed ends the program.
+ * 
+ * @param table     The table to load, its columns must already be created.
+ * @param file_name The name of the CSV file.
+ * 
+ * @return The size of the file in bytes, 0 if it could not be read.
+*/
+size_t load_csv(Table &table, const string &file_name)
+{
+    int file_descriptor = open(file_name.c_str(), O_RDONLY);
+    if (file_descriptor == -1)
+        return 0;
+
+    struct stat file_stat;
+    if ((fstat(file_descriptor, &file_stat) == -1) || (file_stat.st_size == 0))
+    {
+        close(file_descriptor);
+        return 0;
+    }
+
+    size_t file_size = file_stat.st_size;
+    table.source_size = file_stat.st_size;
+    table.source_mtime = (int64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+
+    void *mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    close(file_descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        cout << "Unable to map " << file_name << "!!!" << endl;
+        return 0;
+    }
+    madvise(mapping, file_size, MADV_WILLNEED);
+    const char *file_data = (const char *)mapping;
+
+    // Use one thread per core, but give each thread at least 1 MB
+    int thread_count = max(1u, thread::hardware_concurrency());
+    thread_count = max(1, (int)min((size_t)thread_count, file_size >> 20));
+
+    // First find where every line starts, each thread scans one chunk
+    vector<vector<size_t>> chunk_line_starts(thread_count);
+    vector<thread> threads;
+    for (int thread_idx = 0; thread_idx < thread_count; thread_idx++)
+    {
+        size_t chunk_begin = file_size / thread_count * thread_idx;
+        size_t chunk_end = (thread_idx == thread_count - 1) ? file_size : file_size / thread_count * (thread_idx + 1);
+        threads.push_back(thread([&chunk_line_starts, file_data, file_size, chunk_begin, chunk_end, thread_idx]()
+        {
+            chunk_line_starts[thread_idx] = find_line_starts(file_data, file_size, chunk_begin, chunk_end);
+        }));
+    }
+    for (int thread_idx = 0; thread_idx < thread_count; thread_idx++)
+    {
+        threads[thread_idx].join();
+    }
+    threads.clear();
+
+    vector<size_t> line_starts;
+    for (int thread_idx = 0; thread_idx < thread_count; thread_idx++)
+    {
+        line_starts.insert(line_starts.end(), chunk_line_starts[thread_idx].begin(), chunk_line_starts[thread_idx].end());
+        vector<size_t>().swap(chunk_line_starts[thread_idx]);
+    }
+
+    // The columns that are loaded later share the mapping and the line 
+    // starts, the file is unmapped once the last of them no longer needs it
+    shared_ptr<const char> file(file_data, [file_size](const char *data) { munmap((void *)data, file_size); });
+    shared_ptr<const vector<size_t>> file_line_starts = make_shared<const vector<size_t>>(move(line_starts));
+
+    int row_count = file_line_starts->size();
+    table.file_rows.clear();
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        table.file_rows.push_back(row_idx);
+    }
+    table.next_file_row = row_count;
+
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        Column &column = table.table_data[column_idx];
+        column.row_count = row_count;
+        if ((column.column_name == "TC") && (column.type == INT))
+        {
+            report_rejected_fields(table, column, parse_column(column, column_idx, file_data, file_size, 
+                                                               *file_line_starts, table.file_rows));
+            continue;
+        }
+
+        shared_ptr<Column_Source> source = make_shared<Column_Source>();
+        source->file = file;
+        source->file_size = file_size;
+        source->field_idx = column_idx;
+        source->line_starts = file_line_starts;
+        source->file_name = file_name;
+        source->file_mtime = table.source_mtime;
+        column_loader.attach(column, source);
+    }
+
+    // The pages that were read are let go, they are read again when a 
+    // column is loaded
+    madvise(mapping, file_size, MADV_DONTNEED);
+    return file_size;
+}
+
+/**
+ * Function that compiles a WHERE string into a tree of typed conditions. The
+ * conditions can be separated by commas or AND, separated by OR, and grouped
+ * with parentheses. AND is evaluated before OR.
+ * 
+ * A value can be left as ? in a prepared query, the ?s are numbered in the
+ * order they are written and their values are bound by EXECUTE.
+ * 
+ * @param where_string    A string that contains the list of conditions.
+ * @param table           The table that the conditions will be run against.
+ * @param where_predicate The compiled conditions.
+ * @param parameter_count Set to the number of ?s, NULL if they are not allowed.
+ * 
+ * @return True if the string was valid, otherwise an error is printed.
+*/
+bool compile_where(const string &where_string, const Table &table, Predicate &where_predicate, 
+                   int *parameter_count)
+{
+    vector<string> tokens = split_where_tokens(where_string);
+    int token_idx = 0;
+
+    if (!parse_where_or(tokens, token_idx, table, where_predicate))
+        return false;
+
+    if (token_idx != tokens.size())
+    {
+        cout << "Invalid WHERE statement near: " << tokens[token_idx] << endl;
+        return false;
+    }
+
+    int found_parameters = number_parameters(where_predicate, 0);
+    if ((found_parameters > 0) && (parameter_count == NULL))
+    {
+        cout << "Invalid value in WHERE statement: ?, only prepared queries have parameters" << endl;
+        return false;
+    }
+    if (parameter_count != NULL)
+        *parameter_count = found_parameters;
+    return true;
+}
+
+/**
+ * Function that will filter the given table based on the compiled WHERE
+ * conditions.
+ * 
+ * @param where_predicate The compiled conditions.
+ * @param table_to_parse  A Table object that should be filtered.
+ * @param tc_level        The users security level.
+ * @param file_order      False if the rows can be left in the order they are
+ *                        stored, which skips merging the TC levels.
+ * @param row_limit       The number of rows that are needed, -1 for all of 
+ *                        them. Only the first row_limit rows are returned.
+ * 
+ * @return A view of the rows that passed the conditions, with every column.
+ *         The rows are in the same order as the table's data file.
+*/
+Table_View parse_table(const Predicate &where_predicate, const Table &table_to_parse, int tc_level, bool file_order,
+                       int row_limit)
+{
+    // Every row the user can see starts out as a candidate, the conditions 
+    // then narrow the list down to the rows that pass them. Since the rows are
+    // grouped by TC level these are always the first rows of the table, 
+    // followed by the inserted rows the user can see. If an index answers one
+    // of the conditions, only the rows it finds are candidates.
+    Access_Plan plan = plan_access(where_predicate, table_to_parse);
+    int visible_rows = visible_row_count(table_to_parse, tc_level);
+    vector<int> tail_rows;
+    vector<int> index_rows;
+    int candidate_count = visible_rows;
+    if (plan.index != NULL)
+    {
+        index_rows = index_lookup(*plan.index, table_to_parse, *plan.condition, tc_level);
+        candidate_count = index_rows.size();
+    }
+    else
+    {
+        tail_rows = visible_tail_rows(table_to_parse, tc_level);
+        candidate_count += tail_rows.size();
+    }
+
+    // With a limit the candidates of each TC level are checked separately. 
+    // Each level is in file order, so the first rows in file order are always
+    // among the first row_limit rows of each level. The inserted rows are in
+    // file order too, they are the last segment.
+    vector<int> segment_ends;
+    for (int level_idx = 0; (row_limit >= 0) && (level_idx < table_to_parse.tc_levels.size()); level_idx++)
+    {
+        int level_end = min(table_to_parse.tc_level_ends[level_idx], visible_rows);
+        int segment_end = level_end;
+        if (plan.index != NULL)
+            segment_end = lower_bound(index_rows.begin(), index_rows.end(), level_end) - index_rows.begin();
+        if (segment_end > (segment_ends.empty() ? 0 : segment_ends.back()))
+            segment_ends.push_back(segment_end);
+    }
+    if (segment_ends.empty() || (segment_ends.back() < candidate_count))
+        segment_ends.push_back(candidate_count);
+
+    // The candidates are split into morsels that are checked in parallel, 
+    // each morsel's rows are kept apart so they can be joined back in order.
+    // With a limit the morsels are run one wave at a time, with one morsel per
+    // thread, until the level has found enough rows.
+    Table_View result;
+    result.table = &table_to_parse;
+    int segment_begin = 0;
+    for (int segment_end : segment_ends)
+    {
+        int morsel_count = (segment_end - segment_begin + MORSEL_ROWS - 1) / MORSEL_ROWS;
+        int wave_size = (row_limit < 0) ? morsel_count : query_pool.thread_count();
+        size_t segment_first_row = result.row_idxs.size();
+
+        for (int first_morsel = 0; (first_morsel < morsel_count) && 
+             ((row_limit < 0) || (result.row_idxs.size() - segment_first_row < row_limit)); first_morsel += wave_size)
+        {
+            int wave_count = min(wave_size, morsel_count - first_morsel);
+            vector<vector<int>> morsel_rows(wave_count);
+            query_pool.run_morsels(wave_count, [&](int morsel_idx)
+            {
+                int first_candidate = segment_begin + (first_morsel + morsel_idx) * MORSEL_ROWS;
+                int last_candidate = min(segment_end, first_candidate + MORSEL_ROWS);
+
+                vector<int> candidate_rows;
+                if (plan.index != NULL)
+                    candidate_rows.assign(index_rows.begin() + first_candidate, index_rows.begin() + last_candidate);
+                else
+                {
+                    for (int candidate = first_candidate; candidate < last_candidate; candidate++)
+                    {
+                        candidate_rows.push_back((candidate < visible_rows) ? candidate 
+                                                                            : tail_rows[candidate - visible_rows]);
+                    }
+                }
+                morsel_rows[morsel_idx] = evaluate_predicate(plan.remaining, table_to_parse, candidate_rows);
+            });
+
+            for (vector<int> &rows : morsel_rows)
+            {
+                result.row_idxs.insert(result.row_idxs.end(), rows.begin(), rows.end());
+                vector<int>().swap(rows);
+            }
+        }
+
+        if ((row_limit >= 0) && (result.row_idxs.size() - segment_first_row > row_limit))
+            result.row_idxs.resize(segment_first_row + row_limit);
+        segment_begin = segment_end;
+    }
+
+    // Each TC level is a run of rows that are in file order, and so are the
+    // inserted rows after them, merge the runs so the result is in file order
+    // as well
+    const vector<int> &file_rows = table_to_parse.file_rows;
+    auto file_less = [&file_rows](int row_idx1, int row_idx2) { return file_rows[row_idx1] < file_rows[row_idx2]; };
+    vector<int>::iterator run_begin = result.row_idxs.begin();
+    for (int level_idx = 0; file_order && (level_idx < table_to_parse.tc_levels.size()); level_idx++)
+    {
+        vector<int>::iterator run_end = lower_bound(run_begin, result.row_idxs.end(), 
+                                                    table_to_parse.tc_level_ends[level_idx]);
+        inplace_merge(result.row_idxs.begin(), run_begin, run_end, file_less);
+        run_begin = run_end;
+    }
+    if (file_order)
+        inplace_merge(result.row_idxs.begin(), run_begin, result.row_idxs.end(), file_less);
+    if ((row_limit >= 0) && (result.row_idxs.size() > row_limit))
+        result.row_idxs.resize(row_limit);
+
+    for (int column_idx = 0; column_idx < table_to_parse.table_data.size(); column_idx++)
+    {
+        result.column_idxs.push_back(column_idx);
+    }
+    return result;
+}
+
+/**
+ * Function that decides how the rows of a table are found for a WHERE clause.
+ * An index is used when it can answer one of the conditions that every row
+ * must pass, preferring a HASH index on an equality.
+ * 
+ * @param where_predicate The compiled conditions.
+ * @param table           The table that the conditions will be run against.
+ * 
+ * @return The plan. The remaining conditions are the WHERE clause without the
+ *         condition that the index answers.
+*/
+Access_Plan plan_access(const Predicate &where_predicate, const Table &table)
+{
+    Access_Plan plan;
+    plan.index = NULL;
+    plan.condition = NULL;
+    plan.remaining = where_predicate;
+
+    // Only a single condition, or a condition directly under the top AND, 
+    // has to be true for every row in the result
+    vector<const Predicate *> conditions;
+    if (where_predicate.kind == PREDICATE_COMPARE)
+        conditions.push_back(&where_predicate);
+    else if (where_predicate.kind == PREDICATE_AND)
+    {
+        for (const Predicate &child : where_predicate.children)
+        {
+            if (child.kind == PREDICATE_COMPARE)
+                conditions.push_back(&child);
+        }
+    }
+
+    int best_score = 0;
+    for (const Predicate *condition : conditions)
+    {
+        for (const Index &index : table.indexes)
+        {
+            if ((index.column_idx != condition->column_idx) || (condition->op == OP_NE))
+                continue;
+
+            int score = 0;
+            if ((condition->op == OP_EQ) && (index.type == INDEX_HASH))
+                score = 3;
+            else if (condition->op == OP_EQ)
+                score = 2;
+            else if (index.type == INDEX_ORDERED)
+                score = 1;
+
+            if (score > best_score)
+            {
+                best_score = score;
+                plan.index = &index;
+                plan.condition = condition;
+            }
+        }
+    }
+
+    if (plan.index != NULL)
+    {
+        plan.remaining.kind = PREDICATE_AND;
+        plan.remaining.children.clear();
+        if (where_predicate.kind == PREDICATE_AND)
+        {
+            for (const Predicate &child : where_predicate.children)
+            {
+                if (&child != plan.condition)
+                    plan.remaining.children.push_back(child);
+            }
+        }
+    }
+    return plan;
+}
+
+/**
+ * Prints the steps that a query will run, without running it.
+ * 
+ * @param where_predicate  The compiled conditions.
+ * @param table            The table in the FROM statement.
+ * @param tc_level         The users security level.
+ * @param aggregate_string How the rows are aggregated, empty if they are not.
+ * @param order_string     The ORDERBY list, empty if there is none.
+ * @param select_string    The SELECT list, empty if there is none.
+ * @param limit_string     The LIMIT and OFFSET, empty if there is no LIMIT.
+*/
+void print_plan(const Predicate &where_predicate, const Table &table, int tc_level, 
+                const string &aggregate_string, const string &order_string, const string &select_string,
+                const string &limit_string)
+{
+    cout << "PLAN" << endl;
+    print_access(where_predicate, table, tc_level);
+
+    if (aggregate_string != "")
+        cout << "  AGGREGATE " << aggregate_string << endl;
+    if (trim(order_string) != "")
+        cout << "  ORDERBY " << trim(order_string) << endl;
+    if (trim(select_string) != "")
+        cout << "  SELECT " << trim(select_string) << endl;
+    if (limit_string != "")
+        cout << "  LIMIT " << limit_string << endl;
+    cout << endl;
+}
+
+/**
+ * Prints how the rows of one table are found and filtered.
+ * 
+ * @param where_predicate The compiled conditions on the table.
+ * @param table           The table.
+ * @param tc_level        The TC level of the user.
+*/
+void print_access(const Predicate &where_predicate, const Table &table, int tc_level)
+{
+    Access_Plan plan = plan_access(where_predicate, table);
+    int visible_rows = visible_row_count(table, tc_level) + visible_tail_rows(table, tc_level).size();
+
+    if (plan.index != NULL)
+    {
+        cout << "  INDEX " << table.table_name << "." << table.table_data[plan.index->column_idx].column_name
+             << " (" << (plan.index->type == INDEX_HASH ? "HASH" : "ORDERED") << ") ON "
+             << predicate_to_string(*plan.condition, table) << endl;
+    }
+    else
+    {
+        cout << "  SCAN " << table.table_name << " (" << visible_rows << " rows at TC<=" << tc_level << ")" << endl;
+    }
+
+    if (!((plan.remaining.kind == PREDICATE_AND) && plan.remaining.children.empty()))
+        cout << "  FILTER " << predicate_to_string(plan.remaining, table) << endl;
+}
+
+/**
+ * Prints the steps that a join query would run, without running them. Each 
+ * table is listed with the conditions that are pushed down to it, followed
+ * by the joins and the conditions that need columns of several tables.
+ * 
+ * @param join             The join of the query.
+ * @param tables           The tables of the join, in the order they are listed.
+ * @param where_predicate  The compiled conditions, resolved against the schema.
+ * @param tc_level         The TC level of the user.
+ * @param aggregate_string How the rows are aggregated, empty if they are not.
+ * @param order_string     The ORDERBY statement, can be empty.
+ * @param select_string    The SELECT statement, can be empty.
+ * @param limit_string     The LIMIT and OFFSET, empty if there is no LIMIT.
+*/
+void print_join_plan(const Join_Query &join, const vector<const Table *> &tables, const Predicate &where_predicate, 
+                     int tc_level, const string &aggregate_string, const string &order_string, 
+                     const string &select_string, const string &limit_string)
+{
+    vector<Predicate> table_predicates;
+    Predicate residual;
+    split_join_predicate(where_predicate, join, table_predicates, residual);
+
+    cout << "PLAN" << endl;
+    for (int table_idx = 0; table_idx < tables.size(); table_idx++)
+    {
+        print_access(table_predicates[table_idx], *tables[table_idx], tc_level);
+        if (table_idx == 0)
+            continue;
+
+        cout << "  HASH JOIN " << join.schema.table_data[join.join_columns[table_idx - 1].first].column_name << "="
+             << join.schema.table_data[join.join_columns[table_idx - 1].second].column_name << endl;
+    }
+
+    if (!residual.children.empty())
+        cout << "  FILTER " << predicate_to_string(residual, join.schema) << endl;
+    if (aggregate_string != "")
+        cout << "  AGGREGATE " << aggregate_string << endl;
+    if (trim(order_string) != "")
+        cout << "  ORDERBY " << trim(order_string) << endl;
+    if (trim(select_string) != "")
+        cout << "  SELECT " << trim(select_string) << endl;
+    if (limit_string != "")
+        cout << "  LIMIT " << limit_string << endl;
+    cout << endl;
+}
+
+/**
+ * Function that parses the FROM statement of a join, which has the form 
+ * <table> JOIN <table> ON <table>.<column>=<table>.<column> [JOIN ...]. Each
+ * condition compares a column of the joined table with a column of a table
+ * listed before it. Columns can be given without their table if the name is
+ * only used by one table.
+ * 
+ * @param from_words The words of the FROM statement.
+ * @param database   The database that holds the tables.
+ * @param join       The parsed tables and conditions.
+ * 
+ * @return True if the statement was valid, otherwise an error is printed.
+*/
+bool parse_join(const vector<string> &from_words, const vector<Table> &database, Join_Query &join)
+{
+    int word_idx = 0;
+    while (word_idx < from_words.size())
+    {
+        // Every table after the first is preceded by JOIN
+        if ((join.tables.size() > 0) && ((from_words[word_idx] != "JOIN") || (++word_idx == from_words.size())))
+        {
+            cout << "Invalid JOIN statement, expected: FROM <table> JOIN <table> ON <column>=<column>" << endl;
+            return false;
+        }
+
+        const Table *table = NULL;
+        for (const Table &database_table : database)
+        {
+            if (database_table.table_name == from_words[word_idx])
+                table = &database_table;
+        }
+        if (table == NULL)
+        {
+            cout << "Invalid table in FROM statement: " << from_words[word_idx] << endl;
+            return false;
+        }
+        if (find(join.tables.begin(), join.tables.end(), table) != join.tables.end())
+        {
+            cout << "Invalid JOIN statement, a table can only be used once: " << table->table_name << endl;
+            return false;
+        }
+        word_idx++;
+
+        join.tables.push_back(table);
+        join.column_offsets.push_back(join.schema.table_data.size());
+        for (const Column &column : table->table_data)
+        {
+            join.schema.table_data.push_back(new_column(table->table_name + "." + column.column_name, column.type));
+        }
+        join.schema.table_name += (join.tables.size() == 1 ? "" : "+") + table->table_name;
+        if (join.tables.size() == 1)
+            continue;
+
+        // The condition runs until the next JOIN
+        string condition_string;
+        if ((word_idx < from_words.size()) && (from_words[word_idx] == "ON"))
+        {
+            for (word_idx++; (word_idx < from_words.size()) && (from_words[word_idx] != "JOIN"); word_idx++)
+            {
+                condition_string += from_words[word_idx];
+            }
+        }
+
+        size_t equals_pos = condition_string.find('=');
+        if ((equals_pos == string::npos) || (condition_string.find_first_of("<>") != string::npos))
+        {
+            cout << "Invalid JOIN condition, expected: ON <column>=<column>" << endl;
+            return false;
+        }
+
+        string column_names[2] = { condition_string.substr(0, equals_pos), condition_string.substr(equals_pos + 1) };
+        int column_idxs[2];
+        for (int side = 0; side < 2; side++)
+        {
+            column_idxs[side] = find_column(join.schema, column_names[side]);
+            if (column_idxs[side] < 0)
+            {
+                cout << "Invalid column in JOIN condition: " << column_names[side] << endl;
+                return false;
+            }
+        }
+
+        // The joined table's column goes second
+        int table_idx = join.tables.size() - 1;
+        if (join_table_of(join, column_idxs[0]) == table_idx)
+            swap(column_idxs[0], column_idxs[1]);
+        if ((join_table_of(join, column_idxs[1]) != table_idx) || (join_table_of(join, column_idxs[0]) == table_idx))
+        {
+            cout << "Invalid JOIN condition, it must compare " << table->table_name 
+                 << " with an earlier table: " << condition_string << endl;
+            return false;
+        }
+        if (join.schema.table_data[column_idxs[0]].type != join.schema.table_data[column_idxs[1]].type)
+        {
+            cout << "Invalid JOIN condition, the columns have different types: " << condition_string << endl;
+            return false;
+        }
+        join.join_columns.push_back(make_pair(column_idxs[0], column_idxs[1]));
+    }
+
+    join.schema.tc_column_idx = -1;
+    return true;
+}
+
+/**
+ * Function that runs a join. The conditions that only use one table are run
+ * on that table first, which also only keeps the rows the user can see. The
+ * tables are then hash joined in the order they are listed and the columns of
+ * the matching rows are copied into a new table, where the conditions that 
+ * use several tables are run.
+ * 
+ * @param join            The join of the query.
+ * @param tables          The tables of the join, in the order they are listed.
+ * @param where_predicate The compiled conditions, resolved against the schema.
+ * @param tc_level        The TC level of the user.
+ * @param joined_table    The table that the joined rows are copied into.
+ * 
+ * @return A view of the joined rows that passed every condition, ordered by 
+ *         the rows of the first table, then the second table and so on.
+*/
+Table_View run_join(const Join_Query &join, const vector<const Table *> &tables, const Predicate &where_predicate, 
+                    int tc_level, Table &joined_table)
+{
+    vector<Predicate> table_predicates;
+    Predicate residual;
+    split_join_predicate(where_predicate, join, table_predicates, residual);
+
+    // For each table the row it has in each joined row
+    vector<vector<int>> joined_rows(tables.size());
+    joined_rows[0] = parse_table(table_predicates[0], *tables[0], tc_level).row_idxs;
+
+    for (int table_idx = 1; table_idx < tables.size(); table_idx++)
+    {
+        vector<int> table_rows = parse_table(table_predicates[table_idx], *tables[table_idx], tc_level).row_idxs;
+
+        int left_column_idx = join.join_columns[table_idx - 1].first;
+        int left_table_idx = join_table_of(join, left_column_idx);
+        const Column &left_column = tables[left_table_idx]->table_data[left_column_idx - join.column_offsets[left_table_idx]];
+        const Column &right_column = tables[table_idx]->table_data[join.join_columns[table_idx - 1].second - 
+                                                                   join.column_offsets[table_idx]];
+
+        vector<pair<int, int>> matches = hash_join(left_column, joined_rows[left_table_idx], right_column, table_rows);
+
+        vector<vector<int>> next_rows(tables.size());
+        for (int earlier_idx = 0; earlier_idx <= table_idx; earlier_idx++)
+        {
+            next_rows[earlier_idx].reserve(matches.size());
+        }
+        for (const pair<int, int> &match : matches)
+        {
+            for (int earlier_idx = 0; earlier_idx < table_idx; earlier_idx++)
+            {
+                next_rows[earlier_idx].push_back(joined_rows[earlier_idx][match.first]);
+            }
+            next_rows[table_idx].push_back(table_rows[match.second]);
+        }
+        joined_rows.swap(next_rows);
+    }
+
+    joined_table = join.schema;
+    for (int table_idx = 0; table_idx < tables.size(); table_idx++)
+    {
+        const Table &table = *tables[table_idx];
+        for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+        {
+            Column &joined_column = joined_table.table_data[join.column_offsets[table_idx] + column_idx];
+            string column_name = joined_column.column_name;
+            joined_column = gather_rows(table.table_data[column_idx], joined_rows[table_idx]);
+            joined_column.column_name = column_name;
+        }
+    }
+
+    return parse_table(residual, joined_table, tc_level);
+}
+
+/**
+ * Splits the top level conditions of a join's WHERE clause into the ones that
+ * only use one table, which are resolved against that table, and the ones 
+ * that use several tables.
+ * 
+ * @param where_predicate  The compiled conditions, resolved against the schema.
+ * @param join             The tables of the query.
+ * @param table_predicates The conditions of each table.
+ * @param residual         The conditions that use several tables.
+*/
+void split_join_predicate(const Predicate &where_predicate, const Join_Query &join, 
+                          vector<Predicate> &table_predicates, Predicate &residual)
+{
+    Predicate no_conditions;
+    no_conditions.kind = PREDICATE_AND;
+    table_predicates.assign(join.tables.size(), no_conditions);
+    residual = no_conditions;
+
+    vector<Predicate> conditions;
+    if (where_predicate.kind == PREDICATE_AND)
+        conditions = where_predicate.children;
+    else
+        conditions.push_back(where_predicate);
+
+    for (Predicate &condition : conditions)
+    {
+        int table_idx = predicate_table(condition, join);
+        if (table_idx < 0)
+        {
+            residual.children.push_back(condition);
+            continue;
+        }
+
+        shift_predicate_columns(condition, -join.column_offsets[table_idx]);
+        table_predicates[table_idx].children.push_back(condition);
+    }
+}
+
+/**
+ * Joins two lists of rows on the equality of a column of each. A hash table is
+ * built on the shorter list and probed with the longer one. Empty values do 
+ * not match anything.
+ * 
+ * @param left_column  The column of the left rows.
+ * @param left_rows    The left rows.
+ * @param right_column The column of the right rows, of the same type.
+ * @param right_rows   The right rows.
+ * 
+ * @return The positions in the lists of each pair of matching rows, ordered
+ *         by the left position and then the right position.
+*/
+vector<pair<int, int>> hash_join(const Column &left_column, const vector<int> &left_rows, 
+                                 const Column &right_column, const vector<int> &right_rows)
+{
+    vector<pair<int, int>> matches;
+    bool build_left = left_rows.size() < right_rows.size();
+    const Column &build_column = build_left ? left_column : right_column;
+    const vector<int> &build_rows = build_left ? left_rows : right_rows;
+    const Column &probe_column = build_left ? right_column : left_column;
+    const vector<int> &probe_rows = build_left ? right_rows : left_rows;
+
+    // Strings are compared by value since each column has its own dictionary
+    if (build_column.type == STRING)
+        hash_join_keys(join_keys<string>(build_column, build_rows), join_keys<string>(probe_column, probe_rows), matches);
+    else
+        hash_join_keys(join_keys<int64_t>(build_column, build_rows), join_keys<int64_t>(probe_column, probe_rows), matches);
+
+    if (!build_left)
+        return matches;
+
+    // The matches are ordered by the right rows, put them in order of the left
+    // rows with a stable counting sort
+    vector<int> left_begins(left_rows.size() + 1, 0);
+    for (const pair<int, int> &match : matches)
+    {
+        left_begins[match.second + 1]++;
+    }
+    for (int left_idx = 0; left_idx < left_rows.size(); left_idx++)
+    {
+        left_begins[left_idx + 1] += left_begins[left_idx];
+    }
+
+    vector<pair<int, int>> sorted_matches(matches.size());
+    for (const pair<int, int> &match : matches)
+    {
+        sorted_matches[left_begins[match.second]++] = make_pair(match.second, match.first);
+    }
+    return sorted_matches;
+}
+
+/**
+ * Function that runs a CREATE INDEX statement, which has the form
+ * CREATE INDEX ON <table> (<column>) [USING HASH|ORDERED]. HASH is used if no
+ * type is given. An existing index of the same type on the column is rebuilt.
+ * 
+ * @param database  The database that holds the table.
+ * @param statement The statement to run.
+ * 
+ * @return True if the index was built, otherwise an error is printed.
+*/
+bool create_index(vector<Table> &database, const string &statement)
+{
+    string cleaned_statement = statement;
+    replace(cleaned_statement.begin(), cleaned_statement.end(), '(', ' ');
+    replace(cleaned_statement.begin(), cleaned_statement.end(), ')', ' ');
+    vector<string> list_of_words = split_string_space(cleaned_statement + " ");
+
+    if ((list_of_words.size() < 5) || (list_of_words[0] != "CREATE") || (list_of_words[1] != "INDEX") || 
+        (list_of_words[2] != "ON") || ((list_of_words.size() > 5) && (list_of_words[5] != "USING")) ||
+        (list_of_words.size() == 6) || (list_of_words.size() > 7))
+    {
+        cout << "Invalid CREATE INDEX statement, expected: CREATE INDEX ON <table> (<column>) USING <HASH|ORDERED>" << endl;
+        return false;
+    }
+
+    enum index_type type = INDEX_HASH;
+    if ((list_of_words.size() == 7) && (list_of_words[6] == "ORDERED"))
+        type = INDEX_ORDERED;
+    else if ((list_of_words.size() == 7) && (list_of_words[6] != "HASH"))
+    {
+        cout << "Invalid index type: " << list_of_words[6] << endl;
+        return false;
+    }
+
+    for (Table &table : database)
+    {
+        if (table.table_name != list_of_words[3])
+            continue;
+
+        for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+        {
+            if (table.table_data.read(column_idx).column_name == list_of_words[4])
+            {
+                build_index(table, column_idx, type);
+                return true;
+            }
+        }
+        cout << "Invalid column in CREATE INDEX statement: " << list_of_words[4] << endl;
+        return false;
+    }
+    cout << "Invalid table in CREATE INDEX statement: " << list_of_words[3] << endl;
+    return false;
+}
+
+/**
+ * Runs an INSERT, UPDATE or DELETE statement and appends it to the write-ahead
+ * log. Nothing is printed when the statement succeeds. Unless the session 
+ * uses group commit, the statement waits until its log record is synced.
+ * 
+ * @param input_line The statement, with its ';' replaced by a space.
+ * @param database   The database that holds the tables.
+ * @param session    The settings of the user's session, rows above its TC
+ *                   level can not be written.
+ * 
+ * @return The number of rows that changed, -1 if the statement is not valid or
+ *         the log can not be written.
+*/
+int run_write(string input_line, vector<Table> &database, Session &session)
+{
+    int table_idx = write_table(database, input_line);
+    if (table_idx == -1)
+        return -1;
+
+    // After a failed sync the tables may already hold writes that are not 
+    // in the log, they must not be built on
+    if (!write_log.writable())
+    {
+        cout << "Unable to write " << WRITE_LOG_FILE << ", writes are refused until the program is restarted!!!" 
+             << endl;
+        return -1;
+    }
+
+    int row_count = modify_table(database[table_idx], input_line, session.tc_level);
+    if (row_count <= 0)
+        return row_count;
+
+    // The statement is logged as it was written, replaying it on the same 
+    // rows makes the same changes
+    int64_t sequence = write_log.append(session.tc_level, trim(input_line) + ";");
+    database[table_idx].log_sequence = sequence;
+    if (write_log.size() >= checkpoint_bytes)
+        checkpoint(database);
+
+    session.commit_sequence = sequence;
+    if (session.group_commit)
+        return row_count;
+
+    session.commit_sequence = 0;
+    if (!write_log.wait_synced(sequence))
+    {
+        cout << "Unable to write " << WRITE_LOG_FILE << "!!!" << endl;
+        return -1;
+    }
+    return row_count;
+}
+
+/**
+ * Finds the table that an INSERT, UPDATE or DELETE statement writes to.
+ * 
+ * @param database  The database that holds the tables.
+ * @param statement The statement.
+ * 
+ * @return The index of the table in the database, -1 if there is none, then
+ *         an error is printed.
+*/
+int write_table(const vector<Table> &database, const string &statement)
+{
+    vector<string> list_of_words = split_string_space(statement + " ");
+    string table_name = "";
+    if ((list_of_words.size() >= 3) && (((list_of_words[0] == "INSERT") && (list_of_words[1] == "INTO")) || 
+                                        ((list_of_words[0] == "DELETE") && (list_of_words[1] == "FROM"))))
+        table_name = list_of_words[2];
+    else if ((list_of_words.size() >= 2) && (list_of_words[0] == "UPDATE"))
+        table_name = list_of_words[1];
+    else
+    {
+        cout << "Invalid " << (list_of_words.empty() ? "write" : list_of_words[0]) << " statement, expected: "
+             << "INSERT INTO <table> ..., UPDATE <table> ... or DELETE FROM <table> ..." << endl;
+        return -1;
+    }
+
+    // A column list can follow the table of an INSERT without a space
+    table_name = table_name.substr(0, table_name.find('('));
+    for (int table_idx = 0; table_idx < database.size(); table_idx++)
+    {
+        if (database[table_idx].table_name == table_name)
+            return table_idx;
+    }
+    cout << "Invalid table in " << list_of_words[0] << " statement: " << table_name << endl;
+    return -1;
+}
+
+/**
+ * Runs an INSERT, UPDATE or DELETE statement on its table, without logging 
+ * it. The table's version is increased if any rows changed.
+ * 
+ * @param table     The table the statement writes to.
+ * @param statement The statement.
+ * @param tc_level  The users security level.
+ * 
+ * @return The number of rows that changed, -1 if the statement is not valid.
+*/
+int modify_table(Table &table, const string &statement, int tc_level)
+{
+    string first_word = trim(statement).substr(0, 6);
+    if ((first_word == "INSERT") || (first_word == "UPDATE") || (first_word == "DELETE"))
+        materialize_columns(table);
+
+    int row_count = -1;
+    if (first_word == "INSERT")
+        row_count = run_insert(table, statement, tc_level);
+    else if (first_word == "UPDATE")
+        row_count = run_update(table, statement, tc_level);
+    else if (first_word == "DELETE")
+        row_count = run_delete(table, statement, tc_level);
+
+    if (row_count > 0)
+        table.version++;
+    return row_count;
+}
+
+/**
+ * Function that runs an INSERT statement, which has the form
+ * INSERT INTO <table> [(<column>, ...)] VALUES (<value>, ...)[, (<value>, ...)].
+ * Without a column list the values are given for every column in order. 
+ * Columns that are left out or have no value between their commas are empty.
+ * A row that is not given a TC level gets the users level, a higher level is
+ * rejected. Each row is stored at the end of the table, see insert_row.
+ * 
+ * @param table     The table to insert into.
+ * @param statement The statement to run.
+ * @param tc_level  The users security level.
+ * 
+ * @return The number of rows inserted, -1 if the statement is not valid, then
+ *         an error is printed.
+*/
+int run_insert(Table &table, const string &statement, int tc_level)
+{
+    size_t table_end = statement.find(" " + table.table_name) + 1 + table.table_name.size();
+    size_t values_pos = statement.find("VALUES", table_end);
+    string column_string = "";
+    if (values_pos != string::npos)
+        column_string = trim(statement.substr(table_end, values_pos - table_end));
+    bool columns_listed = (column_string != "");
+    if ((values_pos == string::npos) || 
+        (columns_listed && ((column_string[0] != '(') || (column_string[column_string.size() - 1] != ')'))))
+    {
+        cout << "Invalid INSERT statement, expected: INSERT INTO <table> [(<column>, ...)] VALUES (<value>, ...)" 
+             << endl;
+        return -1;
+    }
+
+    // The columns that the values are given for, in order
+    vector<int> column_idxs;
+    for (int column_idx = 0; !columns_listed && (column_idx < table.table_data.size()); column_idx++)
+    {
+        column_idxs.push_back(column_idx);
+    }
+    if (columns_listed)
+    {
+        for (string column_name : split_string_comma(column_string.substr(1, column_string.size() - 2)))
+        {
+            int column_idx = find_column(table, trim(column_name));
+            if ((column_idx < 0) || (find(column_idxs.begin(), column_idxs.end(), column_idx) != column_idxs.end()))
+            {
+                cout << "Invalid column in INSERT statement: " << trim(column_name) << endl;
+                return -1;
+            }
+            column_idxs.push_back(column_idx);
+        }
+    }
+
+    // Every row is checked before any is inserted, so a bad row does not 
+    // leave the rows before it behind
+    Data empty_value = { .empty = true };
+    vector<vector<Data>> rows;
+    size_t cursor = values_pos + string("VALUES").size();
+    while (cursor != string::npos)
+    {
+        size_t row_begin = statement.find_first_not_of(" \t", cursor);
+        size_t row_end = (row_begin == string::npos) ? string::npos : statement.find(')', row_begin);
+        if ((row_begin == string::npos) || (statement[row_begin] != '(') || (row_end == string::npos))
+        {
+            cout << "Invalid VALUES in INSERT statement, expected: (<value>, ...)" << endl;
+            return -1;
+        }
+
+        vector<string> values = split_string_comma(statement.substr(row_begin + 1, row_end - row_begin - 1));
+        if (values.size() != column_idxs.size())
+        {
+            cout << "Invalid VALUES in INSERT statement, expected " << column_idxs.size() << " values: " 
+                 << statement.substr(row_begin, row_end - row_begin + 1) << endl;
+            return -1;
+        }
+
+        vector<Data> row(table.table_data.size(), empty_value);
+        for (int value_idx = 0; value_idx < values.size(); value_idx++)
+        {
+            int column_idx = column_idxs[value_idx];
+            if (!convert_value(trim(values[value_idx]), table.table_data.read(column_idx), "INSERT", row[column_idx]))
+                return -1;
+        }
+
+        if ((table.tc_column_idx != -1) && row[table.tc_column_idx].empty)
+        {
+            row[table.tc_column_idx].empty = false;
+            row[table.tc_column_idx].int_data = tc_level;
+        }
+        if (!check_tc_value(table, (table.tc_column_idx == -1) ? empty_value : row[table.tc_column_idx], tc_level, 
+                            "INSERT"))
+            return -1;
+        rows.push_back(row);
+
+        // Rows are separated by commas
+        cursor = statement.find_first_not_of(" \t", row_end + 1);
+        if ((cursor != string::npos) && (statement[cursor] != ','))
+        {
+            cout << "Invalid INSERT statement, unexpected text after VALUES: " << statement.substr(cursor) << endl;
+            return -1;
+        }
+        if (cursor != string::npos)
+            cursor++;
+    }
+
+    for (const vector<Data> &row : rows)
+    {
+        for (int column_idx = 0; column_idx < row.size(); column_idx++)
+        {
+            admit_value(table, column_idx, row[column_idx]);
+        }
+        insert_row(table, row);
+    }
+    return rows.size();
+}
+
+/**
+ * Function that runs an UPDATE statement, which has the form
+ * UPDATE <table> SET <column>=<value>[, ...] [WHERE <conditions>]. Only the
+ * rows the user can see are changed, and the TC level of a row can not be 
+ * raised above the users level. A value left out after the = empties the 
+ * column.
+ * 
+ * @param table     The table to update.
+ * @param statement The statement to run.
+ * @param tc_level  The users security level.
+ * 
+ * @return The number of rows updated, -1 if the statement is not valid, then
+ *         an error is printed.
+*/
+int run_update(Table &table, const string &statement, int tc_level)
+{
+    size_t set_pos = statement.find(" SET ", statement.find(" " + table.table_name));
+    size_t where_pos = (set_pos == string::npos) ? string::npos : statement.find(" WHERE ", set_pos);
+    if (set_pos == string::npos)
+    {
+        cout << "Invalid UPDATE statement, expected: UPDATE <table> SET <column>=<value>[, ...] [WHERE <conditions>]"
+             << endl;
+        return -1;
+    }
+
+    set_pos += string(" SET ").size();
+    string set_string = statement.substr(set_pos, (where_pos == string::npos) ? string::npos : where_pos - set_pos);
+    vector<pair<int, Data>> assignments;
+    bool tc_changes = false;
+    for (string assignment : split_string_comma(set_string))
+    {
+        size_t equals_pos = assignment.find('=');
+        int column_idx = (equals_pos == string::npos) ? -1 : find_column(table, trim(assignment.substr(0, equals_pos)));
+        if (column_idx < 0)
+        {
+            cout << "Invalid column in UPDATE statement: " << trim(assignment) << endl;
+            return -1;
+        }
+
+        Data value;
+        if (!convert_value(trim(assignment.substr(equals_pos + 1)), table.table_data.read(column_idx), "UPDATE", value))
+            return -1;
+        if ((column_idx == table.tc_column_idx) && !check_tc_value(table, value, tc_level, "UPDATE"))
+            return -1;
+        tc_changes = tc_changes || (column_idx == table.tc_column_idx);
+        assignments.push_back(make_pair(column_idx, value));
+    }
+
+    vector<int> row_idxs;
+    string where_string = (where_pos == string::npos) ? "" : statement.substr(where_pos + string(" WHERE ").size());
+    if (!matching_rows(table, where_string, tc_level, row_idxs))
+        return -1;
+    if (row_idxs.empty())
+        return 0;
+
+    for (const pair<int, Data> &assignment : assignments)
+    {
+        admit_value(table, assignment.first, assignment.second);
+        Column &column = table.table_data[assignment.first];
+        for (int row_idx : row_idxs)
+        {
+            set_data(column, row_idx, assignment.second);
+        }
+    }
+
+    // Rows that move to another TC level have to be regrouped, which also 
+    // rebuilds the indexes
+    if (tc_changes)
+        cluster_by_tc_level(table);
+    else
+    {
+        for (const pair<int, Data> &assignment : assignments)
+        {
+            reindex_rows(table, assignment.first, row_idxs);
+        }
+    }
+    return row_idxs.size();
+}
+
+/**
+ * Function that runs a DELETE statement, which has the form
+ * DELETE FROM <table> [WHERE <conditions>]. Only the rows the user can see 
+ * are deleted.
+ * 
+ * @param table     The table to delete from.
+ * @param statement The statement to run.
+ * @param tc_level  The users security level.
+ * 
+ * @return The number of rows deleted, -1 if the statement is not valid, then
+ *         an error is printed.
+*/
+int run_delete(Table &table, const string &statement, int tc_level)
+{
+    size_t table_end = statement.find(" " + table.table_name) + 1 + table.table_name.size();
+    size_t where_pos = statement.find(" WHERE ", table_end);
+    string rest = trim(statement.substr(table_end, (where_pos == string::npos) ? string::npos : where_pos - table_end));
+    if (rest != "")
+    {
+        cout << "Invalid DELETE statement, expected: DELETE FROM <table> [WHERE <conditions>]" << endl;
+        return -1;
+    }
+
+    vector<int> row_idxs;
+    string where_string = (where_pos == string::npos) ? "" : statement.substr(where_pos + string(" WHERE ").size());
+    if (!matching_rows(table, where_string, tc_level, row_idxs))
+        return -1;
+
+    if (!row_idxs.empty())
+        remove_rows(table, row_idxs);
+    return row_idxs.size();
+}
+
+/**
+ * Converts a value of an INSERT or UPDATE statement to the type of its 
+ * column. A value that is an empty string leaves the column empty.
+ * 
+ * @param value          The value as it was written, without surrounding
+ *                       whitespace.
+ * @param column         The column the value is stored in.
+ * @param statement_name The name of the statement, used in errors.
+ * @param data_item      The converted value.
+ * 
+ * @return True if the value is valid for the column, otherwise an error is 
+ *         printed.
+*/
+bool convert_value(const string &value, const Column &column, const string &statement_name, Data &data_item)
+{
+    data_item = Data();
+    data_item.empty = (value == "");
+    if (!data_item.empty && !convert_literal(value, column.type, data_item))
+    {
+        cout << "Invalid value for " << column.column_name << " in " << statement_name << " statement: " 
+             << value << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Checks that a row written by a user stays at or below the users TC level.
+ * 
+ * @param table          The table the row is written to.
+ * @param tc_value       The TC level of the row.
+ * @param tc_level       The users security level.
+ * @param statement_name The name of the statement, used in errors.
+ * 
+ * @return True if the user can write the row, otherwise an error is printed.
+ *         Tables without a TC column can always be written.
+*/
+bool check_tc_value(const Table &table, const Data &tc_value, int tc_level, const string &statement_name)
+{
+    if (table.tc_column_idx == -1)
+        return true;
+
+    if (tc_value.empty)
+    {
+        cout << "Invalid TC level in " << statement_name << " statement, every row needs one" << endl;
+        return false;
+    }
+    if (tc_value.int_data > tc_level)
+    {
+        cout << "Invalid TC level in " << statement_name << " statement, " << tc_value.int_data 
+             << " is above the session's level of " << tc_level << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Finds the rows of a table that an UPDATE or DELETE statement changes.
+ * 
+ * @param table        The table the statement writes to.
+ * @param where_string The WHERE statement, empty for every row.
+ * @param tc_level     The users security level, only rows the user can see 
+ *                     are found.
+ * @param row_idxs     The rows that pass the conditions, in ascending order.
+ * 
+ * @return True if the WHERE statement is valid, otherwise an error is 
+ *         printed.
+*/
+bool matching_rows(const Table &table, const string &where_string, int tc_level, vector<int> &row_idxs)
+{
+    Predicate where_predicate;
+    where_predicate.kind = PREDICATE_AND;
+    if ((trim(where_string) != "") && !compile_where(where_string, table, where_predicate))
+        return false;
+
+    row_idxs = parse_table(where_predicate, table, tc_level, false).row_idxs;
+    sort(row_idxs.begin(), row_idxs.end());
+    return true;
+}
+
+/**
+ * A single ORDERBY key.
+ * 
+ * @var column    The column that the rows are ordered by.
+ * @var ascending True for ascending order (1), false for descending (-1).
+*/
+typedef struct sort_key
+{
+    const Column *column;
+    bool ascending;
+}
+Sort_Key;
+
+/**
+ * Compares two rows of a table using a list of ORDERBY keys. Later keys are
+ * only used to break ties of the earlier ones, and empty values always sort
+ * after the non-empty ones.
+*/
+class Row_Comparator
+{
+public:
+    Row_Comparator(const vector<Sort_Key> &sort_keys) : sort_keys(sort_keys) {}
+
+    /**
+     * @return True if row_idx1 should come before row_idx2.
+    */
+    bool operator()(int row_idx1, int row_idx2) const
+    {
+        for (const Sort_Key &key : sort_keys)
+        {
+            const Column &column = *key.column;
+            bool empty1 = is_row_empty(column, row_idx1);
+            bool empty2 = is_row_empty(column, row_idx2);
+
+            if (empty1 || empty2)
+            {
+                if (empty1 == empty2)
+                    continue;
+                return empty2;
+            }
+
+            int result = compare_column_rows(column, row_idx1, row_idx2);
+            if (result != 0)
+                return key.ascending ? (result < 0) : (result > 0);
+        }
+        return false;
+    }
+
+private:
+    const vector<Sort_Key> &sort_keys;
+};
+
+/**
+ * Function that will sort the given table based on the passed string of 
+ * conditions
+ * 
+ * @param orderby_string A string that contains the comma separated list of 
+ *                       orderby conditions.
+ * @param view_to_order  The view whose rows should be sorted.
+ * @param row_limit      The number of rows that are needed, -1 for all of them.
+ *                       Only the first row_limit rows are kept.
+*/
+void sort_table(const string &orderby_string, Table_View &view_to_order, int row_limit)
+{
+    const Table &table_to_order = *view_to_order.table;
+    vector<string> order_list = split_string_comma(orderby_string);
+    vector<Sort_Key> sort_keys;
+
+    for (string order_string : order_list)
+    {
+        string data1;
+        string data2;
+        int current_item = 0;
+
+        // Get the column and whether the sorting is to be ascending or descending
+        for (int idx = 0; idx < order_string.size(); idx++)
+        {
+            if ((current_item == 0) && (order_string[idx] != ' ')&& (order_string[idx] != ':'))
+                data1 += order_string[idx];
+            else if (order_string[idx] == ':')
+                current_item = 2;
+            else if ((current_item == 2) && (order_string[idx] != ' '))
+                data2 += order_string[idx];
+        }
+
+        // Get the column that the condition will be run against, keys on
+        // unknown columns or with an invalid direction are ignored
+        int column_idx = find_column(table_to_order, data1);
+        if ((column_idx >= 0) && (data2 == "1" || data2 == "-1"))
+        {
+            Sort_Key key = { .column = &table_to_order.table_data[column_idx], .ascending = (data2 == "1") };
+            sort_keys.push_back(key);
+        }
+    }
+
+    // Sort the view's list of row indexes instead of the rows themselves. The 
+    // sort is stable so rows that tie on every key keep their current order.
+    vector<int> &row_idxs = view_to_order.row_idxs;
+    Row_Comparator comparator(sort_keys);
+    if (sort_keys.empty())
+        return;
+    else if ((row_limit < 0) || (row_limit >= row_idxs.size()))
+    {
+        stable_sort(row_idxs.begin(), row_idxs.end(), comparator);
+        return;
+    }
+
+    // Only the first row_limit rows are needed, they are kept in a max heap of
+    // their positions in the view so each row costs O(log row_limit). Ties are
+    // broken by position, which gives the same rows as the stable sort.
+    auto position_less = [&](int position1, int position2)
+    {
+        if (comparator(row_idxs[position1], row_idxs[position2]))
+            return true;
+        else if (comparator(row_idxs[position2], row_idxs[position1]))
+            return false;
+        return position1 < position2;
+    };
+
+    vector<int> heap;
+    heap.reserve(row_limit);
+    for (int position = 0; position < row_idxs.size(); position++)
+    {
+        if (heap.size() < row_limit)
+        {
+            heap.push_back(position);
+            push_heap(heap.begin(), heap.end(), position_less);
+        }
+        else if ((row_limit > 0) && position_less(position, heap.front()))
+        {
+            pop_heap(heap.begin(), heap.end(), position_less);
+            heap.back() = position;
+            push_heap(heap.begin(), heap.end(), position_less);
+        }
+    }
+    sort_heap(heap.begin(), heap.end(), position_less);
+
+    vector<int> top_rows;
+    top_rows.reserve(heap.size());
+    for (int position : heap)
+    {
+        top_rows.push_back(row_idxs[position]);
+    }
+    row_idxs.swap(top_rows);
+}
+
+/**
+ * Function that parses the LIMIT statement, which has the form 
+ * LIMIT <count> [OFFSET <count>] and ends the query. The statement is removed
+ * from the list of words.
+ * 
+ * @param list_of_words The words of the query.
+ * @param limit_count   The number of rows to return, -1 if there is no LIMIT.
+ * @param limit_offset  The number of rows to skip, 0 if there is no OFFSET.
+ * 
+ * @return True if there is no LIMIT or it is valid, otherwise an error is 
+ *         printed.
+*/
+bool parse_limit(vector<string> &list_of_words, int &limit_count, int &limit_offset)
+{
+    limit_count = -1;
+    limit_offset = 0;
+
+    for (int word_idx = 0; word_idx < list_of_words.size(); word_idx++)
+    {
+        if (list_of_words[word_idx] != "LIMIT")
+            continue;
+
+        int word_count = list_of_words.size() - word_idx;
+        const string &count_string = (word_count > 1) ? list_of_words[word_idx + 1] : "";
+        const string &offset_string = (word_count > 3) ? list_of_words[word_idx + 3] : "0";
+        if (((word_count != 2) && ((word_count != 4) || (list_of_words[word_idx + 2] != "OFFSET"))) ||
+            !parse_argument(count_string.c_str(), 0, limit_count) || 
+            !parse_argument(offset_string.c_str(), 0, limit_offset))
+        {
+            cout << "Invalid LIMIT statement, expected: LIMIT <count> [OFFSET <count>]" << endl;
+            return false;
+        }
+
+        list_of_words.resize(word_idx);
+        break;
+    }
+    return true;
+}
+
+/**
+ * Function that parses the FORMAT statement, which has the form 
+ * FORMAT TEXT|CSV|JSONL|BINARY and ends the query, before or after a LIMIT
+ * statement. The statement is removed from the list of words.
+ * 
+ * @param list_of_words The words of the query.
+ * @param format        The format of the result, left unchanged if there is 
+ *                      no FORMAT.
+ * 
+ * @return True if there is no FORMAT or it is valid, otherwise an error is 
+ *         printed.
+*/
+bool parse_format(vector<string> &list_of_words, enum output_format &format)
+{
+    for (int word_idx = 0; word_idx < list_of_words.size(); word_idx++)
+    {
+        if (list_of_words[word_idx] != "FORMAT")
+            continue;
+
+        if ((word_idx + 1 == list_of_words.size()) || !format_from_name(list_of_words[word_idx + 1], format))
+        {
+            cout << "Invalid FORMAT statement, expected: FORMAT TEXT|CSV|JSONL|BINARY" << endl;
+            return false;
+        }
+
+        list_of_words.erase(list_of_words.begin() + word_idx, list_of_words.begin() + word_idx + 2);
+        break;
+    }
+    return true;
+}
+
+/**
+ * Finds the output format with the given name.
+ * 
+ * @param format_name The name of the format.
+ * @param format      Set to the format if the name is known.
+ * 
+ * @return True if the name is known.
+*/
+bool format_from_name(const string &format_name, enum output_format &format)
+{
+    if (format_name == "TEXT")
+        format = FORMAT_TEXT;
+    else if (format_name == "CSV")
+        format = FORMAT_CSV;
+    else if (format_name == "JSONL")
+        format = FORMAT_JSONL;
+    else if (format_name == "BINARY")
+        format = FORMAT_BINARY;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * Function that will parse the select statment, and perform the desired
+ * operations.
+ * 
+ * @param select_string  The string that contains the select statement.
+ * @param view_to_select The view that the select statement should be run on,
+ *                       only its list of columns is changed.
+*/
+void select_columns(const string &select_string, Table_View &view_to_select)
+{
+    vector<string> select_list = split_string_comma(select_string);
+    const Table &table_to_select = *view_to_select.table;
+    vector<int> new_column_idxs;
+    bool add_column = false;
+    vector<string> columns_to_include_or_remove;
+
+    for (string select_string: select_list)
+    {
+        string data1;
+        string data2;
+        int current_item = 0;
+
+        // Get the column and whether the sorting is to be ascending or descending
+        for (int idx = 0; idx < select_string.size(); idx++)
+        {
+            if ((current_item == 0) && (select_string[idx] != ' ') && (select_string[idx] != ':'))
+            {
+                if (select_string[idx] == '*')
+                    return;
+                data1 += select_string[idx];
+            }
+            else if (select_string[idx] == ':')
+                current_item = 2;
+            else if ((current_item == 2) && (select_string[idx] != ' '))
+                data2 += select_string[idx];
+        }
+
+        if (data2 == "1")
+            add_column = true;
+
+        columns_to_include_or_remove.push_back(data1);
+    }
+
+    // Include columns based on the list
+    if (add_column)
+    {
+        for (int idx = 0; idx < columns_to_include_or_remove.size(); idx++)
+        {
+            for (int column_idx : view_to_select.column_idxs)
+            {
+                if (column_has_name(table_to_select.table_data[column_idx], columns_to_include_or_remove[idx]))
+                    new_column_idxs.push_back(column_idx);
+            }
+        }
+    }
+    else // Remove columns based on the list
+    {
+        for (int column_idx : view_to_select.column_idxs)
+        {
+            bool remove_column = false;
+            for (const string &column_name : columns_to_include_or_remove)
+            {
+                if (column_has_name(table_to_select.table_data[column_idx], column_name))
+                    remove_column = true;
+            }
+
+            if (!remove_column)
+                new_column_idxs.push_back(column_idx);
+        }
+    }
+
+    view_to_select.column_idxs.swap(new_column_idxs);
+}
+
+/**
+ * Function that parses the SELECT and GROUPBY statements of a query that 
+ * aggregates its rows. SELECT lists the result columns, each one is either a
+ * GROUPBY column or one of COUNT(*), COUNT(<column>), SUM(<column>), 
+ * AVG(<column>), MIN(<column>) and MAX(<column>). SUM and AVG need an INT or
+ * FLOAT column.
+ * 
+ * @param select_string The SELECT statement.
+ * @param group_string  The GROUPBY statement, empty if every row is one group.
+ * @param table         The table the query reads from.
+ * @param query         The parsed statements.
+ * 
+ * @return True if the statements were valid, otherwise an error is printed.
+*/
+bool parse_aggregates(const string &select_string, const string &group_string, const Table &table, 
+                      Aggregate_Query &query)
+{
+    for (string group_name : split_string_comma(group_string))
+    {
+        group_name = trim(group_name);
+        if (group_name == "")
+            continue;
+
+        int column_idx = find_column(table, group_name);
+        if (column_idx < 0)
+        {
+            cout << "Invalid column in GROUPBY statement: " << group_name << endl;
+            return false;
+        }
+        query.group_columns.push_back(column_idx);
+    }
+
+    const char *function_names[] = { "", "COUNT", "SUM", "AVG", "MIN", "MAX" };
+    for (string item_string : split_string_comma(select_string))
+    {
+        item_string = trim(item_string);
+        if (item_string == "")
+            continue;
+
+        Aggregate item;
+        item.function = AGGREGATE_NONE;
+        string column_name = item_string;
+
+        // Aggregate functions have the form <function>(<column>)
+        size_t open_pos = item_string.find('(');
+        if (open_pos != string::npos)
+        {
+            string function_name = trim(item_string.substr(0, open_pos));
+            for (int function = AGGREGATE_COUNT; function <= AGGREGATE_MAX; function++)
+            {
+                if (function_name == function_names[function])
+                    item.function = (enum aggregate_function)function;
+            }
+            if ((item.function == AGGREGATE_NONE) || (item_string[item_string.size() - 1] != ')'))
+            {
+                cout << "Invalid aggregate in SELECT statement: " << item_string << endl;
+                return false;
+            }
+            column_name = trim(item_string.substr(open_pos + 1, item_string.size() - open_pos - 2));
+        }
+
+        item.name = (item.function == AGGREGATE_NONE) ? column_name : 
+                    string(function_names[item.function]) + "(" + column_name + ")";
+        item.column_idx = ((item.function == AGGREGATE_COUNT) && (column_name == "*")) ? -1 : 
+                          find_column(table, column_name);
+        if ((item.column_idx < 0) && (column_name != "*"))
+        {
+            cout << "Invalid column in SELECT statement: " << column_name << endl;
+            return false;
+        }
+        if ((item.function == AGGREGATE_NONE) && 
+            (count(query.group_columns.begin(), query.group_columns.end(), item.column_idx) == 0))
+        {
+            cout << "Invalid SELECT statement, " << column_name 
+                 << " must be in GROUPBY or inside an aggregate function" << endl;
+            return false;
+        }
+        if (((item.function == AGGREGATE_SUM) || (item.function == AGGREGATE_AVG)) && 
+            (table.table_data[item.column_idx].type != INT) && (table.table_data[item.column_idx].type != FLOAT))
+        {
+            cout << "Invalid SELECT statement, " << function_names[item.function] 
+                 << " needs an INT or FLOAT column: " << column_name << endl;
+            return false;
+        }
+        query.items.push_back(item);
+    }
+
+    if (query.items.empty())
+    {
+        cout << "Invalid SELECT statement, expected the columns and aggregates to return" << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Function that aggregates the rows of a view into one row per group, with 
+ * hash aggregation. Each row is given the id of its group and the aggregate
+ * functions are then run over every row into the state of its group. Without
+ * GROUPBY every row is in one group, and the rows are split into morsels that
+ * are aggregated in parallel.
+ * 
+ * @param query             The GROUPBY columns and the SELECT items.
+ * @param view_to_aggregate The rows to aggregate, in any order.
+ * @param aggregate_table   The table that the result rows are stored in, with
+ *                          one column per SELECT item.
+ * 
+ * @return A view of the result rows, ordered by the GROUPBY columns.
+*/
+Table_View aggregate_rows(const Aggregate_Query &query, const Table_View &view_to_aggregate, Table &aggregate_table)
+{
+    const Table &table = *view_to_aggregate.table;
+    const vector<int> &row_idxs = view_to_aggregate.row_idxs;
+    int item_count = query.items.size();
+    Aggregate_State empty_state = { 0, 0, 0.0, -1 };
+
+    vector<const Column *> item_columns;
+    for (const Aggregate &item : query.items)
+    {
+        item_columns.push_back((item.column_idx == -1) ? NULL : &table.table_data[item.column_idx]);
+    }
+
+    // The states of each item are stored one after another, one per group
+    vector<int> first_rows;
+    vector<Aggregate_State> states;
+    if (query.group_columns.empty())
+    {
+        int morsel_count = (row_idxs.size() + MORSEL_ROWS - 1) / MORSEL_ROWS;
+        vector<Aggregate_State> morsel_states(morsel_count * item_count, empty_state);
+        query_pool.run_morsels(morsel_count, [&](int morsel_idx)
+        {
+            int first_position = morsel_idx * MORSEL_ROWS;
+            int count = min(MORSEL_ROWS, (int)row_idxs.size() - first_position);
+            for (int item_idx = 0; item_idx < item_count; item_idx++)
+            {
+                accumulate_rows(query.items[item_idx], item_columns[item_idx], row_idxs.data() + first_position, 
+                                count, morsel_states[morsel_idx * item_count + item_idx]);
+            }
+        });
+
+        // Combine the morsels in order, so the result does not depend on the
+        // number of threads
+        first_rows.push_back(row_idxs.empty() ? -1 : row_idxs[0]);
+        states.assign(item_count, empty_state);
+        for (int morsel_idx = 0; morsel_idx < morsel_count; morsel_idx++)
+        {
+            for (int item_idx = 0; item_idx < item_count; item_idx++)
+            {
+                const Aggregate_State &morsel_state = morsel_states[morsel_idx * item_count + item_idx];
+                Aggregate_State &state = states[item_idx];
+                state.count += morsel_state.count;
+                state.int_sum += morsel_state.int_sum;
+                state.float_sum += morsel_state.float_sum;
+
+                if ((morsel_state.best_row != -1) && 
+                    ((state.best_row == -1) || 
+                     ((query.items[item_idx].function == AGGREGATE_MIN) && 
+                      (compare_column_rows(*item_columns[item_idx], morsel_state.best_row, state.best_row) < 0)) ||
+                     ((query.items[item_idx].function == AGGREGATE_MAX) && 
+                      (compare_column_rows(*item_columns[item_idx], morsel_state.best_row, state.best_row) > 0))))
+                {
+                    state.best_row = morsel_state.best_row;
+                }
+            }
+        }
+    }
+    else
+    {
+        vector<int> group_ids = group_rows(query, table, row_idxs, first_rows);
+        int group_count = first_rows.size();
+        states.assign(group_count * item_count, empty_state);
+        for (int item_idx = 0; item_idx < item_count; item_idx++)
+        {
+            Aggregate_State *item_states = states.data() + item_idx * group_count;
+            for (int position = 0; position < row_idxs.size(); position++)
+            {
+                accumulate_row(query.items[item_idx], item_columns[item_idx], row_idxs[position], 
+                               item_states[group_ids[position]]);
+            }
+        }
+    }
+
+    int group_count = first_rows.size();
+    aggregate_table = { .table_name = table.table_name, .tc_column_idx = -1 };
+    for (int item_idx = 0; item_idx < item_count; item_idx++)
+    {
+        aggregate_table.table_data.push_back(aggregate_column(query.items[item_idx], table, 
+                                                              states.data() + item_idx * group_count, first_rows));
+    }
+
+    // Order the groups by the values of the GROUPBY columns
+    Table_View result;
+    result.table = &aggregate_table;
+    for (int group = 0; group < group_count; group++)
+    {
+        result.row_idxs.push_back(group);
+    }
+    for (int item_idx = 0; item_idx < item_count; item_idx++)
+    {
+        result.column_idxs.push_back(item_idx);
+    }
+
+    vector<Sort_Key> sort_keys;
+    for (int column_idx : query.group_columns)
+    {
+        Sort_Key key = { .column = &table.table_data[column_idx], .ascending = true };
+        sort_keys.push_back(key);
+    }
+    Row_Comparator comparator(sort_keys);
+    stable_sort(result.row_idxs.begin(), result.row_idxs.end(), 
+                [&](int group1, int group2) { return comparator(first_rows[group1], first_rows[group2]); });
+
+    return result;
+}
+
+/**
+ * Gives each row the id of its group, the rows with the same values in every
+ * GROUPBY column are in the same group. The ids of each column are found 
+ * first and then combined with a hash table.
+ * 
+ * @param query      The GROUPBY columns.
+ * @param table      The table holding the rows.
+ * @param row_idxs   The rows to group.
+ * @param first_rows The first row of each group.
+ * 
+ * @return The group id of each row, the groups are numbered in the order of
+ *         their first row.
+*/
+vector<int> group_rows(const Aggregate_Query &query, const Table &table, const vector<int> &row_idxs, 
+                       vector<int> &first_rows)
+{
+    vector<int> group_ids;
+    int group_count = 0;
+    for (int key_idx = 0; key_idx < query.group_columns.size(); key_idx++)
+    {
+        int column_group_count;
+        vector<int> column_ids = column_group_ids(table.table_data[query.group_columns[key_idx]], row_idxs, 
+                                                  column_group_count);
+        if (key_idx == 0)
+        {
+            group_ids.swap(column_ids);
+            group_count = column_group_count;
+            continue;
+        }
+
+        unordered_map<uint64_t, int> combined_groups;
+        for (int position = 0; position < row_idxs.size(); position++)
+        {
+            uint64_t key = ((uint64_t)group_ids[position] << 32) | (uint32_t)column_ids[position];
+            group_ids[position] = combined_groups.insert(make_pair(key, (int)combined_groups.size())).first->second;
+        }
+        group_count = combined_groups.size();
+    }
+
+    first_rows.assign(group_count, -1);
+    for (int position = 0; position < row_idxs.size(); position++)
+    {
+        if (first_rows[group_ids[position]] == -1)
+            first_rows[group_ids[position]] = row_idxs[position];
+    }
+    return group_ids;
+}
+
+/**
+ * Gives each row the id of its value in a column, the empty rows share one
+ * id. CHAR and dictionary encoded STRING columns look the ids up in an array,
+ * the other types use a hash table.
+ * 
+ * @param column      The column holding the values.
+ * @param row_idxs    The rows to group.
+ * @param group_count The number of distinct ids.
+ * 
+ * @return The id of each row, numbered in the order of their first row.
+*/
+vector<int> column_group_ids(const Column &column, const vector<int> &row_idxs, int &group_count)
+{
+    vector<int> ids(row_idxs.size());
+    int empty_group = -1;
+    group_count = 0;
+
+    vector<int> value_groups;
+    unordered_map<int64_t, int> key_groups;
+    unordered_map<string, int> string_groups;
+    bool dense = (column.type == CHAR) || ((column.type == STRING) && column.dictionary_encoded);
+    if (dense)
+        value_groups.assign((column.type == CHAR) ? 256 : column.dictionary.size(), -1);
+
+    for (int position = 0; position < row_idxs.size(); position++)
+    {
+        int row_idx = row_idxs[position];
+        if (is_row_empty(column, row_idx))
+        {
+            if (empty_group == -1)
+                empty_group = group_count++;
+            ids[position] = empty_group;
+        }
+        else if (dense)
+        {
+            int value = (column.type == CHAR) ? (unsigned char)column.char_data[row_idx] : column.string_codes[row_idx];
+            if (value_groups[value] == -1)
+                value_groups[value] = group_count++;
+            ids[position] = value_groups[value];
+        }
+        else if (column.type == STRING)
+        {
+            unordered_map<string, int>::iterator found = string_groups.find(column.string_data[row_idx]);
+            if (found == string_groups.end())
+                found = string_groups.insert(make_pair(column.string_data[row_idx], group_count++)).first;
+            ids[position] = found->second;
+        }
+        else
+        {
+            int64_t key = index_key(column.type, 0, 
+                                    column.type == INT ? column.int_data[row_idx] : 0,
+                                    column.type == FLOAT ? column.float_data[row_idx] : 0.0f);
+            unordered_map<int64_t, int>::iterator found = key_groups.find(key);
+            if (found == key_groups.end())
+                found = key_groups.insert(make_pair(key, group_count++)).first;
+            ids[position] = found->second;
+        }
+    }
+    return ids;
+}
+
+/**
+ * Adds one row to the state of an aggregate function.
+ * 
+ * @param item    The aggregate function.
+ * @param column  The column the function reads, NULL for COUNT(*).
+ * @param row_idx The row to add.
+ * @param state   The state of the row's group.
+*/
+void accumulate_row(const Aggregate &item, const Column *column, int row_idx, Aggregate_State &state)
+{
+    if (column == NULL)
+    {
+        state.count++;
+        return;
+    }
+    if (is_row_empty(*column, row_idx))
+        return;
+
+    state.count++;
+    if ((item.function == AGGREGATE_SUM) || (item.function == AGGREGATE_AVG))
+    {
+        if (column->type == INT)
+            state.int_sum += column->int_data[row_idx];
+        else
+            state.float_sum += column->float_data[row_idx];
+    }
+    else if ((item.function == AGGREGATE_MIN) || (item.function == AGGREGATE_MAX))
+    {
+        int result = (state.best_row == -1) ? 0 : compare_column_rows(*column, row_idx, state.best_row);
+        if ((state.best_row == -1) || ((item.function == AGGREGATE_MIN) && (result < 0)) || 
+            ((item.function == AGGREGATE_MAX) && (result > 0)))
+        {
+            state.best_row = row_idx;
+        }
+    }
+}
+
+/**
+ * Adds a list of rows to the state of an aggregate function. SUM and AVG add
+ * the whole null bitmap words of each run of consecutive rows with the sum 
+ * kernels, the other rows are added one at a time.
+ * 
+ * @param item     The aggregate function.
+ * @param column   The column the function reads, NULL for COUNT(*).
+ * @param row_idxs The rows to add.
+ * @param count    The number of rows.
+ * @param state    The state to add to.
+*/
+void accumulate_rows(const Aggregate &item, const Column *column, const int *row_idxs, int count, 
+                     Aggregate_State &state)
+{
+    if ((column == NULL) || ((item.function != AGGREGATE_SUM) && (item.function != AGGREGATE_AVG)))
+    {
+        for (int position = 0; position < count; position++)
+        {
+            accumulate_row(item, column, row_idxs[position], state);
+        }
+        return;
+    }
+
+    int position = 0;
+    while (position < count)
+    {
+        int run_end = position + 1;
+        while ((run_end < count) && (row_idxs[run_end] == row_idxs[run_end - 1] + 1))
+        {
+            run_end++;
+        }
+
+        // The rows of the run that fill whole bitmap words
+        int first_row = row_idxs[position];
+        int last_row = row_idxs[run_end - 1] + 1;
+        int kernel_begin = min(last_row, (first_row + 63) / 64 * 64);
+        int kernel_end = max(kernel_begin, last_row / 64 * 64);
+
+        for (int row_idx = first_row; row_idx < kernel_begin; row_idx++)
+        {
+            accumulate_row(item, column, row_idx, state);
+        }
+
+        if (kernel_end > kernel_begin)
+        {
+            int word_count = (kernel_end - kernel_begin) / 64;
+            const uint64_t *null_words = column->null_bitmap.data() + kernel_begin / 64;
+            if (column->type == INT)
+                sum_kernel(column->int_data.data() + kernel_begin, null_words, word_count, state.int_sum);
+            else
+                sum_kernel(column->float_data.data() + kernel_begin, null_words, word_count, state.float_sum);
+
+            state.count += kernel_end - kernel_begin;
+            for (int word_idx = 0; word_idx < word_count; word_idx++)
+            {
+                state.count -= __builtin_popcountll(null_words[word_idx]);
+            }
+        }
+
+        for (int row_idx = kernel_end; row_idx < last_row; row_idx++)
+        {
+            accumulate_row(item, column, row_idx, state);
+        }
+        position = run_end;
+    }
+}
+
+/**
+ * Builds the result column of one SELECT item of an aggregate query. COUNT 
+ * gives an INT column, SUM of an INT column a BIGINT column and the other 
+ * SUM and AVG a DOUBLE column. GROUPBY columns, MIN and MAX keep the type of
+ * their column. The result is empty for a group without any values.
+ * 
+ * @param item       The SELECT item.
+ * @param table      The table that was aggregated.
+ * @param states     The state of the item in each group.
+ * @param first_rows The first row of each group, -1 if there are no rows.
+ * 
+ * @return The column, with one row per group.
+*/
+Column aggregate_column(const Aggregate &item, const Table &table, const Aggregate_State *states, 
+                        const vector<int> &first_rows)
+{
+    int group_count = first_rows.size();
+    const Column *column = (item.column_idx == -1) ? NULL : &table.table_data[item.column_idx];
+
+    // A group without any values in the column gets its first row, which is
+    // empty as well
+    if ((item.function == AGGREGATE_NONE) || (item.function == AGGREGATE_MIN) || (item.function == AGGREGATE_MAX))
+    {
+        vector<int> value_rows(group_count);
+        for (int group = 0; group < group_count; group++)
+        {
+            value_rows[group] = (states[group].best_row != -1) ? states[group].best_row : first_rows[group];
+        }
+
+        // Only a query without GROUPBY can have no rows
+        if ((group_count == 1) && (value_rows[0] == -1))
+        {
+            Column result = new_column(item.name, column->type);
+            Data data_item;
+            data_item.empty = true;
+            append_data(result, data_item);
+            return result;
+        }
+
+        Column result = gather_rows(*column, value_rows);
+        result.column_name = item.name;
+        return result;
+    }
+
+    enum data_type type = DOUBLE;
+    if (item.function == AGGREGATE_COUNT)
+        type = INT;
+    else if ((item.function == AGGREGATE_SUM) && (column->type == INT))
+        type = BIGINT;
+
+    Column result = new_column(item.name, type);
+    result.row_count = group_count;
+    result.null_bitmap.assign((group_count + 63) / 64, 0);
+    for (int group = 0; group < group_count; group++)
+    {
+        const Aggregate_State &state = states[group];
+        double sum = (column != NULL && column->type == INT) ? (double)state.int_sum : state.float_sum;
+
+        if (item.function == AGGREGATE_COUNT)
+            result.int_data.push_back(state.count);
+        else if (type == BIGINT)
+            result.bigint_data.push_back(state.int_sum);
+        else if (item.function == AGGREGATE_SUM)
+            result.double_data.push_back(sum);
+        else // AGGREGATE_AVG
+            result.double_data.push_back((state.count == 0) ? 0.0 : sum / state.count);
+
+        if ((item.function != AGGREGATE_COUNT) && (state.count == 0))
+            result.null_bitmap[group / 64] |= (uint64_t)1 << (group % 64);
+    }
+    return result;
+}
+
+/**
+ * Prints out the rows and columns of a view to stdout in the given format.
+ * 
+ * @param view_to_print The view to print.
+ * @param format        The format to print the view in.
+*/
+void print_table(const Table_View &view_to_print, enum output_format format)
+{
+    cout << format_header(view_to_print, format);
+
+    // Print each row of data in the view. The rows are formatted a morsel at
+    // a time in parallel and printed in order, a few morsels per thread are
+    // formatted at once so the whole output is never held in memory.
+    const vector<int> &row_idxs = view_to_print.row_idxs;
+    int morsel_count = (row_idxs.size() + MORSEL_ROWS - 1) / MORSEL_ROWS;
+    int batch_size = 4 * query_pool.thread_count();
+    for (int first_morsel = 0; first_morsel < morsel_count; first_morsel += batch_size)
+    {
+        int batch_count = min(batch_size, morsel_count - first_morsel);
+        vector<string> batch_text(batch_count);
+        query_pool.run_morsels(batch_count, [&](int batch_idx)
+        {
+            int first_row = (first_morsel + batch_idx) * MORSEL_ROWS;
+            int last_row = min((int)row_idxs.size(), first_row + MORSEL_ROWS);
+            batch_text[batch_idx] = format_rows(view_to_print, first_row, last_row, format);
+        });
+
+        for (const string &text : batch_text)
+        {
+            cout << text;
+        }
+    }
+
+    // Text results end with an empty line, binary results with a batch of 
+    // zero rows
+    if (format == FORMAT_TEXT)
+        cout << endl;
+    else if (format == FORMAT_BINARY)
+        cout.write("\0\0\0\0\0\0\0\0", sizeof(uint64_t)) << flush;
+    else
+        cout << flush;
+}
+
+/**
+ * Formats the start of a result, which names the columns of a view. Text and
+ * CSV have a line of column names and JSON Lines has none, since every row 
+ * names its values.
+ * 
+ * A binary result starts with the magic "MLSB", the number of columns as a 
+ * uint32 and, for each column, its data_type and the length of its name as 
+ * uint32s followed by the name padded to 8 bytes. Batches of rows follow, see
+ * format_binary_rows. Numbers are in the byte order of the machine.
+ * 
+ * @param view_to_format The view to format.
+ * @param format         The format of the result.
+ * 
+ * @return The start of the result.
+*/
+string format_header(const Table_View &view_to_format, enum output_format format)
+{
+    const Table &table_to_format = *view_to_format.table;
+    const vector<int> &column_idxs = view_to_format.column_idxs;
+    string text;
+
+    if (format == FORMAT_BINARY)
+    {
+        uint32_t column_count = column_idxs.size();
+        text.append("MLSB", 4);
+        text.append((const char *)&column_count, sizeof(column_count));
+        for (int column_idx : column_idxs)
+        {
+            const Column &column = table_to_format.table_data[column_idx];
+            uint32_t column_info[2] = { (uint32_t)column.type, (uint32_t)column.column_name.size() };
+            text.append((const char *)column_info, sizeof(column_info));
+            text.append(column.column_name);
+            text.resize((text.size() + 7) & ~(size_t)7, '\0');
+        }
+        return text;
+    }
+
+    if (format == FORMAT_JSONL)
+        return text;
+
+    // Print the column names in a comma seperated list
+    for (int idx = 0; idx < column_idxs.size(); idx++)
+    {
+        const string &column_name = table_to_format.table_data[column_idxs[idx]].column_name;
+        if (format == FORMAT_CSV)
+            append_csv_field(text, column_name.data(), column_name.size());
+        else
+            text += column_name;
+
+        if (idx != column_idxs.size() - 1)
+            text += ',';
+    }
+    text += (format == FORMAT_CSV) ? "\r\n" : "\n";
+    return text;
+}
+
+/**
+ * Formats a range of the rows in a view. Text rows are formatted the same way
+ * cout would print them, with the values separated by commas and one row per
+ * line. CSV rows quote the values that need it and end with CRLF, as RFC 4180
+ * asks. JSON Lines rows are objects keyed by column name, with null for empty
+ * values.
+ * 
+ * @param view_to_format The view holding the rows.
+ * @param first_row      The position of the first row in the view.
+ * @param last_row       One past the position of the last row.
+ * @param format         The format of the result.
+ * 
+ * @return The formatted rows.
+*/
+string format_rows(const Table_View &view_to_format, int first_row, int last_row, enum output_format format)
+{
+    if (format == FORMAT_BINARY)
+        return format_binary_rows(view_to_format, first_row, last_row);
+
+    const Table &table_to_format = *view_to_format.table;
+    const vector<int> &column_idxs = view_to_format.column_idxs;
+    string text;
+    text.reserve((last_row - first_row) * column_idxs.size() * 8);
+
+    // The quoted column names that start the values of a JSON object
+    vector<string> json_keys;
+    for (int idx = 0; (format == FORMAT_JSONL) && (idx < column_idxs.size()); idx++)
+    {
+        const string &column_name = table_to_format.table_data[column_idxs[idx]].column_name;
+        json_keys.push_back((idx == 0) ? "{" : ",");
+        append_json_string(json_keys.back(), column_name.data(), column_name.size());
+        json_keys.back() += ':';
+    }
+
+    for (int position = first_row; position < last_row; position++)
+    {
+        int row_idx = view_to_format.row_idxs[position];
+        for (int idx = 0; idx < column_idxs.size(); idx++)
+        {
+            const Column &column = table_to_format.table_data[column_idxs[idx]];
+            if (format == FORMAT_JSONL)
+                text += json_keys[idx];
+
+            if (is_row_empty(column, row_idx))
+            {
+                if (format == FORMAT_JSONL)
+                    text += "null";
+            }
+            else if ((column.type == CHAR) || (column.type == STRING))
+            {
+                const char *value = NULL;
+                size_t length = 1;
+                if (column.type == CHAR)
+                    value = column.char_data.data() + row_idx;
+                else
+                {
+                    const string &string_data = string_value(column, row_idx);
+                    value = string_data.data();
+                    length = string_data.size();
+                }
+
+                if (format == FORMAT_CSV)
+                    append_csv_field(text, value, length);
+                else if (format == FORMAT_JSONL)
+                    append_json_string(text, value, length);
+                else
+                    text.append(value, length);
+            }
+            else if (column.type == INT)
+                append_int(text, column.int_data[row_idx]);
+            else if (column.type == BIGINT)
+                append_int(text, column.bigint_data[row_idx]);
+            else
+            {
+                // JSON has no numbers for infinity and NaN
+                double value = (column.type == FLOAT) ? column.float_data[row_idx] : column.double_data[row_idx];
+                if ((format == FORMAT_JSONL) && !isfinite(value))
+                    text += "null";
+                else
+                    append_float(text, value, (column.type == FLOAT) ? 6 : 15);
+            }
+
+            if (idx != column_idxs.size() - 1)
+                text += (format == FORMAT_JSONL) ? "" : ",";
+            else if (format == FORMAT_CSV)
+                text += "\r\n";
+            else if (format == FORMAT_JSONL)
+                text += "}\n";
+            else
+                text += '\n';
+        }
+    }
+    return text;
+}
+
+/**
+ * Formats a range of the rows in a view as one batch of a binary result. The
+ * batch starts with the number of rows as a uint64, then each column has a 
+ * null bitmap buffer, one bit per row where a set bit means the row has no 
+ * value, and a buffer of values. CHAR, INT, FLOAT, BIGINT and DOUBLE values
+ * are stored as 1 byte, int32, float, int64 and double arrays. STRING columns
+ * have a buffer of uint32 offsets, one per row plus one, into a buffer of 
+ * characters. Every buffer is prefixed by its size in bytes as a uint64 and 
+ * padded to 8 bytes, so a reader can use the arrays without copying them.
+ * 
+ * @param view_to_format The view holding the rows.
+ * @param first_row      The position of the first row in the view.
+ * @param last_row       One past the position of the last row.
+ * 
+ * @return The batch of rows.
+*/
+string format_binary_rows(const Table_View &view_to_format, int first_row, int last_row)
+{
+    const Table &table_to_format = *view_to_format.table;
+    const vector<int> &row_idxs = view_to_format.row_idxs;
+    uint64_t row_count = last_row - first_row;
+    string frame;
+    frame.append((const char *)&row_count, sizeof(row_count));
+
+    for (int column_idx : view_to_format.column_idxs)
+    {
+        const Column &column = table_to_format.table_data[column_idx];
+
+        vector<uint64_t> null_bitmap((row_count + 63) / 64, 0);
+        for (int position = first_row; position < last_row; position++)
+        {
+            if (is_row_empty(column, row_idxs[position]))
+                null_bitmap[(position - first_row) / 64] |= (uint64_t)1 << ((position - first_row) % 64);
+        }
+        append_buffer(frame, null_bitmap.data(), null_bitmap.size() * sizeof(uint64_t));
+
+        if (column.type == CHAR)
+            append_column_values(frame, column.char_data, row_idxs, first_row, last_row);
+        else if (column.type == INT)
+            append_column_values(frame, column.int_data, row_idxs, first_row, last_row);
+        else if (column.type == FLOAT)
+            append_column_values(frame, column.float_data, row_idxs, first_row, last_row);
+        else if (column.type == BIGINT)
+            append_column_values(frame, column.bigint_data, row_idxs, first_row, last_row);
+        else if (column.type == DOUBLE)
+            append_column_values(frame, column.double_data, row_idxs, first_row, last_row);
+        else // STRING
+        {
+            vector<uint32_t> offsets(1, 0);
+            string characters;
+            for (int position = first_row; position < last_row; position++)
+            {
+                if (!is_row_empty(column, row_idxs[position]))
+                    characters += string_value(column, row_idxs[position]);
+                offsets.push_back(characters.size());
+            }
+            append_buffer(frame, offsets.data(), offsets.size() * sizeof(uint32_t));
+            append_buffer(frame, characters.data(), characters.size());
+        }
+    }
+    return frame;
+}
+
+/**
+ * Appends an integer to a string the same way cout would print it, without
+ * allocating a temporary string.
+ * 
+ * @param text  The string to append to.
+ * @param value The integer to append.
+*/
+void append_int(string &text, int64_t value)
+{
+    char digits[24];
+    char *digit = digits + sizeof(digits);
+    uint64_t magnitude = (value < 0) ? 0 - (uint64_t)value : (uint64_t)value;
+    do
+    {
+        *--digit = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (value < 0)
+        *--digit = '-';
+    text.append(digit, digits + sizeof(digits) - digit);
+}
+
+/**
+ * Appends a floating point value to a string the same way cout would print it
+ * with the given precision. Whole numbers, the common case, skip the general 
+ * formatting.
+ * 
+ * @param text      The string to append to.
+ * @param value     The value to append.
+ * @param precision The number of significant digits.
+*/
+void append_float(string &text, double value, int precision)
+{
+    double limit = pow(10.0, precision);
+    if ((value > -limit) && (value < limit) && (value == (double)(int64_t)value) && !((value == 0) && signbit(value)))
+    {
+        append_int(text, (int64_t)value);
+        return;
+    }
+
+    char digits[32];
+    int length = snprintf(digits, sizeof(digits), "%.*g", precision, value);
+    text.append(digits, length);
+}
+
+/**
+ * Appends a value to a string as an RFC 4180 CSV field. Values that hold a 
+ * comma, a quote or a line break are quoted, with quotes doubled.
+ * 
+ * @param text   The string to append to.
+ * @param value  The characters of the value.
+ * @param length The number of characters in the value.
+*/
+void append_csv_field(string &text, const char *value, size_t length)
+{
+    const char *value_end = value + length;
+    if (find_if(value, value_end, [](char c) { return (c == ',') || (c == '"') || (c == '\r') || (c == '\n'); })
+        == value_end)
+    {
+        text.append(value, length);
+        return;
+    }
+
+    text += '"';
+    for (const char *c = value; c != value_end; c++)
+    {
+        if (*c == '"')
+            text += '"';
+        text += *c;
+    }
+    text += '"';
+}
+
+/**
+ * Appends a value to a string as a quoted JSON string, escaping quotes, 
+ * backslashes and control characters.
+ * 
+ * @param text   The string to append to.
+ * @param value  The characters of the value.
+ * @param length The number of characters in the value.
+*/
+void append_json_string(string &text, const char *value, size_t length)
+{
+    text += '"';
+    for (const char *c = value; c != value + length; c++)
+    {
+        if ((*c == '"') || (*c == '\\'))
+        {
+            text += '\\';
+            text += *c;
+        }
+        else if ((unsigned char)*c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)*c);
+            text += escape;
+        }
+        else
+            text += *c;
+    }
+    text += '"';
+}
+
+/**
+ * Appends a buffer to a binary result, prefixed by its size in bytes as a 
+ * uint64 and padded with zeros to a multiple of 8 bytes.
+ * 
+ * @param frame The binary result to append to.
+ * @param data  The bytes of the buffer.
+ * @param size  The number of bytes in the buffer.
+*/
+void append_buffer(string &frame, const void *data, size_t size)
+{
+    uint64_t buffer_size = size;
+    frame.append((const char *)&buffer_size, sizeof(buffer_size));
+    frame.append((const char *)data, size);
+    frame.resize((frame.size() + 7) & ~(size_t)7, '\0');
+}
+
+/**
+ * Appends the values of a range of rows in a view to a binary result as one
+ * buffer. Empty rows keep whatever the column stores for them.
+ * 
+ * @param frame     The binary result to append to.
+ * @param values    The values of the column.
+ * @param row_idxs  The rows of the view.
+ * @param first_row The position of the first row in the view.
+ * @param last_row  One past the position of the last row.
+*/
+template <typename T>
+void append_column_values(string &frame, const vector<T> &values, const vector<int> &row_idxs, 
+                          int first_row, int last_row)
+{
+    vector<T> row_values;
+    row_values.reserve(last_row - first_row);
+    for (int position = first_row; position < last_row; position++)
+    {
+        row_values.push_back(values[row_idxs[position]]);
+    }
+    append_buffer(frame, row_values.data(), row_values.size() * sizeof(T));
+}
+
+/**
+ * Function that runs a SNAPSHOT statement, which has the form 
+ * SNAPSHOT [<table>]. A snapshot of the table, or of every table if none is 
+ * given, is written to <table>.snap so that later runs can skip the CSV file.
+ * 
+ * @param database  The database that holds the tables.
+ * @param statement The statement to run.
+ * 
+ * @return True if the snapshots were written, otherwise an error is printed.
+*/
+bool write_snapshots(const vector<Table> &database, const string &statement)
+{
+    vector<string> list_of_words = split_string_space(statement + " ");
+    if ((list_of_words.size() < 1) || (list_of_words.size() > 2) || (list_of_words[0] != "SNAPSHOT"))
+    {
+        cout << "Invalid SNAPSHOT statement, expected: SNAPSHOT [<table>]" << endl;
+        return false;
+    }
+
+    bool table_found = false;
+    for (const Table &table : database)
+    {
+        if ((list_of_words.size() == 2) && (table.table_name != list_of_words[1]))
+            continue;
+
+        table_found = true;
+        if (!write_snapshot(table, table.table_name + ".snap"))
+            return false;
+    }
+
+    if (!table_found)
+    {
+        cout << "Invalid table in SNAPSHOT statement: " << list_of_words[1] << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes a table to a snapshot file. The file is written under a temporary 
+ * name, synced and then renamed, so a reader never sees a partly written 
+ * snapshot and the log records it holds can be dropped once this returns.
+ * 
+ * @param table     The table to write.
+ * @param file_name The name of the snapshot file.
+ * 
+ * @return True if the snapshot was written, otherwise an error is printed.
+*/
+bool write_snapshot(const Table &table, const string &file_name)
+{
+    // A snapshot only records where each TC level ends and codes that follow
+    // the order of their values, so the rows inserted since the table was 
+    // grouped and the values added to dictionaries are put in order in a 
+    // copy first
+    bool grouped = (table.tc_column_idx == -1) || (table.tail_begin == table.file_rows.size());
+    bool sorted = true;
+    for (const Column &column : table.table_data)
+    {
+        sorted = sorted && (column.sorted_values == column.dictionary.size());
+    }
+    if (!grouped || !sorted)
+    {
+        Table ordered_table = table;
+        if (!grouped)
+            cluster_by_tc_level(ordered_table);
+        for (int column_idx = 0; column_idx < ordered_table.table_data.size(); column_idx++)
+        {
+            const Column &column = ordered_table.table_data.read(column_idx);
+            if (column.sorted_values < column.dictionary.size())
+                sort_dictionary(ordered_table.table_data[column_idx]);
+        }
+        return write_snapshot(ordered_table, file_name);
+    }
+
+    string temporary_name = file_name + ".tmp";
+    ofstream file(temporary_name, ios::binary | ios::trunc);
+    if (!file.is_open())
+    {
+        cout << "Unable to write " << file_name << "!!!" << endl;
+        return false;
+    }
+
+    // Every column is written, so they all have to be in memory
+    Column_Pins pins;
+    column_loader.pin_table(table, pins);
+    int row_count = table.table_data.empty() ? 0 : table.table_data[0].row_count;
+
+    Snapshot_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "CS301SNP", sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.column_count = table.table_data.size();
+    header.row_count = row_count;
+    header.source_size = table.source_size;
+    header.source_mtime = table.source_mtime;
+    header.log_sequence = table.log_sequence;
+
+    // The header is written again once the payload size and checksum are known
+    file.write((const char *)&header, sizeof(header));
+
+    uint64_t checksum = CHECKSUM_SEED;
+    string schema;
+    for (const Column &column : table.table_data)
+    {
+        uint32_t column_info[2] = { (uint32_t)column.type, (uint32_t)column.column_name.size() };
+        schema.append((const char *)column_info, sizeof(column_info));
+        schema.append(column.column_name);
+    }
+    write_block(file, schema.data(), schema.size(), checksum);
+
+    int32_t tc_info[2] = { table.tc_column_idx, (int32_t)table.tc_levels.size() };
+    write_block(file, tc_info, sizeof(tc_info), checksum);
+    write_block(file, table.tc_levels.data(), table.tc_levels.size() * sizeof(int), checksum);
+    write_block(file, table.tc_level_ends.data(), table.tc_level_ends.size() * sizeof(int), checksum);
+    write_block(file, table.file_rows.data(), table.file_rows.size() * sizeof(int), checksum);
+
+    // The directory is filled in once the columns are written
+    vector<uint64_t> directory(table.table_data.size() * 3, 0);
+    streampos directory_position = file.tellp();
+    file.write((const char *)directory.data(), directory.size() * sizeof(uint64_t));
+
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        const Column &column = table.table_data[column_idx];
+        uint64_t column_begin = file.tellp();
+        uint64_t column_checksum = CHECKSUM_SEED;
+        write_block(file, column.null_bitmap.data(), column.null_bitmap.size() * sizeof(uint64_t), column_checksum);
+
+        if (column.type == CHAR)
+            write_block(file, column.char_data.data(), column.char_data.size(), column_checksum);
+        else if (column.type == INT)
+            write_block(file, column.int_data.data(), column.int_data.size() * sizeof(int32_t), column_checksum);
+        else if (column.type == FLOAT)
+            write_block(file, column.float_data.data(), column.float_data.size() * sizeof(float), column_checksum);
+        else // STRING
+        {
+            // Encoded columns store their dictionary and codes, the other
+            // columns store each row's value
+            const vector<string> &strings = column.dictionary_encoded ? column.dictionary : column.string_data;
+            uint64_t string_info[2] = { column.dictionary_encoded, strings.size() };
+            write_block(file, string_info, sizeof(string_info), column_checksum);
+
+            vector<uint64_t> offsets(1, 0);
+            string values;
+            for (const string &value : strings)
+            {
+                values.append(value);
+                offsets.push_back(values.size());
+            }
+            write_block(file, offsets.data(), offsets.size() * sizeof(uint64_t), column_checksum);
+            write_block(file, values.data(), values.size(), column_checksum);
+
+            if (column.dictionary_encoded)
+                write_block(file, column.string_codes.data(), column.string_codes.size() * sizeof(int32_t), 
+                            column_checksum);
+        }
+
+        directory[column_idx * 3] = column_begin;
+        directory[column_idx * 3 + 1] = (uint64_t)file.tellp() - column_begin;
+        directory[column_idx * 3 + 2] = column_checksum;
+    }
+
+    header.payload_size = (uint64_t)file.tellp() - sizeof(header);
+    header.checksum = checksum_words(checksum, (const char *)directory.data(), 
+                                     directory.size() * sizeof(uint64_t));
+    file.seekp(directory_position);
+    file.write((const char *)directory.data(), directory.size() * sizeof(uint64_t));
+    file.seekp(0);
+    file.write((const char *)&header, sizeof(header));
+    file.close();
+
+    if (!file.good() || !sync_file(temporary_name) || (rename(temporary_name.c_str(), file_name.c_str()) != 0) ||
+        !sync_file("."))
+    {
+        cout << "Unable to write " << file_name << "!!!" << endl;
+        remove(temporary_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Loads a table from a snapshot file. The snapshot is only used if it matches
+ * the table's schema, was made from the current version of the table's data 
+ * file (when there is one) and the checksum of the blocks before the columns
+ * is correct. Only those blocks are read, each column is read and checked 
+ * when a query first uses it (see Column_Loader), so the file stays mapped.
+ * 
+ * Otherwise the data file is loaded instead, unless the snapshot holds 
+ * writes: once a checkpoint emptied the write-ahead log the snapshot is the
+ * only copy of them, so the program stops rather than lose them. A version 3
+ * snapshot is read as well and written again in the current format by the 
+ * next checkpoint.
+ * 
+ * @param table     The table to load, its columns must already be created.
+ * @param file_name The name of the snapshot file.
+ * 
+ * @return The number of bytes read from the snapshot, 0 if it was not used.
+*/
+size_t load_snapshot(Table &table, const string &file_name)
+{
+    int file_descriptor = open(file_name.c_str(), O_RDONLY);
+    if (file_descriptor == -1)
+        return 0;
+
+    struct stat file_stat;
+    if ((fstat(file_descriptor, &file_stat) == -1) || (file_stat.st_size < sizeof(Snapshot_Header)))
+    {
+        close(file_descriptor);
+        return 0;
+    }
+
+    size_t file_size = file_stat.st_size;
+    void *mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    close(file_descriptor);
+    if (mapping == MAP_FAILED)
+        return 0;
+
+    const char *file_data = (const char *)mapping;
+    Snapshot_Header header;
+    memcpy(&header, file_data, sizeof(header));
+
+    // Checked in order, the first problem found is reported
+    const char *problem = NULL;
+    int64_t source_size;
+    int64_t source_mtime;
+    bool known_magic = (memcmp(header.magic, "CS301SNP", sizeof(header.magic)) == 0);
+    if (!known_magic || (header.version < LOGGED_SNAPSHOT_VERSION) || (header.version > SNAPSHOT_VERSION))
+        problem = "has an unknown format";
+    else if ((header.payload_size != file_size - sizeof(header)) || (header.row_count > INT_MAX))
+        problem = "is truncated";
+    else if (file_stamp(table.table_name + ".csv", source_size, source_mtime) &&
+             ((source_size != header.source_size) || (source_mtime != header.source_mtime)))
+        problem = "is stale";
+    else if ((header.version == LOGGED_SNAPSHOT_VERSION) && 
+             (checksum_words(CHECKSUM_SEED, file_data + sizeof(header), header.payload_size) != header.checksum))
+        problem = "is corrupt";
+
+    const char *cursor = file_data + sizeof(header);
+    const char *payload_end = file_data + file_size;
+    int row_count = header.row_count;
+    const Shared_Vector<Column> &columns = table.table_data;
+
+    // The schema has to match the one from TAB_COLUMNS.csv
+    const char *schema = NULL;
+    if ((problem == NULL) && (header.column_count == columns.size()))
+    {
+        size_t schema_size = 0;
+        for (const Column &column : columns)
+        {
+            schema_size += 2 * sizeof(uint32_t) + column.column_name.size();
+        }
+        schema = read_block(cursor, payload_end, schema_size);
+    }
+    for (int column_idx = 0; (problem == NULL) && (column_idx < columns.size()); column_idx++)
+    {
+        uint32_t column_info[2];
+        if (schema != NULL)
+            memcpy(column_info, schema, sizeof(column_info));
+        if ((schema == NULL) || (column_info[0] != columns[column_idx].type) || 
+            (column_info[1] != columns[column_idx].column_name.size()) ||
+            (memcmp(schema + sizeof(column_info), columns[column_idx].column_name.data(), column_info[1]) != 0))
+        {
+            problem = "does not match TAB_COLUMNS.csv";
+            break;
+        }
+        schema += sizeof(column_info) + column_info[1];
+    }
+    if ((problem == NULL) && (columns.empty() || header.column_count != columns.size()))
+        problem = "does not match TAB_COLUMNS.csv";
+
+    // The TC clustering is stored as well, so it does not have to be redone
+    const char *tc_info_block = (problem == NULL) ? read_block(cursor, payload_end, 2 * sizeof(int32_t)) : NULL;
+    int32_t tc_info[2] = { -1, 0 };
+    if (tc_info_block != NULL)
+        memcpy(tc_info, tc_info_block, sizeof(tc_info));
+    if ((tc_info[0] >= (int)columns.size()) || (tc_info[1] < 0) || (tc_info[1] > row_count))
+        tc_info_block = NULL;
+
+    const char *tc_levels = NULL;
+    const char *tc_level_ends = NULL;
+    const char *file_rows = NULL;
+    const char *directory = NULL;
+    if (tc_info_block != NULL)
+    {
+        tc_levels = read_block(cursor, payload_end, tc_info[1] * sizeof(int));
+        tc_level_ends = read_block(cursor, payload_end, tc_info[1] * sizeof(int));
+        file_rows = read_block(cursor, payload_end, (size_t)row_count * sizeof(int));
+        if (header.version == SNAPSHOT_VERSION)
+            directory = read_block(cursor, payload_end, columns.size() * 3 * sizeof(uint64_t));
+    }
+    if ((problem == NULL) && ((tc_levels == NULL) || (tc_level_ends == NULL) || (file_rows == NULL) || 
+                              ((directory == NULL) && (header.version == SNAPSHOT_VERSION))))
+    {
+        problem = "is corrupt";
+    }
+    else if ((problem == NULL) && (header.version == SNAPSHOT_VERSION) &&
+             (checksum_words(CHECKSUM_SEED, file_data + sizeof(header), cursor - file_data - sizeof(header)) != 
+              header.checksum))
+    {
+        problem = "is corrupt";
+    }
+
+    // The blocks of each column come after the directory. Without one they 
+    // follow each other, and are found by their sizes.
+    vector<uint64_t> column_blocks(columns.size() * 3);
+    if ((problem == NULL) && (directory != NULL))
+        memcpy(column_blocks.data(), directory, column_blocks.size() * sizeof(uint64_t));
+    const char *blocks_cursor = cursor;
+    for (int column_idx = 0; (problem == NULL) && (directory == NULL) && (column_idx < columns.size()); column_idx++)
+    {
+        const char *blocks = blocks_cursor;
+        if (!skip_column_blocks(blocks_cursor, payload_end, columns[column_idx], row_count))
+        {
+            problem = "is corrupt";
+            break;
+        }
+        column_blocks[column_idx * 3] = blocks - file_data;
+        column_blocks[column_idx * 3 + 1] = blocks_cursor - blocks;
+        column_blocks[column_idx * 3 + 2] = checksum_words(CHECKSUM_SEED, blocks, blocks_cursor - blocks);
+    }
+    for (int column_idx = 0; (problem == NULL) && (column_idx < columns.size()); column_idx++)
+    {
+        uint64_t block_begin = column_blocks[column_idx * 3];
+        uint64_t block_size = column_blocks[column_idx * 3 + 1];
+        if ((block_begin < (uint64_t)(cursor - file_data)) || (block_begin > file_size) || 
+            (block_size > file_size - block_begin) || (block_size % 8 != 0))
+        {
+            problem = "is corrupt";
+        }
+    }
+
+    if (problem != NULL)
+    {
+        munmap(mapping, file_size);
+
+        // A snapshot of a newer version may hold writes as well
+        if (known_magic && (header.version >= LOGGED_SNAPSHOT_VERSION) && 
+            ((header.log_sequence > 0) || (header.version > SNAPSHOT_VERSION)))
+        {
+            cerr << file_name << " " << problem << ", but it holds writes that " << table.table_name 
+                 << ".csv does not have. Remove " << file_name << " to load " << table.table_name 
+                 << ".csv without them!!!" << endl;
+            exit(-1);
+        }
+        cerr << file_name << " " << problem << ", loading " << table.table_name << ".csv instead" << endl;
+        return 0;
+    }
+
+    // The columns share the mapping, the file is unmapped once the last of
+    // them no longer needs it
+    shared_ptr<const char> file(file_data, [file_size](const char *data) { munmap((void *)data, file_size); });
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        Column &column = table.table_data[column_idx];
+        column.row_count = row_count;
+
+        shared_ptr<Column_Source> source = make_shared<Column_Source>();
+        source->file = file;
+        source->file_size = file_size;
+        source->block_begin = column_blocks[column_idx * 3];
+        source->block_size = column_blocks[column_idx * 3 + 1];
+        source->checksum = column_blocks[column_idx * 3 + 2];
+        source->field_idx = -1;
+        column_loader.attach(column, source);
+    }
+
+    table.tc_column_idx = tc_info[0];
+    table.tc_levels.assign((const int *)tc_levels, (const int *)tc_levels + tc_info[1]);
+    table.tc_level_ends.assign((const int *)tc_level_ends, (const int *)tc_level_ends + tc_info[1]);
+    table.file_rows.assign((const int *)file_rows, (const int *)file_rows + row_count);
+    table.tail_begin = row_count;
+    table.next_file_row = 0;
+    if (!table.file_rows.empty())
+        table.next_file_row = *max_element(table.file_rows.begin(), table.file_rows.end()) + 1;
+    table.source_size = header.source_size;
+    table.source_mtime = header.source_mtime;
+    table.log_sequence = header.log_sequence;
+
+    // The next checkpoint writes an older snapshot again
+    table.saved_sequence = (header.version == SNAPSHOT_VERSION) ? header.log_sequence : -1;
+    return cursor - file_data;
+}
+
+/**
+ * Reads the blocks of one column of a snapshot into the column, see 
+ * Snapshot_Header. The column blocks are copied as they are, nothing is 
+ * parsed.
+ * 
+ * @param cursor     The start of the column's blocks.
+ * @param blocks_end The end of the column's blocks.
+ * @param column     The column to read into, with its row count set. Its 
+ *                   values are replaced.
+ * 
+ * @return True if the blocks are complete and hold valid values.
+*/
+bool read_column_blocks(const char *cursor, const char *blocks_end, Column &column)
+{
+    int row_count = column.row_count;
+    resize_column(column, row_count);
+
+    const char *null_bitmap = read_block(cursor, blocks_end, column.null_bitmap.size() * sizeof(uint64_t));
+    const char *values = NULL;
+    if (column.type == CHAR)
+        values = read_block(cursor, blocks_end, row_count);
+    else if (column.type == INT)
+        values = read_block(cursor, blocks_end, (size_t)row_count * sizeof(int32_t));
+    else if (column.type == FLOAT)
+        values = read_block(cursor, blocks_end, (size_t)row_count * sizeof(float));
+    else // STRING
+        values = read_block(cursor, blocks_end, 2 * sizeof(uint64_t));
+
+    if ((null_bitmap == NULL) || (values == NULL))
+        return false;
+
+    memcpy(column.null_bitmap.data(), null_bitmap, column.null_bitmap.size() * sizeof(uint64_t));
+    if (column.type == CHAR)
+        memcpy(column.char_data.data(), values, row_count);
+    else if (column.type == INT)
+        memcpy(column.int_data.data(), values, (size_t)row_count * sizeof(int32_t));
+    else if (column.type == FLOAT)
+        memcpy(column.float_data.data(), values, (size_t)row_count * sizeof(float));
+    if (column.type != STRING)
+        return true;
+
+    uint64_t string_info[2];
+    memcpy(string_info, values, sizeof(string_info));
+    column.dictionary_encoded = string_info[0];
+
+    // An encoded column has its dictionary here, otherwise each row's value.
+    // Dictionaries are sorted before they are written.
+    vector<string> &strings = column.dictionary_encoded ? column.dictionary : column.string_data;
+    if (column.dictionary_encoded)
+        strings.resize(min(string_info[1], (uint64_t)row_count));
+    column.sorted_values = column.dictionary.size();
+    column.added_codes.clear();
+    const char *offset_block = NULL;
+    if (string_info[1] == strings.size())
+        offset_block = read_block(cursor, blocks_end, (strings.size() + 1) * sizeof(uint64_t));
+    if (offset_block == NULL)
+        return false;
+
+    vector<uint64_t> offsets(strings.size() + 1);
+    memcpy(offsets.data(), offset_block, offsets.size() * sizeof(uint64_t));
+    const char *string_values = read_block(cursor, blocks_end, offsets.back());
+    const char *codes = NULL;
+    if (column.dictionary_encoded)
+        codes = read_block(cursor, blocks_end, (size_t)row_count * sizeof(int32_t));
+    if ((string_values == NULL) || (column.dictionary_encoded && (codes == NULL)))
+        return false;
+
+    for (int string_idx = 0; string_idx < strings.size(); string_idx++)
+    {
+        if ((offsets[string_idx] > offsets[string_idx + 1]) || (offsets[string_idx + 1] > offsets.back()))
+            return false;
+        strings[string_idx].assign(string_values + offsets[string_idx], string_values + offsets[string_idx + 1]);
+    }
+
+    if (column.dictionary_encoded)
+    {
+        vector<string>().swap(column.string_data);
+        column.string_codes.resize(row_count);
+        memcpy(column.string_codes.data(), codes, (size_t)row_count * sizeof(int32_t));
+        for (int32_t code : column.string_codes)
+        {
+            if ((code < 0) || (code >= (int32_t)strings.size()))
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Writes a block of a snapshot, padded with zeros to a multiple of 8 bytes, 
+ * and adds it to the checksum.
+ * 
+ * @param file     The snapshot file.
+ * @param data     The contents of the block.
+ * @param size     The size of the block in bytes.
+ * @param checksum The running checksum of the payload.
+*/
+void write_block(ofstream &file, const void *data, size_t size, uint64_t &checksum)
+{
+    static const char padding[8] = { 0 };
+    size_t padded_size = (size + 7) / 8 * 8;
+
+    file.write((const char *)data, size);
+    file.write(padding, padded_size - size);
+
+    // Only whole words are checksummed, so the last partial word is padded
+    size_t whole_size = size / 8 * 8;
+    checksum = checksum_words(checksum, (const char *)data, whole_size);
+    if (whole_size != size)
+    {
+        char last_word[8] = { 0 };
+        memcpy(last_word, (const char *)data + whole_size, size - whole_size);
+        checksum = checksum_words(checksum, last_word, sizeof(last_word));
+    }
+}
+
+/**
+ * Reads a block of a snapshot and moves the cursor past its padding.
+ * 
+ * @param cursor      The start of the block, moved to the next block.
+ * @param payload_end The end of the snapshot.
+ * @param size        The size of the block in bytes.
+ * 
+ * @return The start of the block, NULL if the snapshot is too short.
+*/
+const char *read_block(const char *&cursor, const char *payload_end, size_t size)
+{
+    size_t padded_size = (size + 7) / 8 * 8;
+    if ((cursor == NULL) || (padded_size < size) || (padded_size > (size_t)(payload_end - cursor)))
+        return NULL;
+
+    const char *block = cursor;
+    cursor += padded_size;
+    return block;
+}
+
+/**
+ * Moves past the blocks of one column of a snapshot, see Snapshot_Header, 
+ * without reading its values.
+ * 
+ * @param cursor      The start of the column's blocks, moved to the next 
+ *                    column.
+ * @param payload_end The end of the snapshot.
+ * @param column      The column, for its type.
+ * @param row_count   The number of rows in the snapshot.
+ * 
+ * @return False if the blocks are cut off.
+*/
+bool skip_column_blocks(const char *&cursor, const char *payload_end, const Column &column, int row_count)
+{
+    const char *null_bitmap = read_block(cursor, payload_end, ((size_t)row_count + 63) / 64 * sizeof(uint64_t));
+    if (column.type == CHAR)
+        return (null_bitmap != NULL) && (read_block(cursor, payload_end, row_count) != NULL);
+    else if (column.type == INT)
+        return (null_bitmap != NULL) && (read_block(cursor, payload_end, (size_t)row_count * sizeof(int32_t)) != NULL);
+    else if (column.type == FLOAT)
+        return (null_bitmap != NULL) && (read_block(cursor, payload_end, (size_t)row_count * sizeof(float)) != NULL);
+
+    // STRING columns have as many values as rows, or a dictionary with at
+    // most that many values and a code for each row
+    const char *string_info_block = (null_bitmap == NULL) ? NULL : read_block(cursor, payload_end, 
+                                                                              2 * sizeof(uint64_t));
+    if (string_info_block == NULL)
+        return false;
+
+    uint64_t string_info[2];
+    memcpy(string_info, string_info_block, sizeof(string_info));
+    if ((string_info[1] > (uint64_t)row_count) || (!string_info[0] && (string_info[1] != (uint64_t)row_count)))
+        return false;
+
+    const char *offset_block = read_block(cursor, payload_end, (string_info[1] + 1) * sizeof(uint64_t));
+    if (offset_block == NULL)
+        return false;
+
+    uint64_t values_size;
+    memcpy(&values_size, offset_block + string_info[1] * sizeof(uint64_t), sizeof(values_size));
+    return (read_block(cursor, payload_end, values_size) != NULL) && 
+           (!string_info[0] || (read_block(cursor, payload_end, (size_t)row_count * sizeof(int32_t)) != NULL));
+}
+
+/**
+ * Adds whole 64 bit words to a checksum. Works like FNV-1a, but on a word at 
+ * a time instead of a byte at a time.
+ * 
+ * @param checksum The checksum so far, CHECKSUM_SEED to start a new one.
+ * @param data     The words to add.
+ * @param size     The number of bytes to add, a multiple of 8.
+ * 
+ * @return The new checksum.
+*/
+uint64_t checksum_words(uint64_t checksum, const char *data, size_t size)
+{
+    for (size_t offset = 0; offset < size; offset += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + offset, sizeof(word));
+        checksum = (checksum ^ word) * 1099511628211ULL;
+    }
+    return checksum;
+}
+
+/**
+ * Gets the size and modification time of a file.
+ * 
+ * @param file_name  The name of the file.
+ * @param file_size  The size of the file.
+ * @param file_mtime The modification time of the file in nanoseconds.
+ * 
+ * @return True if the file exists.
+*/
+bool file_stamp(const string &file_name, int64_t &file_size, int64_t &file_mtime)
+{
+    struct stat file_stat;
+    if (stat(file_name.c_str(), &file_stat) == -1)
+        return false;
+
+    file_size = file_stat.st_size;
+    file_mtime = (int64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+    return true;
+}
+
+/**
+ * Waits until a file, or the entries of a directory, are on disk.
+ * 
+ * @param file_name The name of the file or directory.
+ * 
+ * @return True if the file was synced.
+*/
+bool sync_file(const string &file_name)
+{
+    int file_descriptor = open(file_name.c_str(), O_RDONLY);
+    if (file_descriptor == -1)
+        return false;
+
+    bool synced = (fsync(file_descriptor) == 0);
+    close(file_descriptor);
+    return synced;
+}
+
+/**
+ * Replays the write-ahead log on top of the loaded tables and opens it for 
+ * new records. Records that a table's snapshot already holds are skipped. 
+ * Replay stops at the first record that is cut off or whose checksum does not
+ * match, since the program stopped while writing it, and the log is cut back
+ * to the records before it.
+ * 
+ * @param database  The database that holds the tables.
+ * @param file_name The name of the log file.
+ * 
+ * @return The number of records replayed, -1 if the log can not be opened.
+*/
+int replay_log(vector<Table> &database, const string &file_name)
+{
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    ifstream log_file(file_name, ios::binary);
+    string log_data((istreambuf_iterator<char>(log_file)), istreambuf_iterator<char>());
+    log_file.close();
+
+    int replayed_records = 0;
+    size_t valid_bytes = 0;
+    int64_t last_sequence = 0;
+    while (valid_bytes < log_data.size())
+    {
+        size_t line_end = log_data.find('\n', valid_bytes);
+        int64_t sequence;
+        int tc_level;
+        string statement;
+        if ((line_end == string::npos) || 
+            !parse_log_record(log_data.substr(valid_bytes, line_end - valid_bytes), sequence, tc_level, statement) ||
+            (sequence <= last_sequence))
+        {
+            cerr << file_name << " has a damaged record at byte " << valid_bytes << ", dropping the " 
+                 << log_data.size() - valid_bytes << " bytes from there on" << endl;
+            break;
+        }
+        valid_bytes = line_end + 1;
+        last_sequence = sequence;
+
+        // Statements are run without their ';', as run_query does
+        if (!statement.empty() && (statement[statement.size() - 1] == ';'))
+            statement[statement.size() - 1] = ' ';
+
+        int table_idx = write_table(database, statement);
+        if ((table_idx == -1) || (sequence <= database[table_idx].log_sequence))
+            continue;
+
+        if (modify_table(database[table_idx], statement, tc_level) < 0)
+            cerr << file_name << " record " << sequence << " could not be replayed: " << statement << endl;
+        database[table_idx].log_sequence = sequence;
+        replayed_records++;
+    }
+
+    // New records are numbered after every record a snapshot holds, even 
+    // once the log that had them is emptied
+    for (const Table &table : database)
+    {
+        last_sequence = max(last_sequence, table.log_sequence);
+    }
+    if (!write_log.open_log(file_name, valid_bytes, last_sequence))
+    {
+        cerr << "Unable to open " << file_name << ": " << strerror(errno) << endl;
+        return -1;
+    }
+
+    if (replayed_records > 0)
+        cerr << fixed << setprecision(3) << "Replayed " << replayed_records << " records of " << file_name << " in " 
+             << chrono::duration<double>(chrono::steady_clock::now() - start_time).count() << " s" << endl;
+    return replayed_records;
+}
+
+/**
+ * Runs a checkpoint. The tables that changed since their snapshot was written
+ * are written to it again, with their STRING columns encoded again where 
+ * writes added values to the dictionary. The write-ahead log is then emptied,
+ * the snapshots hold everything it had.
+ * 
+ * @param database The database that holds the tables. No other thread can 
+ *                 write to it while the checkpoint runs.
+ * 
+ * @return True if the checkpoint finished, otherwise an error is printed.
+*/
+bool checkpoint(vector<Table> &database)
+{
+    // A record that is not synced yet belongs to a writer that is still 
+    // waiting for it, the sync has to finish first. Once a sync failed the
+    // tables hold writes that were never logged, which must not be saved.
+    if (!write_log.writable() || !write_log.wait_synced(write_log.sequence()))
+    {
+        cout << "Unable to write " << WRITE_LOG_FILE << "!!!" << endl;
+        return false;
+    }
+
+    for (Table &table : database)
+    {
+        if (table.log_sequence == table.saved_sequence)
+            continue;
+
+        // Columns that no query read yet are loaded to be encoded and written
+        Column_Pins pins;
+        column_loader.pin_table(table, pins);
+
+        // The inserted rows are grouped with the others, so the snapshot does
+        // not have to be grouped in a copy
+        if ((table.tc_column_idx != -1) && (table.tail_begin < table.file_rows.size()))
+            cluster_by_tc_level(table);
+        for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+        {
+            // A column is only copied when it could be encoded, or when its
+            // dictionary has to be sorted
+            const Column &column = table.table_data.read(column_idx);
+            bool recoded = false;
+            if ((column.type == STRING) && !column.dictionary_encoded)
+                recoded = encode_strings(table.table_data[column_idx]);
+            else if ((column.type == STRING) && (column.sorted_values < column.dictionary.size()))
+                recoded = sort_dictionary(table.table_data[column_idx]);
+            if (!recoded)
+                continue;
+
+            for (int index_idx = 0; index_idx < table.indexes.size(); index_idx++)
+            {
+                const Index &index = table.indexes.read(index_idx);
+                if ((index.column_idx == column_idx) && (index.type == INDEX_HASH))
+                    build_index(table, column_idx, INDEX_HASH);
+            }
+        }
+
+        if (!write_snapshot(table, table.table_name + ".snap"))
+            return false;
+        table.saved_sequence = table.log_sequence;
+    }
+
+    if (!write_log.truncate())
+    {
+        cout << "Unable to write " << WRITE_LOG_FILE << "!!!" << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Formats a record of the write-ahead log. The checksum covers the rest of 
+ * the record, see checksum_words.
+ * 
+ * @param sequence  The sequence number of the record.
+ * @param tc_level  The TC level of the session that ran the statement.
+ * @param statement The statement, on a single line.
+ * 
+ * @return The record, ending with a newline.
+*/
+string log_record(int64_t sequence, int tc_level, const string &statement)
+{
+    string checked_text = to_string(sequence) + " " + to_string(tc_level) + " " + statement;
+    string padded_text = checked_text;
+    padded_text.resize((padded_text.size() + 7) / 8 * 8, '\0');
+    uint64_t checksum = checksum_words(CHECKSUM_SEED, padded_text.data(), padded_text.size());
+
+    char checksum_text[17];
+    snprintf(checksum_text, sizeof(checksum_text), "%016llx", (unsigned long long)checksum);
+    return to_string(sequence) + " " + to_string(tc_level) + " " + checksum_text + " " + statement + "\n";
+}
+
+/**
+ * Parses a record of the write-ahead log and checks its checksum.
+ * 
+ * @param line      The record, without its newline.
+ * @param sequence  The sequence number of the record.
+ * @param tc_level  The TC level of the session that ran the statement.
+ * @param statement The statement.
+ * 
+ * @return True if the record is complete and its checksum matches.
+*/
+bool parse_log_record(const string &line, int64_t &sequence, int &tc_level, string &statement)
+{
+    size_t sequence_end = line.find(' ');
+    size_t level_end = (sequence_end == string::npos) ? string::npos : line.find(' ', sequence_end + 1);
+    if ((level_end == string::npos) || (line.size() < level_end + 18) || (line[level_end + 17] != ' '))
+        return false;
+
+    char *number_end = NULL;
+    sequence = strtoll(line.c_str(), &number_end, 10);
+    if (number_end != line.c_str() + sequence_end)
+        return false;
+    tc_level = strtol(line.c_str() + sequence_end + 1, &number_end, 10);
+    if (number_end != line.c_str() + level_end)
+        return false;
+
+    statement = line.substr(level_end + 18);
+    return log_record(sequence, tc_level, statement) == line + "\n";
+}
+
+/**
+ * Creates an empty column of the given type.
+ * 
+ * @param column_name The name of the column.
+ * @param type        The type of data that the column will store.
+ * 
+ * @return The new column.
+*/
+Column new_column(string column_name, enum data_type type)
+{
+    Column column;
+    column.column_name = column_name;
+    column.type = type;
+    column.row_count = 0;
+    column.dictionary_encoded = false;
+    column.sorted_values = 0;
+    return column;
+}
+
+/**
+ * Appends a value to the end of a column. Only the field of the data item that
+ * matches the column's type is stored.
+ * 
+ * @param column    The column to append to.
+ * @param data_item The value to append.
+*/
+void append_data(Column &column, const Data &data_item)
+{
+    if (column.row_count % 64 == 0)
+        column.null_bitmap.push_back(0);
+
+    if (data_item.empty)
+        column.null_bitmap[column.row_count / 64] |= (uint64_t)1 << (column.row_count % 64);
+
+    // Empty rows still take a slot in the typed array so that the row indexes
+    // line up across all columns. A value that is not in the dictionary is 
+    // added to it.
+    const string &value = data_item.empty ? string() : data_item.string_data;
+    if (column.type == CHAR)
+        column.char_data.push_back(data_item.empty ? '\0' : data_item.char_data);
+    else if ((column.type == STRING) && column.dictionary_encoded)
+        column.string_codes.push_back(add_dictionary_value(column, value));
+    else if (column.type == STRING)
+        column.string_data.push_back(value);
+    else if (column.type == INT)
+        column.int_data.push_back(data_item.empty ? 0 : data_item.int_data);
+    else // FLOAT
+        column.float_data.push_back(data_item.empty ? 0.0f : data_item.float_data);
+
+    column.row_count++;
+}
+
+/**
+ * Removes rows from a column, the rows after them move up.
+ * 
+ * @param column   The column to remove from.
+ * @param row_idxs The rows to remove, in ascending order.
+*/
+void remove_data(Column &column, const vector<int> &row_idxs)
+{
+    if (row_idxs.empty())
+        return;
+
+    // The bits before the first removed row stay where they are. The bits of
+    // each run of kept rows are moved a word at a time once they line up.
+    vector<uint64_t> &bitmap = column.null_bitmap;
+    int kept_count = row_idxs[0];
+    for (int idx = 0; idx < row_idxs.size(); idx++)
+    {
+        int row_idx = row_idxs[idx] + 1;
+        int run_end = (idx + 1 < row_idxs.size()) ? row_idxs[idx + 1] : column.row_count;
+        while (row_idx < run_end)
+        {
+            int word_idx = row_idx / 64;
+            int offset = row_idx % 64;
+            if ((kept_count % 64 == 0) && (run_end - row_idx >= 64))
+            {
+                bitmap[kept_count / 64] = (offset == 0) ? bitmap[word_idx] : 
+                                          (bitmap[word_idx] >> offset) | (bitmap[word_idx + 1] << (64 - offset));
+                row_idx += 64;
+                kept_count += 64;
+                continue;
+            }
+
+            uint64_t row_bit = (uint64_t)1 << (kept_count % 64);
+            if (is_row_empty(column, row_idx))
+                bitmap[kept_count / 64] |= row_bit;
+            else
+                bitmap[kept_count / 64] &= ~row_bit;
+            row_idx++;
+            kept_count++;
+        }
+    }
+    column.row_count = kept_count;
+    column.null_bitmap.resize((kept_count + 63) / 64);
+
+    if (column.type == CHAR)
+        remove_values(column.char_data, row_idxs);
+    else if ((column.type == STRING) && column.dictionary_encoded)
+        remove_values(column.string_codes, row_idxs);
+    else if (column.type == STRING)
+        remove_values(column.string_data, row_idxs);
+    else if (column.type == INT)
+        remove_values(column.int_data, row_idxs);
+    else // FLOAT
+        remove_values(column.float_data, row_idxs);
+}
+
+/**
+ * Removes entries from an array, the runs of entries between them are moved 
+ * up in one piece.
+ * 
+ * @param values   The array to remove from.
+ * @param row_idxs The entries to remove, in ascending order.
+*/
+template <typename T>
+void remove_values(vector<T> &values, const vector<int> &row_idxs)
+{
+    typename vector<T>::iterator kept_end = values.begin() + row_idxs[0];
+    for (int idx = 0; idx < row_idxs.size(); idx++)
+    {
+        int run_end = (idx + 1 < row_idxs.size()) ? row_idxs[idx + 1] : values.size();
+        kept_end = move(values.begin() + row_idxs[idx] + 1, values.begin() + run_end, kept_end);
+    }
+    values.resize(kept_end - values.begin());
+}
+
+/**
+ * Inserts a value into a column, the rows from row_idx on move down by one.
+ * A STRING value has to be in the dictionary of an encoded column, see 
+ * admit_value.
+ * 
+ * @param column    The column to insert into.
+ * @param row_idx   The row the value is stored in.
+ * @param data_item The value to insert.
+*/
+void insert_data(Column &column, int row_idx, const Data &data_item)
+{
+    if (column.row_count % 64 == 0)
+        column.null_bitmap.push_back(0);
+
+    // Move the bits of the later rows up by one, starting from the last word
+    int first_word = row_idx / 64;
+    for (int word_idx = column.null_bitmap.size() - 1; word_idx > first_word; word_idx--)
+    {
+        column.null_bitmap[word_idx] = (column.null_bitmap[word_idx] << 1) | (column.null_bitmap[word_idx - 1] >> 63);
+    }
+    uint64_t lower_bits = ((uint64_t)1 << (row_idx % 64)) - 1;
+    uint64_t &word = column.null_bitmap[first_word];
+    word = (word & lower_bits) | ((word & ~lower_bits) << 1);
+    if (data_item.empty)
+        word |= (uint64_t)1 << (row_idx % 64);
+
+    const string &value = data_item.empty ? string() : data_item.string_data;
+    if (column.type == CHAR)
+        column.char_data.insert(column.char_data.begin() + row_idx, data_item.empty ? '\0' : data_item.char_data);
+    else if ((column.type == STRING) && column.dictionary_encoded)
+        column.string_codes.insert(column.string_codes.begin() + row_idx, dictionary_code(column, value));
+    else if (column.type == STRING)
+        column.string_data.insert(column.string_data.begin() + row_idx, value);
+    else if (column.type == INT)
+        column.int_data.insert(column.int_data.begin() + row_idx, data_item.empty ? 0 : data_item.int_data);
+    else // FLOAT
+        column.float_data.insert(column.float_data.begin() + row_idx, data_item.empty ? 0.0f : data_item.float_data);
+
+    column.row_count++;
+}
+
+/**
+ * Replaces the value of a row of a column. A STRING value has to be in the 
+ * dictionary of an encoded column, see admit_value.
+ * 
+ * @param column    The column holding the row.
+ * @param row_idx   The row to change.
+ * @param data_item The new value.
+*/
+void set_data(Column &column, int row_idx, const Data &data_item)
+{
+    uint64_t row_bit = (uint64_t)1 << (row_idx % 64);
+    if (data_item.empty)
+        column.null_bitmap[row_idx / 64] |= row_bit;
+    else
+        column.null_bitmap[row_idx / 64] &= ~row_bit;
+
+    const string &value = data_item.empty ? string() : data_item.string_data;
+    if (column.type == CHAR)
+        column.char_data[row_idx] = data_item.empty ? '\0' : data_item.char_data;
+    else if ((column.type == STRING) && column.dictionary_encoded)
+        column.string_codes[row_idx] = dictionary_code(column, value);
+    else if (column.type == STRING)
+        column.string_data[row_idx] = value;
+    else if (column.type == INT)
+        column.int_data[row_idx] = data_item.empty ? 0 : data_item.int_data;
+    else // FLOAT
+        column.float_data[row_idx] = data_item.empty ? 0.0f : data_item.float_data;
+}
+
+/**
+ * Checks the null bitmap to see if a row has a value.
+ * 
+ * @param column  The column to check.
+ * @param row_idx The row to check.
+ * 
+ * @return True if the row has no value.
+*/
+bool is_row_empty(const Column &column, int row_idx)
+{
+    return (column.null_bitmap[row_idx / 64] >> (row_idx % 64)) & 1;
+}
+
+/**
+ * Gets the value of a row of a STRING column, whether or not it is encoded.
+ * 
+ * @param column  The column holding the value.
+ * @param row_idx The row of the value.
+ * 
+ * @return The value, empty rows have an empty string.
+*/
+const string &string_value(const Column &column, int row_idx)
+{
+    if (column.dictionary_encoded)
+        return column.dictionary[column.string_codes[row_idx]];
+    return column.string_data[row_idx];
+}
+
+/**
+ * Dictionary encodes a STRING column if it repeats its values, on average 
+ * each value has to be used by at least 4 rows. Empty rows count as the 
+ * empty string.
+ * 
+ * @param column The column to encode.
+ * 
+ * @return True if the column was encoded.
+*/
+bool encode_strings(Column &column)
+{
+    if ((column.type != STRING) || column.dictionary_encoded)
+        return false;
+
+    // Number the values in the order they are first seen, and give up as 
+    // soon as there are too many of them
+    int max_values = column.row_count / 4;
+    unordered_map<string, int32_t> value_ids;
+    vector<int32_t> row_ids(column.row_count);
+    for (int row_idx = 0; row_idx < column.row_count; row_idx++)
+    {
+        row_ids[row_idx] = value_ids.insert(make_pair(column.string_data[row_idx], (int32_t)value_ids.size())).first->second;
+        if (value_ids.size() > max_values)
+            return false;
+    }
+
+    // Sort the dictionary so that codes compare like the values do
+    vector<string> dictionary;
+    dictionary.reserve(value_ids.size());
+    for (const pair<const string, int32_t> &value_id : value_ids)
+    {
+        dictionary.push_back(value_id.first);
+    }
+    sort(dictionary.begin(), dictionary.end());
+
+    vector<int32_t> id_codes(dictionary.size());
+    for (int32_t code = 0; code < dictionary.size(); code++)
+    {
+        id_codes[value_ids[dictionary[code]]] = code;
+    }
+
+    column.string_codes.resize(column.row_count);
+    for (int row_idx = 0; row_idx < column.row_count; row_idx++)
+    {
+        column.string_codes[row_idx] = id_codes[row_ids[row_idx]];
+    }
+
+    column.dictionary.swap(dictionary);
+    column.dictionary_encoded = true;
+    column.sorted_values = column.dictionary.size();
+    column.added_codes.clear();
+    vector<string>().swap(column.string_data);
+    return true;
+}
+
+/**
+ * Turns a dictionary encoded column back into one that stores each value.
+ * 
+ * @param column The column to decode.
+*/
+void decode_strings(Column &column)
+{
+    if (!column.dictionary_encoded)
+        return;
+
+    column.string_data.resize(column.row_count);
+    for (int row_idx = 0; row_idx < column.row_count; row_idx++)
+    {
+        column.string_data[row_idx] = column.dictionary[column.string_codes[row_idx]];
+    }
+
+    column.dictionary_encoded = false;
+    vector<string>().swap(column.dictionary);
+    column.sorted_values = 0;
+    unordered_map<string, int32_t>().swap(column.added_codes);
+    vector<int32_t>().swap(column.string_codes);
+}
+
+/**
+ * Finds the code of a value in the dictionary of an encoded column.
+ * 
+ * @param column The encoded column.
+ * @param value  The value to look for.
+ * 
+ * @return The code of the value, -1 if it is not in the dictionary.
+*/
+int32_t dictionary_code(const Column &column, const string &value)
+{
+    vector<string>::const_iterator sorted_end = column.dictionary.begin() + column.sorted_values;
+    vector<string>::const_iterator lower = lower_bound(column.dictionary.begin(), sorted_end, value);
+    if ((lower != sorted_end) && (*lower == value))
+        return lower - column.dictionary.begin();
+
+    unordered_map<string, int32_t>::const_iterator added = column.added_codes.find(value);
+    return (added == column.added_codes.end()) ? -1 : added->second;
+}
+
+/**
+ * Gets the code of a value in the dictionary of an encoded column. A value 
+ * that is not in the dictionary yet is added at its end, so the codes of the
+ * rows stay the same but the dictionary is no longer sorted.
+ * 
+ * @param column The encoded column.
+ * @param value  The value.
+ * 
+ * @return The code of the value.
+*/
+int32_t add_dictionary_value(Column &column, const string &value)
+{
+    int32_t code = dictionary_code(column, value);
+    if (code != -1)
+        return code;
+
+    code = column.dictionary.size();
+    column.dictionary.push_back(value);
+    column.added_codes.insert(make_pair(value, code));
+    return code;
+}
+
+/**
+ * Encodes a column again once writes added values to its dictionary, so the
+ * dictionary is sorted. A column that no longer repeats its values enough is
+ * left decoded, see encode_strings.
+ * 
+ * @param column The column.
+ * 
+ * @return True if the codes of the rows changed.
+*/
+bool sort_dictionary(Column &column)
+{
+    if (!column.dictionary_encoded || (column.sorted_values == column.dictionary.size()))
+        return false;
+
+    decode_strings(column);
+    encode_strings(column);
+    return true;
+}
+
+/**
+ * Turns a comparison against a string into the same comparison against the 
+ * codes of a dictionary encoded column. Since the dictionary is sorted every
+ * inequality becomes a single comparison on the codes. The inequalities other
+ * than = and <> need the whole dictionary to be sorted, see filter_dictionary.
+ * 
+ * @param column The encoded column.
+ * @param value  The string to compare against.
+ * @param op     The inequality, replaced with the one to use on the codes.
+ * @param code   The code to compare against.
+ * 
+ * @return False if no row can pass the comparison.
+*/
+bool encode_literal(const Column &column, const string &value, enum compare_op &op, int32_t &code)
+{
+    if ((op == OP_EQ) || (op == OP_NE))
+    {
+        // Every value is different from one that is not in the dictionary
+        code = dictionary_code(column, value);
+        bool found = (code != -1);
+        if (!found && (op == OP_NE))
+            op = OP_GE;
+        code = found ? code : 0;
+        return found || (op != OP_EQ);
+    }
+
+    vector<string>::const_iterator lower = lower_bound(column.dictionary.begin(), column.dictionary.end(), value);
+    bool found = (lower != column.dictionary.end()) && (*lower == value);
+    int32_t lower_code = lower - column.dictionary.begin();
+    int32_t upper_code = found ? lower_code + 1 : lower_code;
+
+    if (op == OP_LT)
+        code = lower_code;
+    else if (op == OP_LE)
+    {
+        op = OP_LT;
+        code = upper_code;
+    }
+    else if (op == OP_GT)
+    {
+        op = OP_GE;
+        code = upper_code;
+    }
+    else // OP_GE
+        code = lower_code;
+    return true;
+}
+
+/**
+ * Sets the number of rows in an empty column. The new rows have a zero value 
+ * and are not marked as empty.
+ * 
+ * @param column    The column to resize.
+ * @param row_count The number of rows.
+*/
+void resize_column(Column &column, int row_count)
+{
+    column.row_count = row_count;
+    column.null_bitmap.assign((row_count + 63) / 64, 0);
+
+    if (column.type == CHAR)
+        column.char_data.assign(row_count, '\0');
+    else if (column.type == STRING)
+        column.string_data.assign(row_count, string());
+    else if (column.type == INT)
+        column.int_data.assign(row_count, 0);
+    else // FLOAT
+        column.float_data.assign(row_count, 0.0f);
+}
+
+/**
+ * Stores one field of a data file in a row of a column. Surrounding 
+ * whitespace is removed, a field that is a single space has no value.
+ * 
+ * @param column      The column to store the value in.
+ * @param row_idx     The row to store the value in.
+ * @param field_begin The first character of the field.
+ * @param field_end   One past the last character of the field.
+ * 
+ * @return False if the field is not a number of the column's type, the row 
+ *         is then left without a value.
+*/
+bool store_field(Column &column, int row_idx, const char *field_begin, const char *field_end)
+{
+    bool empty = (field_end - field_begin == 1) && (*field_begin == ' ');
+
+    while ((field_begin < field_end) && (*field_begin == ' ' || *field_begin == '\t'))
+    {
+        field_begin++;
+    }
+    while ((field_end > field_begin) && (field_end[-1] == ' ' || field_end[-1] == '\t'))
+    {
+        field_end--;
+    }
+
+    bool parsed = true;
+    if (empty)
+        ;
+    else if (column.type == CHAR)
+        column.char_data[row_idx] = (field_begin < field_end) ? *field_begin : '\0';
+    else if (column.type == STRING)
+        column.string_data[row_idx].assign(field_begin, field_end);
+    else if (column.type == INT)
+        parsed = parse_int(field_begin, field_end, column.int_data[row_idx]);
+    else // FLOAT
+        parsed = parse_float(field_begin, field_end, column.float_data[row_idx]);
+
+    if (empty || !parsed)
+        column.null_bitmap[row_idx / 64] |= (uint64_t)1 << (row_idx % 64);
+
+    // A field with nothing in it is a missing value, not a bad one
+    return parsed || (field_begin == field_end);
+}
+
+/**
+ * Finds the start of every line that starts inside one chunk of a data file.
+ * Blank lines are left out.
+ * 
+ * @param file_data   The contents of the file.
+ * @param file_size   The size of the file.
+ * @param chunk_begin The first byte of the chunk.
+ * @param chunk_end   One past the last byte of the chunk.
+ * 
+ * @return The offsets of the lines, in ascending order.
+*/
+vector<size_t> find_line_starts(const char *file_data, size_t file_size, size_t chunk_begin, size_t chunk_end)
+{
+    vector<size_t> line_starts;
+
+    // A line starts at the beginning of the file or right after a newline
+    size_t line_start = chunk_begin;
+    if ((chunk_begin != 0) && (file_data[chunk_begin - 1] != '\n'))
+    {
+        const char *newline = (const char *)memchr(file_data + chunk_begin, '\n', chunk_end - chunk_begin);
+        line_start = (newline == NULL) ? chunk_end : newline - file_data + 1;
+    }
+
+    while (line_start < chunk_end)
+    {
+        const char *newline = (const char *)memchr(file_data + line_start, '\n', file_size - line_start);
+        size_t line_end = (newline == NULL) ? file_size : newline - file_data;
+
+        size_t line_length = line_end - line_start;
+        if ((line_length > 1) || ((line_length == 1) && (file_data[line_start] != '\r')))
+            line_starts.push_back(line_start);
+
+        line_start = line_end + 1;
+    }
+
+    return line_starts;
+}
+
+/**
+ * Parses one field of every line of a data file into a column, in parallel.
+ * The column's values are replaced.
+ * 
+ * @param column      The column, with its row count set.
+ * @param field_idx   The field of each line that holds the column.
+ * @param file_data   The contents of the file.
+ * @param file_size   The size of the file.
+ * @param line_starts The offset of every line in the file.
+ * @param file_rows   For each row of the column, the line it is parsed from.
+ * 
+ * @return The number of fields that were not a number of the column's type,
+ *         see store_field. Their rows have no value.
+*/
+int parse_column(Column &column, int field_idx, const char *file_data, size_t file_size, 
+                 const vector<size_t> &line_starts, const vector<int> &file_rows)
+{
+    int row_count = column.row_count;
+    resize_column(column, row_count);
+
+    // Use one thread per core, but give each thread at least a morsel of 
+    // rows. Each thread gets a multiple of 64 rows so that no two threads 
+    // write to the same word of the null bitmap.
+    int thread_count = max(1u, thread::hardware_concurrency());
+    thread_count = max(1, min(thread_count, row_count / MORSEL_ROWS));
+    int rows_per_thread = ((row_count + thread_count - 1) / thread_count + 63) / 64 * 64;
+
+    vector<thread> threads;
+    vector<int> rejected_counts(thread_count, 0);
+    for (int first_row = 0; first_row < row_count; first_row += rows_per_thread)
+    {
+        int last_row = min(row_count, first_row + rows_per_thread);
+        threads.push_back(thread(parse_field, ref(column), field_idx, file_data, file_size, cref(line_starts), 
+                                 cref(file_rows), first_row, last_row, ref(rejected_counts[threads.size()])));
+    }
+    for (int thread_idx = 0; thread_idx < threads.size(); thread_idx++)
+    {
+        threads[thread_idx].join();
+    }
+
+    int rejected_count = 0;
+    for (int thread_rejected : rejected_counts)
+    {
+        rejected_count += thread_rejected;
+    }
+    return rejected_count;
+}
+
+/**
+ * Parses one field of a range of lines of a data file into the matching rows
+ * of a column. A line that ends before the field leaves its row empty.
+ * 
+ * @param column      The column to store the values in, it must already hold
+ *                    enough rows.
+ * @param field_idx   The field of each line that holds the column.
+ * @param file_data   The contents of the file.
+ * @param file_size   The size of the file.
+ * @param line_starts The offset of every line in the file.
+ * @param file_rows   For each row of the column, the line it is parsed from.
+ * @param first_row   The first row to parse.
+ * @param last_row    One past the last row to parse.
+ * @param rejected_count Set to the number of fields that were not a number 
+ *                    of the column's type.
+*/
+void parse_field(Column &column, int field_idx, const char *file_data, size_t file_size, 
+                 const vector<size_t> &line_starts, const vector<int> &file_rows, int first_row, int last_row,
+                 int &rejected_count)
+{
+    const char *file_end = file_data + file_size;
+
+    for (int row_idx = first_row; row_idx < last_row; row_idx++)
+    {
+        const char *cursor = file_data + line_starts[file_rows[row_idx]];
+        const char *line_end = (const char *)memchr(cursor, '\n', file_end - cursor);
+        if (line_end == NULL)
+            line_end = file_end;
+        if ((line_end > cursor) && (line_end[-1] == '\r'))
+            line_end--;
+
+        // Skip the fields before the column's
+        bool line_done = false;
+        for (int skipped_idx = 0; !line_done && (skipped_idx < field_idx); skipped_idx++)
+        {
+            const char *comma = (const char *)memchr(cursor, ',', line_end - cursor);
+            if (comma == NULL)
+                line_done = true;
+            else
+                cursor = comma + 1;
+        }
+        if (line_done)
+        {
+            column.null_bitmap[row_idx / 64] |= (uint64_t)1 << (row_idx % 64);
+            continue;
+        }
+
+        const char *field_end = (const char *)memchr(cursor, ',', line_end - cursor);
+        if (!store_field(column, row_idx, cursor, (field_end == NULL) ? line_end : field_end))
+            rejected_count++;
+    }
+}
+
+/**
+ * Reports the fields of a data file that were left without a value because 
+ * they are not a number of their column's type. The report goes to stderr 
+ * so that query output stays clean.
+ * 
+ * @param table          The table the data file belongs to.
+ * @param column         The column the fields were parsed into.
+ * @param rejected_count The number of fields, nothing is reported if 0.
+*/
+void report_rejected_fields(const Table &table, const Column &column, int rejected_count)
+{
+    if (rejected_count > 0)
+        cerr << table.table_name << ".csv has " << rejected_count << " values of " << column.column_name 
+             << " that are not valid, they are left empty" << endl;
+}
+
+/**
+ * Adds up the heap memory used by a column, including the characters of 
+ * strings that are too long to be stored inside the string object.
+ * 
+ * @param column The column to measure.
+ * 
+ * @return The number of bytes.
+*/
+size_t column_bytes(const Column &column)
+{
+    size_t bytes = column.char_data.capacity() + column.int_data.capacity() * sizeof(int32_t) +
+                   column.float_data.capacity() * sizeof(float) + column.null_bitmap.capacity() * sizeof(uint64_t) +
+                   column.bigint_data.capacity() * sizeof(int64_t) + column.double_data.capacity() * sizeof(double) +
+                   column.string_codes.capacity() * sizeof(int32_t) + 
+                   (column.string_data.capacity() + column.dictionary.capacity()) * sizeof(string);
+
+    for (const vector<string> *strings : { &column.string_data, &column.dictionary })
+    {
+        for (const string &value : *strings)
+        {
+            // Short strings are stored inside the string object
+            if (value.capacity() > 15)
+                bytes += value.capacity() + 1;
+        }
+    }
+    return bytes;
+}
+
+/**
+ * Frees the values of a column, keeping its name, type and row count.
+ * 
+ * @param column The column.
+*/
+void unload_column(Column &column)
+{
+    vector<char>().swap(column.char_data);
+    vector<string>().swap(column.string_data);
+    vector<int32_t>().swap(column.int_data);
+    vector<float>().swap(column.float_data);
+    vector<uint64_t>().swap(column.null_bitmap);
+    vector<string>().swap(column.dictionary);
+    column.sorted_values = 0;
+    unordered_map<string, int32_t>().swap(column.added_codes);
+    vector<int32_t>().swap(column.string_codes);
+    column.dictionary_encoded = false;
+}
+
+/**
+ * Loads every column of a table whose rows are about to change, and makes 
+ * the columns that were loaded on first use the table's own, since they will
+ * no longer match their source.
+ * 
+ * @param table The table.
+*/
+void materialize_columns(Table &table)
+{
+    Column_Pins pins;
+    column_loader.pin_table(table, pins);
+
+    // A column shared with another version is copied first, the copy has no
+    // source and the other version keeps its column as it is
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        if (table.table_data.read(column_idx).source.get() != NULL)
+            table.table_data[column_idx].source.reset();
+    }
+}
+
+/**
+ * Builds a new column out of the given rows of a column, in the order that
+ * they are listed.
+ * 
+ * @param column   The column to copy the rows from.
+ * @param row_idxs The rows to copy.
+ * 
+ * @return A column holding only the listed rows.
+*/
+Column gather_rows(const Column &column, const vector<int> &row_idxs)
+{
+    Column result = new_column(column.column_name, column.type);
+    result.row_count = row_idxs.size();
+    result.null_bitmap.assign((result.row_count + 63) / 64, 0);
+
+    if (column.type == CHAR)
+        result.char_data.reserve(row_idxs.size());
+    else if ((column.type == STRING) && column.dictionary_encoded)
+    {
+        result.dictionary_encoded = true;
+        result.dictionary = column.dictionary;
+        result.sorted_values = column.sorted_values;
+        result.added_codes = column.added_codes;
+        result.string_codes.reserve(row_idxs.size());
+    }
+    else if (column.type == STRING)
+        result.string_data.reserve(row_idxs.size());
+    else if (column.type == INT)
+        result.int_data.reserve(row_idxs.size());
+    else // FLOAT
+        result.float_data.reserve(row_idxs.size());
+
+    for (int idx = 0; idx < row_idxs.size(); idx++)
+    {
+        int row_idx = row_idxs[idx];
+
+        if (column.type == CHAR)
+            result.char_data.push_back(column.char_data[row_idx]);
+        else if ((column.type == STRING) && column.dictionary_encoded)
+            result.string_codes.push_back(column.string_codes[row_idx]);
+        else if (column.type == STRING)
+            result.string_data.push_back(column.string_data[row_idx]);
+        else if (column.type == INT)
+            result.int_data.push_back(column.int_data[row_idx]);
+        else // FLOAT
+            result.float_data.push_back(column.float_data[row_idx]);
+
+        if (is_row_empty(column, row_idx))
+            result.null_bitmap[idx / 64] |= (uint64_t)1 << (idx % 64);
+    }
+
+    return result;
+}
+
+/**
+ * Reorders the rows of a table so they are grouped by TC level in ascending 
+ * order, keeping the file order inside each level. Rows without a TC level 
+ * are put last and are never visible. The TC level boundaries and the file 
+ * row of each row are recorded in the table, and its indexes are rebuilt.
+ * Rows that were inserted since the last time are grouped with the others.
+ * 
+ * @param table The table to reorder. Rows that were just loaded are in file
+ *              order, otherwise the table's file rows give the order. The 
+ *              TC column has to be in memory.
+*/
+void cluster_by_tc_level(Table &table)
+{
+    int row_count = table.table_data.empty() ? 0 : table.table_data[0].row_count;
+
+    table.tc_column_idx = -1;
+    table.tc_levels.clear();
+    table.tc_level_ends.clear();
+    table.tail_begin = row_count;
+    if (table.file_rows.size() != row_count)
+    {
+        table.file_rows.clear();
+        for (int row_idx = 0; row_idx < row_count; row_idx++)
+        {
+            table.file_rows.push_back(row_idx);
+        }
+        table.next_file_row = row_count;
+    }
+
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        const Column &column = table.table_data.read(column_idx);
+        if ((column.column_name == "TC") && (column.type == INT))
+            table.tc_column_idx = column_idx;
+    }
+    if (table.tc_column_idx == -1)
+        return;
+
+    const Column &tc_column = table.table_data.read(table.tc_column_idx);
+    const vector<int> &file_rows = table.file_rows;
+    vector<int> permutation;
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        permutation.push_back(row_idx);
+    }
+    sort(permutation.begin(), permutation.end(), [&tc_column, &file_rows](int row_idx1, int row_idx2)
+    {
+        bool empty1 = is_row_empty(tc_column, row_idx1);
+        bool empty2 = is_row_empty(tc_column, row_idx2);
+        if (empty1 != empty2)
+            return !empty1;
+        if (!empty1 && (tc_column.int_data[row_idx1] != tc_column.int_data[row_idx2]))
+            return tc_column.int_data[row_idx1] < tc_column.int_data[row_idx2];
+        return file_rows[row_idx1] < file_rows[row_idx2];
+    });
+
+    // Columns that are still in the data file are not moved, their rows are
+    // read in the new order through the file rows once they are loaded
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        if (table.table_data.read(column_idx).source.get() == NULL)
+            table.table_data.replace(column_idx, gather_rows(table.table_data.read(column_idx), permutation));
+    }
+    vector<int> sorted_file_rows;
+    for (int row_idx : permutation)
+    {
+        sorted_file_rows.push_back(file_rows[row_idx]);
+    }
+    table.file_rows.swap(sorted_file_rows);
+
+    // Record where each level ends
+    const Column &sorted_tc_column = table.table_data.read(table.tc_column_idx);
+    for (int row_idx = 0; (row_idx < row_count) && !is_row_empty(sorted_tc_column, row_idx); row_idx++)
+    {
+        int level = sorted_tc_column.int_data[row_idx];
+        if (table.tc_levels.empty() || (table.tc_levels.back() != level))
+        {
+            table.tc_levels.push_back(level);
+            table.tc_level_ends.push_back(row_idx);
+        }
+        table.tc_level_ends.back() = row_idx + 1;
+    }
+
+    // The rows moved, so the indexes are built again
+    for (int index_idx = 0; index_idx < table.indexes.size(); index_idx++)
+    {
+        build_index(table, table.indexes.read(index_idx).column_idx, table.indexes.read(index_idx).type);
+    }
+}
+
+/**
+ * Checks that every row of a table is inside the range recorded for its TC
+ * level, so no query can be given a row above the users level.
+ * 
+ * @param table The table to check.
+ * 
+ * @return True if the rows are grouped correctly.
+*/
+bool check_tc_clusters(const Table &table)
+{
+    if (table.tc_column_idx == -1)
+        return true;
+
+    Column_Pins pins;
+    column_loader.pin(table, vector<int>(1, table.tc_column_idx), pins);
+    const Column &tc_column = table.table_data[table.tc_column_idx];
+    int row_idx = 0;
+    for (int level_idx = 0; level_idx < table.tc_levels.size(); level_idx++)
+    {
+        if ((level_idx > 0) && (table.tc_levels[level_idx] <= table.tc_levels[level_idx - 1]))
+            return false;
+
+        for (; row_idx < table.tc_level_ends[level_idx]; row_idx++)
+        {
+            if (is_row_empty(tc_column, row_idx) || (tc_column.int_data[row_idx] != table.tc_levels[level_idx]))
+                return false;
+        }
+    }
+
+    // Only rows without a TC level can come between the last level and the
+    // inserted rows, which always have one
+    for (; row_idx < tc_column.row_count; row_idx++)
+    {
+        if (is_row_empty(tc_column, row_idx) != (row_idx < table.tail_begin))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Finds how many of the grouped rows of a table a user can see. These are 
+ * always the first rows of the table, the inserted rows the user can see are
+ * found by visible_tail_rows.
+ * 
+ * @param table    The table to check.
+ * @param tc_level The users security level.
+ * 
+ * @return The number of grouped rows at or below the users TC level. Tables 
+ *         without a TC column are fully visible.
+*/
+int visible_row_count(const Table &table, int tc_level)
+{
+    if (table.tc_column_idx == -1)
+        return table.table_data.empty() ? 0 : table.table_data[0].row_count;
+
+    vector<int>::const_iterator level = upper_bound(table.tc_levels.begin(), table.tc_levels.end(), tc_level);
+    if (level == table.tc_levels.begin())
+        return 0;
+    return table.tc_level_ends[level - table.tc_levels.begin() - 1];
+}
+
+/**
+ * Finds the rows inserted since a table was grouped by TC level that a user 
+ * can see.
+ * 
+ * @param table    The table to check.
+ * @param tc_level The users security level.
+ * 
+ * @return The rows at or below the users TC level, in ascending order. Tables
+ *         without a TC column have none, visible_row_count counts every row.
+*/
+vector<int> visible_tail_rows(const Table &table, int tc_level)
+{
+    vector<int> tail_rows;
+    int row_count = table.table_data.empty() ? 0 : table.table_data[0].row_count;
+    for (int row_idx = table.tail_begin; row_idx < row_count; row_idx++)
+    {
+        if (tail_row_visible(table, row_idx, tc_level))
+            tail_rows.push_back(row_idx);
+    }
+    return tail_rows;
+}
+
+/**
+ * Checks if a user can see a row that was inserted since its table was 
+ * grouped by TC level.
+ * 
+ * @param table    The table that holds the row.
+ * @param row_idx  The row.
+ * @param tc_level The users security level.
+ * 
+ * @return False if the row is one of the grouped rows, or its TC level is 
+ *         above the users level.
+*/
+bool tail_row_visible(const Table &table, int row_idx, int tc_level)
+{
+    if ((table.tc_column_idx == -1) || (row_idx < table.tail_begin))
+        return false;
+
+    const Column &tc_column = table.table_data[table.tc_column_idx];
+    return !is_row_empty(tc_column, row_idx) && (tc_column.int_data[row_idx] <= tc_level);
+}
+
+/**
+ * Gets a column of a table ready to store a value. A value that is not in the
+ * dictionary of an encoded column is added to it with the next code, the 
+ * codes of the rows stay the same. Checkpoints sort the dictionary again.
+ * 
+ * @param table      The table that holds the column.
+ * @param column_idx The column the value will be stored in.
+ * @param data_item  The value.
+*/
+void admit_value(Table &table, int column_idx, const Data &data_item)
+{
+    const Column &column = table.table_data.read(column_idx);
+    const string &value = data_item.empty ? string() : data_item.string_data;
+    if ((column.type == STRING) && column.dictionary_encoded && (dictionary_code(column, value) == -1))
+        add_dictionary_value(table.table_data[column_idx], value);
+}
+
+/**
+ * Inserts a row at the end of a table, so no other row moves. The row gets 
+ * the next file row, so the inserted rows stay in file order. Its TC level 
+ * is checked by the queries that read it until the table is grouped again,
+ * see cluster_by_tc_level. The indexes are updated. Every value has to be 
+ * admitted first, see admit_value.
+ * 
+ * @param table The table to insert into, its columns have to be in memory.
+ * @param row   The value of each column, the TC level can not be empty.
+ * 
+ * @return The row the values were stored in.
+*/
+int insert_row(Table &table, const vector<Data> &row)
+{
+    int row_idx = table.file_rows.size();
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        insert_data(table.table_data[column_idx], row_idx, row[column_idx]);
+    }
+    table.file_rows.push_back(table.next_file_row++);
+
+    for (Index &index : table.indexes)
+    {
+        index_add_row(index, table.table_data[index.column_idx], row_idx);
+    }
+    return row_idx;
+}
+
+/**
+ * Removes rows from a table. The TC level boundaries, the start of the 
+ * inserted rows and the indexes are updated, levels that no longer have rows
+ * are dropped.
+ * 
+ * @param table    The table to remove from.
+ * @param row_idxs The rows to remove, in ascending order.
+*/
+void remove_rows(Table &table, const vector<int> &row_idxs)
+{
+    int row_count = table.file_rows.size();
+    vector<int> new_rows(row_count);
+    int kept_count = 0;
+    vector<int>::const_iterator removed = row_idxs.begin();
+    for (int row_idx = 0; row_idx < row_count; row_idx++)
+    {
+        if ((removed != row_idxs.end()) && (*removed == row_idx))
+        {
+            new_rows[row_idx] = -1;
+            removed++;
+        }
+        else
+            new_rows[row_idx] = kept_count++;
+    }
+
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        remove_data(table.table_data[column_idx], row_idxs);
+    }
+    remove_values(table.file_rows, row_idxs);
+
+    // Each level ends earlier by the number of rows removed before its end
+    int level_count = 0;
+    for (int level_idx = 0; level_idx < table.tc_levels.size(); level_idx++)
+    {
+        int removed_before = lower_bound(row_idxs.begin(), row_idxs.end(), table.tc_level_ends[level_idx]) - 
+                             row_idxs.begin();
+        int level_end = table.tc_level_ends[level_idx] - removed_before;
+        if (level_end == ((level_count > 0) ? table.tc_level_ends[level_count - 1] : 0))
+            continue;
+
+        table.tc_levels[level_count] = table.tc_levels[level_idx];
+        table.tc_level_ends[level_count] = level_end;
+        level_count++;
+    }
+    table.tc_levels.resize(level_count);
+    table.tc_level_ends.resize(level_count);
+    table.tail_begin -= lower_bound(row_idxs.begin(), row_idxs.end(), table.tail_begin) - row_idxs.begin();
+
+    for (Index &index : table.indexes)
+    {
+        remap_index(index, [&new_rows](int old_row) { return new_rows[old_row]; });
+    }
+}
+
+/**
+ * Brings the indexes on a column up to date after the values of some of its
+ * rows changed. When many rows changed the indexes are rebuilt instead.
+ * 
+ * @param table      The table that holds the column.
+ * @param column_idx The column that changed.
+ * @param row_idxs   The rows that changed, in ascending order.
+*/
+void reindex_rows(Table &table, int column_idx, const vector<int> &row_idxs)
+{
+    const Column &column = table.table_data.read(column_idx);
+    for (int index_idx = 0; index_idx < table.indexes.size(); index_idx++)
+    {
+        if (table.indexes.read(index_idx).column_idx != column_idx)
+            continue;
+
+        // Each changed row costs a pass over the index, a rebuild is cheaper
+        // once a few percent of the rows changed
+        if (row_idxs.size() * 32 > column.row_count)
+        {
+            build_index(table, column_idx, table.indexes.read(index_idx).type);
+            continue;
+        }
+
+        Index &index = table.indexes[index_idx];
+        remap_index(index, [&row_idxs](int old_row) 
+        { 
+            return binary_search(row_idxs.begin(), row_idxs.end(), old_row) ? -1 : old_row; 
+        });
+        for (int row_idx : row_idxs)
+        {
+            index_add_row(index, column, row_idx);
+        }
+    }
+}
+
+/**
+ * Builds a secondary index on a column of a table. An existing index of the
+ * same type on the column is replaced.
+ * 
+ * @param table      The table that holds the column.
+ * @param column_idx The column to index.
+ * @param type       The kind of index to build.
+*/
+void build_index(Table &table, int column_idx, enum index_type type)
+{
+    Column_Pins pins;
+    column_loader.pin(table, vector<int>(1, column_idx), pins);
+    const Column &column = table.table_data.read(column_idx);
+    Index index;
+    index.column_idx = column_idx;
+    index.type = type;
+
+    // Give each distinct value a group, then lay the rows out group by group
+    vector<int> row_groups(column.row_count, -1);
+    for (int row_idx = 0; row_idx < column.row_count; row_idx++)
+    {
+        if (is_row_empty(column, row_idx))
+            continue;
+
+        if (type == INDEX_ORDERED)
+            index.sorted_rows.push_back(row_idx);
+        else if ((column.type == STRING) && column.dictionary_encoded)
+            row_groups[row_idx] = index.value_groups.insert(column.string_codes[row_idx], index.value_groups.size());
+        else if (column.type == STRING)
+            row_groups[row_idx] = index.string_groups.insert(column.string_data[row_idx], index.string_groups.size());
+        else
+        {
+            int64_t key = index_key(column.type, 
+                                    column.type == CHAR ? column.char_data[row_idx] : 0,
+                                    column.type == INT ? column.int_data[row_idx] : 0,
+                                    column.type == FLOAT ? column.float_data[row_idx] : 0.0f);
+            row_groups[row_idx] = index.value_groups.insert(key, index.value_groups.size());
+        }
+    }
+
+    if (type == INDEX_HASH)
+    {
+        int group_count = index.value_groups.size() + index.string_groups.size();
+        index.group_begins.assign(group_count + 1, 0);
+        for (int group : row_groups)
+        {
+            if (group != -1)
+                index.group_begins[group + 1]++;
+        }
+        for (int group = 0; group < group_count; group++)
+        {
+            index.group_begins[group + 1] += index.group_begins[group];
+        }
+
+        vector<int> next_slot(index.group_begins.begin(), index.group_begins.end() - 1);
+        index.grouped_rows.resize(index.group_begins.back());
+        for (int row_idx = 0; row_idx < column.row_count; row_idx++)
+        {
+            if (row_groups[row_idx] != -1)
+                index.grouped_rows[next_slot[row_groups[row_idx]]++] = row_idx;
+        }
+    }
+    else // INDEX_ORDERED
+    {
+        // The rows start out in ascending order, so a stable sort leaves rows
+        // with the same value in ascending order too
+        Sort_Key key = { .column = &column, .ascending = true };
+        vector<Sort_Key> sort_keys(1, key);
+        stable_sort(index.sorted_rows.begin(), index.sorted_rows.end(), Row_Comparator(sort_keys));
+    }
+
+    for (int index_idx = 0; index_idx < table.indexes.size(); index_idx++)
+    {
+        if ((table.indexes.read(index_idx).column_idx == column_idx) && (table.indexes.read(index_idx).type == type))
+        {
+            table.indexes.replace(index_idx, index);
+            return;
+        }
+    }
+    table.indexes.push_back(index);
+}
+
+/**
+ * Turns a CHAR, INT or FLOAT value into the key used by HASH indexes. Only the
+ * argument that matches the type is used.
+ * 
+ * @return The key of the value.
+*/
+int64_t index_key(enum data_type type, char char_data, int int_data, float float_data)
+{
+    if (type == CHAR)
+        return (unsigned char)char_data;
+    else if (type == INT)
+        return int_data;
+
+    // FLOAT values are keyed by their bits, with -0 and 0 sharing a key since
+    // they are equal
+    if (float_data == 0.0f)
+        float_data = 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &float_data, sizeof(bits));
+    return bits;
+}
+
+/**
+ * Finds the rows that pass a condition using an index on the condition's
+ * column. Only rows the user can see are returned.
+ * 
+ * @param index     The index to use.
+ * @param table     The table that holds the index.
+ * @param condition The condition to answer, it can not be <>.
+ * @param tc_level  The users security level.
+ * 
+ * @return The rows that pass the condition, in ascending order.
+*/
+vector<int> index_lookup(const Index &index, const Table &table, const Predicate &condition, int tc_level)
+{
+    int visible_rows = visible_row_count(table, tc_level);
+    const Column &column = table.table_data[index.column_idx];
+    const Data &literal = condition.literal;
+    vector<int> matching_rows;
+
+    if (index.type == INDEX_HASH)
+    {
+        int group = -1;
+        enum compare_op op = OP_EQ;
+        int32_t code;
+        if ((column.type == STRING) && column.dictionary_encoded)
+        {
+            if (encode_literal(column, literal.string_data, op, code))
+                group = index.value_groups.find(code);
+        }
+        else if (column.type == STRING)
+            group = index.string_groups.find(literal.string_data);
+        else
+        {
+            int64_t key = index_key(column.type, literal.char_data, literal.int_data, literal.float_data);
+            group = index.value_groups.find(key);
+        }
+
+        // The rows are in ascending order, so the visible grouped rows come 
+        // first and the inserted rows last
+        if (group != -1)
+        {
+            vector<int>::const_iterator rows_begin = index.grouped_rows.begin() + index.group_begins[group];
+            vector<int>::const_iterator rows_end = index.grouped_rows.begin() + index.group_begins[group + 1];
+            matching_rows.assign(rows_begin, lower_bound(rows_begin, rows_end, visible_rows));
+            for (vector<int>::const_iterator row = lower_bound(rows_begin, rows_end, table.tail_begin); 
+                 row < rows_end; row++)
+            {
+                if (tail_row_visible(table, *row, tc_level))
+                    matching_rows.push_back(*row);
+            }
+        }
+        return matching_rows;
+    }
+
+    // The ORDERED index is sorted by value, so the matching rows are one range
+    vector<int>::const_iterator range_begin = index.sorted_rows.begin();
+    vector<int>::const_iterator range_end = index.sorted_rows.end();
+    auto value_less = [&column, &literal](int row_idx, int) { return compare_to_literal(column, row_idx, literal) < 0; };
+    auto value_greater = [&column, &literal](int, int row_idx) { return compare_to_literal(column, row_idx, literal) > 0; };
+
+    if ((condition.op == OP_EQ) || (condition.op == OP_GE) || (condition.op == OP_GT))
+    {
+        range_begin = (condition.op == OP_GT) ? upper_bound(range_begin, range_end, 0, value_greater)
+                                              : lower_bound(range_begin, range_end, 0, value_less);
+    }
+    if ((condition.op == OP_EQ) || (condition.op == OP_LE) || (condition.op == OP_LT))
+    {
+        range_end = (condition.op == OP_LT) ? lower_bound(range_begin, range_end, 0, value_less)
+                                            : upper_bound(range_begin, range_end, 0, value_greater);
+    }
+
+    for (vector<int>::const_iterator row = range_begin; row < range_end; row++)
+    {
+        if ((*row < visible_rows) || tail_row_visible(table, *row, tc_level))
+            matching_rows.push_back(*row);
+    }
+    sort(matching_rows.begin(), matching_rows.end());
+    return matching_rows;
+}
+
+/**
+ * Compares a value in a column with a literal of the column's type.
+ * 
+ * @param column  The column holding the value.
+ * @param row_idx The row of the value, it must not be empty.
+ * @param literal The value to compare against.
+ * 
+ * @return A negative number, zero or a positive number if the value is less 
+ *         than, equal to or greater than the literal.
+*/
+int compare_to_literal(const Column &column, int row_idx, const Data &literal)
+{
+    if (column.type == CHAR)
+        return (column.char_data[row_idx] > literal.char_data) - (column.char_data[row_idx] < literal.char_data);
+    else if (column.type == STRING)
+        return string_value(column, row_idx).compare(literal.string_data);
+    else if (column.type == INT)
+        return (column.int_data[row_idx] > literal.int_data) - (column.int_data[row_idx] < literal.int_data);
+    else // FLOAT
+        return (column.float_data[row_idx] > literal.float_data) - (column.float_data[row_idx] < literal.float_data);
+}
+
+/**
+ * Adds a row to an index. The rows already in the index have to be numbered 
+ * the way they are in the table, see remap_index. Empty rows are not added.
+ * 
+ * @param index   The index to add to.
+ * @param column  The column the index is on.
+ * @param row_idx The row to add.
+*/
+void index_add_row(Index &index, const Column &column, int row_idx)
+{
+    if (is_row_empty(column, row_idx))
+        return;
+
+    if (index.type == INDEX_ORDERED)
+    {
+        vector<int>::iterator position = upper_bound(index.sorted_rows.begin(), index.sorted_rows.end(), row_idx,
+                                                     [&column](int row_idx1, int row_idx2)
+        {
+            int compare = compare_column_rows(column, row_idx1, row_idx2);
+            return (compare != 0) ? (compare < 0) : (row_idx1 < row_idx2);
+        });
+        index.sorted_rows.insert(position, row_idx);
+        return;
+    }
+
+    // A new value gets a new group after the others
+    int group_count = index.group_begins.size() - 1;
+    int group;
+    if ((column.type == STRING) && column.dictionary_encoded)
+        group = index.value_groups.insert(column.string_codes[row_idx], group_count);
+    else if (column.type == STRING)
+        group = index.string_groups.insert(column.string_data[row_idx], group_count);
+    else
+    {
+        int64_t key = index_key(column.type, 
+                                column.type == CHAR ? column.char_data[row_idx] : 0,
+                                column.type == INT ? column.int_data[row_idx] : 0,
+                                column.type == FLOAT ? column.float_data[row_idx] : 0.0f);
+        group = index.value_groups.insert(key, group_count);
+    }
+    if (group == group_count)
+        index.group_begins.push_back(index.group_begins.back());
+
+    vector<int>::iterator group_begin = index.grouped_rows.begin() + index.group_begins[group];
+    vector<int>::iterator group_end = index.grouped_rows.begin() + index.group_begins[group + 1];
+    index.grouped_rows.insert(upper_bound(group_begin, group_end, row_idx), row_idx);
+    for (int begin_idx = group + 1; begin_idx < index.group_begins.size(); begin_idx++)
+    {
+        index.group_begins[begin_idx]++;
+    }
+}
+
+/**
+ * Renumbers the rows of an index after rows of its table were inserted or 
+ * removed. The renumbering has to keep the rows that stay in the same order.
+ * 
+ * @param index   The index to renumber.
+ * @param new_row Gives the new number of a row, -1 to remove it from the 
+ *                index.
+*/
+template <typename F>
+void remap_index(Index &index, F new_row)
+{
+    if (index.type == INDEX_ORDERED)
+    {
+        int kept_count = 0;
+        for (int row_idx : index.sorted_rows)
+        {
+            int mapped_row = new_row(row_idx);
+            if (mapped_row != -1)
+                index.sorted_rows[kept_count++] = mapped_row;
+        }
+        index.sorted_rows.resize(kept_count);
+        return;
+    }
+
+    // Groups keep their place, they only get smaller
+    int kept_count = 0;
+    int group_begin = 0;
+    for (int group = 0; group + 1 < index.group_begins.size(); group++)
+    {
+        int group_end = index.group_begins[group + 1];
+        index.group_begins[group] = kept_count;
+        for (int slot = group_begin; slot < group_end; slot++)
+        {
+            int mapped_row = new_row(index.grouped_rows[slot]);
+            if (mapped_row != -1)
+                index.grouped_rows[kept_count++] = mapped_row;
+        }
+        group_begin = group_end;
+    }
+    index.group_begins.back() = kept_count;
+    index.grouped_rows.resize(kept_count);
+}
+
+/**
+ * Parse a space seperated string of words.
+ * 
+ * @param string_to_parse THe string of space seperated words.
+ * 
+ * @return A vector of parsed words.
+*/
+vector<string> split_string_space(string string_to_parse)
+{
+    vector<string> result;
+    string new_string = "";
+    for (int char_idx = 0; char_idx < string_to_parse.size(); char_idx++)
+    {
+        if (string_to_parse[char_idx] == ' ' || string_to_parse[char_idx] == '\t')
+        {
+            // Loop and remove any whitespace
+            while (string_to_parse[char_idx] == ' ' || string_to_parse[char_idx] == '\t')
+            {
+                char_idx++;
+            }
+            char_idx--; // For loop will hanle the last increment
+            result.push_back(new_string);
+            new_string = "";
+        }
+        else
+        {
+            new_string.push_back(string_to_parse[char_idx]);
+        }
+    }
+    return result;
+}
+
+/**
+ * Parse a comma seperated string of words.
+ * 
+ * @param string_to_parse The string of comma seperated words.
+ * 
+ * @return A vector of the parsed words.
+*/
+vector<string> split_string_comma(string string_to_parse)
+{
+    vector<string> result;
+    // Create string stream from the string
+    stringstream s_stream(string_to_parse);
+    while(s_stream.good()) 
+    {
+        string substr;
+        // Get string delimited by comma
+        getline(s_stream, substr, ',');
+        result.push_back(substr);
+    }
+
+    return result;
+}
+
+/**
+ * Converts a type string to its appropiated enum value
+ * 
+ * @param type_string Enum type in string form.
+ * 
+ * @return The enum value of the string.
+*/
+enum data_type get_type(string type_string)
+{
+    if ("CHAR" == type_string)
+        return CHAR;
+    else if ("STRING" == type_string)
+        return STRING;
+    else if("INT" == type_string)
+        return INT;
+    else if ("FLOAT" == type_string)
+        return FLOAT;
+    else
+    {
+        cout << "Invalid type parsed!!!" << endl;
+        return STRING;
+    }
+}
+
+/**
+ * Splits a WHERE string into tokens. Commas and parentheses are always their 
+ * own token, everything else is separated by whitespace.
+ * 
+ * @param where_string The WHERE string to split.
+ * 
+ * @return A vector of the tokens.
+*/
+vector<string> split_where_tokens(const string &where_string)
+{
+    vector<string> tokens;
+    string token = "";
+    for (char character : where_string)
+    {
+        if ((character == ' ') || (character == '\t') || (character == ',') || 
+            (character == '(') || (character == ')'))
+        {
+            if (token != "")
+                tokens.push_back(token);
+            token = "";
+
+            if ((character != ' ') && (character != '\t'))
+                tokens.push_back(string(1, character));
+        }
+        else
+        {
+            token.push_back(character);
+        }
+    }
+    if (token != "")
+        tokens.push_back(token);
+
+    return tokens;
+}
+
+/**
+ * Joins the words of a query into the text that identifies it. The words of
+ * the WHERE statement are split into the tokens that compile_where reads, 
+ * and the tokens of one condition are put together without spaces, as 
+ * parse_where_condition does, so conditions that only differ in spacing, 
+ * such as SSN=123456789 and SSN = 123456789, get the same text. The other
+ * words are joined by single spaces.
+ * 
+ * @param list_of_words The words of the query.
+ * 
+ * @return The text of the query.
+*/
+string normalize_query(const vector<string> &list_of_words)
+{
+    string query_text = "";
+    bool in_where = false;
+    bool in_condition = false;
+    for (const string &word : list_of_words)
+    {
+        // The statements after WHERE end it, LIMIT and FORMAT are kept apart
+        // from the last condition since they are taken off before it is read
+        if ((word == "GROUPBY") || (word == "ORDERBY"))
+            in_where = false;
+        if (!in_where || (word == "LIMIT") || (word == "OFFSET") || (word == "FORMAT"))
+        {
+            if (!query_text.empty())
+                query_text += ' ';
+            query_text += word;
+            in_where = in_where || (word == "WHERE");
+            in_condition = false;
+            continue;
+        }
+
+        // The tokens are the runs of characters between tabs, commas and
+        // parentheses, as split_where_tokens finds them
+        size_t run_begin = 0;
+        for (size_t char_idx = 0; char_idx <= word.size(); char_idx++)
+        {
+            if ((char_idx < word.size()) && (word[char_idx] != ',') && (word[char_idx] != '(') && 
+                (word[char_idx] != ')') && (word[char_idx] != '\t'))
+                continue;
+
+            size_t run_length = char_idx - run_begin;
+            bool separator = ((run_length == 3) && (word.compare(run_begin, 3, "AND") == 0)) ||
+                             ((run_length == 2) && (word.compare(run_begin, 2, "OR") == 0));
+            if ((run_length > 0) && (!in_condition || separator))
+                query_text += ' ';
+            query_text.append(word, run_begin, run_length);
+            in_condition = (run_length > 0) ? !separator : in_condition;
+
+            if ((char_idx < word.size()) && (word[char_idx] != '\t'))
+            {
+                query_text += ' ';
+                query_text += word[char_idx];
+                in_condition = false;
+            }
+            run_begin = char_idx + 1;
+        }
+    }
+    return query_text;
+}
+
+/**
+ * Turns a compiled WHERE tree back into text, used to print query plans.
+ * 
+ * @param node  The tree to print.
+ * @param table The table that the tree was compiled for.
+ * 
+ * @return The text of the tree, with parentheses around every AND and OR.
+*/
+string predicate_to_string(const Predicate &node, const Table &table)
+{
+    const char *op_strings[] = { "=", "<>", "<", "<=", ">", ">=" };
+    stringstream result;
+
+    if (node.kind == PREDICATE_COMPARE)
+    {
+        const Column &column = table.table_data[node.column_idx];
+        result << column.column_name << op_strings[node.op];
+        if (column.type == CHAR)
+            result << node.literal.char_data;
+        else if (column.type == STRING)
+            result << node.literal.string_data;
+        else if (column.type == INT)
+            result << node.literal.int_data;
+        else // FLOAT
+            result << node.literal.float_data;
+        return result.str();
+    }
+
+    result << "(";
+    for (int child_idx = 0; child_idx < node.children.size(); child_idx++)
+    {
+        if (child_idx > 0)
+            result << (node.kind == PREDICATE_AND ? " AND " : " OR ");
+        result << predicate_to_string(node.children[child_idx], table);
+    }
+    result << ")";
+    return result.str();
+}
+
+/**
+ * Parses a list of conditions that are separated by OR.
+ * 
+ * @param tokens    The tokens of the WHERE string.
+ * @param token_idx The token to start at, moved past the parsed tokens.
+ * @param table     The table that the conditions will be run against.
+ * @param node      The parsed tree.
+ * 
+ * @return True if the tokens were valid.
+*/
+bool parse_where_or(const vector<string> &tokens, int &token_idx, const Table &table, Predicate &node)
+{
+    Predicate child;
+    if (!parse_where_and(tokens, token_idx, table, child))
+        return false;
+
+    if ((token_idx == tokens.size()) || (tokens[token_idx] != "OR"))
+    {
+        node = child;
+        return true;
+    }
+
+    node.kind = PREDICATE_OR;
+    node.children.push_back(child);
+    while ((token_idx < tokens.size()) && (tokens[token_idx] == "OR"))
+    {
+        token_idx++;
+        node.children.push_back(Predicate());
+        if (!parse_where_and(tokens, token_idx, table, node.children.back()))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Parses a list of conditions that are separated by AND or commas.
+ * 
+ * @param tokens    The tokens of the WHERE string.
+ * @param token_idx The token to start at, moved past the parsed tokens.
+ * @param table     The table that the conditions will be run against.
+ * @param node      The parsed tree.
+ * 
+ * @return True if the tokens were valid.
+*/
+bool parse_where_and(const vector<string> &tokens, int &token_idx, const Table &table, Predicate &node)
+{
+    node.kind = PREDICATE_AND;
+    do
+    {
+        if ((token_idx < tokens.size()) && ((tokens[token_idx] == ",") || (tokens[token_idx] == "AND")))
+            token_idx++;
+
+        node.children.push_back(Predicate());
+        if ((token_idx < tokens.size()) && (tokens[token_idx] == "("))
+        {
+            // A group of conditions in parentheses
+            token_idx++;
+            if (!parse_where_or(tokens, token_idx, table, node.children.back()))
+                return false;
+            if ((token_idx == tokens.size()) || (tokens[token_idx] != ")"))
+            {
+                cout << "Invalid WHERE statement, missing ')'" << endl;
+                return false;
+            }
+            token_idx++;
+        }
+        else if (!parse_where_condition(tokens, token_idx, table, node.children.back()))
+        {
+            return false;
+        }
+    } while ((token_idx < tokens.size()) && ((tokens[token_idx] == ",") || (tokens[token_idx] == "AND")));
+
+    if (node.children.size() == 1)
+    {
+        Predicate child = node.children[0];
+        node = child;
+    }
+    return true;
+}
+
+/**
+ * Parses a single condition such as "SALARY >= 30000". The condition can be
+ * split over several tokens, the whitespace between them is ignored.
+ * 
+ * @param tokens    The tokens of the WHERE string.
+ * @param token_idx The token to start at, moved past the parsed tokens.
+ * @param table     The table that the condition will be run against.
+ * @param node      The parsed condition.
+ * 
+ * @return True if the condition was valid.
+*/
+bool parse_where_condition(const vector<string> &tokens, int &token_idx, const Table &table, Predicate &node)
+{
+    string condition_string;
+    while ((token_idx < tokens.size()) && (tokens[token_idx] != ",") && (tokens[token_idx] != "(") && 
+           (tokens[token_idx] != ")") && (tokens[token_idx] != "AND") && (tokens[token_idx] != "OR"))
+    {
+        condition_string += tokens[token_idx];
+        token_idx++;
+    }
+
+    string data1;
+    string data2;
+    string condition;
+    int current_item = 0;
+
+    // Get the column, inequalty, and data from the condition string
+    for (int idx = 0; idx < condition_string.size(); idx++)
+    {
+        if ((current_item == 0) && 
+            (condition_string[idx] != '=') && (condition_string[idx] != '>') && (condition_string[idx] != '<'))
+        {
+            data1 += condition_string[idx];
+        }
+
+        if ((condition_string[idx] == '=') || (condition_string[idx] == '>') || (condition_string[idx] == '<'))
+        {
+            current_item = 2;
+            condition += condition_string[idx];
+        } 
+        else if (current_item == 2)
+        {
+            data2 += condition_string[idx];
+        }
+    }
+
+    if (condition_string == "")
+    {
+        cout << "Invalid WHERE statement, missing condition" << endl;
+        return false;
+    }
+
+    node.kind = PREDICATE_COMPARE;
+    if (condition == "=")
+        node.op = OP_EQ;
+    else if (condition == "<>")
+        node.op = OP_NE;
+    else if (condition == "<")
+        node.op = OP_LT;
+    else if (condition == "<=")
+        node.op = OP_LE;
+    else if (condition == ">")
+        node.op = OP_GT;
+    else if (condition == ">=")
+        node.op = OP_GE;
+    else
+    {
+        cout << "Invalid inequality in WHERE statement: " << condition_string << endl;
+        return false;
+    }
+
+    // Get the column that the condition will be run against
+    node.column_idx = find_column(table, data1);
+    if (node.column_idx == -2)
+    {
+        cout << "Ambiguous column in WHERE statement: " << data1 << endl;
+        return false;
+    }
+    else if (node.column_idx == -1)
+    {
+        cout << "Invalid column in WHERE statement: " << data1 << endl;
+        return false;
+    }
+
+    // A ? is a parameter, its value is converted when it is bound
+    node.parameter_idx = -1;
+    node.literal.empty = false;
+    if (data2 == "?")
+    {
+        node.parameter_idx = 0;
+        return true;
+    }
+
+    // Convert the value to the column's type now, so it is not done per row
+    if (!convert_literal(data2, table.table_data[node.column_idx].type, node.literal))
+    {
+        cout << "Invalid value in WHERE statement: " << condition_string << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Converts the value of a condition to the type of its column.
+ * 
+ * @param value   The value as it was written.
+ * @param type    The type of the column.
+ * @param literal The converted value.
+ * 
+ * @return True if the value is valid for the type.
+*/
+bool convert_literal(const string &value, enum data_type type, Data &literal)
+{
+    try
+    {
+        if (value == "")
+            throw invalid_argument(value);
+        else if (type == CHAR)
+            literal.char_data = value[0];
+        else if (type == STRING)
+            literal.string_data = value;
+        else if (type == INT)
+            literal.int_data = stoi(value);
+        else // FLOAT
+            literal.float_data = stof(value);
+    }
+    catch (const exception &error)
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Numbers the ?s of a compiled WHERE tree in the order they are written.
+ * 
+ * @param node          The tree.
+ * @param parameter_idx The number of the first ? in the tree.
+ * 
+ * @return The number of the first ? after the tree.
+*/
+int number_parameters(Predicate &node, int parameter_idx)
+{
+    if (node.kind == PREDICATE_COMPARE)
+    {
+        if (node.parameter_idx >= 0)
+            node.parameter_idx = parameter_idx++;
+        return parameter_idx;
+    }
+
+    for (Predicate &child : node.children)
+    {
+        parameter_idx = number_parameters(child, parameter_idx);
+    }
+    return parameter_idx;
+}
+
+/**
+ * Collects the columns that a compiled WHERE clause reads.
+ * 
+ * @param node        The root of the clause.
+ * @param column_idxs Where the columns are added, a column can be added more
+ *                    than once.
+*/
+void predicate_columns(const Predicate &node, vector<int> &column_idxs)
+{
+    if (node.kind == PREDICATE_COMPARE)
+    {
+        column_idxs.push_back(node.column_idx);
+        return;
+    }
+
+    for (const Predicate &child : node.children)
+    {
+        predicate_columns(child, column_idxs);
+    }
+}
+
+/**
+ * Checks the candidate rows of a column against a literal with a fixed 
+ * comparison, so the loop has no branches on the type or the inequality.
+ * Empty values never pass.
+ * 
+ * @param values         The typed values of the column.
+ * @param null_bitmap    The null bitmap of the column.
+ * @param literal        The value to compare against.
+ * @param compare        The comparison to run.
+ * @param candidate_rows The rows to check, in ascending order.
+ * @param matching_rows  The rows that passed are appended to this vector.
+*/
+template <typename T, typename Compare>
+void filter_column(const vector<T> &values, const vector<uint64_t> &null_bitmap, const T &literal,
+                   Compare compare, const vector<int> &candidate_rows, vector<int> &matching_rows)
+{
+    for (int row_idx : candidate_rows)
+    {
+        if (!((null_bitmap[row_idx / 64] >> (row_idx % 64)) & 1) && compare(values[row_idx], literal))
+            matching_rows.push_back(row_idx);
+    }
+}
+
+/**
+ * Picks the comparison for an inequality and runs filter_column with it.
+*/
+template <typename T>
+void filter_column_op(const vector<T> &values, const vector<uint64_t> &null_bitmap, const T &literal,
+                      enum compare_op op, const vector<int> &candidate_rows, vector<int> &matching_rows)
+{
+    if (op == OP_EQ)
+        filter_column(values, null_bitmap, literal, equal_to<T>(), candidate_rows, matching_rows);
+    else if (op == OP_NE)
+        filter_column(values, null_bitmap, literal, not_equal_to<T>(), candidate_rows, matching_rows);
+    else if (op == OP_LT)
+        filter_column(values, null_bitmap, literal, less<T>(), candidate_rows, matching_rows);
+    else if (op == OP_LE)
+        filter_column(values, null_bitmap, literal, less_equal<T>(), candidate_rows, matching_rows);
+    else if (op == OP_GT)
+        filter_column(values, null_bitmap, literal, greater<T>(), candidate_rows, matching_rows);
+    else // OP_GE
+        filter_column(values, null_bitmap, literal, greater_equal<T>(), candidate_rows, matching_rows);
+}
+
+/**
+ * Checks the rows of a dictionary encoded column whose dictionary is not 
+ * sorted against a range of values. Each value of the dictionary is compared
+ * once, the rows are then checked by their code.
+ * 
+ * @param column         The encoded column.
+ * @param value          The string to compare against.
+ * @param op             The inequality, one of <, <=, > and >=.
+ * @param candidate_rows The rows to check, in ascending order.
+ * @param matching_rows  The rows that passed are appended to this vector.
+*/
+void filter_dictionary(const Column &column, const string &value, enum compare_op op, 
+                       const vector<int> &candidate_rows, vector<int> &matching_rows)
+{
+    vector<char> passing_codes(column.dictionary.size());
+    for (int32_t code = 0; code < column.dictionary.size(); code++)
+    {
+        int compare = column.dictionary[code].compare(value);
+        passing_codes[code] = (op == OP_LT) ? (compare < 0) : (op == OP_LE) ? (compare <= 0) : 
+                              (op == OP_GT) ? (compare > 0) : (compare >= 0);
+    }
+    filter_column(column.string_codes, column.null_bitmap, (int32_t)0, 
+                  [&passing_codes](int32_t code, int32_t) { return passing_codes[code] != 0; },
+                  candidate_rows, matching_rows);
+}
+
+/**
+ * Checks a run of consecutive rows of an INT or FLOAT column against a literal
+ * using the comparison kernels. Empty values never pass.
+ * 
+ * @param values        The typed values of the column.
+ * @param null_bitmap   The null bitmap of the column.
+ * @param literal       The value to compare against.
+ * @param op            The inequality to test.
+ * @param begin_row     The first row to check.
+ * @param end_row       One past the last row to check.
+ * @param matching_rows The rows that passed are appended to this vector.
+*/
+template <typename T>
+void filter_column_range(const vector<T> &values, const vector<uint64_t> &null_bitmap, T literal,
+                         enum compare_op op, int begin_row, int end_row, vector<int> &matching_rows)
+{
+    // Work in blocks that start on a word of the null bitmap, so the mask
+    // words line up with the null words
+    const int block_rows = 4096;
+    uint64_t mask[block_rows / 64];
+
+    for (int block_begin = begin_row - (begin_row % 64); block_begin < end_row; block_begin += block_rows)
+    {
+        int block_count = min(block_rows, end_row - block_begin);
+        compare_kernel(values.data() + block_begin, block_count, literal, op, mask);
+
+        for (int word_idx = 0; word_idx * 64 < block_count; word_idx++)
+        {
+            int first_row = block_begin + word_idx * 64;
+            uint64_t bits = mask[word_idx] & ~null_bitmap[first_row / 64];
+
+            // Clear the bits of the rows before begin_row and after end_row
+            if (first_row < begin_row)
+                bits &= ~(uint64_t)0 << (begin_row - first_row);
+            if (end_row - first_row < 64)
+                bits &= ((uint64_t)1 << (end_row - first_row)) - 1;
+
+            while (bits != 0)
+            {
+                matching_rows.push_back(first_row + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+
+/**
+ * Compares the values of two rows of a column, neither of which is empty.
+ * 
+ * @param column   The column holding the values.
+ * @param row_idx1 The first row.
+ * @param row_idx2 The second row.
+ * 
+ * @return A negative number if the first value is smaller, 0 if the values 
+ *         are equal and a positive number if the first value is larger.
+*/
+int compare_column_rows(const Column &column, int row_idx1, int row_idx2)
+{
+    // Codes only compare like their values while the dictionary is sorted
+    if (column.type == CHAR)
+        return (column.char_data[row_idx1] > column.char_data[row_idx2]) - 
+               (column.char_data[row_idx1] < column.char_data[row_idx2]);
+    else if ((column.type == STRING) && column.dictionary_encoded && (column.sorted_values == column.dictionary.size()))
+        return (column.string_codes[row_idx1] > column.string_codes[row_idx2]) - 
+               (column.string_codes[row_idx1] < column.string_codes[row_idx2]);
+    else if (column.type == STRING)
+        return string_value(column, row_idx1).compare(string_value(column, row_idx2));
+    else if (column.type == INT)
+        return (column.int_data[row_idx1] > column.int_data[row_idx2]) - 
+               (column.int_data[row_idx1] < column.int_data[row_idx2]);
+    else if (column.type == FLOAT)
+        return (column.float_data[row_idx1] > column.float_data[row_idx2]) - 
+               (column.float_data[row_idx1] < column.float_data[row_idx2]);
+    else if (column.type == BIGINT)
+        return (column.bigint_data[row_idx1] > column.bigint_data[row_idx2]) - 
+               (column.bigint_data[row_idx1] < column.bigint_data[row_idx2]);
+    else // DOUBLE
+        return (column.double_data[row_idx1] > column.double_data[row_idx2]) - 
+               (column.double_data[row_idx1] < column.double_data[row_idx2]);
+}
+
+/**
+ * Finds a column by name. In a join the columns are named <table>.<column>, 
+ * they can also be found by the name of the column alone if no other table
+ * has a column with that name.
+ * 
+ * @param table       The table holding the column.
+ * @param column_name The name of the column.
+ * 
+ * @return The index of the column, -1 if there is none, -2 if the name is 
+ *         used by more than one table.
+*/
+int find_column(const Table &table, const string &column_name)
+{
+    int found_idx = -1;
+    for (int column_idx = 0; column_idx < table.table_data.size(); column_idx++)
+    {
+        if (table.table_data[column_idx].column_name == column_name)
+            return column_idx;
+
+        if (column_has_name(table.table_data[column_idx], column_name))
+            found_idx = (found_idx == -1) ? column_idx : -2;
+    }
+    return found_idx;
+}
+
+/**
+ * Checks if a column has the given name, or is named <table>.<name> in a join.
+ * 
+ * @param column      The column to check.
+ * @param column_name The name to check for.
+ * 
+ * @return True if the column has the name.
+*/
+bool column_has_name(const Column &column, const string &column_name)
+{
+    const string &name = column.column_name;
+    if (name == column_name)
+        return true;
+
+    return (name.size() > column_name.size()) && (name[name.size() - column_name.size() - 1] == '.') &&
+           (name.compare(name.size() - column_name.size(), column_name.size(), column_name) == 0);
+}
+
+/**
+ * Finds the table of a join that a schema column belongs to.
+ * 
+ * @param join       The tables of the query.
+ * @param column_idx The index of the column in the schema.
+ * 
+ * @return The position of the table in the join.
+*/
+int join_table_of(const Join_Query &join, int column_idx)
+{
+    return upper_bound(join.column_offsets.begin(), join.column_offsets.end(), column_idx) - 
+           join.column_offsets.begin() - 1;
+}
+
+/**
+ * Finds the table of a join that a WHERE tree uses.
+ * 
+ * @param node The tree, resolved against the join's schema.
+ * @param join The tables of the query.
+ * 
+ * @return The position of the table in the join, -1 if the tree uses no 
+ *         columns and -2 if it uses the columns of several tables.
+*/
+int predicate_table(const Predicate &node, const Join_Query &join)
+{
+    if (node.kind == PREDICATE_COMPARE)
+        return join_table_of(join, node.column_idx);
+
+    int table_idx = -1;
+    for (const Predicate &child : node.children)
+    {
+        int child_table_idx = predicate_table(child, join);
+        if ((child_table_idx == -2) || ((table_idx >= 0) && (child_table_idx >= 0) && (child_table_idx != table_idx)))
+            return -2;
+        if (child_table_idx >= 0)
+            table_idx = child_table_idx;
+    }
+    return table_idx;
+}
+
+/**
+ * Moves the columns used by a WHERE tree, so a tree resolved against a join's
+ * schema can be run on one of its tables.
+ * 
+ * @param node   The tree to change.
+ * @param offset The amount to add to each column index.
+*/
+void shift_predicate_columns(Predicate &node, int offset)
+{
+    if (node.kind == PREDICATE_COMPARE)
+        node.column_idx += offset;
+
+    for (Predicate &child : node.children)
+    {
+        shift_predicate_columns(child, offset);
+    }
+}
+
+/**
+ * Gets the join key of each row in a list, empty rows get no key.
+ * 
+ * @param column The column holding the keys.
+ * @param rows   The rows to get the keys of.
+ * 
+ * @return The key and position in the list of each row that has a value.
+*/
+template <typename K>
+vector<pair<K, int>> join_keys(const Column &column, const vector<int> &rows)
+{
+    vector<pair<K, int>> keys;
+    keys.reserve(rows.size());
+    for (int position = 0; position < rows.size(); position++)
+    {
+        if (is_row_empty(column, rows[position]))
+            continue;
+
+        K key;
+        join_key(column, rows[position], key);
+        keys.push_back(make_pair(key, position));
+    }
+    return keys;
+}
+
+/**
+ * Gets the join key of a row of a STRING column.
+ * 
+ * @param column  The column.
+ * @param row_idx The row.
+ * @param key     The value of the row.
+*/
+void join_key(const Column &column, int row_idx, string &key)
+{
+    key = string_value(column, row_idx);
+}
+
+/**
+ * Gets the join key of a row of a CHAR, INT or FLOAT column, see index_key.
  * 
- * @var table_name The name of the table. Should always be in all caps.
- * @var A vector of Column objects representing the table's columns.
+ * @param column  The column.
+ * @param row_idx The row.
+ * @param key     The key of the row's value.
 */
-typedef struct table
+void join_key(const Column &column, int row_idx, int64_t &key)
 {
-    string table_name;
-    vector<Column> table_data;
-} 
-Table;
-
-// Implementation functions
-vector<Table> init_database(void);
-Table parse_table(string where_string, Table table_to_parse);
-Table sort_table(string orderby_string, Table table_to_order);
-Table select_columns(string select_string, Table table_to_select);
-void print_table(Table table_to_print);
-
-// Helper Functions
-bool compare_data_condition(Data stored_data, Data test_data, string inequality, enum data_type type);
-bool compare_char_condition(Data stored_data, Data test_data, string inequality);
-bool compare_string_condition(Data stored_data, Data test_data, string inequality);
-bool compare_int_condition(Data stored_data, Data test_data, string inequality);
-bool compare_float_condition(Data stored_data, Data test_data, string inequality);
-string trim(string string_to_trim);
-vector<string> split_string_comma(string string_to_parse);
-vector<string> split_string_space(string string_to_parse);
-enum data_type get_type(string type_string);
+    key = index_key(column.type, 
+                    column.type == CHAR ? column.char_data[row_idx] : 0,
+                    column.type == INT ? column.int_data[row_idx] : 0,
+                    column.type == FLOAT ? column.float_data[row_idx] : 0.0f);
+}
 
 /**
- * The main function of the database program. 
+ * Matches two lists of join keys. The first list is put in a hash table which
+ * is then probed with each key of the second list.
  * 
- * @note To exit the program the user must enter "EXIT"
- * 
- * @param tc_level An integer representing the users permissions in regards to 
- *                 accessing database records.
- * 
- * @retval  0 The program ran successfully.
- * @retval -1 An error was encountered.
+ * @param build_keys The keys to build the hash table from.
+ * @param probe_keys The keys to look up.
+ * @param matches    The matching positions, the probe position first. They 
+ *                   are ordered by the probe position, then the build position.
 */
-int main(int argc, char **argv)
-{    
-    // Format string to pass to filtering function to ensure the user can only
-    // view the appropriate data based on security level.
-    string tc_level = "TC<=";
-    tc_level.push_back(argv[1][0]);
+template <typename K>
+void hash_join_keys(const vector<pair<K, int>> &build_keys, const vector<pair<K, int>> &probe_keys, 
+                    vector<pair<int, int>> &matches)
+{
+    // Group the build positions by key, the same way as a HASH index
+    unordered_map<K, int> key_groups;
+    vector<int> key_group_ids(build_keys.size());
+    for (int key_idx = 0; key_idx < build_keys.size(); key_idx++)
+    {
+        key_group_ids[key_idx] = key_groups.insert(make_pair(build_keys[key_idx].first, (int)key_groups.size())).first->second;
+    }
 
-    // Initialize the database a return a copy to be used for queries
-    vector<Table> database = init_database();
-    // Loop until the user requests to exit the program
-    string input_line;
-    while(1)
+    vector<int> group_begins(key_groups.size() + 1, 0);
+    for (int group : key_group_ids)
     {
-        cout << "MLS>";
-        getline(cin, input_line);
+        group_begins[group + 1]++;
+    }
+    for (int group = 0; group < key_groups.size(); group++)
+    {
+        group_begins[group + 1] += group_begins[group];
+    }
 
-        if (input_line == "EXIT") { break; }
+    vector<int> next_slot(group_begins.begin(), group_begins.end() - 1);
+    vector<int> grouped_positions(build_keys.size());
+    for (int key_idx = 0; key_idx < build_keys.size(); key_idx++)
+    {
+        grouped_positions[next_slot[key_group_ids[key_idx]]++] = build_keys[key_idx].second;
+    }
 
-        // Get the query section that comes before the ';' (inclusive)
-        size_t pos = input_line.find(';');
-        if (pos != string::npos)
-        {
-            input_line = input_line.substr(0, pos + 1);
-        }
+    for (const pair<K, int> &probe_key : probe_keys)
+    {
+        typename unordered_map<K, int>::const_iterator found = key_groups.find(probe_key.first);
+        if (found == key_groups.end())
+            continue;
 
-        // If ';' is missing the query is invalid
-        if (input_line[input_line.size() - 1] == ';')
+        for (int slot = group_begins[found->second]; slot < group_begins[found->second + 1]; slot++)
         {
-            // replace the ';' character with a space, so the string can be split
-            // properly
-            input_line[input_line.size() - 1] = ' ';
-
-            string select_string = "";
-            string from_string   = "";
-            string where_string  = "";
-            string order_string  = "";
-            Table copy_of_table;
-
-            // Split the string using a space delimiter in order to parse out
-            // query information.
-            vector<string> list_of_words = split_string_space(input_line);
-
-            // Use the FROM section to determine which table to use, for this
-            // program only one table can be used
-            for (int word_idx = 0; word_idx < list_of_words.size() - 1; word_idx++)
-            {
-                if (list_of_words[word_idx] == "FROM")
-                {
-                    // First non whitespace string is the table table that we will use
-                    from_string = list_of_words[word_idx + 1];
-                    break;
-                }
-            }
-
-            // Get a copy of the table using the FROM statement
-            bool table_exists = false;
-            for (int table_idx = 0; table_idx < database.size(); table_idx++)
-            {
-                if (from_string == database[table_idx].table_name)
-                {
-                    copy_of_table = database[table_idx];
-                    table_exists = true;
-                    break;
-                }
-            }
-            // If a the table exists, then get the other query information
-            if (table_exists)
-            {
-                // Check for a where statement and use it to parse information if necessary
-                int where_idx = 0;
-                for (int word_idx = 0; word_idx < list_of_words.size(); word_idx++)
-                {
-                    if (list_of_words[word_idx] == "WHERE")
-                    {
-                        where_idx = word_idx;
-                        break;
-                    }
-                }
-                // If the where statment exists, then we need to get the conditions
-                // that will filter the table
-                for (int word_idx = where_idx + 1; word_idx < list_of_words.size(); word_idx++)
-                {
-                    if (list_of_words[word_idx] != "ORDERBY")
-                        where_string = where_string + list_of_words[word_idx] + " ";
-                    else
-                        break;
-                }
-
-                if (where_idx != 0)
-                {
-                    // Add the users tc level to the filtering string
-                    where_string = where_string + "," + tc_level;
-                }
-                else
-                {
-                    where_string = tc_level;
-                }
-
-                // Parse information out of table using the where string
-                copy_of_table = parse_table(where_string, copy_of_table);
-
-                // CHeck for an order by statement
-                int orderby_idx = 0;
-                for (int word_idx = 0; (word_idx < list_of_words.size()) && (copy_of_table.table_data[0].column_data.size() != 0); word_idx++)
-                {
-                    if (list_of_words[word_idx] == "ORDERBY")
-                    {
-                        orderby_idx = word_idx;
-                        break;
-                    }
-                }
-                // If the order by statement exists, then we need to get the 
-                // conditions that will filter the table
-                if (orderby_idx != 0)
-                {
-                    for (int word_idx = orderby_idx + 1; word_idx < list_of_words.size(); word_idx++)
-                    {
-                        order_string = order_string + list_of_words[word_idx] + " ";
-                    }
-
-                    copy_of_table = sort_table(order_string, copy_of_table);
-                }
-
-                // Check for an order by statement
-                int select_idx = -1;
-                for (int word_idx = 0; word_idx < list_of_words.size(); word_idx++)
-                {
-                    if (list_of_words[word_idx] == "SELECT")
-                    {
-                        select_idx = word_idx;
-                        break;
-                    }
-                }
-
-                // If the select statement exists, then we need to get the select conditions,
-                // so we know what columns are needed
-                if (select_idx != -1)
-                {
-                    for (int word_idx = select_idx + 1; word_idx < list_of_words.size(); word_idx++)
-                    {
-                        if (list_of_words[word_idx] != "FROM")
-                            select_string = select_string + list_of_words[word_idx] + " ";
-                        else
-                            break;
-                    }
-                    copy_of_table = select_columns(select_string, copy_of_table);
-                }
-
-                // Print out the entire table, which should only contain the desired
-                // elements
-                print_table(copy_of_table);
-            }
+            matches.push_back(make_pair(probe_key.second, grouped_positions[slot]));
         }
     }
-
-    return 0;
 }
 
 /**
- * A function will initialize the database based on the provided TAB_COLUMNS.csv
- * file.
+ * Runs a compiled WHERE tree over a list of candidate rows.
  * 
- * @return A vector of tables representing the database.
+ * @param node           The tree to run.
+ * @param table          The table that the tree was compiled for.
+ * @param candidate_rows The rows to check, in ascending order.
+ * 
+ * @return The candidate rows that passed, in ascending order.
 */
-vector<Table> init_database()
+vector<int> evaluate_predicate(const Predicate &node, const Table &table, const vector<int> &candidate_rows)
 {
-    vector<Table> database;
-    string input_line;
+    vector<int> matching_rows;
 
-    // First need to get the format of the table.
-    // The columns should be in descending order.
-    ifstream schema_file("TAB_COLUMNS.csv");
-    while (getline(schema_file, input_line))
+    if (node.kind == PREDICATE_COMPARE)
     {
-        // Split each line of the schema file. The line should be in the 
-        // following order <table>,<column>,<type>,<column_num>
-        vector<string> list_of_words = split_string_comma(input_line);
+        const Column &column = table.table_data[node.column_idx];
 
-        // Iterate through the database to see if the table already exists
-        bool table_exists = false;
-        for (int idx = 0; idx < database.size(); idx++)
+        // When the candidates are a run of consecutive rows the INT and FLOAT
+        // columns can be checked many rows at a time
+        bool consecutive_rows = (candidate_rows.size() >= 64) && 
+                                (candidate_rows.back() - candidate_rows.front() + 1 == candidate_rows.size());
+
+        // Encoded columns compare codes, which can also use the INT kernels.
+        // Codes of the values that writes added are not in order, so until 
+        // the dictionary is sorted again a range is checked value by value.
+        enum compare_op op = node.op;
+        int32_t code = 0;
+        if ((column.type == STRING) && column.dictionary_encoded && (op != OP_EQ) && (op != OP_NE) && 
+            (column.sorted_values < column.dictionary.size()))
         {
-            // If the table does exist, then just add the column to it
-            if (database[idx].table_name == list_of_words[0])
-            {
-                Column new_column = 
-                {
-                    .column_name = list_of_words[1],
-                    .type = get_type(list_of_words[2])
-                };
-                database[idx].table_data.push_back(new_column);
-                table_exists = true;
-                break;
-            }
+            filter_dictionary(column, node.literal.string_data, op, candidate_rows, matching_rows);
+            return matching_rows;
         }
-        if (!table_exists) // The table does not yet exist
+        if ((column.type == STRING) && column.dictionary_encoded && 
+            !encode_literal(column, node.literal.string_data, op, code))
         {
-            Table new_table = { .table_name = list_of_words[0] };
-            Column new_column = 
-            {
-                .column_name = list_of_words[1],
-                .type = get_type(list_of_words[2])
-            };
-            new_table.table_data.push_back(new_column);
-            database.push_back(new_table);
+            return matching_rows;
         }
-    }
-    schema_file.close();
 
-    // The schema read from the input file is in decending order, therefore
-    // invert the vector so that the columns are indexable.
-    for (int table_idx = 0; table_idx < database.size(); table_idx++)
+        if (consecutive_rows && (column.type == STRING) && column.dictionary_encoded)
+            filter_column_range(column.string_codes, column.null_bitmap, code, op,
+                                candidate_rows.front(), candidate_rows.back() + 1, matching_rows);
+        else if ((column.type == STRING) && column.dictionary_encoded)
+            filter_column_op(column.string_codes, column.null_bitmap, code, op, candidate_rows, matching_rows);
+        else if (consecutive_rows && (column.type == INT))
+            filter_column_range(column.int_data, column.null_bitmap, node.literal.int_data, node.op,
+                                candidate_rows.front(), candidate_rows.back() + 1, matching_rows);
+        else if (consecutive_rows && (column.type == FLOAT))
+            filter_column_range(column.float_data, column.null_bitmap, node.literal.float_data, node.op,
+                                candidate_rows.front(), candidate_rows.back() + 1, matching_rows);
+        else if (column.type == CHAR)
+            filter_column_op(column.char_data, column.null_bitmap, node.literal.char_data, node.op, candidate_rows, matching_rows);
+        else if (column.type == STRING)
+            filter_column_op(column.string_data, column.null_bitmap, node.literal.string_data, node.op, candidate_rows, matching_rows);
+        else if (column.type == INT)
+            filter_column_op(column.int_data, column.null_bitmap, node.literal.int_data, node.op, candidate_rows, matching_rows);
+        else // FLOAT
+            filter_column_op(column.float_data, column.null_bitmap, node.literal.float_data, node.op, candidate_rows, matching_rows);
+    }
+    else if (node.kind == PREDICATE_AND)
     {
-        reverse(database[table_idx].table_data.begin(), database[table_idx].table_data.end());
-
-        // Read through the employee data and store it in the table
-        ifstream data_file(database[table_idx].table_name + ".csv");
-        while (data_file.is_open() && getline(data_file, input_line))
+        // Each child only checks the rows that passed the previous children
+        matching_rows = candidate_rows;
+        for (int child_idx = 0; (child_idx < node.children.size()) && !matching_rows.empty(); child_idx++)
         {
-            vector<string> list_of_words = split_string_comma(input_line);
-
-            for (int column_idx = 0; column_idx < database[table_idx].table_data.size(); column_idx++)
-            {
-                Data data_item;
-                data_item.empty = false;
-
-                enum data_type type = database[table_idx].table_data[column_idx].type;
-
-                // Assign the data value based on the column's type
-                if (list_of_words[column_idx] == " ")
-                    data_item.empty = true;
-                else if (CHAR == type)
-                    data_item.char_data = trim(list_of_words[column_idx])[0];
-                else if (STRING == type)
-                    data_item.string_data = trim(list_of_words[column_idx]);
-                else if (INT == type)
-                    data_item.int_data = stoi(trim(list_of_words[column_idx]));
-                else if (FLOAT == type)
-                    data_item.float_data = stof(trim(list_of_words[column_idx]));
+            matching_rows = evaluate_predicate(node.children[child_idx], table, matching_rows);
+        }
+    }
+    else // PREDICATE_OR
+    {
+        // Each child only checks the rows that no previous child has matched,
+        // and the matches are merged so the rows stay in ascending order
+        vector<int> remaining_rows = candidate_rows;
+        for (int child_idx = 0; (child_idx < node.children.size()) && !remaining_rows.empty(); child_idx++)
+        {
+            vector<int> child_rows = evaluate_predicate(node.children[child_idx], table, remaining_rows);
+            vector<int> merged_rows;
+            vector<int> unmatched_rows;
 
-                database[table_idx].table_data[column_idx].column_data.push_back(data_item);
-            }
+            set_union(matching_rows.begin(), matching_rows.end(), child_rows.begin(), child_rows.end(),
+                      back_inserter(merged_rows));
+            set_difference(remaining_rows.begin(), remaining_rows.end(), child_rows.begin(), child_rows.end(),
+                           back_inserter(unmatched_rows));
+            matching_rows.swap(merged_rows);
+            remaining_rows.swap(unmatched_rows);
         }
-        data_file.close();
     }
 
-    return database;
+    return matching_rows;
 }
 
 /**
- * Function that will filter the given table based on the passed string of 
- * conditions
+ * Finds the best instruction set that the comparison kernels can use on this
+ * CPU.
  * 
- * @param where_string   A string that contains the comma separated list of 
- *                       conditions.
- * @param table_to_parse A Table object that should be filtered.
- * 
- * @return The filtered table.
+ * @return The instruction set to use.
 */
-Table parse_table(string where_string, Table table_to_parse)
+enum simd_level detect_simd_level()
 {
-    vector<string> conditions;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    else if (__builtin_cpu_supports("sse4.2"))
+        return SIMD_SSE42;
+    else
+        return SIMD_SCALAR;
+}
 
-    // Split the given where string based on the commas, which will give us the
-    // number of filters that need to be ran.
-    conditions = split_string_comma(where_string);
+/**
+ * Compares two values with an inequality that is known at compile time.
+*/
+template <int OP, typename T>
+inline bool compare_values(T value, T literal)
+{
+    if (OP == OP_EQ)
+        return value == literal;
+    else if (OP == OP_NE)
+        return value != literal;
+    else if (OP == OP_LT)
+        return value < literal;
+    else if (OP == OP_LE)
+        return value <= literal;
+    else if (OP == OP_GT)
+        return value > literal;
+    else // OP_GE
+        return value >= literal;
+}
 
-    // For each condition, filter the table
-    for (string condition_string : conditions)
+/**
+ * Comparison kernel that checks one value at a time. Bit i of the mask is set
+ * when value i passes, unused bits of the last word are cleared.
+*/
+template <int OP, typename T>
+void scalar_kernel(const T *values, int count, T literal, uint64_t *mask)
+{
+    for (int word_idx = 0; word_idx * 64 < count; word_idx++)
     {
-        string data1;
-        string data2;
-        string condition;
-        Column column_to_parse;
-        Data test_data;
-        int current_item = 0;
-
-        // Get the column, inequalty, and data from the condition string
-        for (int idx = 0; idx < condition_string.size(); idx++)
+        uint64_t bits = 0;
+        int word_count = min(64, count - word_idx * 64);
+        for (int bit_idx = 0; bit_idx < word_count; bit_idx++)
         {
-            if ((current_item == 0) && (condition_string[idx] != ' ') && 
-                (condition_string[idx] != '=') && (condition_string[idx] != '>') && (condition_string[idx] != '<'))
-            {
-                data1 += condition_string[idx];
-            }
-
-            if ((condition_string[idx] == '=') || (condition_string[idx] == '>') || (condition_string[idx] == '<'))
-            {
-                current_item = 2;
-                condition += condition_string[idx];
-            } 
-            else if ((current_item == 2) && (condition_string[idx] != ' ') && (condition_string[idx] != '\t'))
-            {
-                data2 += condition_string[idx];
-            }
+            bits |= (uint64_t)compare_values<OP>(values[word_idx * 64 + bit_idx], literal) << bit_idx;
         }
+        mask[word_idx] = bits;
+    }
+}
 
-        // Get the column that the condition will be run against
-        for (Column column : table_to_parse.table_data)
-        {
-            if (column.column_name == data1)
-            {
-                column_to_parse = column;
-                if (column_to_parse.type == CHAR)
-                    test_data.char_data = data2[0];
-                else if (column_to_parse.type == STRING)
-                    test_data.string_data = data2;
-                else if (column_to_parse.type == INT)
-                    test_data.int_data = stoi(data2);
-                else // FLOAT
-                    test_data.float_data = stof(data2);
-            }
-        }
+/**
+ * Comparison kernel for INT columns that checks 4 values at a time with 
+ * SSE4.2. The rows that do not fill a whole mask word use scalar_kernel.
+*/
+template <int OP>
+__attribute__((target("sse4.2")))
+void sse42_int_kernel(const int32_t *values, int count, int32_t literal, uint64_t *mask)
+{
+    __m128i literal_vector = _mm_set1_epi32(literal);
+    int word_count = count / 64;
 
-        // Go through the column and delete the rows that don't meet the condition
-        // from the entire table
-        for (int idx = 0; idx < column_to_parse.column_data.size(); idx++)
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
+    {
+        uint64_t bits = 0;
+        for (int lane_idx = 0; lane_idx < 64; lane_idx += 4)
         {
-            if (!compare_data_condition(column_to_parse.column_data[idx], test_data, condition, column_to_parse.type))
-            {
-                for (int idx2 = 0; idx2 < table_to_parse.table_data.size(); idx2++)
-                {
-                    table_to_parse.table_data[idx2].column_data.erase(table_to_parse.table_data[idx2].column_data.begin() + idx);
-                }
-                column_to_parse.column_data.erase(column_to_parse.column_data.begin() + idx);
-                idx = idx - 1;
-            }
+            __m128i value_vector = _mm_loadu_si128((const __m128i *)(values + word_idx * 64 + lane_idx));
+            __m128i result;
+            if ((OP == OP_EQ) || (OP == OP_NE))
+                result = _mm_cmpeq_epi32(value_vector, literal_vector);
+            else if ((OP == OP_GT) || (OP == OP_LE))
+                result = _mm_cmpgt_epi32(value_vector, literal_vector);
+            else // OP_LT, OP_GE
+                result = _mm_cmpgt_epi32(literal_vector, value_vector);
+            bits |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(result)) << lane_idx;
         }
-    }   
-    return table_to_parse;
+
+        // The inverted inequalities are computed from their opposites
+        if ((OP == OP_NE) || (OP == OP_LE) || (OP == OP_GE))
+            bits = ~bits;
+        mask[word_idx] = bits;
+    }
+
+    if (word_count * 64 < count)
+        scalar_kernel<OP>(values + word_count * 64, count - word_count * 64, literal, mask + word_count);
 }
 
 /**
- * Function that will sort the given table based on the passed string of 
- * conditions
- * 
- * @param orderby_string A string that contains the comma separated list of 
- *                       orderby conditions.
- * @param table_to_parse A Table object that should be sorted.
- * 
- * @return The sorted table.
+ * Comparison kernel for INT columns that checks 8 values at a time with AVX2.
+ * The rows that do not fill a whole mask word use scalar_kernel.
 */
-Table sort_table(string orderby_string, Table table_to_order)
+template <int OP>
+__attribute__((target("avx2")))
+void avx2_int_kernel(const int32_t *values, int count, int32_t literal, uint64_t *mask)
 {
-    vector<string> order_list = split_string_comma(orderby_string);
-
-    vector<vector<int>> groups;
-    vector<int> initial_group;
-    for (int data_idx = 0; data_idx < table_to_order.table_data[0].column_data.size(); data_idx++)
-    {   
-        initial_group.push_back(data_idx);
-    }
-    groups.push_back(initial_group);
+    __m256i literal_vector = _mm256_set1_epi32(literal);
+    int word_count = count / 64;
 
-    for (string order_string : order_list)
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
     {
-        string data1;
-        string data2;
-        Column column_to_order;
-        int current_item = 0;
-
-        // Get the column and whether the sorting is to be ascending or descending
-        for (int idx = 0; idx < order_string.size(); idx++)
+        uint64_t bits = 0;
+        for (int lane_idx = 0; lane_idx < 64; lane_idx += 8)
         {
-            if ((current_item == 0) && (order_string[idx] != ' ')&& (order_string[idx] != ':'))
-                data1 += order_string[idx];
-            else if (order_string[idx] == ':')
-                current_item = 2;
-            else if ((current_item == 2) && (order_string[idx] != ' '))
-                data2 += order_string[idx];
+            __m256i value_vector = _mm256_loadu_si256((const __m256i *)(values + word_idx * 64 + lane_idx));
+            __m256i result;
+            if ((OP == OP_EQ) || (OP == OP_NE))
+                result = _mm256_cmpeq_epi32(value_vector, literal_vector);
+            else if ((OP == OP_GT) || (OP == OP_LE))
+                result = _mm256_cmpgt_epi32(value_vector, literal_vector);
+            else // OP_LT, OP_GE
+                result = _mm256_cmpgt_epi32(literal_vector, value_vector);
+            bits |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(result)) << lane_idx;
         }
 
-        // Get the column that the condition will be run against
-        for (Column column : table_to_order.table_data)
-        {
-            if (column.column_name == data1)
-                column_to_order = column;
-        }
+        // The inverted inequalities are computed from their opposites
+        if ((OP == OP_NE) || (OP == OP_LE) || (OP == OP_GE))
+            bits = ~bits;
+        mask[word_idx] = bits;
+    }
 
-        string operator_string;
-        if (data2 == "1")
-            operator_string = ">";
-        else if (data2 == "-1")
-            operator_string = "<";
+    if (word_count * 64 < count)
+        scalar_kernel<OP>(values + word_count * 64, count - word_count * 64, literal, mask + word_count);
+}
+
+/**
+ * Comparison kernel for FLOAT columns that checks 4 values at a time with 
+ * SSE4.2. The rows that do not fill a whole mask word use scalar_kernel.
+*/
+template <int OP>
+__attribute__((target("sse4.2")))
+void sse42_float_kernel(const float *values, int count, float literal, uint64_t *mask)
+{
+    __m128 literal_vector = _mm_set1_ps(literal);
+    int word_count = count / 64;
 
-        // Sort the table
-        for (int data_idx = 0; data_idx < column_to_order.column_data.size() - 1; data_idx++)
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
+    {
+        uint64_t bits = 0;
+        for (int lane_idx = 0; lane_idx < 64; lane_idx += 4)
         {
-            bool data1_in_group = false;
-            bool data2_in_group = false;
-            for (int group_idx = 0; group_idx < groups.size(); group_idx++)
-            {
-                if (count(groups[group_idx].begin(), groups[group_idx].end(), data_idx))
-                    data1_in_group = true;
-                if (count(groups[group_idx].begin(), groups[group_idx].end(), data_idx + 1))
-                    data2_in_group = true;
+            __m128 value_vector = _mm_loadu_ps(values + word_idx * 64 + lane_idx);
+            __m128 result;
+            if (OP == OP_EQ)
+                result = _mm_cmpeq_ps(value_vector, literal_vector);
+            else if (OP == OP_NE)
+                result = _mm_cmpneq_ps(value_vector, literal_vector);
+            else if (OP == OP_LT)
+                result = _mm_cmplt_ps(value_vector, literal_vector);
+            else if (OP == OP_LE)
+                result = _mm_cmple_ps(value_vector, literal_vector);
+            else if (OP == OP_GT)
+                result = _mm_cmpgt_ps(value_vector, literal_vector);
+            else // OP_GE
+                result = _mm_cmpge_ps(value_vector, literal_vector);
+            bits |= (uint64_t)_mm_movemask_ps(result) << lane_idx;
+        }
+        mask[word_idx] = bits;
+    }
 
-                if (!data1_in_group || !data2_in_group)
-                {
-                    data1_in_group = false;
-                    data2_in_group = false;
-                }
-                else
-                {
-                    break;
-                }
-            }
+    if (word_count * 64 < count)
+        scalar_kernel<OP>(values + word_count * 64, count - word_count * 64, literal, mask + word_count);
+}
 
-            if (data1_in_group && data2_in_group)
-            {
-                if (compare_data_condition(column_to_order.column_data[data_idx], 
-                                           column_to_order.column_data[data_idx + 1],
-                                           operator_string,
-                                           column_to_order.type) &&
-                    !column_to_order.column_data[data_idx + 1].empty)
-                {
-                    // Swap the column values that we are using to sort the table
-                    iter_swap(column_to_order.column_data.begin() + data_idx,
-                              column_to_order.column_data.begin() + data_idx + 1);
+/**
+ * Comparison kernel for FLOAT columns that checks 8 values at a time with 
+ * AVX2. The rows that do not fill a whole mask word use scalar_kernel.
+*/
+template <int OP>
+__attribute__((target("avx2")))
+void avx2_float_kernel(const float *values, int count, float literal, uint64_t *mask)
+{
+    __m256 literal_vector = _mm256_set1_ps(literal);
+    int word_count = count / 64;
 
-                    // Swap the column values in each column of the table
-                    for (int column_idx = 0; column_idx < table_to_order.table_data.size(); column_idx++)
-                    {
-                        iter_swap(table_to_order.table_data[column_idx].column_data.begin() + data_idx, 
-                                  table_to_order.table_data[column_idx].column_data.begin() + data_idx + 1);
-                    }
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
+    {
+        uint64_t bits = 0;
+        for (int lane_idx = 0; lane_idx < 64; lane_idx += 8)
+        {
+            __m256 value_vector = _mm256_loadu_ps(values + word_idx * 64 + lane_idx);
+            __m256 result;
+            if (OP == OP_EQ)
+                result = _mm256_cmp_ps(value_vector, literal_vector, _CMP_EQ_OQ);
+            else if (OP == OP_NE)
+                result = _mm256_cmp_ps(value_vector, literal_vector, _CMP_NEQ_UQ);
+            else if (OP == OP_LT)
+                result = _mm256_cmp_ps(value_vector, literal_vector, _CMP_LT_OQ);
+            else if (OP == OP_LE)
+                result = _mm256_cmp_ps(value_vector, literal_vector, _CMP_LE_OQ);
+            else if (OP == OP_GT)
+                result = _mm256_cmp_ps(value_vector, literal_vector, _CMP_GT_OQ);
+            else // OP_GE
+                result = _mm256_cmp_ps(value_vector, literal_vector, _CMP_GE_OQ);
+            bits |= (uint64_t)(uint32_t)_mm256_movemask_ps(result) << lane_idx;
+        }
+        mask[word_idx] = bits;
+    }
 
-                    // Reset the index back to zero once the for loop execute
-                    data_idx = -1;
-                }
-                else if (column_to_order.column_data[data_idx].empty)
-                {
-                    // If the next entry is not empty, then move the row with the
-                    // empty element down
-                    if (!column_to_order.column_data[data_idx + 1].empty)
-                    {
-                        // Swap the column values that we are using to sort the table
-                        iter_swap(column_to_order.column_data.begin() + data_idx,
-                                  column_to_order.column_data.begin() + data_idx + 1);
-
-                        // Swap the column values in each column of the table
-                        for (int column_idx = 0; column_idx < table_to_order.table_data.size(); column_idx++)
-                        {
-                            iter_swap(table_to_order.table_data[column_idx].column_data.begin() + data_idx, 
-                                      table_to_order.table_data[column_idx].column_data.begin() + data_idx + 1);
-                        }
-                        // Reset the index back to zero once the for loop execute
-                        data_idx = -1;
-                    }
+    if (word_count * 64 < count)
+        scalar_kernel<OP>(values + word_count * 64, count - word_count * 64, literal, mask + word_count);
+}
 
-                }
-            }
-        }
+/**
+ * Runs the kernel for an inequality using the instruction set picked by 
+ * kernel_simd_level.
+*/
+template <int OP>
+void run_kernel(const int32_t *values, int count, int32_t literal, uint64_t *mask)
+{
+    if (kernel_simd_level == SIMD_AVX2)
+        avx2_int_kernel<OP>(values, count, literal, mask);
+    else if (kernel_simd_level == SIMD_SSE42)
+        sse42_int_kernel<OP>(values, count, literal, mask);
+    else
+        scalar_kernel<OP>(values, count, literal, mask);
+}
+template <int OP>
+void run_kernel(const float *values, int count, float literal, uint64_t *mask)
+{
+    if (kernel_simd_level == SIMD_AVX2)
+        avx2_float_kernel<OP>(values, count, literal, mask);
+    else if (kernel_simd_level == SIMD_SSE42)
+        sse42_float_kernel<OP>(values, count, literal, mask);
+    else
+        scalar_kernel<OP>(values, count, literal, mask);
+}
 
-        // Set up groups based on if the column to compare has the same value
-        vector<vector<int>> new_groups;
-        for (int data_idx = 0; data_idx < column_to_order.column_data.size(); data_idx++)
-        {
-            bool found_group = false;
-            for (int group_idx = 0; group_idx < new_groups.size(); group_idx++)
-            {
-                if (compare_data_condition(column_to_order.column_data[new_groups[group_idx][0]], 
-                                           column_to_order.column_data[data_idx],
-                                           "=",
-                                           column_to_order.type))
-                {
-                    // Check if the one of the new groups idxes is in the same old group 
-                    // as the current data_idx
-                    for (int old_group_idx = 0; old_group_idx < groups.size(); old_group_idx++)
-                    {
-                        if (count(groups[old_group_idx].begin(), groups[old_group_idx].end(), data_idx &&
-                            count(groups[old_group_idx].begin(), groups[old_group_idx].end(), new_groups[group_idx][0])))
-                        {
-                            new_groups[group_idx].push_back(data_idx);
-                            found_group = true;
-                        }
-                    }
-                }
-            }
+/**
+ * Compares count values against a literal and sets bit i of the mask when 
+ * value i passes the inequality. The mask must hold (count + 63) / 64 words.
+ * 
+ * @param values  The values to compare.
+ * @param count   The number of values.
+ * @param literal The value to compare against.
+ * @param op      The inequality to test.
+ * @param mask    The bitmask to write.
+*/
+void compare_kernel(const int32_t *values, int count, int32_t literal, enum compare_op op, uint64_t *mask)
+{
+    if (op == OP_EQ)
+        run_kernel<OP_EQ>(values, count, literal, mask);
+    else if (op == OP_NE)
+        run_kernel<OP_NE>(values, count, literal, mask);
+    else if (op == OP_LT)
+        run_kernel<OP_LT>(values, count, literal, mask);
+    else if (op == OP_LE)
+        run_kernel<OP_LE>(values, count, literal, mask);
+    else if (op == OP_GT)
+        run_kernel<OP_GT>(values, count, literal, mask);
+    else // OP_GE
+        run_kernel<OP_GE>(values, count, literal, mask);
+}
+void compare_kernel(const float *values, int count, float literal, enum compare_op op, uint64_t *mask)
+{
+    if (op == OP_EQ)
+        run_kernel<OP_EQ>(values, count, literal, mask);
+    else if (op == OP_NE)
+        run_kernel<OP_NE>(values, count, literal, mask);
+    else if (op == OP_LT)
+        run_kernel<OP_LT>(values, count, literal, mask);
+    else if (op == OP_LE)
+        run_kernel<OP_LE>(values, count, literal, mask);
+    else if (op == OP_GT)
+        run_kernel<OP_GT>(values, count, literal, mask);
+    else // OP_GE
+        run_kernel<OP_GE>(values, count, literal, mask);
+}
 
-            if (!found_group)
-            {
-                vector<int> group;
-                group.push_back(data_idx);
-                new_groups.push_back(group);
-            }
+/**
+ * Sum kernel for INT columns that adds one value at a time. Rows whose null
+ * bit is set are skipped.
+*/
+void scalar_sum_kernel(const int32_t *values, const uint64_t *null_words, int word_count, int64_t &sum)
+{
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
+    {
+        uint64_t null_word = null_words[word_idx];
+        for (int bit_idx = 0; bit_idx < 64; bit_idx++)
+        {
+            if (!((null_word >> bit_idx) & 1))
+                sum += values[word_idx * 64 + bit_idx];
         }
-
-        groups = new_groups;
     }
-    return table_to_order;
 }
 
 /**
- * Function that will parse the select statment, and perform the desired
- * operations.
- * 
- * @param select_string   The string that contains the select statement.
- * @param table_to_select The table that the select statement should be run on.
- * 
- * @return Table with only the desired columns.
+ * Sum kernel for INT columns that widens and adds 4 values at a time with 
+ * SSE4.2. The values of empty rows are masked to 0.
 */
-Table select_columns(string select_string, Table table_to_select)
+__attribute__((target("sse4.2")))
+void sse42_sum_kernel(const int32_t *values, const uint64_t *null_words, int word_count, int64_t &sum)
 {
-    vector<string> select_list = split_string_comma(select_string);
-    Table new_table;
-    bool add_column = false;
-    vector<string> columns_to_include_or_remove;
+    __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    __m128i sum_low = _mm_setzero_si128();
+    __m128i sum_high = _mm_setzero_si128();
 
-    for (string select_string: select_list)
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
     {
-        string data1;
-        string data2;
-        int current_item = 0;
-
-        // Get the column and whether the sorting is to be ascending or descending
-        for (int idx = 0; idx < select_string.size(); idx++)
+        uint64_t valid_bits = ~null_words[word_idx];
+        for (int lane_idx = 0; lane_idx < 64; lane_idx += 4)
         {
-            if ((current_item == 0) && (select_string[idx] != ' ') && (select_string[idx] != ':'))
-            {
-                if (select_string[idx] == '*')
-                    return table_to_select;
-                data1 += select_string[idx];
-            }
-            else if (select_string[idx] == ':')
-                current_item = 2;
-            else if ((current_item == 2) && (select_string[idx] != ' '))
-                data2 += select_string[idx];
+            __m128i value_vector = _mm_loadu_si128((const __m128i *)(values + word_idx * 64 + lane_idx));
+            __m128i valid_vector = _mm_set1_epi32((valid_bits >> lane_idx) & 0xF);
+            value_vector = _mm_and_si128(value_vector, _mm_cmpeq_epi32(_mm_and_si128(valid_vector, lane_bits), lane_bits));
+            sum_low = _mm_add_epi64(sum_low, _mm_cvtepi32_epi64(value_vector));
+            sum_high = _mm_add_epi64(sum_high, _mm_cvtepi32_epi64(_mm_srli_si128(value_vector, 8)));
         }
+    }
 
-        if (data2 == "1")
-            add_column = true;
+    int64_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, sum_low);
+    _mm_storeu_si128((__m128i *)(lanes + 2), sum_high);
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
 
-        columns_to_include_or_remove.push_back(data1);
-    }
+/**
+ * Sum kernel for INT columns that widens and adds 8 values at a time with 
+ * AVX2. The values of empty rows are masked to 0.
+*/
+__attribute__((target("avx2")))
+void avx2_sum_kernel(const int32_t *values, const uint64_t *null_words, int word_count, int64_t &sum)
+{
+    __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i sum_low = _mm256_setzero_si256();
+    __m256i sum_high = _mm256_setzero_si256();
 
-    // Include columns based on the list
-    if (add_column)
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
     {
-        for (int idx = 0; idx < columns_to_include_or_remove.size(); idx++)
+        uint64_t valid_bits = ~null_words[word_idx];
+        for (int lane_idx = 0; lane_idx < 64; lane_idx += 8)
         {
-            for (int column_idx = 0; column_idx < table_to_select.table_data.size(); column_idx++)
-            {
-                if (table_to_select.table_data[column_idx].column_name == columns_to_include_or_remove[idx])
-                    new_table.table_data.push_back(table_to_select.table_data[column_idx]);
-            }
+            __m256i value_vector = _mm256_loadu_si256((const __m256i *)(values + word_idx * 64 + lane_idx));
+            __m256i valid_vector = _mm256_set1_epi32((valid_bits >> lane_idx) & 0xFF);
+            value_vector = _mm256_and_si256(value_vector, 
+                                            _mm256_cmpeq_epi32(_mm256_and_si256(valid_vector, lane_bits), lane_bits));
+            sum_low = _mm256_add_epi64(sum_low, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(value_vector)));
+            sum_high = _mm256_add_epi64(sum_high, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(value_vector, 1)));
         }
     }
-    else // Remove columns based on the list
+
+    int64_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, sum_low);
+    _mm256_storeu_si256((__m256i *)(lanes + 4), sum_high);
+    for (int64_t lane : lanes)
+    {
+        sum += lane;
+    }
+}
+
+/**
+ * Sum kernel for FLOAT columns that adds one value at a time. The values are
+ * added in doubles, into 8 lanes by position the same way as the vector 
+ * kernels so that every instruction set gives the same sum.
+*/
+void scalar_sum_kernel(const float *values, const uint64_t *null_words, int word_count, double &sum)
+{
+    double lanes[8] = { 0.0 };
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
     {
-        for (int column_idx = 0; column_idx < table_to_select.table_data.size(); column_idx++)
+        uint64_t null_word = null_words[word_idx];
+        for (int bit_idx = 0; bit_idx < 64; bit_idx++)
         {
-            if (0 == count(columns_to_include_or_remove.begin(),
-                           columns_to_include_or_remove.end(),
-                           table_to_select.table_data[column_idx].column_name))
-            {
-                new_table.table_data.push_back(table_to_select.table_data[column_idx]);
-            }
+            lanes[bit_idx % 8] += ((null_word >> bit_idx) & 1) ? 0.0 : (double)values[word_idx * 64 + bit_idx];
         }
     }
 
-    return new_table;
+    double total = 0.0;
+    for (double lane : lanes)
+    {
+        total += lane;
+    }
+    sum += total;
 }
 
 /**
- * Prints out the table to stdin.
- * 
- * @param table_to_print The table to print.
+ * Sum kernel for FLOAT columns that converts and adds 4 values at a time with
+ * SSE4.2. The values of empty rows are masked to 0.
 */
-void print_table(Table table_to_print)
+__attribute__((target("sse4.2")))
+void sse42_sum_kernel(const float *values, const uint64_t *null_words, int word_count, double &sum)
 {
-    // Print the column names in a comma seperated list
-    for (int column_idx = 0; column_idx < table_to_print.table_data.size(); column_idx++)
-    {
-        cout << table_to_print.table_data[column_idx].column_name;
-        if (column_idx == table_to_print.table_data.size() - 1)
-            cout << endl;
-        else
-            cout << ",";
-    }
+    __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    __m128d sum_vectors[4] = { _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd() };
 
-    // Print each row of data in the table
-    for (int row_idx = 0; row_idx < table_to_print.table_data[0].column_data.size(); row_idx++)
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
     {
-        for (int column_idx = 0; column_idx < table_to_print.table_data.size(); column_idx++)
+        uint64_t valid_bits = ~null_words[word_idx];
+        for (int lane_idx = 0; lane_idx < 64; lane_idx += 4)
         {
-            if (table_to_print.table_data[column_idx].column_data[row_idx].empty)
-                cout << "";
-            else if (table_to_print.table_data[column_idx].type == CHAR)
-                cout << table_to_print.table_data[column_idx].column_data[row_idx].char_data;
-            else if (table_to_print.table_data[column_idx].type == STRING)
-                cout << table_to_print.table_data[column_idx].column_data[row_idx].string_data;
-            else if (table_to_print.table_data[column_idx].type == INT)
-                cout << table_to_print.table_data[column_idx].column_data[row_idx].int_data;
-            else if (table_to_print.table_data[column_idx].type == FLOAT)
-                cout << table_to_print.table_data[column_idx].column_data[row_idx].float_data;
+            __m128 value_vector = _mm_loadu_ps(values + word_idx * 64 + lane_idx);
+            __m128i valid_vector = _mm_set1_epi32((valid_bits >> lane_idx) & 0xF);
+            value_vector = _mm_and_ps(value_vector, 
+                                      _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(valid_vector, lane_bits), lane_bits)));
 
-            if (column_idx == table_to_print.table_data.size() - 1)
-                cout << endl;
-            else
-                cout << ",";
+            int vector_idx = (lane_idx % 8) / 2;
+            sum_vectors[vector_idx] = _mm_add_pd(sum_vectors[vector_idx], _mm_cvtps_pd(value_vector));
+            sum_vectors[vector_idx + 1] = _mm_add_pd(sum_vectors[vector_idx + 1], 
+                                                     _mm_cvtps_pd(_mm_movehl_ps(value_vector, value_vector)));
         }
     }
-    cout << endl;
+
+    double lanes[8];
+    for (int vector_idx = 0; vector_idx < 4; vector_idx++)
+    {
+        _mm_storeu_pd(lanes + vector_idx * 2, sum_vectors[vector_idx]);
+    }
+
+    double total = 0.0;
+    for (double lane : lanes)
+    {
+        total += lane;
+    }
+    sum += total;
 }
 
 /**
- * Parse a space seperated string of words.
- * 
- * @param string_to_parse THe string of space seperated words.
- * 
- * @return A vector of parsed words.
+ * Sum kernel for FLOAT columns that converts and adds 8 values at a time with
+ * AVX2. The values of empty rows are masked to 0.
 */
-vector<string> split_string_space(string string_to_parse)
+__attribute__((target("avx2")))
+void avx2_sum_kernel(const float *values, const uint64_t *null_words, int word_count, double &sum)
 {
-    vector<string> result;
-    string new_string = "";
-    for (int char_idx = 0; char_idx < string_to_parse.size(); char_idx++)
+    __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256d sum_low = _mm256_setzero_pd();
+    __m256d sum_high = _mm256_setzero_pd();
+
+    for (int word_idx = 0; word_idx < word_count; word_idx++)
     {
-        if (string_to_parse[char_idx] == ' ' || string_to_parse[char_idx] == '\t')
-        {
-            // Loop and remove any whitespace
-            while (string_to_parse[char_idx] == ' ' || string_to_parse[char_idx] == '\t')
-            {
-                char_idx++;
-            }
-            char_idx--; // For loop will hanle the last increment
-            result.push_back(new_string);
-            new_string = "";
-        }
-        else
+        uint64_t valid_bits = ~null_words[word_idx];
+        for (int lane_idx = 0; lane_idx < 64; lane_idx += 8)
         {
-            new_string.push_back(string_to_parse[char_idx]);
+            __m256 value_vector = _mm256_loadu_ps(values + word_idx * 64 + lane_idx);
+            __m256i valid_vector = _mm256_set1_epi32((valid_bits >> lane_idx) & 0xFF);
+            value_vector = _mm256_and_ps(value_vector, 
+                                         _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(valid_vector, lane_bits), 
+                                                                                lane_bits)));
+            sum_low = _mm256_add_pd(sum_low, _mm256_cvtps_pd(_mm256_castps256_ps128(value_vector)));
+            sum_high = _mm256_add_pd(sum_high, _mm256_cvtps_pd(_mm256_extractf128_ps(value_vector, 1)));
         }
     }
-    return result;
+
+    double lanes[8];
+    _mm256_storeu_pd(lanes, sum_low);
+    _mm256_storeu_pd(lanes + 4, sum_high);
+
+    double total = 0.0;
+    for (double lane : lanes)
+    {
+        total += lane;
+    }
+    sum += total;
 }
 
 /**
- * Parse a comma seperated string of words.
+ * Adds the values of whole null bitmap words of rows to a sum, skipping the
+ * empty rows. Uses the instruction set picked by kernel_simd_level.
  * 
- * @param string_to_parse The string of comma seperated words.
+ * @param values     The values of the first row of the first word onwards.
+ * @param null_words The null bitmap words of the rows.
+ * @param word_count The number of words, each covering 64 rows.
+ * @param sum        The sum to add to.
+*/
+void sum_kernel(const int32_t *values, const uint64_t *null_words, int word_count, int64_t &sum)
+{
+    if (kernel_simd_level == SIMD_AVX2)
+        avx2_sum_kernel(values, null_words, word_count, sum);
+    else if (kernel_simd_level == SIMD_SSE42)
+        sse42_sum_kernel(values, null_words, word_count, sum);
+    else
+        scalar_sum_kernel(values, null_words, word_count, sum);
+}
+void sum_kernel(const float *values, const uint64_t *null_words, int word_count, double &sum)
+{
+    if (kernel_simd_level == SIMD_AVX2)
+        avx2_sum_kernel(values, null_words, word_count, sum);
+    else if (kernel_simd_level == SIMD_SSE42)
+        sse42_sum_kernel(values, null_words, word_count, sum);
+    else
+        scalar_sum_kernel(values, null_words, word_count, sum);
+}
+
+/**
+ * Function to trim any leading or trailing whitespace from a string.
  * 
- * @return A vector of the parsed words.
+ * @param string_to_trim The string that we want to be trimmed.
+ * 
+ * @return The trimmed string.
 */
-vector<string> split_string_comma(string string_to_parse)
+string trim(string string_to_trim)
 {
-    vector<string> result;
-    // Create string stream from the string
-    stringstream s_stream(string_to_parse);
-    while(s_stream.good()) 
+    size_t p = string_to_trim.find_first_not_of(" \t");
+    string_to_trim.erase(0, p);
+   
+    p = string_to_trim.find_last_not_of(" \t");
+    if (string::npos != p)
+         string_to_trim.erase(p+1);
+    return string_to_trim;
+}
+
+/**
+ * Parses a whole number without creating a string.
+ * 
+ * @param field_begin The first character of the number.
+ * @param field_end   One past the last character of the number.
+ * @param value       The parsed number, left as it is if the field is not 
+ *                    valid.
+ * 
+ * @return True if the whole field is a number that fits in an int32_t.
+*/
+bool parse_int(const char *field_begin, const char *field_end, int32_t &value)
+{
+    bool negative = false;
+    if ((field_begin < field_end) && (*field_begin == '-' || *field_begin == '+'))
     {
-        string substr;
-        // Get string delimited by comma
-        getline(s_stream, substr, ',');
-        result.push_back(substr);
+        negative = (*field_begin == '-');
+        field_begin++;
     }
 
-    return result;
+    // The magnitude of INT32_MIN is one more than INT32_MAX
+    const char *digits_begin = field_begin;
+    int64_t limit = (int64_t)INT32_MAX + (negative ? 1 : 0);
+    int64_t result = 0;
+    while ((field_begin < field_end) && (*field_begin >= '0') && (*field_begin <= '9'))
+    {
+        result = result * 10 + (*field_begin - '0');
+        if (result > limit)
+            return false;
+        field_begin++;
+    }
+    if ((field_begin == digits_begin) || (field_begin != field_end))
+        return false;
+
+    value = negative ? -result : result;
+    return true;
 }
 
 /**
- * Converts a type string to its appropiated enum value
+ * Parses a decimal number without creating a string, the field is copied to 
+ * a buffer on the stack so it can be passed to strtof.
  * 
- * @param type_string Enum type in string form.
+ * @param field_begin The first character of the number.
+ * @param field_end   One past the last character of the number.
+ * @param value       The parsed number.
  * 
- * @return The enum value of the string.
+ * @return True if the field starts with a number.
 */
-enum data_type get_type(string type_string)
+bool parse_float(const char *field_begin, const char *field_end, float &value)
 {
-    if ("CHAR" == type_string)
-        return CHAR;
-    else if ("STRING" == type_string)
-        return STRING;
-    else if("INT" == type_string)
-        return INT;
-    else if ("FLOAT" == type_string)
-        return FLOAT;
-    else
-    {
-        cout << "Invalid type parsed!!!" << endl;
-        return STRING;
-    }
+    char buffer[64];
+    size_t length = min((size_t)(field_end - field_begin), sizeof(buffer) - 1);
+    memcpy(buffer, field_begin, length);
+    buffer[length] = '\0';
+
+    char *number_end;
+    value = strtof(buffer, &number_end);
+    return number_end != buffer;
 }
 
 /**
- * Compares the two data items based on the given inequality.
+ * Parses a whole number given on the command line. Unlike stoi nothing is 
+ * thrown, so a bad argument can be answered with the usage line.
  * 
- * @param stored_data The value that will be on the left hand side of the inequality.
- * @param test_data   The value that will be on the right hand side of the inequality.
- * @param inequality  The operators that will be used in the inequality.
+ * @param text      The argument.
+ * @param min_value The smallest number that is accepted.
+ * @param value     The parsed number.
  * 
- * @return The result of the inequality.
+ * @return True if the whole argument is a number of at least min_value that
+ *         fits in an int.
 */
-bool compare_data_condition(Data stored_data, Data test_data, string inequality, enum data_type type)
+bool parse_argument(const char *text, long min_value, int &value)
 {
-    if (stored_data.empty)
-        return false;
-    else if (type == CHAR)
-        return compare_char_condition(stored_data, test_data, inequality);
-    else if (type == STRING)
-        return compare_string_condition(stored_data, test_data, inequality);
-    else if (type == INT)
-        return compare_int_condition(stored_data, test_data, inequality);
-    else if (type == FLOAT)
-        return compare_float_condition(stored_data, test_data, inequality);
-    else
+    char *number_end = NULL;
+    errno = 0;
+    long number = strtol(text, &number_end, 10);
+    if ((number_end == text) || (*number_end != '\0') || (errno == ERANGE) || 
+        (number < min_value) || (number > INT_MAX))
         return false;
+
+    value = (int)number;
+    return true;
 }
-bool compare_char_condition(Data stored_data, Data test_data, string inequality)
-{
-    if (inequality == ">")
-        return stored_data.char_data > test_data.char_data;
-    else if (inequality == "<")
-        return stored_data.char_data < test_data.char_data;
-    else if (inequality == "=")
-        return stored_data.char_data == test_data.char_data;
-    else if (inequality == "<>")
-        return stored_data.char_data != test_data.char_data;
-    else if (inequality == ">=")
-        return stored_data.char_data >= test_data.char_data;
-    else if (inequality == "<=")
-        return stored_data.char_data <= test_data.char_data;
-    else
-        return false;
+
+/**
+ * Starts the worker threads, replacing any that are running. The thread that
+ * runs jobs counts as one of the threads, so one less worker is started.
+ * 
+ * @param thread_count The number of threads that run each job.
+*/
+void Thread_Pool::start(int thread_count)
+{
+    stop();
+    if (thread_count <= 1)
+        return;
+
+    vector<morsel_queue>(thread_count).swap(queues);
+    for (int queue_idx = 1; queue_idx < thread_count; queue_idx++)
+    {
+        workers.push_back(thread(&Thread_Pool::worker_loop, this, queue_idx));
+    }
 }
-bool compare_string_condition(Data stored_data,Data test_data, string inequality)
-{
-    if (inequality == ">")
-        return stored_data.string_data > test_data.string_data;
-    else if (inequality == "<")
-        return stored_data.string_data < test_data.string_data;
-    else if (inequality == "=")
-        return stored_data.string_data == test_data.string_data;
-    else if (inequality == "<>")
-        return stored_data.string_data != test_data.string_data;
-    else if (inequality == ">=")
-        return stored_data.string_data >= test_data.string_data;
-    else if (inequality == "<=")
-        return stored_data.string_data <= test_data.string_data;
-    else
-        return false;
+
+/**
+ * Stops the worker threads, waiting for them to finish. Jobs then run on the
+ * calling thread.
+*/
+void Thread_Pool::stop()
+{
+    {
+        lock_guard<mutex> state_lock(state_mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    workers.clear();
+    vector<morsel_queue>().swap(queues);
+    stopping = false;
 }
-bool compare_int_condition(Data stored_data, Data test_data, string inequality)
-{
-    if (inequality == ">")
-        return stored_data.int_data > test_data.int_data;
-    else if (inequality == "<")
-        return stored_data.int_data < test_data.int_data;
-    else if (inequality == "=")
-        return stored_data.int_data == test_data.int_data;
-    else if (inequality == "<>")
-        return stored_data.int_data != test_data.int_data;
-    else if (inequality == ">=")
-        return stored_data.int_data >= test_data.int_data;
-    else if (inequality == "<=")
-        return stored_data.int_data <= test_data.int_data;
-    else
-        return false;
+
+/**
+ * Runs every morsel of a job and waits for them to finish. Without workers 
+ * the morsels are run in order on the calling thread.
+ * 
+ * @param morsel_count The number of morsels in the job.
+ * @param run_morsel   The function that runs one morsel, given its index. It 
+ *                     is called from several threads at once and must not 
+ *                     start another job.
+*/
+void Thread_Pool::run_morsels(int morsel_count, const function<void(int)> &run_morsel)
+{
+    if (workers.empty() || (morsel_count <= 1))
+    {
+        for (int morsel_idx = 0; morsel_idx < morsel_count; morsel_idx++)
+        {
+            run_morsel(morsel_idx);
+        }
+        return;
+    }
+
+    // Only one job runs at a time
+    lock_guard<mutex> job_lock(job_mutex);
+    job = &run_morsel;
+    job_allocations = allocation_counter;
+    pending_morsels = morsel_count;
+
+    // Each queue gets a run of neighbouring morsels
+    for (int queue_idx = 0; queue_idx < queues.size(); queue_idx++)
+    {
+        lock_guard<mutex> queue_lock(queues[queue_idx].queue_mutex);
+        for (int morsel_idx = (long)morsel_count * queue_idx / queues.size(); 
+             morsel_idx < (long)morsel_count * (queue_idx + 1) / queues.size(); morsel_idx++)
+        {
+            queues[queue_idx].morsels.push_back(morsel_idx);
+        }
+    }
+
+    {
+        lock_guard<mutex> state_lock(state_mutex);
+        job_generation++;
+    }
+    work_ready.notify_all();
+
+    run_queue(0);
+
+    unique_lock<mutex> state_lock(state_mutex);
+    job_done.wait(state_lock, [this]() { return pending_morsels == 0; });
 }
-bool compare_float_condition(Data stored_data, Data test_data, string inequality)
-{
-    if (inequality == ">")
-        return stored_data.float_data > test_data.float_data;
-    else if (inequality == "<")
-        return stored_data.float_data < test_data.float_data;
-    else if (inequality == "=")
-        return stored_data.float_data == test_data.float_data;
-    else if (inequality == "<>")
-        return stored_data.float_data != test_data.float_data;
-    else if (inequality == ">=")
-        return stored_data.float_data >= test_data.float_data;
-    else if (inequality == "<=")
-        return stored_data.float_data <= test_data.float_data;
-    else
-        return false;
+
+/**
+ * The loop of a worker thread, which works on each new job until the pool
+ * is stopped.
+ * 
+ * @param queue_idx The worker's queue.
+*/
+void Thread_Pool::worker_loop(int queue_idx)
+{
+    long seen_generation = 0;
+    while (1)
+    {
+        {
+            unique_lock<mutex> state_lock(state_mutex);
+            work_ready.wait(state_lock, [&]() { return stopping || (job_generation != seen_generation); });
+            if (stopping)
+                return;
+            seen_generation = job_generation;
+        }
+
+        run_queue(queue_idx);
+    }
 }
 
 /**
- * Function to trim any leading or trailing whitespace from a string.
+ * Runs morsels of the current job until there are none left to run or steal.
  * 
- * @param string_to_trim The string that we want to be trimmed.
+ * @param queue_idx The queue of the thread.
+*/
+void Thread_Pool::run_queue(int queue_idx)
+{
+    // The morsels allocate for the thread that started the job
+    atomic<int64_t> *thread_counter = allocation_counter;
+    allocation_counter = job_allocations;
+
+    int morsel_idx;
+    while (next_morsel(queue_idx, morsel_idx))
+    {
+        (*job)(morsel_idx);
+
+        if (--pending_morsels == 0)
+        {
+            lock_guard<mutex> state_lock(state_mutex);
+            job_done.notify_all();
+        }
+    }
+    allocation_counter = thread_counter;
+}
+
+/**
+ * Takes the next morsel from a thread's own queue, or steals the last morsel
+ * of another queue if its own is empty.
  * 
- * @return The trimmed string.
+ * @param queue_idx  The queue of the thread.
+ * @param morsel_idx The morsel to run.
+ * 
+ * @return False if every queue is empty.
 */
-string trim(string string_to_trim)
+bool Thread_Pool::next_morsel(int queue_idx, int &morsel_idx)
 {
-    size_t p = string_to_trim.find_first_not_of(" \t");
-    string_to_trim.erase(0, p);
-   
-    p = string_to_trim.find_last_not_of(" \t");
-    if (string::npos != p)
-         string_to_trim.erase(p+1);
-    return string_to_trim;
+    for (int offset = 0; offset < queues.size(); offset++)
+    {
+        morsel_queue &queue = queues[(queue_idx + offset) % queues.size()];
+        lock_guard<mutex> queue_lock(queue.queue_mutex);
+        if (queue.morsels.empty())
+            continue;
+
+        if (offset == 0)
+        {
+            morsel_idx = queue.morsels.front();
+            queue.morsels.pop_front();
+        }
+        else
+        {
+            morsel_idx = queue.morsels.back();
+            queue.morsels.pop_back();
+        }
+        return true;
+    }
+    return false;
 }
\ No newline at end of file
@@ -0,0 +1,640 @@
+// Generates a synthetic database at any scale. The columns of each table are
+// written in the order TAB_COLUMNS.csv lists them, so the output loads with
+// the same schema as the shipped data. Names, cities and project numbers are
+// skewed, and some values are left empty.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+using namespace std;
+
+/**
+ * A column of the schema, read from TAB_COLUMNS.csv.
+ *
+ * @var column_name The name of the column.
+ * @var type_name   The type of the column, INT, FLOAT, CHAR or STRING.
+ * @var column_num  The position of the column in the table, starting at 1.
+*/
+typedef struct schema_column
+{
+    string column_name;
+    string type_name;
+    int column_num;
+} Schema_Column;
+
+/**
+ * A table of the schema.
+ *
+ * @var table_name The name of the table.
+ * @var columns    The columns of the table, in file order.
+*/
+typedef struct schema_table
+{
+    string table_name;
+    vector<Schema_Column> columns;
+} Schema_Table;
+
+/**
+ * Picks items from a list with Zipf skew, the first item is picked most often.
+*/
+class Zipf_Distribution
+{
+public:
+    Zipf_Distribution(int item_count, double exponent);
+    int operator()(mt19937_64 &generator);
+
+private:
+    vector<double> cumulative;
+    uniform_real_distribution<double> uniform;
+};
+
+/**
+ * The kinds of values a column can be filled with. The columns of the shipped
+ * tables get values that look like the shipped data, any other column gets
+ * random values of its type.
+*/
+enum value_kind
+{
+    VALUE_TC_LEVEL,
+    VALUE_FIRST_NAME,
+    VALUE_INITIAL,
+    VALUE_LAST_NAME,
+    VALUE_SSN,
+    VALUE_BIRTH_DATE,
+    VALUE_ADDRESS,
+    VALUE_CITY,
+    VALUE_STATE,
+    VALUE_SEX,
+    VALUE_SALARY,
+    VALUE_SUPERVISOR,
+    VALUE_EMPLOYEE,
+    VALUE_PROJECT,
+    VALUE_HOURS,
+    VALUE_PROJECT_NAME,
+    VALUE_ROW_NUMBER,
+    VALUE_VESSEL,
+    VALUE_OBJECTIVE,
+    VALUE_DESTINATION,
+    VALUE_RANDOM_INT,
+    VALUE_RANDOM_FLOAT,
+    VALUE_RANDOM_CHAR,
+    VALUE_RANDOM_STRING
+};
+
+/**
+ * The state shared by the value generators of one table.
+ *
+ * @var row_idx        The row being generated.
+ * @var employee_count The number of rows in EMPLOYEE.
+ * @var project_count  The number of rows in PROJECT.
+ * @var generator      The random number generator.
+*/
+typedef struct row_state
+{
+    long row_idx;
+    long employee_count;
+    long project_count;
+    mt19937_64 generator;
+} Row_State;
+
+// Names the values are picked from
+const char *FIRST_NAMES[] = { "James", "Mary", "John", "Patricia", "Robert", "Jennifer", "Michael", "Linda",
+                              "William", "Elizabeth", "David", "Barbara", "Richard", "Susan", "Joseph", "Jessica",
+                              "Thomas", "Sarah", "Charles", "Karen", "Franklin", "Alicia", "Alice", "Ramesh",
+                              "Joyce", "Ahmad", "Kevin", "Maria", "Jose", "Wei", "Priya", "Olga" };
+const char *LAST_NAMES[] = { "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller", "Davis",
+                             "Rodriguez", "Martinez", "Hernandez", "Lopez", "Gonzalez", "Wilson", "Anderson",
+                             "Thomas", "Taylor", "Moore", "Jackson", "Martin", "Lee", "Perez", "Thompson", "White",
+                             "Wong", "Zelaya", "Narayan", "English", "Jabbar", "Borg", "Nguyen", "Kim", "Patel",
+                             "Chen", "Singh", "Walker", "Young", "Allen", "King", "Wright" };
+const char *STREETS[] = { "Main", "Fondren", "Voss", "Castle", "Fire Oak", "Rice", "Stone", "Berry", "Oak",
+                          "Elm", "Maple", "Cedar", "Pine", "Westheimer", "Kirby", "Shepherd" };
+const char *CITIES[] = { "Houston", "Bellaire", "Sugarland", "Stafford", "Spring", "Humble", "Katy", "Pasadena",
+                         "Pearland", "Cypress", "Conroe", "Baytown", "Galveston", "Austin", "Dallas", "San Antonio",
+                         "El Paso", "Fort Worth", "Arlington", "Plano" };
+const char *STATES[] = { "TX", "LA", "OK", "NM", "AR", "CA", "NY", "FL" };
+const char *VESSELS[] = { "Micra", "Vision", "Avenger", "Falcon", "Corvette", "Destroyer", "Shuttle", "Frigate",
+                          "Cruiser", "Freighter", "Scout", "Bomber" };
+const char *OBJECTIVES[] = { "Shipping", "Spying", "Mining", "Patrol", "Rescue", "Research", "Attack", "Escort" };
+const char *DESTINATIONS[] = { "Moon", "Mars", "Saturn", "Jupiter", "Venus", "Mercury", "Neptune", "Uranus",
+                               "Pluto", "Titan", "Europa", "Io" };
+
+// How often values are left empty
+const double SALARY_NULL_RATE = 0.02;
+const double SUPERSSN_NULL_RATE = 0.05;
+const double HOURS_NULL_RATE = 0.03;
+const double OTHER_NULL_RATE = 0.01;
+
+// The first social security number, every employee gets the next one
+const long FIRST_SSN = 100000000;
+
+// Generator functions
+vector<Schema_Table> read_schema(const string &schema_file);
+long parse_scale(const string &scale_string);
+long table_rows(const string &table_name, long employee_count);
+bool write_table(const Schema_Table &table, const string &output_dir, long row_count, long employee_count,
+                 uint64_t seed);
+enum value_kind column_kind(const string &table_name, const Schema_Column &column);
+void append_value(string &line, enum value_kind kind, Row_State &state);
+void append_number(string &line, long value);
+bool copy_file(const string &source_file, const string &target_file);
+
+template <size_t N>
+const char *pick(const char *(&names)[N], Zipf_Distribution &distribution, Row_State &state);
+
+/**
+ * Writes the CSV files of a synthetic database into a directory, together
+ * with the schema and index files they were generated for.
+ *
+ * @param output_dir The directory to write the database to, it is created if
+ *                   it does not exist.
+ * @param rows       The number of EMPLOYEE rows, with an optional k, M or G
+ *                   suffix. WORKS_ON gets twice as many rows, STAR_WAR as
+ *                   many and PROJECT one for every hundred.
+ * @param --seed     The seed of the random values, followed by the number.
+ *                   Defaults to 301.
+ * @param --schema   The directory holding TAB_COLUMNS.csv and the optional
+ *                   TAB_INDEXES.csv, followed by the path. Defaults to the
+ *                   current directory.
+ *
+ * @retval  0 The database was written.
+ * @retval -1 An error was encountered.
+*/
+int main(int argc, char **argv)
+{
+    uint64_t seed = 301;
+    string schema_dir = ".";
+    long employee_count = (argc >= 3) ? parse_scale(argv[2]) : -1;
+    bool valid_arguments = (employee_count > 0);
+    for (int arg_idx = 3; valid_arguments && (arg_idx < argc); arg_idx++)
+    {
+        string argument = argv[arg_idx];
+        if (arg_idx + 1 >= argc)
+            valid_arguments = false;
+        else if (argument == "--seed")
+            seed = stoull(argv[++arg_idx]);
+        else if (argument == "--schema")
+            schema_dir = argv[++arg_idx];
+        else
+            valid_arguments = false;
+    }
+    if (!valid_arguments)
+    {
+        cout << "Usage: " << argv[0] << " <output_dir> <rows, e.g. 10k, 1M, 100M> [--seed <number>] "
+             << "[--schema <dir>]" << endl;
+        return -1;
+    }
+
+    string output_dir = argv[1];
+    vector<Schema_Table> schema = read_schema(schema_dir + "/TAB_COLUMNS.csv");
+    if (schema.empty())
+    {
+        cout << "Invalid schema: " << schema_dir << "/TAB_COLUMNS.csv" << endl;
+        return -1;
+    }
+    mkdir(output_dir.c_str(), 0755);
+    if (!copy_file(schema_dir + "/TAB_COLUMNS.csv", output_dir + "/TAB_COLUMNS.csv"))
+    {
+        cout << "Could not write to " << output_dir << endl;
+        return -1;
+    }
+    copy_file(schema_dir + "/TAB_INDEXES.csv", output_dir + "/TAB_INDEXES.csv");
+
+    for (int table_idx = 0; table_idx < schema.size(); table_idx++)
+    {
+        long row_count = table_rows(schema[table_idx].table_name, employee_count);
+        if (!write_table(schema[table_idx], output_dir, row_count, employee_count, seed + table_idx))
+        {
+            cout << "Could not write " << schema[table_idx].table_name << ".csv" << endl;
+            return -1;
+        }
+        cerr << schema[table_idx].table_name << ": " << row_count << " rows" << endl;
+    }
+    return 0;
+}
+
+/**
+ * Reads the tables and columns of the schema. The lines are in the format
+ * <table>,<column>,<type>,<column_num>.
+ *
+ * @param schema_file The path of TAB_COLUMNS.csv.
+ *
+ * @return The tables with their columns in file order, empty if the file is
+ *         missing or a line is invalid.
+*/
+vector<Schema_Table> read_schema(const string &schema_file)
+{
+    vector<Schema_Table> schema;
+    ifstream input(schema_file);
+    string line;
+    while (getline(input, line))
+    {
+        line.erase(remove(line.begin(), line.end(), '\r'), line.end());
+        if (line.empty())
+            continue;
+
+        vector<string> words;
+        size_t word_begin = 0;
+        size_t comma;
+        while ((comma = line.find(',', word_begin)) != string::npos)
+        {
+            words.push_back(line.substr(word_begin, comma - word_begin));
+            word_begin = comma + 1;
+        }
+        words.push_back(line.substr(word_begin));
+        if ((words.size() != 4) || (words[3].find_first_not_of("0123456789 ") != string::npos))
+            return vector<Schema_Table>();
+
+        Schema_Column column = { words[1], words[2], stoi(words[3]) };
+        vector<Schema_Table>::iterator table = find_if(schema.begin(), schema.end(),
+                                                       [&](const Schema_Table &table)
+                                                       { return table.table_name == words[0]; });
+        if (table == schema.end())
+        {
+            schema.push_back({ words[0], vector<Schema_Column>() });
+            table = schema.end() - 1;
+        }
+        table->columns.push_back(column);
+    }
+
+    for (Schema_Table &table : schema)
+    {
+        sort(table.columns.begin(), table.columns.end(), [](const Schema_Column &left, const Schema_Column &right)
+        {
+            return left.column_num < right.column_num;
+        });
+    }
+    return schema;
+}
+
+/**
+ * Reads a row count with an optional k, M or G suffix.
+ *
+ * @param scale_string The row count, e.g. 10k or 100M.
+ *
+ * @return The number of rows, -1 if the count is invalid.
+*/
+long parse_scale(const string &scale_string)
+{
+    char *number_end = NULL;
+    double rows = strtod(scale_string.c_str(), &number_end);
+    if ((number_end == scale_string.c_str()) || (rows <= 0))
+        return -1;
+
+    string suffix = number_end;
+    if ((suffix == "k") || (suffix == "K"))
+        rows *= 1e3;
+    else if ((suffix == "m") || (suffix == "M"))
+        rows *= 1e6;
+    else if ((suffix == "g") || (suffix == "G"))
+        rows *= 1e9;
+    else if (suffix != "")
+        return -1;
+    return (long)rows;
+}
+
+/**
+ * The number of rows to generate for a table.
+ *
+ * @param table_name     The name of the table.
+ * @param employee_count The number of rows in EMPLOYEE.
+ *
+ * @return The number of rows.
+*/
+long table_rows(const string &table_name, long employee_count)
+{
+    if (table_name == "WORKS_ON")
+        return employee_count * 2;
+    if (table_name == "PROJECT")
+        return max(3L, employee_count / 100);
+    return employee_count;
+}
+
+/**
+ * Writes the rows of one table to <output_dir>/<table>.csv.
+ *
+ * @param table          The table and its columns.
+ * @param output_dir     The directory to write to.
+ * @param row_count      The number of rows to write.
+ * @param employee_count The number of rows in EMPLOYEE, which WORKS_ON and
+ *                       SUPERSSN refer to.
+ * @param seed           The seed of the table's random values.
+ *
+ * @return True if the file was written.
+*/
+bool write_table(const Schema_Table &table, const string &output_dir, long row_count, long employee_count,
+                 uint64_t seed)
+{
+    FILE *output = fopen((output_dir + "/" + table.table_name + ".csv").c_str(), "w");
+    if (output == NULL)
+        return false;
+
+    Row_State state;
+    state.employee_count = employee_count;
+    state.project_count = table_rows("PROJECT", employee_count);
+    state.generator.seed(seed);
+
+    vector<enum value_kind> kinds;
+    for (const Schema_Column &column : table.columns)
+    {
+        kinds.push_back(column_kind(table.table_name, column));
+    }
+
+    // Rows are written in blocks of about a megabyte
+    string block;
+    block.reserve(1 << 21);
+    bool written = true;
+    for (state.row_idx = 0; written && (state.row_idx < row_count); state.row_idx++)
+    {
+        for (int column_idx = 0; column_idx < kinds.size(); column_idx++)
+        {
+            if (column_idx > 0)
+                block.push_back(',');
+            append_value(block, kinds[column_idx], state);
+        }
+        block.push_back('\n');
+
+        if ((block.size() >= (1 << 20)) || (state.row_idx + 1 == row_count))
+        {
+            written = (fwrite(block.data(), 1, block.size(), output) == block.size());
+            block.clear();
+        }
+    }
+    return (fclose(output) == 0) && written;
+}
+
+/**
+ * Finds the kind of values to fill a column with.
+ *
+ * @param table_name The name of the table.
+ * @param column     The column.
+ *
+ * @return The kind of values.
+*/
+enum value_kind column_kind(const string &table_name, const Schema_Column &column)
+{
+    struct known_column
+    {
+        const char *table_name;
+        const char *column_name;
+        enum value_kind kind;
+    };
+    static const known_column known_columns[] = 
+    {
+        { "EMPLOYEE", "FNAME", VALUE_FIRST_NAME }, { "EMPLOYEE", "MINIT", VALUE_INITIAL },
+        { "EMPLOYEE", "LNAME", VALUE_LAST_NAME }, { "EMPLOYEE", "SSN", VALUE_SSN },
+        { "EMPLOYEE", "BDATE", VALUE_BIRTH_DATE }, { "EMPLOYEE", "ADDRESS", VALUE_ADDRESS },
+        { "EMPLOYEE", "CITY", VALUE_CITY }, { "EMPLOYEE", "STATE", VALUE_STATE }, { "EMPLOYEE", "SEX", VALUE_SEX },
+        { "EMPLOYEE", "SALARY", VALUE_SALARY }, { "EMPLOYEE", "SUPERSSN", VALUE_SUPERVISOR },
+        { "WORKS_ON", "ESSN", VALUE_EMPLOYEE }, { "WORKS_ON", "PNO", VALUE_PROJECT },
+        { "WORKS_ON", "HOURS", VALUE_HOURS }, { "PROJECT", "PNAME", VALUE_PROJECT_NAME },
+        { "PROJECT", "PNUMBER", VALUE_ROW_NUMBER }, { "PROJECT", "PLOCATION", VALUE_CITY },
+        { "STAR_WAR", "VESSEL", VALUE_VESSEL }, { "STAR_WAR", "OBJECTIVE", VALUE_OBJECTIVE },
+        { "STAR_WAR", "DESTINATION", VALUE_DESTINATION }
+    };
+
+    if (column.column_name == "TC")
+        return VALUE_TC_LEVEL;
+    for (const known_column &known : known_columns)
+    {
+        if ((table_name == known.table_name) && (column.column_name == known.column_name))
+            return known.kind;
+    }
+
+    if (column.type_name == "INT")
+        return VALUE_RANDOM_INT;
+    if (column.type_name == "FLOAT")
+        return VALUE_RANDOM_FLOAT;
+    if (column.type_name == "CHAR")
+        return VALUE_RANDOM_CHAR;
+    return VALUE_RANDOM_STRING;
+}
+
+/**
+ * Appends the value of one column of the current row. An empty value is 
+ * written as a single space.
+ *
+ * @param line  The text to append to.
+ * @param kind  The kind of value.
+ * @param state The row being generated.
+*/
+void append_value(string &line, enum value_kind kind, Row_State &state)
+{
+    static Zipf_Distribution first_names(sizeof(FIRST_NAMES) / sizeof(FIRST_NAMES[0]), 1.0);
+    static Zipf_Distribution last_names(sizeof(LAST_NAMES) / sizeof(LAST_NAMES[0]), 1.1);
+    static Zipf_Distribution streets(sizeof(STREETS) / sizeof(STREETS[0]), 0.8);
+    static Zipf_Distribution cities(sizeof(CITIES) / sizeof(CITIES[0]), 1.2);
+    static Zipf_Distribution vessels(sizeof(VESSELS) / sizeof(VESSELS[0]), 1.0);
+    static Zipf_Distribution objectives(sizeof(OBJECTIVES) / sizeof(OBJECTIVES[0]), 0.9);
+    static Zipf_Distribution destinations(sizeof(DESTINATIONS) / sizeof(DESTINATIONS[0]), 1.1);
+    static Zipf_Distribution project_numbers(state.project_count, 1.05);
+
+    // Salaries are log-normal, most people earn close to the median
+    static lognormal_distribution<double> salaries(log(55000.0), 0.4);
+    static uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    switch (kind)
+    {
+        case VALUE_TC_LEVEL:
+        {
+            // Most rows are at the lowest level and few at the highest, 50%, 
+            // 25%, 15% and 10% for levels 1 to 4
+            int percent = state.generator() % 100;
+            line.push_back((percent < 50) ? '1' : (percent < 75) ? '2' : (percent < 90) ? '3' : '4');
+            break;
+        }
+        case VALUE_FIRST_NAME:
+            line += pick(FIRST_NAMES, first_names, state);
+            break;
+        case VALUE_INITIAL:
+        case VALUE_RANDOM_CHAR:
+            line.push_back('A' + state.generator() % 26);
+            break;
+        case VALUE_LAST_NAME:
+            line += pick(LAST_NAMES, last_names, state);
+            break;
+        case VALUE_SSN:
+            append_number(line, FIRST_SSN + state.row_idx);
+            break;
+        case VALUE_BIRTH_DATE:
+        {
+            char date[16];
+            snprintf(date, sizeof(date), "%04d-%02d-%02d", 1940 + (int)(state.generator() % 60),
+                     1 + (int)(state.generator() % 12), 1 + (int)(state.generator() % 28));
+            line += date;
+            break;
+        }
+        case VALUE_ADDRESS:
+            append_number(line, 1 + state.generator() % 9999);
+            line.push_back(' ');
+            line += pick(STREETS, streets, state);
+            break;
+        case VALUE_CITY:
+            line += pick(CITIES, cities, state);
+            break;
+        case VALUE_STATE:
+            line += (uniform(state.generator) < 0.9) ? "TX" : STATES[state.generator() % 8];
+            break;
+        case VALUE_SEX:
+            line.push_back((state.generator() % 2) ? 'M' : 'F');
+            break;
+        case VALUE_SALARY:
+            if (uniform(state.generator) < SALARY_NULL_RATE)
+                line.push_back(' ');
+            else
+                append_number(line, (long)salaries(state.generator));
+            break;
+        case VALUE_SUPERVISOR:
+            // About one employee in ten is a supervisor
+            if (uniform(state.generator) < SUPERSSN_NULL_RATE)
+                line.push_back(' ');
+            else
+                append_number(line, FIRST_SSN + (long)(state.generator() % max(1L, state.employee_count / 10)) * 10);
+            break;
+        case VALUE_EMPLOYEE:
+            append_number(line, FIRST_SSN + (long)(state.generator() % state.employee_count));
+            break;
+        case VALUE_PROJECT:
+            append_number(line, 1 + project_numbers(state.generator));
+            break;
+        case VALUE_HOURS:
+        {
+            // Half hours from 0.5 to 40.0
+            if (uniform(state.generator) < HOURS_NULL_RATE)
+            {
+                line.push_back(' ');
+                break;
+            }
+            long half_hours = 1 + state.generator() % 80;
+            append_number(line, half_hours / 2);
+            line += (half_hours % 2) ? ".5" : ".0";
+            break;
+        }
+        case VALUE_PROJECT_NAME:
+            line += "Product";
+            append_number(line, state.row_idx + 1);
+            break;
+        case VALUE_ROW_NUMBER:
+            append_number(line, state.row_idx + 1);
+            break;
+        case VALUE_VESSEL:
+            line += pick(VESSELS, vessels, state);
+            break;
+        case VALUE_OBJECTIVE:
+            line += pick(OBJECTIVES, objectives, state);
+            break;
+        case VALUE_DESTINATION:
+            line += pick(DESTINATIONS, destinations, state);
+            break;
+        case VALUE_RANDOM_INT:
+        case VALUE_RANDOM_FLOAT:
+        case VALUE_RANDOM_STRING:
+            // A few values are left empty
+            if (uniform(state.generator) < OTHER_NULL_RATE)
+            {
+                line.push_back(' ');
+                break;
+            }
+            if (kind == VALUE_RANDOM_STRING)
+                line.push_back('V');
+            append_number(line, state.generator() % 100000);
+            if (kind == VALUE_RANDOM_FLOAT)
+                line += (state.generator() % 2) ? ".5" : ".25";
+            break;
+    }
+}
+
+/**
+ * Appends a number that is not negative, without building a temporary
+ * string.
+ *
+ * @param line  The text to append to.
+ * @param value The number.
+*/
+void append_number(string &line, long value)
+{
+    char digits[24];
+    int digit_idx = sizeof(digits);
+    do
+    {
+        digits[--digit_idx] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    line.append(digits + digit_idx, sizeof(digits) - digit_idx);
+}
+
+/**
+ * Picks a name from a list.
+ *
+ * @param names        The list of names.
+ * @param distribution The skew of the picks.
+ * @param state        The row being generated.
+ *
+ * @return The name.
+*/
+template <size_t N>
+const char *pick(const char *(&names)[N], Zipf_Distribution &distribution, Row_State &state)
+{
+    return names[distribution(state.generator) % N];
+}
+
+/**
+ * Copies a file.
+ *
+ * @param source_file The file to copy.
+ * @param target_file The copy.
+ *
+ * @return True if the file was copied.
+*/
+bool copy_file(const string &source_file, const string &target_file)
+{
+    ifstream source(source_file, ios::binary);
+    if (!source.is_open())
+        return false;
+    ofstream target(target_file, ios::binary);
+    target << source.rdbuf();
+    return target.good();
+}
+
+/**
+ * Builds the table of cumulative probabilities, item k is picked with a
+ * probability proportional to 1 / (k + 1)^exponent.
+ *
+ * @param item_count The number of items.
+ * @param exponent   The skew, 0 picks every item as often.
+*/
+Zipf_Distribution::Zipf_Distribution(int item_count, double exponent) : uniform(0.0, 1.0)
+{
+    double total = 0.0;
+    for (int item_idx = 0; item_idx < item_count; item_idx++)
+    {
+        total += 1.0 / pow(item_idx + 1, exponent);
+        cumulative.push_back(total);
+    }
+    for (double &probability : cumulative)
+    {
+        probability /= total;
+    }
+}
+
+/**
+ * Picks an item.
+ *
+ * @param generator The random number generator.
+ *
+ * @return The index of the item.
+*/
+int Zipf_Distribution::operator()(mt19937_64 &generator)
+{
+    double probability = uniform(generator);
+    int item_idx = lower_bound(cumulative.begin(), cumulative.end(), probability) - cumulative.begin();
+    return min(item_idx, (int)cumulative.size() - 1);
+}
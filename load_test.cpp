@@ -0,0 +1,414 @@
+// Load test for the query server. Each client connects to the server's
+// socket and sends the queries of a file one after another, waiting for each
+// result before sending the next. A writer can send the statements of another
+// file at a steady rate meanwhile, to see how the queries hold up under 
+// writes. The engine is compiled into this file without its REPL, so the 
+// client can use the same line helpers as the server.
+#define CS301_NO_MAIN
+#include "cs301project.cpp"
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * What one client measured.
+ *
+ * @var latencies The time each query took, in milliseconds.
+ * @var errors    The number of queries the server answered with an error.
+ * @var connected If the client connected and its session was accepted.
+*/
+typedef struct client_result
+{
+    vector<double> latencies;
+    long errors;
+    bool connected;
+} Client_Result;
+
+/**
+ * The statements a writer sends and how often.
+ * 
+ * @var statements The statements, sent in order and wrapping around.
+ * @var rate       The number of statements to send per second.
+*/
+typedef struct write_load
+{
+    vector<string> statements;
+    double rate;
+}
+Write_Load;
+
+// Load test functions
+vector<string> read_queries(const string &query_file);
+void run_client(const string &socket_path, int tc_level, const vector<string> &queries,
+                int first_query, double seconds, Client_Result &result);
+void run_writer(const string &socket_path, int tc_level, const Write_Load &writes, double seconds, 
+                Client_Result &result);
+void run_load(const string &socket_path, int tc_level, const vector<string> &queries,
+              int client_count, double seconds, const Write_Load &writes);
+int connect_server(const string &socket_path, int tc_level);
+bool send_query(int server_fd, string &buffer, const string &query, Client_Result &result);
+double seconds_since(chrono::steady_clock::time_point start_time);
+double percentile(const vector<double> &sorted_latencies, int percent);
+bool parse_decimal(const char *text, double &value);
+
+/**
+ * Runs the load test once for every client count.
+ *
+ * @param socket_path The socket the server listens on.
+ * @param query_file  The file with the queries to send, one per line.
+ * @param --tc        The TC level of each session, followed by the level.
+ *                    Defaults to 4. The server refuses levels above the 
+ *                    clearance of the user that runs the load test.
+ * @param --clients   The client counts to test, separated by commas.
+ *                    Defaults to 1,2,4,8.
+ * @param --seconds   How long each client count is tested, followed by the
+ *                    number of seconds. Defaults to 5.
+ * @param --writes    A file of statements, such as INSERT, that a writer 
+ *                    sends while the clients run. No writer by default.
+ * @param --write-rate The number of statements the writer sends per second.
+ *                    Defaults to 100.
+ *
+ * @retval  0 The load test ran successfully.
+ * @retval -1 An error was encountered.
+*/
+int main(int argc, char **argv)
+{
+    int tc_level = 4;
+    vector<int> client_counts = {1, 2, 4, 8};
+    double seconds = 5;
+    string write_file = "";
+    Write_Load writes = { .statements = vector<string>(), .rate = 100 };
+    bool valid_arguments = (argc >= 3);
+    for (int arg_idx = 3; valid_arguments && (arg_idx < argc); arg_idx++)
+    {
+        string argument = argv[arg_idx];
+        if (arg_idx + 1 >= argc)
+            valid_arguments = false;
+        else if (argument == "--tc")
+            valid_arguments = parse_argument(argv[++arg_idx], INT_MIN, tc_level);
+        else if (argument == "--seconds")
+            valid_arguments = parse_decimal(argv[++arg_idx], seconds) && (seconds > 0);
+        else if (argument == "--writes")
+            write_file = argv[++arg_idx];
+        else if (argument == "--write-rate")
+        {
+            valid_arguments = parse_decimal(argv[++arg_idx], writes.rate);
+            writes.rate = max(0.1, writes.rate);
+        }
+        else if (argument == "--clients")
+        {
+            client_counts.clear();
+            for (string count : split_string_comma(argv[++arg_idx]))
+            {
+                int client_count = 0;
+                valid_arguments = valid_arguments && parse_argument(count.c_str(), 1, client_count);
+                client_counts.push_back(client_count);
+            }
+        }
+        else
+            valid_arguments = false;
+    }
+    if (!valid_arguments)
+    {
+        cout << "Usage: " << argv[0] << " <socket_path> <query_file> [--tc <level>] [--clients <counts>] "
+             << "[--seconds <seconds>] [--writes <statement_file>] [--write-rate <per_second>]" << endl;
+        return -1;
+    }
+
+    vector<string> queries = read_queries(argv[2]);
+    if (queries.empty())
+    {
+        cout << "No queries in " << argv[2] << endl;
+        return -1;
+    }
+
+    if (write_file != "")
+    {
+        writes.statements = read_queries(write_file);
+        if (writes.statements.empty())
+        {
+            cout << "No statements in " << write_file << endl;
+            return -1;
+        }
+    }
+
+    cout << "clients  queries        qps     p50 ms     p99 ms  errors" 
+         << (writes.statements.empty() ? "" : "   writes/s  write p99 ms") << endl;
+    for (int client_count : client_counts)
+    {
+        run_load(argv[1], tc_level, queries, client_count, seconds, writes);
+    }
+    return 0;
+}
+
+/**
+ * Reads the queries to send, skipping blank lines and EXIT.
+ *
+ * @param query_file The file with the queries, one per line.
+ *
+ * @return The queries.
+*/
+vector<string> read_queries(const string &query_file)
+{
+    ifstream input(query_file);
+    vector<string> queries;
+    string line;
+    while (getline(input, line))
+    {
+        if ((line.find_first_not_of(" \t\r") != string::npos) && (line != "EXIT"))
+            queries.push_back(line);
+    }
+    return queries;
+}
+
+/**
+ * Runs a number of clients at once and prints their throughput and latency,
+ * and the writer's if there is one.
+ *
+ * @param socket_path  The socket the server listens on.
+ * @param tc_level     The TC level of each session.
+ * @param queries      The queries to send.
+ * @param client_count The number of clients.
+ * @param seconds      How long the clients send queries for.
+ * @param writes       The statements of the writer, none if there is no 
+ *                     writer.
+*/
+void run_load(const string &socket_path, int tc_level, const vector<string> &queries,
+              int client_count, double seconds, const Write_Load &writes)
+{
+    vector<Client_Result> results(client_count);
+    vector<thread> clients;
+    Client_Result write_result = { .latencies = vector<double>(), .errors = 0, .connected = true };
+    thread writer;
+    if (!writes.statements.empty())
+        writer = thread(run_writer, cref(socket_path), tc_level, cref(writes), seconds, ref(write_result));
+
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    for (int client_idx = 0; client_idx < client_count; client_idx++)
+    {
+        // Clients start at different queries so they do not all ask the same
+        // thing at the same time
+        int first_query = (client_idx * queries.size()) / client_count;
+        clients.push_back(thread(run_client, cref(socket_path), tc_level, cref(queries), first_query, seconds,
+                                 ref(results[client_idx])));
+    }
+    for (thread &client : clients)
+    {
+        client.join();
+    }
+    double elapsed = seconds_since(start_time);
+    if (writer.joinable())
+        writer.join();
+
+    vector<double> latencies;
+    long errors = 0;
+    for (const Client_Result &result : results)
+    {
+        if (!result.connected || !write_result.connected)
+        {
+            cout << "Could not connect to " << socket_path << endl;
+            return;
+        }
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        errors += result.errors;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    printf("%7d %8zu %10.0f %10.3f %10.3f %7ld", client_count, latencies.size(), latencies.size() / elapsed,
+           percentile(latencies, 50), percentile(latencies, 99), errors);
+    if (!writes.statements.empty())
+    {
+        sort(write_result.latencies.begin(), write_result.latencies.end());
+        printf(" %10.0f %13.3f", write_result.latencies.size() / elapsed, percentile(write_result.latencies, 99));
+        errors += write_result.errors;
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/**
+ * One client of the load test. It sends the queries in order, starting at
+ * the given one and wrapping around, until the time is up.
+ *
+ * @param socket_path The socket the server listens on.
+ * @param tc_level    The TC level of the session.
+ * @param queries     The queries to send.
+ * @param first_query The index of the first query to send.
+ * @param seconds     How long to send queries for.
+ * @param result      Where the latencies and errors are stored.
+*/
+void run_client(const string &socket_path, int tc_level, const vector<string> &queries,
+                int first_query, double seconds, Client_Result &result)
+{
+    result.errors = 0;
+    int server_fd = connect_server(socket_path, tc_level);
+    result.connected = (server_fd >= 0);
+    if (server_fd < 0)
+        return;
+
+    string buffer;
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    size_t query_idx = first_query;
+    while ((seconds_since(start_time) < seconds) && send_query(server_fd, buffer, queries[query_idx], result))
+    {
+        query_idx = (query_idx + 1) % queries.size();
+    }
+
+    write_all(server_fd, "EXIT\n", 5);
+    close(server_fd);
+}
+
+/**
+ * The writer of the load test. It sends the statements in order, wrapping 
+ * around, at a steady rate until the time is up. A statement that takes too
+ * long delays the ones after it, they are not sent faster to catch up.
+ *
+ * @param socket_path The socket the server listens on.
+ * @param tc_level    The TC level of the session.
+ * @param writes      The statements and the rate to send them at.
+ * @param seconds     How long to send statements for.
+ * @param result      Where the latencies and errors are stored.
+*/
+void run_writer(const string &socket_path, int tc_level, const Write_Load &writes, double seconds, 
+                Client_Result &result)
+{
+    int server_fd = connect_server(socket_path, tc_level);
+    result.connected = (server_fd >= 0);
+    if (server_fd < 0)
+        return;
+
+    string buffer;
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    chrono::steady_clock::time_point next_send = start_time;
+    chrono::steady_clock::duration interval = chrono::duration_cast<chrono::steady_clock::duration>(
+                                                  chrono::duration<double>(1 / writes.rate));
+    size_t statement_idx = 0;
+    while (seconds_since(start_time) < seconds)
+    {
+        this_thread::sleep_until(next_send);
+        next_send = max(next_send + interval, chrono::steady_clock::now());
+        if (!send_query(server_fd, buffer, writes.statements[statement_idx], result))
+            break;
+        statement_idx = (statement_idx + 1) % writes.statements.size();
+    }
+
+    write_all(server_fd, "EXIT\n", 5);
+    close(server_fd);
+}
+
+/**
+ * Sends one query and waits for its result.
+ *
+ * @param server_fd The connection to the server.
+ * @param buffer    What has been read from the server but not used yet.
+ * @param query     The query.
+ * @param result    The query's latency is added to it, and it counts as an 
+ *                  error if the server says it failed.
+ *
+ * @return True if the result was received, false if the connection broke.
+*/
+bool send_query(int server_fd, string &buffer, const string &query, Client_Result &result)
+{
+    string line = query + "\n";
+    chrono::steady_clock::time_point query_start = chrono::steady_clock::now();
+    if (!write_all(server_fd, line.data(), line.size()))
+        return false;
+
+    // The result ends at its #END line, which also says if it failed
+    while (read_line(server_fd, buffer, line))
+    {
+        if (line.compare(0, 5, "#END ") == 0)
+        {
+            if (line.find(" ERROR") != string::npos)
+                result.errors++;
+            result.latencies.push_back(seconds_since(query_start) * 1000);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Connects to the server's socket and starts a session.
+ *
+ * @param socket_path The socket the server listens on.
+ * @param tc_level    The TC level of the session.
+ *
+ * @return The connected file descriptor, or -1 on failure.
+*/
+int connect_server(const string &socket_path, int tc_level)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((server_fd >= 0) && (connect(server_fd, (sockaddr *)&address, sizeof(address)) < 0))
+    {
+        close(server_fd);
+        server_fd = -1;
+    }
+
+    string buffer;
+    string line;
+    string session = "SESSION " + to_string(tc_level) + "\n";
+    if ((server_fd >= 0) && 
+        (!write_all(server_fd, session.data(), session.size()) || !read_line(server_fd, buffer, line) || 
+         (line != "#READY")))
+    {
+        if (line.compare(0, 7, "#ERROR ") == 0)
+            cerr << "The server refused the session: " << line.substr(7) << endl;
+        close(server_fd);
+        server_fd = -1;
+    }
+    return server_fd;
+}
+
+/**
+ * The number of seconds since a point in time.
+ *
+ * @param start_time The point in time.
+ *
+ * @return The seconds since it.
+*/
+double seconds_since(chrono::steady_clock::time_point start_time)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+/**
+ * A percentile of some latencies.
+ *
+ * @param sorted_latencies The latencies in ascending order.
+ * @param percent          The percentile, from 0 to 100.
+ *
+ * @return The latency, 0 if there are none.
+*/
+double percentile(const vector<double> &sorted_latencies, int percent)
+{
+    if (sorted_latencies.empty())
+        return 0;
+    return sorted_latencies[min(sorted_latencies.size() - 1, sorted_latencies.size() * percent / 100)];
+}
+
+/**
+ * Parses a decimal number given on the command line, without throwing on a
+ * bad argument like stod does.
+ *
+ * @param text  The argument.
+ * @param value The parsed number.
+ *
+ * @return True if the whole argument is a number.
+*/
+bool parse_decimal(const char *text, double &value)
+{
+    char *number_end = NULL;
+    errno = 0;
+    double number = strtod(text, &number_end);
+    if ((number_end == text) || (*number_end != '\0') || (errno == ERANGE) || !isfinite(number))
+        return false;
+
+    value = number;
+    return true;
+}
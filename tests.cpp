@@ -0,0 +1,1134 @@
+// Tests for the database engine. The engine is compiled into this file
+// without its REPL, and the tests run queries through run_query the same way
+// the REPL and the server do, checking what they print. They run on a copy of
+// the data files in a scratch directory, so the snapshots and the write-ahead
+// log they make do not touch the ones next to the program.
+#define CS301_NO_MAIN
+#include "cs301project.cpp"
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+
+// Test functions
+bool test_tc_levels(void);
+bool test_cache_keys(void);
+bool test_limit_counts(void);
+bool test_int_fields(void);
+bool test_changed_data_file(void);
+bool test_version_reads(void);
+bool test_prepared_versions(void);
+bool test_dictionary_writes(void);
+bool load_dictionary_test(vector<Table> &database, bool encoded);
+bool check_same_columns(const string &output, int expected_rows, string &failure);
+bool test_restart(void);
+bool check_restart_writes(const string &phase);
+bool restart_refused(const string &phase);
+bool stopped_in_child(const function<void(void)> &action);
+bool test_log_failure(void);
+bool check_tc_levels(vector<Table> &database, const string &phase);
+bool check_tc_rows(const string &output, int tc_level, const string &query, const string &phase);
+bool run_statements(const vector<string> &statements, vector<Table> &database, Session &session);
+string run_captured(const string &query, vector<Table> &database, Session &session, int &row_count);
+vector<string> split_lines(const string &text);
+bool copy_data_files(const string &scratch_dir);
+bool copy_file(const string &from_name, const string &to_name);
+void remove_scratch_dir(const string &scratch_dir);
+void clear_result_cache(void);
+long cache_hits(vector<Table> &database, Session &session);
+
+// The highest TC level in the data files, and the levels tested are 0 to it
+const int TOP_TC_LEVEL = 4;
+
+// Queries that read rows in every way the engine has, the TC levels of the
+// rows they return are checked at every level. Each one shows a TC column.
+const vector<string> TC_QUERIES = {
+    "SELECT * FROM EMPLOYEE;",
+    "SELECT * FROM WORKS_ON WHERE HOURS>5;",
+    "SELECT * FROM EMPLOYEE WHERE SSN=123456789;",
+    "SELECT * FROM EMPLOYEE WHERE SALARY>=30000;",
+    "SELECT * FROM WORKS_ON WHERE ESSN=123456789;",
+    "SELECT * FROM EMPLOYEE WHERE SEX=F OR SALARY>38000;",
+    "SELECT * FROM EMPLOYEE WHERE SSN=123456789 OR SSN=888665555;",
+    "SELECT * FROM EMPLOYEE JOIN WORKS_ON ON SSN=ESSN;",
+    "SELECT * FROM EMPLOYEE JOIN WORKS_ON ON SSN=ESSN JOIN PROJECT ON PNO=PNUMBER WHERE HOURS>5;",
+    "SELECT TC, COUNT(*) FROM EMPLOYEE GROUPBY TC;",
+    "SELECT SEX, MAX(TC), COUNT(*) FROM EMPLOYEE GROUPBY SEX;",
+    "SELECT PNO, MAX(TC) FROM WORKS_ON GROUPBY PNO;",
+    "SELECT * FROM EMPLOYEE LIMIT 2;",
+    "SELECT * FROM EMPLOYEE ORDERBY TC:-1 LIMIT 3;",
+    "SELECT * FROM WORKS_ON ORDERBY HOURS:-1 LIMIT 2 OFFSET 1;",
+    "EXECUTE by_salary(0);",
+    "EXECUTE by_ssn(123456789);",
+    "EXECUTE by_project(2);"
+};
+
+// The queries that TC_QUERIES executes, prepared in every session
+const vector<string> TC_PREPARES = {
+    "PREPARE by_salary AS SELECT * FROM EMPLOYEE WHERE SALARY>?;",
+    "PREPARE by_ssn AS SELECT * FROM EMPLOYEE WHERE SSN=?;",
+    "PREPARE by_project AS SELECT * FROM WORKS_ON JOIN PROJECT ON PNO=PNUMBER WHERE PNO=?;"
+};
+
+// Writes that put rows at the top level, a new one and ones that were seen at
+// the lowest levels before, so they have to disappear from those levels. The
+// last rows are inserted at low levels after the rows were grouped again, so
+// they stay at the end of their tables.
+const vector<string> TC_WRITES = {
+    "INSERT INTO EMPLOYEE VALUES (Grace, H, Hopper, 555000111, 1906-12-09, 1 Navy Yard, Houston, TX, F, 90000, "
+    "888665555, 4);",
+    "UPDATE EMPLOYEE SET TC=4 WHERE SSN=123456789;",
+    "INSERT INTO WORKS_ON VALUES (555000111, 2, 12.5, 4);",
+    "UPDATE WORKS_ON SET TC=3 WHERE ESSN=123456789;",
+    "INSERT INTO EMPLOYEE VALUES (Ada, A, Lovelace, 555000333, 1815-12-10, 12 St James Square, London, UK, F, "
+    "50000, 888665555, 1);",
+    "INSERT INTO WORKS_ON VALUES (123456789, 2, 7.5, 1), (555000333, 1, 20.0, 3);"
+};
+
+// Groups of queries for the result cache. The queries of a group only differ
+// in spacing and share one result, queries of different groups never do.
+const vector<vector<string>> CACHE_QUERIES = {
+    { "SELECT * FROM EMPLOYEE WHERE SSN=123456789;", "SELECT * FROM EMPLOYEE WHERE SSN = 123456789;",
+      "SELECT  *  FROM EMPLOYEE WHERE SSN= 123456789 ;" },
+    { "SELECT * FROM EMPLOYEE WHERE (SEX=F OR SALARY>38000) AND SSN<>1;",
+      "SELECT * FROM EMPLOYEE WHERE ( SEX = F OR SALARY > 38000 ) AND SSN <> 1;" },
+    { "SELECT * FROM EMPLOYEE WHERE CITY=Houston LIMIT 1;", "SELECT * FROM EMPLOYEE WHERE CITY = Houston LIMIT 1;" },
+    { "SELECT * FROM EMPLOYEE WHERE CITY=HoustonLIMIT 1;" },
+    { "EXECUTE by_ssn(123456789);", "EXECUTE by_ssn( 123456789 );", "EXECUTE by_spaced_ssn(123456789);" }
+};
+
+// LIMIT statements and the number of rows they return, -1 for the ones that
+// have to be refused
+const vector<pair<string, int>> LIMIT_QUERIES = {
+    { "SELECT * FROM EMPLOYEE LIMIT 2;", 2 },
+    { "SELECT * FROM EMPLOYEE LIMIT 1 OFFSET 1;", 1 },
+    { "SELECT * FROM EMPLOYEE LIMIT 2x;", -1 },
+    { "SELECT * FROM EMPLOYEE LIMIT 4294967298;", -1 },
+    { "SELECT * FROM EMPLOYEE LIMIT 99999999999999999999;", -1 },
+    { "SELECT * FROM EMPLOYEE LIMIT -1;", -1 },
+    { "SELECT * FROM EMPLOYEE LIMIT 2 OFFSET 1x;", -1 },
+    { "SELECT * FROM EMPLOYEE LIMIT 2 OFFSET 4294967297;", -1 }
+};
+
+// INT fields of a data file and the value each one loads as, empty for the
+// ones left without a value. The last value is how many have to be reported
+// as not valid, blank fields are not.
+const vector<pair<string, string>> INT_FIELDS = {
+    { "42", "42" },
+    { " -7 ", "-7" },
+    { "2147483647", "2147483647" },
+    { "-2147483648", "-2147483648" },
+    { "4294967298", "" },
+    { "2147483648", "" },
+    { "-2147483649", "" },
+    { "12abc", "" },
+    { "", "" },
+    { " ", "" }
+};
+const int REJECTED_INT_FIELDS = 4;
+
+// The writes and the readers of the version test, every write sets both
+// columns of every row to the same value
+const int VERSION_WRITES = 200;
+const int VERSION_READERS = 3;
+
+// Queries prepared before a row is inserted, and executions of them that run
+// on the version with the row, each with the query it has to print the same
+// rows as. The statement is run without the REPL, so it has no ';'.
+const vector<string> VERSION_PREPARES = {
+    "PREPARE by_ssn AS SELECT * FROM EMPLOYEE WHERE SSN=?;",
+    "PREPARE projects_of AS SELECT * FROM EMPLOYEE JOIN WORKS_ON ON SSN=ESSN WHERE SSN=?;"
+};
+const string VERSION_INSERT = "INSERT INTO EMPLOYEE VALUES (Edsger, W, Dijkstra, 555000444, 1930-05-11, "
+                              "1 Speedway, Austin, TX, M, 70000, 123456789, 1)";
+const vector<pair<string, string>> VERSION_EXECUTES = {
+    { "EXECUTE by_ssn(555000444);", "SELECT * FROM EMPLOYEE WHERE SSN=555000444;" },
+    { "EXECUTE by_ssn(123456789);", "SELECT * FROM EMPLOYEE WHERE SSN=123456789;" },
+    { "EXECUTE by_ssn(1);", "SELECT * FROM EMPLOYEE WHERE SSN=1;" },
+    { "EXECUTE by_ssn(555000444);", "SELECT * FROM EMPLOYEE WHERE SSN=555000444;" },
+    { "EXECUTE projects_of(123456789);", "SELECT * FROM EMPLOYEE JOIN WORKS_ON ON SSN=ESSN WHERE SSN=123456789;" },
+    { "EXECUTE projects_of(555000444);", "SELECT * FROM EMPLOYEE JOIN WORKS_ON ON SSN=ESSN WHERE SSN=555000444;" }
+};
+
+// Writes that add values to the STATE column of EMPLOYEE, before and after the
+// values it has, and queries that read the column in every way the engine 
+// has. The writes are run without the REPL, so they have no ';'.
+const vector<string> DICTIONARY_WRITES = {
+    "INSERT INTO EMPLOYEE VALUES (Edsger, W, Dijkstra, 555000444, 1930-05-11, 1 Speedway, Austin, WA, M, 70000, "
+    "123456789, 1)",
+    "INSERT INTO EMPLOYEE VALUES (Barbara, H, Liskov, 555000555, 1939-11-07, 32 Vassar St, Boston, MA, F, 80000, "
+    "123456789, 2)",
+    "UPDATE EMPLOYEE SET STATE=CA WHERE SSN=123456789",
+    "INSERT INTO EMPLOYEE VALUES (Donald, E, Knuth, 555000666, 1938-01-10, 1 Gates Bldg, Stanford, WA, M, 60000, "
+    "123456789, 1)"
+};
+const vector<string> DICTIONARY_QUERIES = {
+    "SELECT * FROM EMPLOYEE WHERE STATE=WA;",
+    "SELECT * FROM EMPLOYEE WHERE STATE<>TX;",
+    "SELECT * FROM EMPLOYEE WHERE STATE<TX;",
+    "SELECT * FROM EMPLOYEE WHERE STATE<=MA;",
+    "SELECT * FROM EMPLOYEE WHERE STATE>CA;",
+    "SELECT * FROM EMPLOYEE WHERE STATE>=TX AND SALARY>0;",
+    "SELECT * FROM EMPLOYEE ORDERBY STATE:1;",
+    "SELECT STATE, COUNT(*) FROM EMPLOYEE GROUPBY STATE;",
+    "SELECT MIN(STATE), MAX(STATE) FROM EMPLOYEE;"
+};
+
+// Writes that only the snapshot of EMPLOYEE holds after a checkpoint, and 
+// the number of rows each query returns once they are made
+const vector<string> RESTART_WRITES = {
+    "INSERT INTO EMPLOYEE VALUES (Alan, M, Turing, 555000222, 1912-06-23, 2 Wilmslow Rd, Austin, TX, M, 80000, "
+    "888665555, 1);",
+    "DELETE FROM EMPLOYEE WHERE SSN=999887777;"
+};
+const vector<pair<string, int>> RESTART_CHECKS = {
+    { "SELECT * FROM EMPLOYEE WHERE SSN=555000222;", 1 },
+    { "SELECT * FROM EMPLOYEE WHERE SSN=999887777;", 0 }
+};
+
+/**
+ * Runs the tests and prints "ok" or "FAIL" with the reason for each one.
+ *
+ * @retval  0 Every test passed.
+ * @retval  1 A test failed.
+ * @retval -1 The scratch directory could not be made.
+*/
+int main(void)
+{
+    char scratch_dir[] = "/tmp/cs301_tests.XXXXXX";
+    if ((mkdtemp(scratch_dir) == NULL) || !copy_data_files(scratch_dir) || (chdir(scratch_dir) != 0))
+    {
+        cout << "Unable to make a scratch directory with the data files!!!" << endl;
+        return -1;
+    }
+
+    // Results are cached as they are in the server, so a cached result of
+    // one level could be shown at another
+    query_pool.start(2);
+    result_cache.set_budget(1 << 20);
+    output_router.install();
+
+    bool passed = true;
+    passed = test_tc_levels() && passed;
+    passed = test_cache_keys() && passed;
+    passed = test_limit_counts() && passed;
+    passed = test_int_fields() && passed;
+    passed = test_changed_data_file() && passed;
+    passed = test_version_reads() && passed;
+    passed = test_prepared_versions() && passed;
+    passed = test_dictionary_writes() && passed;
+    passed = test_restart() && passed;
+    passed = test_log_failure() && passed;
+
+    query_pool.stop();
+    remove_scratch_dir(scratch_dir);
+    return passed ? 0 : 1;
+}
+
+/**
+ * Checks that no query returns a row above the session's TC level, at every
+ * level from 0 to the top. The queries run on the tables as they are loaded
+ * from the data files, after writes that raise and insert rows, on the
+ * versions the server pins, and after a restart from the snapshots, with
+ * every column evicted after each query.
+ *
+ * @return True if the test passed.
+*/
+bool test_tc_levels(void)
+{
+    vector<Table> database = init_database();
+    if (replay_log(database, WRITE_LOG_FILE) < 0)
+        return false;
+    bool passed = check_tc_levels(database, "loaded from the data files");
+
+    Session writer = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    passed = run_statements(TC_WRITES, database, writer) && passed;
+    passed = check_tc_levels(database, "after INSERT and UPDATE") && passed;
+
+    // Inserted rows come after every row of the data file in file order
+    int row_count = 0;
+    vector<string> lines = split_lines(run_captured("SELECT SSN:1 FROM EMPLOYEE;", database, writer, row_count));
+    if ((lines.size() < 3) || (lines[lines.size() - 2] != "555000111") || (lines.back() != "555000333"))
+    {
+        cout << "FAIL inserted rows are not last in file order: " << (lines.empty() ? "" : lines.back()) << endl;
+        passed = false;
+    }
+
+    // The server writes to a copy and publishes it, queries read the copy
+    // they pinned
+    table_versions.start(database);
+    table_versions.write([&](vector<Table> &tables)
+    {
+        passed = run_statements({ "UPDATE EMPLOYEE SET TC=3 WHERE SEX=F;" }, tables, writer) && passed;
+    });
+    passed = check_tc_levels(*table_versions.pin(), "on a pinned version") && passed;
+    table_versions.stop();
+
+    if (!checkpoint(database))
+        return false;
+    write_log.close_log();
+    column_loader.set_budget(1);
+    database = init_database();
+    clear_result_cache();
+    passed = (replay_log(database, WRITE_LOG_FILE) >= 0) && passed;
+    passed = check_tc_levels(database, "restarted from the snapshots") && passed;
+    column_loader.set_budget(0);
+    write_log.close_log();
+
+    cout << (passed ? "ok" : "FAIL") << " TC levels" << endl;
+    return passed;
+}
+
+/**
+ * Checks that the result cache answers a query from the result of the same
+ * query written with other spacing, and only then.
+ *
+ * @return True if the test passed.
+*/
+bool test_cache_keys(void)
+{
+    vector<Table> database = init_database();
+    clear_result_cache();
+
+    Session session = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    bool passed = run_statements({ "PREPARE by_ssn AS SELECT * FROM EMPLOYEE WHERE SSN=?;",
+                                   "PREPARE by_spaced_ssn AS SELECT * FROM EMPLOYEE WHERE SSN = ?;" },
+                                 database, session);
+
+    long expected_hits = cache_hits(database, session);
+    for (const vector<string> &group : CACHE_QUERIES)
+    {
+        int first_rows = 0;
+        string first_output = run_captured(group[0], database, session, first_rows);
+        for (int query_idx = 1; query_idx < group.size(); query_idx++)
+        {
+            int row_count = 0;
+            if ((run_captured(group[query_idx], database, session, row_count) != first_output) ||
+                (row_count != first_rows))
+            {
+                cout << "FAIL " << group[query_idx] << " printed another result than " << group[0] << endl;
+                passed = false;
+            }
+        }
+        expected_hits += group.size() - 1;
+    }
+
+    long hits = cache_hits(database, session);
+    if (hits != expected_hits)
+    {
+        cout << "FAIL the result cache had " << hits << " hits, expected " << expected_hits << endl;
+        passed = false;
+    }
+
+    cout << (passed ? "ok" : "FAIL") << " result cache keys" << endl;
+    return passed;
+}
+
+/**
+ * Checks that LIMIT and OFFSET take whole numbers that fit in an int, and 
+ * refuse counts with other characters after them or that are too large.
+ *
+ * @return True if the test passed.
+*/
+bool test_limit_counts(void)
+{
+    vector<Table> database = init_database();
+    clear_result_cache();
+
+    bool passed = true;
+    Session session = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    for (const pair<string, int> &query : LIMIT_QUERIES)
+    {
+        int row_count = 0;
+        string output = run_captured(query.first, database, session, row_count);
+        bool refused = (output.find("Invalid LIMIT statement") != string::npos);
+        if ((row_count != query.second) || (refused != (query.second < 0)))
+        {
+            cout << "FAIL " << query.first << " returned " << row_count << " rows, expected " << query.second 
+                 << ": " << output;
+            passed = false;
+        }
+    }
+
+    cout << (passed ? "ok" : "FAIL") << " LIMIT counts" << endl;
+    return passed;
+}
+
+/**
+ * Checks that the loader only takes INT fields that are whole numbers which 
+ * fit in an int, and reports the others. The fields are written to a data 
+ * file of their own and loaded as the table NUMBERS.
+ *
+ * @return True if the test passed.
+*/
+bool test_int_fields(void)
+{
+    ofstream data_file("NUMBERS.csv");
+    for (const pair<string, string> &field : INT_FIELDS)
+    {
+        data_file << "1," << field.first << endl;
+    }
+    data_file.close();
+
+    Table table = { .table_name = "NUMBERS", .tc_column_idx = -1 };
+    table.table_data.push_back(new_column("ID", INT));
+    table.table_data.push_back(new_column("N", INT));
+
+    // The report goes to stderr once the column is parsed
+    stringstream report;
+    streambuf *stderr_buffer = cerr.rdbuf(report.rdbuf());
+    bool loaded = (load_csv(table, "NUMBERS.csv") > 0);
+    Column_Pins pins;
+    column_loader.pin_table(table, pins);
+    cerr.rdbuf(stderr_buffer);
+
+    bool passed = loaded && (table.table_data[1].row_count == INT_FIELDS.size());
+    for (int row_idx = 0; passed && (row_idx < INT_FIELDS.size()); row_idx++)
+    {
+        const Column &column = table.table_data[1];
+        string value = is_row_empty(column, row_idx) ? "" : to_string(column.int_data[row_idx]);
+        if (value != INT_FIELDS[row_idx].second)
+        {
+            cout << "FAIL INT field \"" << INT_FIELDS[row_idx].first << "\" loaded as \"" << value << "\", expected \""
+                 << INT_FIELDS[row_idx].second << "\"" << endl;
+            passed = false;
+        }
+    }
+    if (report.str().find(to_string(REJECTED_INT_FIELDS) + " values of N") == string::npos)
+    {
+        cout << "FAIL expected " << REJECTED_INT_FIELDS << " INT fields to be reported: " << report.str() << endl;
+        passed = false;
+    }
+
+    cout << (passed ? "ok" : "FAIL") << " INT fields" << endl;
+    return passed;
+}
+
+/**
+ * Checks that a column is not loaded from a data file that changed after the
+ * table was loaded, since its lines would no longer match the rows. The file
+ * is appended to once one column was loaded, loading another one then has to
+ * stop the program.
+ *
+ * @return True if the test passed.
+*/
+bool test_changed_data_file(void)
+{
+    ofstream data_file("CHANGING.csv");
+    data_file << "1,10" << endl << "2,20" << endl;
+    data_file.close();
+
+    Table table = { .table_name = "CHANGING", .tc_column_idx = -1 };
+    table.table_data.push_back(new_column("ID", INT));
+    table.table_data.push_back(new_column("N", INT));
+    bool passed = (load_csv(table, "CHANGING.csv") > 0);
+
+    Column_Pins pins;
+    column_loader.pin(table, vector<int>(1, 0), pins);
+    passed = passed && !is_row_empty(table.table_data[0], 1) && (table.table_data[0].int_data[1] == 2);
+
+    data_file.open("CHANGING.csv", ios::app);
+    data_file << "3,30" << endl;
+    data_file.close();
+    auto load_second_column = [&table]()
+    {
+        Column_Pins pins;
+        column_loader.pin(table, vector<int>(1, 1), pins);
+    };
+    if (passed && !stopped_in_child(load_second_column))
+    {
+        cout << "FAIL a column was loaded from CHANGING.csv after it changed" << endl;
+        passed = false;
+    }
+
+    cout << (passed ? "ok" : "FAIL") << " changed data file" << endl;
+    return passed;
+}
+
+/**
+ * Checks that queries on pinned versions never see a write half done. A
+ * writer keeps setting ESSN and PNO of every row of WORKS_ON to one value in
+ * a single UPDATE, while readers scan the versions they pin and check that
+ * the two are equal on every row.
+ *
+ * @return True if the test passed.
+*/
+bool test_version_reads(void)
+{
+    vector<Table> database = init_database();
+    clear_result_cache();
+    if (replay_log(database, WRITE_LOG_FILE) < 0)
+        return false;
+
+    Session writer = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    int row_count = 0;
+    run_captured("SELECT ESSN:1, PNO:1 FROM WORKS_ON;", database, writer, row_count);
+    bool passed = run_statements({ "UPDATE WORKS_ON SET ESSN=0, PNO=0;" }, database, writer) && (row_count > 0);
+
+    table_versions.start(database);
+    atomic<bool> writing(true);
+    vector<string> failures(VERSION_READERS);
+    vector<long> scan_counts(VERSION_READERS, 0);
+    vector<thread> readers;
+    for (int reader_idx = 0; reader_idx < VERSION_READERS; reader_idx++)
+    {
+        readers.push_back(thread([&, reader_idx]()
+        {
+            Session session = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+            while (writing.load() && failures[reader_idx].empty())
+            {
+                shared_ptr<vector<Table>> version = table_versions.pin();
+                int scanned_rows = 0;
+                string output = run_captured("SELECT ESSN:1, PNO:1 FROM WORKS_ON;", *version, session, scanned_rows);
+                if ((scanned_rows != row_count) || !check_same_columns(output, row_count, failures[reader_idx]))
+                    failures[reader_idx] += " (" + to_string(scanned_rows) + " rows)";
+                scan_counts[reader_idx]++;
+            }
+        }));
+    }
+
+    for (int write_idx = 1; passed && (write_idx <= VERSION_WRITES); write_idx++)
+    {
+        string statement = "UPDATE WORKS_ON SET ESSN=" + to_string(write_idx) + ", PNO=" + to_string(write_idx) + ";";
+        table_versions.write([&](vector<Table> &tables)
+        {
+            passed = run_statements({ statement }, tables, writer) && passed;
+        });
+    }
+    writing = false;
+    for (thread &reader : readers)
+        reader.join();
+    table_versions.stop();
+    write_log.close_log();
+
+    for (int reader_idx = 0; reader_idx < VERSION_READERS; reader_idx++)
+    {
+        if (!failures[reader_idx].empty())
+        {
+            cout << "FAIL reader " << reader_idx << " after " << scan_counts[reader_idx] << " scans: "
+                 << failures[reader_idx] << endl;
+            passed = false;
+        }
+    }
+
+    cout << (passed ? "ok" : "FAIL") << " reads of pinned versions" << endl;
+    return passed;
+}
+
+/**
+ * Checks that a query prepared on one version of the tables reads the version
+ * it is executed on, and that the values of one EXECUTE do not stay in the 
+ * prepared query for the next. The row is inserted without logging it, so 
+ * the other tests do not see it.
+ *
+ * @return True if the test passed.
+*/
+bool test_prepared_versions(void)
+{
+    vector<Table> database = init_database();
+    clear_result_cache();
+
+    Session session = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    bool passed = run_statements(VERSION_PREPARES, database, session);
+    table_versions.start(database);
+    table_versions.write([&](vector<Table> &tables)
+    {
+        int table_idx = write_table(tables, VERSION_INSERT);
+        passed = (table_idx != -1) && (modify_table(tables[table_idx], VERSION_INSERT, TOP_TC_LEVEL) == 1) && passed;
+    });
+
+    // The new row is one of the rows the first query has to find
+    shared_ptr<vector<Table>> version = table_versions.pin();
+    for (const pair<string, string> &execute : VERSION_EXECUTES)
+    {
+        int row_count = 0;
+        string output = run_captured(execute.first, *version, session, row_count);
+        int expected_count = 0;
+        string expected_output = run_captured(execute.second, *version, session, expected_count);
+        if ((output != expected_output) || (row_count != expected_count) || 
+            ((execute == VERSION_EXECUTES.front()) && (row_count != 1)))
+        {
+            cout << "FAIL " << execute.first << " returned " << row_count << " rows, expected " << expected_count 
+                 << ": " << output;
+            passed = false;
+        }
+    }
+    version.reset();
+    table_versions.stop();
+
+    cout << (passed ? "ok" : "FAIL") << " prepared queries on new versions" << endl;
+    return passed;
+}
+
+/**
+ * Checks that writes that add values to a dictionary encoded column keep it
+ * encoded, and that queries print the same rows as they do on the column 
+ * when it is not encoded, before and after the dictionary is sorted again.
+ * The writes are not logged, so the other tests do not see them.
+ *
+ * @return True if the test passed.
+*/
+bool test_dictionary_writes(void)
+{
+    vector<Table> encoded_database;
+    vector<Table> plain_database;
+    bool passed = load_dictionary_test(encoded_database, true) && load_dictionary_test(plain_database, false);
+
+    Table &table = encoded_database[write_table(encoded_database, DICTIONARY_WRITES[0])];
+    int column_idx = find_column(table, "STATE");
+    const Column &column = table.table_data.read(column_idx);
+    if (passed && (!column.dictionary_encoded || (column.sorted_values == column.dictionary.size())))
+    {
+        cout << "FAIL the writes did not add to the dictionary of STATE" << endl;
+        passed = false;
+    }
+
+    Session session = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    for (int pass = 0; passed && (pass < 2); pass++)
+    {
+        // The second pass reads the column the way a checkpoint leaves it
+        if (pass == 1)
+        {
+            sort_dictionary(table.table_data[column_idx]);
+            create_index(encoded_database, "CREATE INDEX ON EMPLOYEE (STATE) USING HASH");
+        }
+
+        for (const string &query : DICTIONARY_QUERIES)
+        {
+            int row_count = 0;
+            int expected_count = 0;
+            clear_result_cache();
+            string output = run_captured(query, encoded_database, session, row_count);
+            clear_result_cache();
+            string expected_output = run_captured(query, plain_database, session, expected_count);
+            if ((output != expected_output) || (row_count != expected_count) || (row_count < 0))
+            {
+                cout << "FAIL " << query << " returned " << output << "expected " << expected_output;
+                passed = false;
+            }
+        }
+    }
+
+    cout << (passed ? "ok" : "FAIL") << " writes to encoded columns" << endl;
+    return passed;
+}
+
+/**
+ * Loads the database of the dictionary test and runs its writes. STATE has 
+ * indexes of both types, and is encoded or not before the writes.
+ *
+ * @param database Set to the database.
+ * @param encoded  True to encode STATE.
+ *
+ * @return True if the writes were made.
+*/
+bool load_dictionary_test(vector<Table> &database, bool encoded)
+{
+    database = init_database();
+    Table &table = database[write_table(database, DICTIONARY_WRITES[0])];
+    materialize_columns(table);
+    int column_idx = find_column(table, "STATE");
+    if (encoded)
+        encode_strings(table.table_data[column_idx]);
+    else
+        decode_strings(table.table_data[column_idx]);
+    bool passed = create_index(database, "CREATE INDEX ON EMPLOYEE (STATE) USING HASH") && 
+                  create_index(database, "CREATE INDEX ON EMPLOYEE (STATE) USING ORDERED");
+
+    for (const string &statement : DICTIONARY_WRITES)
+    {
+        passed = (modify_table(table, statement, TOP_TC_LEVEL) == 1) && passed;
+    }
+    return passed;
+}
+
+/**
+ * Checks that the two columns of a CSV result are equal on every row.
+ *
+ * @param output        The result, with a header line.
+ * @param expected_rows The number of rows it must have.
+ * @param failure       Set to what was wrong.
+ *
+ * @return True if every row has two equal values.
+*/
+bool check_same_columns(const string &output, int expected_rows, string &failure)
+{
+    vector<string> lines = split_lines(output);
+    if (lines.size() != expected_rows + 1)
+    {
+        failure = "expected " + to_string(expected_rows) + " rows, got: " + output;
+        return false;
+    }
+
+    for (int line_idx = 1; line_idx < lines.size(); line_idx++)
+    {
+        vector<string> fields = split_string_comma(lines[line_idx]);
+        if ((fields.size() != 2) || (fields[0] != fields[1]))
+        {
+            failure = "a row has different values: " + lines[line_idx];
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Checks that writes survive a restart once a checkpoint emptied the 
+ * write-ahead log, and that a snapshot holding them is never replaced by its
+ * data file: when the data file changes or the snapshot is corrupt the 
+ * program has to stop instead.
+ *
+ * @return True if the test passed.
+*/
+bool test_restart(void)
+{
+    vector<Table> database = init_database();
+    clear_result_cache();
+    if (replay_log(database, WRITE_LOG_FILE) < 0)
+        return false;
+
+    Session writer = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    bool passed = run_statements(RESTART_WRITES, database, writer) && checkpoint(database);
+    write_log.close_log();
+    database.clear();
+    passed = check_restart_writes("after a checkpoint") && passed;
+
+    // Touching the data file makes the snapshot stale
+    struct stat csv_stat;
+    passed = (stat("EMPLOYEE.csv", &csv_stat) == 0) && (utimensat(AT_FDCWD, "EMPLOYEE.csv", NULL, 0) == 0) && passed;
+    passed = restart_refused("after EMPLOYEE.csv was touched") && passed;
+    struct timespec csv_times[2] = { csv_stat.st_atim, csv_stat.st_mtim };
+    passed = (utimensat(AT_FDCWD, "EMPLOYEE.csv", csv_times, 0) == 0) && passed;
+    passed = check_restart_writes("after EMPLOYEE.csv was put back") && passed;
+
+    // A corrupt snapshot is put in place by a rename, as a checkpoint does,
+    // so the mappings of the good one are left alone
+    fstream bad_file;
+    if (copy_file("EMPLOYEE.snap", "EMPLOYEE.snap.good") && copy_file("EMPLOYEE.snap", "EMPLOYEE.snap.bad"))
+        bad_file.open("EMPLOYEE.snap.bad", ios::in | ios::out | ios::binary);
+    bad_file.seekp(offsetof(Snapshot_Header, checksum));
+    bad_file.put(0x5a);
+    bad_file.close();
+    passed = bad_file.good() && (rename("EMPLOYEE.snap.bad", "EMPLOYEE.snap") == 0) && passed;
+    passed = restart_refused("with a corrupt EMPLOYEE.snap") && passed;
+    passed = (rename("EMPLOYEE.snap.good", "EMPLOYEE.snap") == 0) && passed;
+    passed = check_restart_writes("after EMPLOYEE.snap was put back") && passed;
+
+    cout << (passed ? "ok" : "FAIL") << " writes kept across restarts" << endl;
+    return passed;
+}
+
+/**
+ * Checks that once the write-ahead log can not be written, the write that
+ * failed is never saved and no later write is made. The log is made 
+ * unwritable by limiting the size of the files the process can write.
+ *
+ * @return True if the test passed.
+*/
+bool test_log_failure(void)
+{
+    vector<Table> database = init_database();
+    clear_result_cache();
+    if (replay_log(database, WRITE_LOG_FILE) < 0)
+        return false;
+
+    // Writing past the limit fails with EFBIG instead of raising SIGXFSZ. 
+    // Until the limit is lifted nothing is printed, stdout could be a file.
+    struct rlimit file_limit;
+    getrlimit(RLIMIT_FSIZE, &file_limit);
+    struct rlimit small_limit = file_limit;
+    small_limit.rlim_cur = 16;
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &small_limit);
+
+    Session writer = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    int failed_rows = 0;
+    int refused_rows = 0;
+    run_captured("DELETE FROM EMPLOYEE WHERE SSN=555000222;", database, writer, failed_rows);
+    string refused_output = run_captured("DELETE FROM EMPLOYEE WHERE SSN=888665555;", database, writer, refused_rows);
+    int remaining_rows = 0;
+    run_captured("SELECT * FROM EMPLOYEE WHERE SSN=888665555;", database, writer, remaining_rows);
+    stringbuf checkpoint_output;
+    output_router.set_thread_output(&checkpoint_output);
+    bool saved = checkpoint(database);
+    output_router.set_thread_output(NULL);
+
+    setrlimit(RLIMIT_FSIZE, &file_limit);
+    signal(SIGXFSZ, SIG_DFL);
+    write_log.close_log();
+
+    bool passed = true;
+    if ((failed_rows != -1) || (refused_rows != -1) || (refused_output.find("refused") == string::npos) || 
+        (remaining_rows != 1) || saved)
+    {
+        cout << "FAIL a write after a failed sync returned " << refused_rows << ": " << refused_output;
+        passed = false;
+    }
+
+    // The write that failed was never saved, the earlier ones were
+    passed = check_restart_writes("after a failed sync") && passed;
+
+    cout << (passed ? "ok" : "FAIL") << " writes refused after a failed sync" << endl;
+    return passed;
+}
+
+/**
+ * Starts the database again and checks that it has RESTART_WRITES.
+ *
+ * @param phase What was done before the restart, for the failure messages.
+ *
+ * @return True if every write was there.
+*/
+bool check_restart_writes(const string &phase)
+{
+    vector<Table> database = init_database();
+    clear_result_cache();
+    bool passed = (replay_log(database, WRITE_LOG_FILE) >= 0);
+
+    Session session = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    for (const pair<string, int> &check : RESTART_CHECKS)
+    {
+        int row_count = 0;
+        run_captured(check.first, database, session, row_count);
+        if (row_count != check.second)
+        {
+            cout << "FAIL " << check.first << " " << phase << " returned " << row_count << " rows, expected " 
+                 << check.second << endl;
+            passed = false;
+        }
+    }
+    write_log.close_log();
+    return passed;
+}
+
+/**
+ * Starts the database again in a child process, which has to stop without
+ * loading it.
+ *
+ * @param phase What was done before the restart, for the failure messages.
+ *
+ * @return True if the child stopped with an error.
+*/
+bool restart_refused(const string &phase)
+{
+    if (!stopped_in_child([]() { init_database(); }))
+    {
+        cout << "FAIL the database started " << phase << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Runs something in a child process, which has to stop the program.
+ *
+ * @param action What the child runs.
+ *
+ * @return True if the child stopped with an error.
+*/
+bool stopped_in_child(const function<void(void)> &action)
+{
+    // Threads are not copied to the child, the pool's workers have to be
+    // stopped or the child would wait for them when it exits
+    int thread_count = query_pool.thread_count();
+    query_pool.stop();
+    cout.flush();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        // The child prints why it stopped, which is expected here
+        freopen("/dev/null", "w", stderr);
+        action();
+        _exit(0);
+    }
+
+    int status = 0;
+    bool waited = (child != -1) && (waitpid(child, &status, 0) == child);
+    query_pool.start(thread_count);
+    return waited && WIFEXITED(status) && (WEXITSTATUS(status) != 0);
+}
+
+/**
+ * Runs TC_QUERIES at every TC level and checks the TC of every row returned.
+ * Scans of whole tables and COUNT(*) are also checked to return exactly the
+ * rows at or below the level, counted from the rows seen at the top level.
+ *
+ * @param database The database to query.
+ * @param phase    What was done to the database, for the failure messages.
+ *
+ * @return True if every query passed.
+*/
+bool check_tc_levels(vector<Table> &database, const string &phase)
+{
+    bool passed = true;
+
+    // The TC level of every row of every table, as the top level sees them
+    map<string, vector<int>> row_levels;
+    Session top_session = { .tc_level = TOP_TC_LEVEL, .format = FORMAT_CSV };
+    for (const Table &table : database)
+    {
+        int row_count = 0;
+        vector<string> lines = split_lines(run_captured("SELECT TC:1 FROM " + table.table_name + ";", database,
+                                                        top_session, row_count));
+        for (int line_idx = 1; line_idx < lines.size(); line_idx++)
+        {
+            row_levels[table.table_name].push_back(stoi(lines[line_idx]));
+        }
+    }
+
+    for (int tc_level = TOP_TC_LEVEL; tc_level >= 0; tc_level--)
+    {
+        Session session = { .tc_level = tc_level, .format = FORMAT_CSV };
+        passed = run_statements(TC_PREPARES, database, session) && passed;
+
+        for (const string &query : TC_QUERIES)
+        {
+            int row_count = 0;
+            string output = run_captured(query, database, session, row_count);
+            if (row_count < 0)
+            {
+                cout << "FAIL " << query << " at level " << tc_level << " " << phase << ": " << output;
+                passed = false;
+            }
+            passed = check_tc_rows(output, tc_level, query, phase) && passed;
+        }
+
+        for (const pair<const string, vector<int>> &table_levels : row_levels)
+        {
+            long visible_rows = count_if(table_levels.second.begin(), table_levels.second.end(),
+                                         [tc_level](int row_level) { return row_level <= tc_level; });
+
+            int scanned_rows = 0;
+            run_captured("SELECT * FROM " + table_levels.first + ";", database, session, scanned_rows);
+            int row_count = 0;
+            vector<string> count_lines = split_lines(run_captured("SELECT COUNT(*) FROM " + table_levels.first + ";",
+                                                                  database, session, row_count));
+            if ((row_count != 1) || (count_lines.size() != 2))
+                count_lines = { "", "-1" };
+
+            if ((scanned_rows != visible_rows) || (stol(count_lines[1]) != visible_rows))
+            {
+                cout << "FAIL " << table_levels.first << " at level " << tc_level << " " << phase << ": "
+                     << scanned_rows << " rows scanned and " << count_lines[1] << " counted, expected "
+                     << visible_rows << endl;
+                passed = false;
+            }
+        }
+    }
+    return passed;
+}
+
+/**
+ * Checks the TC levels of the rows of a result printed as CSV. The columns
+ * checked are TC, <table>.TC and aggregates of TC such as MAX(TC).
+ *
+ * @param output   What the query printed.
+ * @param tc_level The TC level of the session the query ran in.
+ * @param query    The query, for the failure message.
+ * @param phase    What was done to the database, for the failure message.
+ *
+ * @return True if no row is above the level.
+*/
+bool check_tc_rows(const string &output, int tc_level, const string &query, const string &phase)
+{
+    vector<string> lines = split_lines(output);
+    if (lines.empty())
+        return true;
+
+    vector<int> tc_columns;
+    vector<string> header = split_string_comma(lines[0]);
+    for (int column_idx = 0; column_idx < header.size(); column_idx++)
+    {
+        const string &name = header[column_idx];
+        if ((name == "TC") || ((name.size() > 3) && (name.compare(name.size() - 3, 3, ".TC") == 0)) ||
+            (name.find("(TC)") != string::npos))
+            tc_columns.push_back(column_idx);
+    }
+    if (tc_columns.empty())
+    {
+        cout << "FAIL " << query << " " << phase << ": no TC column in " << lines[0] << endl;
+        return false;
+    }
+
+    for (int line_idx = 1; line_idx < lines.size(); line_idx++)
+    {
+        vector<string> fields = split_string_comma(lines[line_idx]);
+        for (int column_idx : tc_columns)
+        {
+            int32_t row_level = 0;
+            if ((column_idx >= fields.size()) ||
+                !parse_int(fields[column_idx].data(), fields[column_idx].data() + fields[column_idx].size(),
+                           row_level) ||
+                (row_level > tc_level))
+            {
+                cout << "FAIL " << query << " at level " << tc_level << " " << phase << " returned: "
+                     << lines[line_idx] << endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Runs statements that must each succeed, such as PREPARE or INSERT.
+ *
+ * @param statements The statements.
+ * @param database   The database to run them on.
+ * @param session    The session to run them in.
+ *
+ * @return True if every statement ran.
+*/
+bool run_statements(const vector<string> &statements, vector<Table> &database, Session &session)
+{
+    bool passed = true;
+    for (const string &statement : statements)
+    {
+        int row_count = 0;
+        string output = run_captured(statement, database, session, row_count);
+        if (row_count < 0)
+        {
+            cout << "FAIL " << statement << ": " << output;
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+/**
+ * Runs a query and collects what it prints.
+ *
+ * @param query     The query.
+ * @param database  The database to run it on.
+ * @param session   The session to run it in.
+ * @param row_count Set to what run_query returned.
+ *
+ * @return What the query printed.
+*/
+string run_captured(const string &query, vector<Table> &database, Session &session, int &row_count)
+{
+    stringbuf output;
+    output_router.set_thread_output(&output);
+    row_count = run_query(query, database, session);
+    output_router.set_thread_output(NULL);
+    return output.str();
+}
+
+/**
+ * Splits text into its lines, without the line breaks. CSV lines end with
+ * "\r\n".
+ *
+ * @param text The text.
+ *
+ * @return The lines.
+*/
+vector<string> split_lines(const string &text)
+{
+    vector<string> lines;
+    istringstream input(text);
+    string line;
+    while (getline(input, line))
+    {
+        if (!line.empty() && (line[line.size() - 1] == '\r'))
+            line.erase(line.size() - 1);
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+/**
+ * Copies TAB_COLUMNS.csv, TAB_INDEXES.csv and the data file of every table
+ * to the scratch directory.
+ *
+ * @param scratch_dir The scratch directory.
+ *
+ * @return True if the files were copied.
+*/
+bool copy_data_files(const string &scratch_dir)
+{
+    vector<string> file_names = { "TAB_COLUMNS.csv", "TAB_INDEXES.csv" };
+    ifstream schema_file("TAB_COLUMNS.csv");
+    string input_line;
+    while (getline(schema_file, input_line))
+    {
+        string file_name = split_string_comma(input_line)[0] + ".csv";
+        if (find(file_names.begin(), file_names.end(), file_name) == file_names.end())
+            file_names.push_back(file_name);
+    }
+
+    for (const string &file_name : file_names)
+    {
+        if (!copy_file(file_name, scratch_dir + "/" + file_name))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Copies a file.
+ *
+ * @param from_name The name of the file.
+ * @param to_name   The name of the copy.
+ *
+ * @return True if the file was copied.
+*/
+bool copy_file(const string &from_name, const string &to_name)
+{
+    ifstream from_file(from_name, ios::binary);
+    ofstream to_file(to_name, ios::binary | ios::trunc);
+    if (!from_file.is_open() || !to_file.is_open())
+        return false;
+
+    to_file << from_file.rdbuf();
+    return to_file.good();
+}
+
+/**
+ * Removes the scratch directory and the files the tests left in it.
+ *
+ * @param scratch_dir The scratch directory.
+*/
+void remove_scratch_dir(const string &scratch_dir)
+{
+    DIR *directory = opendir(scratch_dir.c_str());
+    dirent *entry;
+    while ((directory != NULL) && ((entry = readdir(directory)) != NULL))
+    {
+        if ((strcmp(entry->d_name, ".") != 0) && (strcmp(entry->d_name, "..") != 0))
+            unlink((scratch_dir + "/" + entry->d_name).c_str());
+    }
+    if (directory != NULL)
+        closedir(directory);
+    rmdir(scratch_dir.c_str());
+}
+
+/**
+ * Drops every cached result. The versions of reloaded tables start over, so
+ * results cached before they were reloaded would look current.
+*/
+void clear_result_cache(void)
+{
+    size_t budget_bytes = result_cache.budget();
+    result_cache.set_budget(0);
+    result_cache.set_budget(budget_bytes);
+}
+
+/**
+ * Finds the number of hits of the result cache so far, from STATUS.
+ *
+ * @param database The database.
+ * @param session  The session to run STATUS in.
+ *
+ * @return The number of hits, -1 if STATUS did not print it.
+*/
+long cache_hits(vector<Table> &database, Session &session)
+{
+    int row_count = 0;
+    string status = run_captured("STATUS;", database, session, row_count);
+    size_t hits_end = status.find(" hits");
+    size_t hits_begin = status.rfind(' ', hits_end - 1);
+    if ((hits_end == string::npos) || (hits_begin == string::npos))
+        return -1;
+    return stol(status.substr(hits_begin + 1, hits_end - hits_begin - 1));
+}